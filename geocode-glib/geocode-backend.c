@@ -22,6 +22,8 @@
  */
 
 #include "geocode-backend.h"
+#include "geocode-error.h"
+#include "geocode-glib-private.h"
 
 /**
  * SECTION:geocode-backend
@@ -48,7 +50,9 @@
  * Custom backends can be implemented by subclassing #GeocodeBackend and
  * implementing the synchronous `forward_search` and `reverse_resolve` methods.
  * The asynchronous versions may be implemented as well; the default
- * implementations run the synchronous version in a thread.
+ * implementations run the synchronous version in a thread. The default
+ * implementation of batches of forward searches runs a few of the
+ * asynchronous searches at once.
  *
  * In order to use a custom backend, either instantiate the backend directly
  * and do forward and reverse queries on it using the #GeocodeBackend interface;
@@ -177,6 +181,80 @@ geocode_backend_forward_search (GeocodeBackend  *backend,
 	return iface->forward_search (backend, params, cancellable, error);
 }
 
+/**
+ * geocode_backend_forward_search_batch_async:
+ * @backend: a #GeocodeBackend.
+ * @params: (transfer none) (element-type GHashTable): an array of #GHashTable
+ *    with string keys and #GValue values, each the parameters of a forward
+ *    geocoding query as given to geocode_backend_forward_search_async().
+ * @cancellable: optional #GCancellable, %NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when all the queries are complete
+ * @user_data: the data to pass to the @callback function
+ *
+ * Asynchronously performs a batch of forward geocoding queries using the
+ * @backend, such as those for each of the addresses in a file. The backend
+ * may run several of the queries at once, and queries with identical
+ * parameters only once; each query gets its own results, or error, whatever
+ * those of the others.
+ *
+ * When all the queries are finished, @callback will be called. You can then
+ * call geocode_backend_forward_search_batch_finish() to get their results.
+ *
+ * Since: 3.27.1
+ */
+void
+geocode_backend_forward_search_batch_async (GeocodeBackend      *backend,
+                                            GPtrArray           *params,
+                                            GCancellable        *cancellable,
+                                            GAsyncReadyCallback  callback,
+                                            gpointer             user_data)
+{
+	GeocodeBackendInterface *iface;
+
+	g_return_if_fail (GEOCODE_IS_BACKEND (backend));
+	g_return_if_fail (params != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	iface = GEOCODE_BACKEND_GET_IFACE (backend);
+
+	(* iface->forward_search_batch_async) (backend, params, cancellable,
+	                                       callback, user_data);
+}
+
+/**
+ * geocode_backend_forward_search_batch_finish:
+ * @backend: a #GeocodeBackend.
+ * @result: a #GAsyncResult.
+ * @error: a #GError.
+ *
+ * Finishes a batch of forward geocoding queries. See
+ * geocode_backend_forward_search_batch_async().
+ *
+ * The results of each query are got with geocode_batch_results_get_places(),
+ * by the index of its parameters in the array of them. A query which fails
+ * does not fail the batch; only cancelling it does.
+ *
+ * Returns: (transfer full): the results of the queries, or %NULL if the
+ *    batch was cancelled. Free with geocode_batch_results_unref().
+ *
+ * Since: 3.27.1
+ */
+GeocodeBatchResults *
+geocode_backend_forward_search_batch_finish (GeocodeBackend  *backend,
+                                             GAsyncResult    *result,
+                                             GError         **error)
+{
+	GeocodeBackendInterface *iface;
+
+	g_return_val_if_fail (GEOCODE_IS_BACKEND (backend), NULL);
+	g_return_val_if_fail (G_IS_ASYNC_RESULT (result), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	iface = GEOCODE_BACKEND_GET_IFACE (backend);
+
+	return (* iface->forward_search_batch_finish) (backend, result, error);
+}
+
 /**
  * geocode_backend_reverse_resolve_async:
  * @backend: a #GeocodeBackend.
@@ -310,6 +388,185 @@ geocode_backend_reverse_resolve (GeocodeBackend   *backend,
 	                                   cancellable, error);
 }
 
+/* Number of queries of a batch which are run at once, unless the backend
+ * runs its batches itself. */
+#define DEFAULT_BATCH_MAX_RUNNING 4
+
+/* A cell of the grid the points of a batch of reverse geocoding queries are
+ * resolved for, and the query for it. */
+typedef struct {
+	gint64 row;
+	gint64 column;
+	guint request;
+} BatchCell;
+
+static guint
+batch_cell_hash (gconstpointer key)
+{
+	const BatchCell *cell = key;
+
+	return (guint) (cell->row * 1000003 ^ cell->column);
+}
+
+static gboolean
+batch_cell_equal (gconstpointer a,
+                  gconstpointer b)
+{
+	const BatchCell *cell_a = a, *cell_b = b;
+
+	return cell_a->row == cell_b->row && cell_a->column == cell_b->column;
+}
+
+static void
+start_batch_reverse_resolve (GeocodeBackend      *backend,
+                             const gdouble       *point,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
+{
+	g_autoptr (GHashTable) params = NULL;
+
+	params = _geocode_coordinates_to_params (point[0], point[1]);
+	geocode_backend_reverse_resolve_async (backend, params, cancellable,
+	                                       callback, user_data);
+}
+
+static GList *
+finish_batch_reverse_resolve (GeocodeBackend  *backend,
+                              GAsyncResult    *result,
+                              GError         **error)
+{
+	return geocode_backend_reverse_resolve_finish (backend, result, error);
+}
+
+/**
+ * geocode_backend_reverse_resolve_batch_async:
+ * @backend: a #GeocodeBackend.
+ * @coordinates: (array) (element-type gdouble): the latitude and longitude of each
+ *    point to resolve, in degrees, one after the other
+ * @n_points: the number of points, which is half the length of @coordinates
+ * @accuracy: the size of the areas whose points may be resolved as one, in
+ *    metres, such as %GEOCODE_LOCATION_ACCURACY_STREET; must be positive
+ * @cancellable: optional #GCancellable, %NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when all the points are resolved
+ * @user_data: the data to pass to the @callback function
+ *
+ * Asynchronously resolves each of a sequence of points, such as those of a
+ * GPS trace, to the places at them using the @backend.
+ *
+ * The points are gathered into a grid of roughly square cells @accuracy
+ * metres high, and only one point of each cell is resolved, so that runs of
+ * points close together (and points coming back to where others were) need
+ * a single query. Each point gets the places found for its cell. A few of
+ * the queries are run at once.
+ *
+ * When all the points are resolved, @callback will be called. You can then
+ * call geocode_backend_reverse_resolve_batch_finish() to get the results.
+ *
+ * Since: 3.27.1
+ */
+void
+geocode_backend_reverse_resolve_batch_async (GeocodeBackend      *backend,
+                                             const gdouble       *coordinates,
+                                             guint                n_points,
+                                             gdouble              accuracy,
+                                             GCancellable        *cancellable,
+                                             GAsyncReadyCallback  callback,
+                                             gpointer             user_data)
+{
+	GeocodeBatch *batch;
+	g_autoptr (GHashTable) cells = NULL;  /* (element-type BatchCell BatchCell) */
+	g_autofree BatchCell *cell_storage = NULL;
+	BatchCell *prev = NULL;
+	guint n_cells = 0, i;
+
+	g_return_if_fail (GEOCODE_IS_BACKEND (backend));
+	g_return_if_fail (coordinates != NULL || n_points == 0);
+	g_return_if_fail (accuracy > 0);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	batch = _geocode_batch_new (n_points,
+	                            (GeocodeBatchStartFunc) start_batch_reverse_resolve,
+	                            (GeocodeBatchFinishFunc) finish_batch_reverse_resolve);
+	cells = g_hash_table_new (batch_cell_hash, batch_cell_equal);
+	cell_storage = g_new (BatchCell, n_points);
+
+	for (i = 0; i < n_points; i++) {
+		gdouble latitude = coordinates[2 * i];
+		gdouble longitude = coordinates[2 * i + 1];
+		BatchCell *cell = &cell_storage[n_cells], *found;
+		gdouble *point;
+
+		if (!(latitude >= -90.0 && latitude <= 90.0) ||
+		    !(longitude >= -180.0 && longitude <= 180.0)) {
+			_geocode_batch_set_error (batch, i,
+			                          g_error_new (GEOCODE_ERROR,
+			                                       GEOCODE_ERROR_INVALID_ARGUMENTS,
+			                                       "Invalid coordinates: %f, %f",
+			                                       latitude, longitude));
+			continue;
+		}
+
+		_geocode_reverse_cache_get_cell (latitude, longitude, accuracy,
+		                                 &cell->row, &cell->column);
+
+		/* Successive points are most often in the same cell. */
+		if (prev != NULL && batch_cell_equal (prev, cell)) {
+			_geocode_batch_add_to_request (batch, prev->request, i);
+			continue;
+		}
+
+		found = g_hash_table_lookup (cells, cell);
+		if (found != NULL) {
+			_geocode_batch_add_to_request (batch, found->request, i);
+			prev = found;
+			continue;
+		}
+
+		point = g_new (gdouble, 2);
+		point[0] = latitude;
+		point[1] = longitude;
+
+		cell->request = _geocode_batch_add_request (batch, point, g_free, i);
+		g_hash_table_add (cells, cell);
+		prev = cell;
+		n_cells++;
+	}
+
+	_geocode_batch_run (batch, backend, DEFAULT_BATCH_MAX_RUNNING,
+	                    cancellable, callback, user_data);
+}
+
+/**
+ * geocode_backend_reverse_resolve_batch_finish:
+ * @backend: a #GeocodeBackend.
+ * @result: a #GAsyncResult.
+ * @error: a #GError.
+ *
+ * Finishes resolving a sequence of points. See
+ * geocode_backend_reverse_resolve_batch_async().
+ *
+ * The places at each point are got with geocode_batch_results_get_places(),
+ * by the index of the point in the sequence. A point which fails to resolve
+ * does not fail the batch; only cancelling it does.
+ *
+ * Returns: (transfer full): the results for the points, or %NULL if the
+ *    batch was cancelled. Free with geocode_batch_results_unref().
+ *
+ * Since: 3.27.1
+ */
+GeocodeBatchResults *
+geocode_backend_reverse_resolve_batch_finish (GeocodeBackend  *backend,
+                                              GAsyncResult    *result,
+                                              GError         **error)
+{
+	g_return_val_if_fail (GEOCODE_IS_BACKEND (backend), NULL);
+	g_return_val_if_fail (g_task_is_valid (result, backend), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	return _geocode_batch_finish (result, error);
+}
+
 /* Free a GList of GeocodePlace objects. */
 static void
 places_list_free (GList *places)
@@ -358,6 +615,57 @@ real_forward_search_finish (GeocodeBackend  *backend,
 	return g_task_propagate_pointer (G_TASK (result), error);
 }
 
+static void
+start_batch_forward_search (GeocodeBackend      *backend,
+                            GHashTable          *params,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+	geocode_backend_forward_search_async (backend, params, cancellable,
+	                                      callback, user_data);
+}
+
+static GList *
+finish_batch_forward_search (GeocodeBackend  *backend,
+                             GAsyncResult    *result,
+                             GError         **error)
+{
+	return geocode_backend_forward_search_finish (backend, result, error);
+}
+
+static void
+real_forward_search_batch_async (GeocodeBackend      *backend,
+                                 GPtrArray           *params,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+	GeocodeBatch *batch;
+	guint i;
+
+	batch = _geocode_batch_new (params->len,
+	                            (GeocodeBatchStartFunc) start_batch_forward_search,
+	                            (GeocodeBatchFinishFunc) finish_batch_forward_search);
+
+	for (i = 0; i < params->len; i++)
+		_geocode_batch_add_request (batch,
+		                            g_hash_table_ref (g_ptr_array_index (params, i)),
+		                            (GDestroyNotify) g_hash_table_unref,
+		                            i);
+
+	_geocode_batch_run (batch, backend, DEFAULT_BATCH_MAX_RUNNING,
+	                    cancellable, callback, user_data);
+}
+
+static GeocodeBatchResults *
+real_forward_search_batch_finish (GeocodeBackend  *backend,
+                                  GAsyncResult    *result,
+                                  GError         **error)
+{
+	return _geocode_batch_finish (result, error);
+}
+
 static void
 reverse_resolve_async_thread (GTask           *task,
                               GeocodeBackend  *backend,
@@ -407,4 +715,6 @@ geocode_backend_default_init (GeocodeBackendInterface *iface)
 	iface->forward_search_finish = real_forward_search_finish;
 	iface->reverse_resolve_async  = real_reverse_resolve_async;
 	iface->reverse_resolve_finish = real_reverse_resolve_finish;
+	iface->forward_search_batch_async  = real_forward_search_batch_async;
+	iface->forward_search_batch_finish = real_forward_search_batch_finish;
 }
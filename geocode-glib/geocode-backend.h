@@ -50,6 +50,37 @@ G_DECLARE_INTERFACE (GeocodeBackend, geocode_backend, GEOCODE, BACKEND, GObject)
  * Since: 3.23.1
  */
 
+/**
+ * GeocodeBatchResults:
+ *
+ * The results of a batch operation, such as
+ * geocode_backend_forward_search_batch_async(): for each of its queries,
+ * either the places found or the error it failed with. All its fields are
+ * private.
+ *
+ * Since: 3.27.1
+ */
+typedef struct _GeocodeBatchResults GeocodeBatchResults;
+
+/**
+ * GEOCODE_TYPE_BATCH_RESULTS:
+ *
+ * See #GeocodeBatchResults.
+ *
+ * Since: 3.27.1
+ */
+#define GEOCODE_TYPE_BATCH_RESULTS (geocode_batch_results_get_type ())
+
+GType                geocode_batch_results_get_type    (void) G_GNUC_CONST;
+GeocodeBatchResults *geocode_batch_results_ref         (GeocodeBatchResults  *results);
+void                 geocode_batch_results_unref       (GeocodeBatchResults  *results);
+guint                geocode_batch_results_get_n_items (GeocodeBatchResults  *results);
+GList               *geocode_batch_results_get_places  (GeocodeBatchResults  *results,
+                                                        guint                 index_,
+                                                        GError              **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GeocodeBatchResults, geocode_batch_results_unref)
+
 /**
  * GeocodeBackendInterface:
  * @forward_search: handles a synchronous forward geocoding request.
@@ -58,6 +89,10 @@ G_DECLARE_INTERFACE (GeocodeBackend, geocode_backend, GEOCODE, BACKEND, GObject)
  * @reverse_resolve: handles a synchronous reverse geocoding request.
  * @reverse_resolve_async: starts an asynchronous reverse geocoding request.
  * @reverse_resolve_finish: finishes an asynchronous reverse geocoding request.
+ * @forward_search_batch_async: starts a batch of asynchronous forward
+ *    geocoding requests. Since: 3.27.1
+ * @forward_search_batch_finish: finishes a batch of asynchronous forward
+ *    geocoding requests. Since: 3.27.1
  *
  * Interface which defines the basic operations for geocoding.
  *
@@ -98,8 +133,18 @@ struct _GeocodeBackendInterface
 	                                          GAsyncResult         *result,
 	                                          GError              **error);
 
+	/* Batch forward */
+	void                 (*forward_search_batch_async)  (GeocodeBackend       *backend,
+	                                                     GPtrArray            *params,
+	                                                     GCancellable         *cancellable,
+	                                                     GAsyncReadyCallback   callback,
+	                                                     gpointer              user_data);
+	GeocodeBatchResults *(*forward_search_batch_finish) (GeocodeBackend       *backend,
+	                                                     GAsyncResult         *result,
+	                                                     GError              **error);
+
 	/*< private >*/
-	gpointer padding[4];
+	gpointer padding[2];
 };
 
 /* Forward geocoding operations */
@@ -116,6 +161,15 @@ GList        *geocode_backend_forward_search         (GeocodeBackend      *backe
                                                       GCancellable        *cancellable,
                                                       GError             **error);
 
+void                 geocode_backend_forward_search_batch_async  (GeocodeBackend       *backend,
+                                                                  GPtrArray            *params,
+                                                                  GCancellable         *cancellable,
+                                                                  GAsyncReadyCallback   callback,
+                                                                  gpointer              user_data);
+GeocodeBatchResults *geocode_backend_forward_search_batch_finish (GeocodeBackend       *backend,
+                                                                  GAsyncResult         *result,
+                                                                  GError              **error);
+
 /* Reverse geocoding operations */
 void          geocode_backend_reverse_resolve_async  (GeocodeBackend       *backend,
                                                       GHashTable           *params,
@@ -130,6 +184,17 @@ GList        *geocode_backend_reverse_resolve        (GeocodeBackend       *back
                                                       GCancellable         *cancellable,
                                                       GError              **error);
 
+void                 geocode_backend_reverse_resolve_batch_async  (GeocodeBackend       *backend,
+                                                                   const gdouble        *coordinates,
+                                                                   guint                 n_points,
+                                                                   gdouble               accuracy,
+                                                                   GCancellable         *cancellable,
+                                                                   GAsyncReadyCallback   callback,
+                                                                   gpointer              user_data);
+GeocodeBatchResults *geocode_backend_reverse_resolve_batch_finish (GeocodeBackend       *backend,
+                                                                   GAsyncResult         *result,
+                                                                   GError              **error);
+
 G_END_DECLS
 
 #endif /* GEOCODE_BACKEND_H */
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2026 The geocode-glib authors
+ *
+ * The geocode-glib library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The geocode-glib library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "geocode-backend.h"
+#include "geocode-glib-private.h"
+
+G_DEFINE_BOXED_TYPE (GeocodeBatchResults, geocode_batch_results,
+                     geocode_batch_results_ref,
+                     geocode_batch_results_unref)
+
+/*
+ * _geocode_batch_results_new:
+ * @n_items: the number of items of the batch operation
+ *
+ * Returns: (transfer full): new results for @n_items items, each of which
+ *    has no places and no error yet
+ */
+GeocodeBatchResults *
+_geocode_batch_results_new (guint n_items)
+{
+	GeocodeBatchResults *results;
+
+	results = g_slice_new0 (GeocodeBatchResults);
+	results->ref_count = 1;
+	results->n_items = n_items;
+	results->places = g_new0 (GList *, n_items);
+	results->errors = g_new0 (GError *, n_items);
+
+	return results;
+}
+
+/**
+ * geocode_batch_results_ref:
+ * @results: a #GeocodeBatchResults
+ *
+ * Returns: (transfer full): @results
+ *
+ * Since: 3.27.1
+ */
+GeocodeBatchResults *
+geocode_batch_results_ref (GeocodeBatchResults *results)
+{
+	g_return_val_if_fail (results != NULL, NULL);
+
+	g_atomic_int_inc (&results->ref_count);
+
+	return results;
+}
+
+/**
+ * geocode_batch_results_unref:
+ * @results: (transfer full): a #GeocodeBatchResults
+ *
+ * Releases a reference to @results, freeing it if it was the last.
+ *
+ * Since: 3.27.1
+ */
+void
+geocode_batch_results_unref (GeocodeBatchResults *results)
+{
+	guint i;
+
+	g_return_if_fail (results != NULL);
+
+	if (!g_atomic_int_dec_and_test (&results->ref_count))
+		return;
+
+	for (i = 0; i < results->n_items; i++) {
+		g_list_free_full (results->places[i], g_object_unref);
+		g_clear_error (&results->errors[i]);
+	}
+
+	g_free (results->places);
+	g_free (results->errors);
+	g_slice_free (GeocodeBatchResults, results);
+}
+
+/**
+ * geocode_batch_results_get_n_items:
+ * @results: a #GeocodeBatchResults
+ *
+ * Gets the number of items of the batch operation, which is the number of
+ * queries it was given.
+ *
+ * Returns: the number of items
+ *
+ * Since: 3.27.1
+ */
+guint
+geocode_batch_results_get_n_items (GeocodeBatchResults *results)
+{
+	g_return_val_if_fail (results != NULL, 0);
+
+	return results->n_items;
+}
+
+/**
+ * geocode_batch_results_get_places:
+ * @results: a #GeocodeBatchResults
+ * @index_: the index of an item
+ * @error: return location for a #GError, or %NULL
+ *
+ * Gets the results of the query at @index_ in the batch operation, or the
+ * error it failed with, as the corresponding single query would have
+ * returned them.
+ *
+ * Returns: (element-type GeocodePlace) (transfer full): A list of places, or
+ *    %NULL if the query failed. Free the returned instances with
+ *    g_object_unref() and the list with g_list_free() when done.
+ *
+ * Since: 3.27.1
+ */
+GList *
+geocode_batch_results_get_places (GeocodeBatchResults  *results,
+                                  guint                 index_,
+                                  GError              **error)
+{
+	g_return_val_if_fail (results != NULL, NULL);
+	g_return_val_if_fail (index_ < results->n_items, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	if (results->errors[index_] != NULL) {
+		g_propagate_error (error, g_error_copy (results->errors[index_]));
+		return NULL;
+	}
+
+	return g_list_copy_deep (results->places[index_],
+	                         (GCopyFunc) g_object_ref, NULL);
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright 2026 The geocode-glib authors
+ *
+ * The geocode-glib library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The geocode-glib library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "geocode-backend.h"
+#include "geocode-glib-private.h"
+
+/*
+ * Runs the queries of a batch operation, with no more than a given number of
+ * them at once. Each query is for one or more items of the batch, which all
+ * get its results, so that identical items need only be queried once. The
+ * results are collected into a #GeocodeBatchResults, indexed by item.
+ */
+
+typedef struct {
+	GeocodeBatch *batch;  /* (unowned) */
+	gpointer data;
+	GDestroyNotify destroy;
+	GArray *indices;  /* (element-type guint) */
+} BatchRequest;
+
+struct _GeocodeBatch {
+	GTask *task;  /* (unowned) (nullable); until run */
+	GeocodeBatchStartFunc start;
+	GeocodeBatchFinishFunc finish;
+	GeocodeBatchResults *results;  /* (owned) (nullable); until returned */
+	GPtrArray *requests;  /* (element-type BatchRequest) */
+	guint next_request;
+	guint n_running;
+	guint max_running;
+};
+
+static void
+batch_request_free (BatchRequest *request)
+{
+	if (request->destroy != NULL)
+		request->destroy (request->data);
+	g_array_unref (request->indices);
+	g_slice_free (BatchRequest, request);
+}
+
+static void
+batch_free (GeocodeBatch *batch)
+{
+	if (batch->results != NULL)
+		geocode_batch_results_unref (batch->results);
+	g_ptr_array_unref (batch->requests);
+	g_slice_free (GeocodeBatch, batch);
+}
+
+/*
+ * _geocode_batch_new:
+ * @n_items: the number of items of the batch operation
+ * @start: the function starting a query
+ * @finish: the function finishing a query
+ *
+ * Returns: (transfer full): a new #GeocodeBatch, to be run with
+ *    _geocode_batch_run()
+ */
+GeocodeBatch *
+_geocode_batch_new (guint                  n_items,
+                    GeocodeBatchStartFunc  start,
+                    GeocodeBatchFinishFunc finish)
+{
+	GeocodeBatch *batch;
+
+	batch = g_slice_new0 (GeocodeBatch);
+	batch->start = start;
+	batch->finish = finish;
+	batch->results = _geocode_batch_results_new (n_items);
+	batch->requests = g_ptr_array_new_with_free_func ((GDestroyNotify) batch_request_free);
+
+	return batch;
+}
+
+/*
+ * _geocode_batch_add_request:
+ * @batch: a #GeocodeBatch
+ * @data: the data to pass to the start function for the query
+ * @destroy: (nullable): the function to free @data with
+ * @index_: the index of the item the query is for
+ *
+ * Adds a query for an item, which more items may be added to with
+ * _geocode_batch_add_to_request().
+ *
+ * Returns: the number of the query
+ */
+guint
+_geocode_batch_add_request (GeocodeBatch   *batch,
+                            gpointer        data,
+                            GDestroyNotify  destroy,
+                            guint           index_)
+{
+	BatchRequest *request;
+
+	g_return_val_if_fail (index_ < batch->results->n_items, 0);
+
+	request = g_slice_new0 (BatchRequest);
+	request->batch = batch;
+	request->data = data;
+	request->destroy = destroy;
+	request->indices = g_array_new (FALSE, FALSE, sizeof (guint));
+	g_array_append_val (request->indices, index_);
+
+	g_ptr_array_add (batch->requests, request);
+
+	return batch->requests->len - 1;
+}
+
+/*
+ * _geocode_batch_add_to_request:
+ * @batch: a #GeocodeBatch
+ * @request: the number of a query, as returned by _geocode_batch_add_request()
+ * @index_: the index of an item the query is also for
+ */
+void
+_geocode_batch_add_to_request (GeocodeBatch *batch,
+                               guint         request,
+                               guint         index_)
+{
+	g_return_if_fail (request < batch->requests->len);
+	g_return_if_fail (index_ < batch->results->n_items);
+
+	g_array_append_val (((BatchRequest *) g_ptr_array_index (batch->requests, request))->indices,
+	                    index_);
+}
+
+/*
+ * _geocode_batch_set_error:
+ * @batch: a #GeocodeBatch
+ * @index_: the index of an item which is not queried
+ * @error: (transfer full): the error the item failed with
+ */
+void
+_geocode_batch_set_error (GeocodeBatch *batch,
+                          guint         index_,
+                          GError       *error)
+{
+	g_return_if_fail (index_ < batch->results->n_items);
+
+	g_clear_error (&batch->results->errors[index_]);
+	batch->results->errors[index_] = error;
+}
+
+/* Gives the items of @request its places, or @error, taking ownership of
+ * them. Each item gets places of its own. */
+static void
+batch_request_set_results (BatchRequest *request,
+                           GList        *places,
+                           GError       *error)
+{
+	GeocodeBatchResults *results = request->batch->results;
+	guint i;
+
+	for (i = 0; i < request->indices->len; i++) {
+		guint index_ = g_array_index (request->indices, guint, i);
+
+		if (error != NULL) {
+			results->errors[index_] = (i == request->indices->len - 1) ?
+			                          error : g_error_copy (error);
+		} else if (i == request->indices->len - 1) {
+			results->places[index_] = places;
+		} else {
+			GList *l;
+
+			for (l = places; l != NULL; l = l->next)
+				results->places[index_] = g_list_prepend (results->places[index_],
+				                                          _geocode_place_dup (l->data));
+			results->places[index_] = g_list_reverse (results->places[index_]);
+		}
+	}
+}
+
+static void batch_start_requests (GTask *task);
+
+static void
+on_request_ready (GObject      *source_object,
+                  GAsyncResult *result,
+                  BatchRequest *request)
+{
+	GeocodeBatch *batch = request->batch;
+	GTask *task = batch->task;
+	GList *places;
+	GError *error = NULL;
+
+	places = batch->finish (source_object, result, &error);
+	batch_request_set_results (request, places, error);
+
+	batch->n_running--;
+	batch_start_requests (task);
+
+	/* Each running query holds a reference on the task. */
+	g_object_unref (task);
+}
+
+static void
+batch_start_requests (GTask *task)
+{
+	GeocodeBatch *batch = g_task_get_task_data (task);
+	GCancellable *cancellable = g_task_get_cancellable (task);
+
+	while (batch->next_request < batch->requests->len &&
+	       batch->n_running < batch->max_running) {
+		BatchRequest *request = g_ptr_array_index (batch->requests,
+		                                           batch->next_request++);
+		GError *error = NULL;
+
+		if (g_cancellable_set_error_if_cancelled (cancellable, &error)) {
+			batch_request_set_results (request, NULL, error);
+			continue;
+		}
+
+		batch->n_running++;
+		batch->start (g_task_get_source_object (task), request->data,
+		              cancellable,
+		              (GAsyncReadyCallback) on_request_ready,
+		              request);
+		g_object_ref (task);
+	}
+
+	if (batch->n_running == 0 && batch->next_request == batch->requests->len &&
+	    batch->results != NULL) {
+		g_task_return_pointer (task, g_steal_pointer (&batch->results),
+		                       (GDestroyNotify) geocode_batch_results_unref);
+	}
+}
+
+/*
+ * _geocode_batch_run:
+ * @batch: (transfer full): a #GeocodeBatch
+ * @source_object: the object to pass to the start and finish functions
+ * @max_running: the largest number of queries to run at once
+ * @cancellable: (nullable): a #GCancellable, which is passed to each query
+ * @callback: the function to call once all the queries have completed
+ * @user_data: the data to pass to @callback
+ *
+ * Runs the queries of @batch, in the order they were added. Finish with
+ * _geocode_batch_finish().
+ */
+void
+_geocode_batch_run (GeocodeBatch        *batch,
+                    gpointer             source_object,
+                    guint                max_running,
+                    GCancellable        *cancellable,
+                    GAsyncReadyCallback  callback,
+                    gpointer             user_data)
+{
+	GTask *task;
+
+	g_return_if_fail (max_running > 0);
+
+	task = g_task_new (source_object, cancellable, callback, user_data);
+	g_task_set_source_tag (task, _geocode_batch_run);
+	g_task_set_task_data (task, batch, (GDestroyNotify) batch_free);
+
+	batch->task = task;
+	batch->max_running = max_running;
+
+	batch_start_requests (task);
+	g_object_unref (task);
+}
+
+/*
+ * _geocode_batch_finish:
+ * @result: the #GAsyncResult passed to the callback of _geocode_batch_run()
+ * @error: return location for a #GError, or %NULL
+ *
+ * Returns: (transfer full): the results of the queries, or %NULL if the
+ *    batch operation was cancelled
+ */
+GeocodeBatchResults *
+_geocode_batch_finish (GAsyncResult  *result,
+                       GError       **error)
+{
+	g_return_val_if_fail (g_async_result_is_tagged (result, _geocode_batch_run), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -0,0 +1,1701 @@
+/*
+ * Copyright 2026 The geocode-glib authors
+ *
+ * The geocode-glib library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The geocode-glib library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#include "geocode-glib-private.h"
+
+/*
+ * The on-disk query cache, stored in two files in the cache directory:
+ *
+ *  - `cache.data` is an append-only log of records, each holding a cache key,
+ *    the cached response, its expiry time and a checksum of all three.
+ *    Replacing an entry appends a new record; the old one becomes garbage
+ *    until the file is compacted.
+ *
+ *  - `cache.index` is an open-addressing hash table, with linear probing,
+ *    mapping key hashes to record offsets in the data file. It is mapped
+ *    shared into memory, so a lookup is a probe of the mapping followed by
+ *    reading a single record, without any per-lookup open() or stat().
+ *
+ * The files may be shared by several processes: all access is done with an
+ * flock() on the index file held (shared for lookups, exclusive for
+ * modifications). The index is never replaced, only grown in place, so all
+ * processes always map the same file. The data file is replaced when it is
+ * compacted; this bumps the generation counter stored in both files, which
+ * other processes notice and reopen the data file.
+ *
+ * Appends are crash-safe without an fsync() per write: the index header
+ * records how much of the data file is committed, so a torn append past that
+ * is truncated away when the store is next opened; and every record is
+ * checksummed, so a record whose data did not make it to disk is treated as
+ * a miss. Operations which rewrite more than one slot of the index (growing
+ * it and compaction) mark the index as dirty while they run, and a dirty
+ * index is rebuilt by scanning the data file when the store is next opened.
+ *
+ * The store is kept within limits on the number of entries and the size of
+ * their records by a CLOCK approximation of LRU eviction: lookups set a
+ * referenced bit on their slot, and the clock hand sweeps the index, evicting
+ * expired entries and, while the store is over its limits, entries whose
+ * referenced bit is clear, clearing it on the others. Evicted slots are
+ * removed by shifting the rest of their probe sequence back, so the index
+ * never fills up with tombstones. The sweep is incremental so that it can be
+ * run in small batches without holding the lock for long; see
+ * _geocode_cache_store_evict().
+ *
+ * Values may be compressed; each record is tagged with the codec used for it
+ * (see #GeocodeCacheCodec), so changing the codec only affects new records,
+ * and records written with any supported codec can be read. A compressed
+ * value is prefixed with its uncompressed length, as a little-endian 32-bit
+ * integer. Values which do not shrink when compressed are stored as they are.
+ * Size limits apply to the stored, compressed, size of records.
+ */
+
+#define DATA_MAGIC "GCGDATA2"
+#define INDEX_MAGIC "GCGINDX2"
+#define RECORD_MAGIC 0x43524347  /* "GCRC" */
+#define FORMAT_VERSION 2
+
+#define INITIAL_SLOTS 1024
+#define MAX_LOAD_PERCENT 70
+
+/* Don’t bother compacting data files smaller than this. */
+#define COMPACTION_MIN_SIZE (1024 * 1024)
+
+#define INDEX_FLAG_DIRTY (1 << 0)
+
+#define SLOT_FLAG_REFERENCED (1 << 0)
+
+typedef struct {
+	char magic[8];
+	guint64 generation;
+} DataHeader;
+
+typedef struct {
+	guint32 magic;
+	guint32 key_len;
+	guint32 value_len;  /* as stored, so compressed if @codec is set */
+	guint32 codec;  /* a GeocodeCacheCodec */
+	guint64 expires;  /* in seconds since the epoch, or 0 for never */
+	guint64 checksum;  /* of the key, value and expiry time */
+} RecordHeader;
+
+typedef struct {
+	char magic[8];
+	guint32 version;
+	guint32 flags;
+	guint64 generation;
+	guint64 data_size;  /* committed length of the data file */
+	guint64 live_bytes;  /* length of the records referenced by slots */
+	guint32 n_slots;  /* always a power of two */
+	guint32 n_used;
+	guint32 clock_hand;
+	guint32 reserved;
+} IndexHeader;
+
+typedef struct {
+	guint64 hash;  /* 0 for an empty slot */
+	guint64 offset;
+	guint64 expires;  /* copied from the record */
+	guint32 size;  /* of the record */
+	guint32 flags;
+} IndexSlot;
+
+struct _GeocodeCacheStore {
+	GMutex lock;
+
+	char *data_path;
+	char *index_path;
+	int data_fd;
+	int index_fd;
+
+	/* The generation of the data file open as @data_fd. */
+	guint64 data_generation;
+
+	/* Shared mapping of the index file. */
+	IndexHeader *header;
+	gsize map_size;
+
+	/* Eviction settings for this process. */
+	guint64 max_bytes;
+	guint max_entries;
+	guint sweep_remaining;
+
+	/* Codec for new records. Accessed atomically. */
+	gint codec;
+};
+
+/* FNV-1a, which is fast, and good enough both for hashing keys and for
+ * detecting torn or corrupted records. */
+static guint64
+fnv1a (guint64       hash,
+       gconstpointer data,
+       gsize         len)
+{
+	const guchar *p = data;
+	gsize i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= G_GUINT64_CONSTANT (0x100000001b3);
+	}
+
+	return hash;
+}
+
+#define FNV1A_INIT G_GUINT64_CONSTANT (0xcbf29ce484222325)
+
+static guint64
+hash_key (const char *key,
+          gsize       key_len)
+{
+	guint64 hash = fnv1a (FNV1A_INIT, key, key_len);
+
+	/* 0 marks an empty slot. */
+	return (hash != 0) ? hash : 1;
+}
+
+static guint64
+record_checksum (const char *key,
+                 gsize       key_len,
+                 const char *value,
+                 gsize       value_len,
+                 guint64     expires)
+{
+	guint64 hash;
+
+	hash = fnv1a (FNV1A_INIT, key, key_len);
+	hash = fnv1a (hash, value, value_len);
+
+	return fnv1a (hash, &expires, sizeof (expires));
+}
+
+static guint64
+now_seconds (void)
+{
+	return g_get_real_time () / G_USEC_PER_SEC;
+}
+
+static inline gboolean
+is_expired (guint64 expires,
+            guint64 now)
+{
+	return (expires != 0 && expires <= now);
+}
+
+static inline IndexSlot *
+get_slots (GeocodeCacheStore *store)
+{
+	return (IndexSlot *) (store->header + 1);
+}
+
+static gsize
+index_size_for_slots (guint32 n_slots)
+{
+	return sizeof (IndexHeader) + (gsize) n_slots * sizeof (IndexSlot);
+}
+
+static void
+set_error_from_errno (GError     **error,
+                      int          saved_errno,
+                      const char  *message,
+                      const char  *path)
+{
+	g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+	             "%s '%s': %s", message, path, g_strerror (saved_errno));
+}
+
+static gboolean
+lock_index (GeocodeCacheStore *store,
+            int                operation)
+{
+	while (flock (store->index_fd, operation) < 0) {
+		if (errno != EINTR) {
+			g_warning ("Failed to lock cache index '%s': %s",
+			           store->index_path, g_strerror (errno));
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static void
+unlock_index (GeocodeCacheStore *store)
+{
+	flock (store->index_fd, LOCK_UN);
+}
+
+static gboolean
+pread_all (int       fd,
+           gpointer  buf,
+           gsize     len,
+           guint64   offset)
+{
+	guchar *p = buf;
+
+	while (len > 0) {
+		gssize n = pread (fd, p, len, offset);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return FALSE;
+
+		p += n;
+		len -= n;
+		offset += n;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+pwrite_all (int           fd,
+            gconstpointer buf,
+            gsize         len,
+            guint64       offset)
+{
+	const guchar *p = buf;
+
+	while (len > 0) {
+		gssize n = pwrite (fd, p, len, offset);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return FALSE;
+
+		p += n;
+		len -= n;
+		offset += n;
+	}
+
+	return TRUE;
+}
+
+/* Maps @n_slots worth of index file, replacing any existing mapping. The file
+ * must already be at least that large. */
+static gboolean
+map_index (GeocodeCacheStore  *store,
+           guint32             n_slots,
+           GError            **error)
+{
+	gsize size = index_size_for_slots (n_slots);
+	gpointer map;
+
+	map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+	            store->index_fd, 0);
+	if (map == MAP_FAILED) {
+		set_error_from_errno (error, errno, "Failed to map cache index",
+		                      store->index_path);
+		return FALSE;
+	}
+
+	if (store->header != NULL)
+		munmap (store->header, store->map_size);
+
+	store->header = map;
+	store->map_size = size;
+
+	return TRUE;
+}
+
+/* Resizes the index file to @n_slots and maps it, with all slots empty. */
+static gboolean
+reset_index (GeocodeCacheStore  *store,
+             guint32             n_slots,
+             GError            **error)
+{
+	if (ftruncate (store->index_fd, index_size_for_slots (n_slots)) < 0) {
+		set_error_from_errno (error, errno, "Failed to resize cache index",
+		                      store->index_path);
+		return FALSE;
+	}
+
+	if (!map_index (store, n_slots, error))
+		return FALSE;
+
+	memset (get_slots (store), 0, (gsize) n_slots * sizeof (IndexSlot));
+	store->header->n_slots = n_slots;
+	store->header->n_used = 0;
+	store->header->live_bytes = 0;
+	store->header->clock_hand = 0;
+
+	return TRUE;
+}
+
+/* Writes a fresh data file header, discarding any existing records. */
+static gboolean
+reset_data (GeocodeCacheStore  *store,
+            guint64             generation,
+            GError            **error)
+{
+	DataHeader header;
+
+	memcpy (header.magic, DATA_MAGIC, sizeof (header.magic));
+	header.generation = generation;
+
+	if (ftruncate (store->data_fd, 0) < 0 ||
+	    !pwrite_all (store->data_fd, &header, sizeof (header), 0)) {
+		set_error_from_errno (error, errno, "Failed to reset cache data",
+		                      store->data_path);
+		return FALSE;
+	}
+
+	store->data_generation = generation;
+
+	return TRUE;
+}
+
+/* Runs @converter over all of @in, returning the output, or %NULL on error.
+ * @expected_len is a hint for the size of the output. */
+static GBytes *
+convert_all (GConverter   *converter,
+             const guint8 *in,
+             gsize         in_len,
+             gsize         expected_len)
+{
+	g_autofree guint8 *out = NULL;
+	gsize out_len = 0, out_size, in_pos = 0;
+	GConverterResult result;
+
+	out_size = MAX (expected_len, 64);
+	out = g_malloc (out_size);
+
+	do {
+		gsize bytes_read, bytes_written;
+		g_autoptr(GError) error = NULL;
+
+		result = g_converter_convert (converter,
+		                              in + in_pos, in_len - in_pos,
+		                              out + out_len, out_size - out_len,
+		                              G_CONVERTER_INPUT_AT_END,
+		                              &bytes_read, &bytes_written,
+		                              &error);
+
+		if (result == G_CONVERTER_ERROR) {
+			if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE))
+				return NULL;
+
+			out_size *= 2;
+			out = g_realloc (out, out_size);
+			continue;
+		}
+
+		in_pos += bytes_read;
+		out_len += bytes_written;
+	} while (result != G_CONVERTER_FINISHED);
+
+	return g_bytes_new_take (g_steal_pointer (&out), out_len);
+}
+
+/* Compresses @value with @codec, prefixed with its length. Returns %NULL if
+ * @codec is %GEOCODE_CACHE_CODEC_NONE, or if compressing does not make @value
+ * smaller. */
+static GBytes *
+compress_value (GeocodeCacheCodec  codec,
+                GBytes            *value)
+{
+	g_autofree guint8 *out = NULL;
+	const guint8 *data;
+	gsize len, out_len;
+	guint32 len_le;
+
+	data = g_bytes_get_data (value, &len);
+
+	/* Not worth it for tiny values. */
+	if (codec == GEOCODE_CACHE_CODEC_NONE || len < 64 || len > G_MAXINT32)
+		return NULL;
+
+	switch (codec) {
+	case GEOCODE_CACHE_CODEC_ZLIB: {
+		g_autoptr(GConverter) compressor = NULL;
+		g_autoptr(GBytes) compressed = NULL;
+		const guint8 *compressed_data;
+
+		compressor = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW, -1));
+		compressed = convert_all (compressor, data, len, len / 2);
+		if (compressed == NULL)
+			return NULL;
+
+		compressed_data = g_bytes_get_data (compressed, &out_len);
+		out = g_malloc (sizeof (len_le) + out_len);
+		memcpy (out + sizeof (len_le), compressed_data, out_len);
+		break;
+	}
+#ifdef HAVE_LZ4
+	case GEOCODE_CACHE_CODEC_LZ4: {
+		int bound, compressed_len;
+
+		bound = LZ4_compressBound (len);
+		out = g_malloc (sizeof (len_le) + bound);
+		compressed_len = LZ4_compress_default ((const char *) data,
+		                                       (char *) out + sizeof (len_le),
+		                                       len, bound);
+		if (compressed_len <= 0)
+			return NULL;
+
+		out_len = compressed_len;
+		break;
+	}
+#endif
+	case GEOCODE_CACHE_CODEC_NONE:
+	default:
+		return NULL;
+	}
+
+	if (sizeof (len_le) + out_len >= len)
+		return NULL;
+
+	len_le = GUINT32_TO_LE (len);
+	memcpy (out, &len_le, sizeof (len_le));
+
+	return g_bytes_new_take (g_steal_pointer (&out), sizeof (len_le) + out_len);
+}
+
+/* Reverses compress_value(). Returns %NULL if @stored is corrupt, or was
+ * compressed with a codec which is not supported. */
+static GBytes *
+decompress_value (guint32  codec,
+                  GBytes  *stored)
+{
+	const guint8 *data;
+	gsize len;
+	guint32 len_le, value_len;
+
+	if (codec == GEOCODE_CACHE_CODEC_NONE)
+		return g_bytes_ref (stored);
+
+	data = g_bytes_get_data (stored, &len);
+	if (len < sizeof (len_le))
+		return NULL;
+
+	memcpy (&len_le, data, sizeof (len_le));
+	value_len = GUINT32_FROM_LE (len_le);
+	data += sizeof (len_le);
+	len -= sizeof (len_le);
+
+	switch (codec) {
+	case GEOCODE_CACHE_CODEC_ZLIB: {
+		g_autoptr(GConverter) decompressor = NULL;
+		g_autoptr(GBytes) value = NULL;
+
+		decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW));
+		value = convert_all (decompressor, data, len, value_len);
+		if (value == NULL || g_bytes_get_size (value) != value_len)
+			return NULL;
+
+		return g_steal_pointer (&value);
+	}
+#ifdef HAVE_LZ4
+	case GEOCODE_CACHE_CODEC_LZ4: {
+		g_autofree char *out = NULL;
+
+		if (value_len > G_MAXINT32)
+			return NULL;
+
+		out = g_malloc (MAX (value_len, 1));
+		if (LZ4_decompress_safe ((const char *) data, out, len,
+		                         value_len) != (int) value_len)
+			return NULL;
+
+		return g_bytes_new_take (g_steal_pointer (&out), value_len);
+	}
+#endif
+	default:
+		return NULL;
+	}
+}
+
+/* Reads and validates the record at @offset. @key and @value are optional;
+ * the checksum is only verified if @value is requested. */
+static gboolean
+read_record (GeocodeCacheStore  *store,
+             guint64             offset,
+             RecordHeader       *header,
+             char              **key,
+             GBytes            **value)
+{
+	g_autofree char *buf = NULL;
+	gsize len;
+
+	if (!pread_all (store->data_fd, header, sizeof (*header), offset) ||
+	    header->magic != RECORD_MAGIC)
+		return FALSE;
+
+	if (key == NULL && value == NULL)
+		return TRUE;
+
+	len = (gsize) header->key_len + ((value != NULL) ? header->value_len : 0);
+	if (offset + sizeof (*header) + len > store->header->data_size)
+		return FALSE;
+
+	buf = g_malloc (len);
+	if (!pread_all (store->data_fd, buf, len, offset + sizeof (*header)))
+		return FALSE;
+
+	if (value != NULL &&
+	    record_checksum (buf, header->key_len,
+	                     buf + header->key_len,
+	                     header->value_len,
+	                     header->expires) != header->checksum)
+		return FALSE;
+
+	if (key != NULL)
+		*key = g_strndup (buf, header->key_len);
+
+	/* The value is returned as a view of the buffer it was read into. */
+	if (value != NULL) {
+		g_autoptr(GBytes) bytes = g_bytes_new_take (g_steal_pointer (&buf), len);
+
+		*value = g_bytes_new_from_bytes (bytes, header->key_len,
+		                                 header->value_len);
+	}
+
+	return TRUE;
+}
+
+/* Finds the slot holding @key, or if it is not in the index, the empty slot
+ * where it would be inserted. */
+static IndexSlot *
+find_slot (GeocodeCacheStore *store,
+           guint64            hash,
+           const char        *key,
+           gsize              key_len,
+           gboolean          *found)
+{
+	IndexSlot *slots = get_slots (store);
+	guint32 mask = store->header->n_slots - 1;
+	guint32 i;
+
+	*found = FALSE;
+
+	for (i = hash & mask; slots[i].hash != 0; i = (i + 1) & mask) {
+		RecordHeader header;
+		g_autofree char *slot_key = NULL;
+
+		if (slots[i].hash != hash)
+			continue;
+
+		if (read_record (store, slots[i].offset, &header, &slot_key, NULL) &&
+		    header.key_len == key_len &&
+		    memcmp (slot_key, key, key_len) == 0) {
+			*found = TRUE;
+			break;
+		}
+	}
+
+	return &slots[i];
+}
+
+static gsize
+record_size (const RecordHeader *header)
+{
+	return sizeof (*header) + header->key_len + header->value_len;
+}
+
+/* Points the index at the record at @offset, replacing any existing record
+ * for the same key. The index must have room for a new slot. */
+static void
+index_record (GeocodeCacheStore  *store,
+              const char         *key,
+              guint64             offset,
+              const RecordHeader *header)
+{
+	guint64 hash = hash_key (key, header->key_len);
+	IndexSlot *slot;
+	gboolean found;
+
+	slot = find_slot (store, hash, key, header->key_len, &found);
+
+	if (found) {
+		store->header->live_bytes -= slot->size;
+	} else {
+		store->header->n_used++;
+	}
+
+	slot->offset = offset;
+	slot->expires = header->expires;
+	slot->size = record_size (header);
+	slot->flags = SLOT_FLAG_REFERENCED;
+
+	/* Write the hash last, as it marks the slot as used. */
+	slot->hash = hash;
+
+	store->header->live_bytes += slot->size;
+}
+
+/* Removes the entry in slot @i, shifting back any following entries in its
+ * probe sequence to fill the hole. */
+static void
+remove_slot (GeocodeCacheStore *store,
+             guint32            i)
+{
+	IndexSlot *slots = get_slots (store);
+	guint32 mask = store->header->n_slots - 1;
+	guint32 j;
+
+	store->header->live_bytes -= slots[i].size;
+	store->header->n_used--;
+
+	for (j = (i + 1) & mask; slots[j].hash != 0; j = (j + 1) & mask) {
+		guint32 home = slots[j].hash & mask;
+
+		/* The entry at @j can fill the hole at @i unless its home slot
+		 * lies cyclically in (@i, @j]. */
+		if ((i <= j) ? (home <= i || home > j) : (home <= i && home > j)) {
+			slots[i] = slots[j];
+			i = j;
+		}
+	}
+
+	memset (&slots[i], 0, sizeof (IndexSlot));
+}
+
+/* Rehashes the index into @n_slots slots. The index is inconsistent while
+ * this runs, so callers must mark it as dirty. Must be called with the index
+ * locked exclusively. */
+static gboolean
+resize_index (GeocodeCacheStore  *store,
+              guint32             n_slots,
+              GError            **error)
+{
+	g_autofree IndexSlot *old_slots = NULL;
+	guint32 old_n_slots = store->header->n_slots;
+	guint64 live_bytes = store->header->live_bytes;
+	IndexSlot *slots;
+	guint32 mask, i;
+
+	old_slots = g_memdup (get_slots (store), old_n_slots * sizeof (IndexSlot));
+
+	if (!reset_index (store, n_slots, error))
+		return FALSE;
+
+	slots = get_slots (store);
+	mask = n_slots - 1;
+
+	for (i = 0; i < old_n_slots; i++) {
+		guint32 j;
+
+		if (old_slots[i].hash == 0)
+			continue;
+
+		for (j = old_slots[i].hash & mask; slots[j].hash != 0; j = (j + 1) & mask);
+		slots[j] = old_slots[i];
+		store->header->n_used++;
+	}
+
+	store->header->live_bytes = live_bytes;
+
+	return TRUE;
+}
+
+/* Rebuilds the index by scanning the data file, truncating it at the first
+ * invalid record. Must be called with the index locked exclusively. */
+static gboolean
+rebuild_index (GeocodeCacheStore  *store,
+               GError            **error)
+{
+	DataHeader data_header;
+	guint64 offset = sizeof (DataHeader);
+	guint64 now;
+	struct stat st;
+
+	g_debug ("Rebuilding cache index '%s'", store->index_path);
+
+	if (fstat (store->data_fd, &st) < 0) {
+		set_error_from_errno (error, errno, "Failed to stat cache data",
+		                      store->data_path);
+		return FALSE;
+	}
+
+	if (!pread_all (store->data_fd, &data_header, sizeof (data_header), 0) ||
+	    memcmp (data_header.magic, DATA_MAGIC, sizeof (data_header.magic)) != 0) {
+		if (!reset_data (store, g_get_real_time (), error))
+			return FALSE;
+		data_header.generation = store->data_generation;
+		st.st_size = sizeof (DataHeader);
+	}
+
+	store->data_generation = data_header.generation;
+
+	memcpy (store->header->magic, INDEX_MAGIC, sizeof (store->header->magic));
+	store->header->version = FORMAT_VERSION;
+	store->header->flags |= INDEX_FLAG_DIRTY;
+
+	if (!reset_index (store, INITIAL_SLOTS, error))
+		return FALSE;
+
+	/* Let read_record() read anything in the file while scanning. */
+	store->header->data_size = st.st_size;
+	now = now_seconds ();
+
+	while (offset + sizeof (RecordHeader) <= (guint64) st.st_size) {
+		RecordHeader header;
+		g_autofree char *key = NULL;
+		g_autoptr(GBytes) value = NULL;
+
+		if (!read_record (store, offset, &header, &key, &value))
+			break;
+
+		offset += record_size (&header);
+
+		if (is_expired (header.expires, now))
+			continue;
+
+		if ((guint64) (store->header->n_used + 1) * 100 >
+		    (guint64) store->header->n_slots * MAX_LOAD_PERCENT &&
+		    !resize_index (store, store->header->n_slots * 2, error))
+			return FALSE;
+
+		index_record (store, key, offset - record_size (&header), &header);
+	}
+
+	if (offset < (guint64) st.st_size) {
+		g_debug ("Truncating cache data '%s' from %" G_GUINT64_FORMAT
+		         " to %" G_GUINT64_FORMAT " bytes", store->data_path,
+		         (guint64) st.st_size, offset);
+		if (ftruncate (store->data_fd, offset) < 0) {
+			set_error_from_errno (error, errno,
+			                      "Failed to truncate cache data",
+			                      store->data_path);
+			return FALSE;
+		}
+	}
+
+	store->header->data_size = offset;
+	store->header->generation = store->data_generation;
+	store->header->flags &= ~INDEX_FLAG_DIRTY;
+
+	return TRUE;
+}
+
+static gboolean
+open_data_file (GeocodeCacheStore  *store,
+                GError            **error)
+{
+	DataHeader header;
+	int fd;
+
+	fd = g_open (store->data_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		set_error_from_errno (error, errno, "Failed to open cache data",
+		                      store->data_path);
+		return FALSE;
+	}
+
+	if (store->data_fd >= 0)
+		close (store->data_fd);
+	store->data_fd = fd;
+
+	if (pread_all (fd, &header, sizeof (header), 0) &&
+	    memcmp (header.magic, DATA_MAGIC, sizeof (header.magic)) == 0)
+		store->data_generation = header.generation;
+	else
+		store->data_generation = 0;
+
+	return TRUE;
+}
+
+/* Picks up changes made by other processes since the index was last locked:
+ * a grown index, or a compacted data file. Returns %FALSE if the store is not
+ * usable until it has been repaired with the index locked exclusively. */
+static gboolean
+refresh (GeocodeCacheStore *store)
+{
+	GError *error = NULL;
+
+	if (index_size_for_slots (store->header->n_slots) != store->map_size &&
+	    !map_index (store, store->header->n_slots, &error)) {
+		g_warning ("%s", error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	if (store->header->generation != store->data_generation &&
+	    !open_data_file (store, &error)) {
+		g_warning ("%s", error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	return ((store->header->flags & INDEX_FLAG_DIRTY) == 0 &&
+	        store->header->generation == store->data_generation);
+}
+
+/* Removes the files left by the one-file-per-query cache used by earlier
+ * versions, which are named after the SHA-256 of their query URI. */
+static void
+remove_legacy_cache_files (const char *directory)
+{
+	GDir *dir;
+	const char *name;
+
+	dir = g_dir_open (directory, 0, NULL);
+	if (dir == NULL)
+		return;
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		g_autofree char *path = NULL;
+		gsize i;
+
+		if (strlen (name) != 64)
+			continue;
+
+		for (i = 0; i < 64 && g_ascii_isxdigit (name[i]); i++);
+		if (i < 64)
+			continue;
+
+		path = g_build_filename (directory, name, NULL);
+		g_unlink (path);
+	}
+
+	g_dir_close (dir);
+}
+
+/*
+ * _geocode_cache_store_open:
+ * @directory: directory to store the cache files in
+ * @error: return location for a #GError
+ *
+ * Opens the cache store in @directory, creating it if needed, and repairing
+ * it if it was left inconsistent by a crash.
+ *
+ * Returns: (transfer full): the store, or %NULL on error
+ */
+GeocodeCacheStore *
+_geocode_cache_store_open (const char  *directory,
+                           GError     **error)
+{
+	GeocodeCacheStore *store;
+	IndexHeader header;
+	gboolean valid;
+	struct stat st = { 0, };
+
+	g_return_val_if_fail (directory != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	if (g_mkdir_with_parents (directory, 0700) < 0) {
+		set_error_from_errno (error, errno,
+		                      "Failed to create cache directory",
+		                      directory);
+		return NULL;
+	}
+
+	store = g_new0 (GeocodeCacheStore, 1);
+	g_mutex_init (&store->lock);
+	store->data_path = g_build_filename (directory, "cache.data", NULL);
+	store->index_path = g_build_filename (directory, "cache.index", NULL);
+	store->data_fd = -1;
+	store->max_bytes = G_MAXUINT64;
+	store->max_entries = G_MAXUINT;
+
+	store->index_fd = g_open (store->index_path,
+	                          O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (store->index_fd < 0) {
+		set_error_from_errno (error, errno, "Failed to open cache index",
+		                      store->index_path);
+		_geocode_cache_store_free (store);
+		return NULL;
+	}
+
+	if (!lock_index (store, LOCK_EX)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+		             "Failed to lock cache index '%s'", store->index_path);
+		_geocode_cache_store_free (store);
+		return NULL;
+	}
+
+	if (!open_data_file (store, error))
+		goto error;
+
+	/* Validate the index header before trusting its size. */
+	valid = (fstat (store->index_fd, &st) == 0 &&
+	         pread_all (store->index_fd, &header, sizeof (header), 0) &&
+	         memcmp (header.magic, INDEX_MAGIC, sizeof (header.magic)) == 0 &&
+	         header.version == FORMAT_VERSION &&
+	         header.n_slots >= INITIAL_SLOTS &&
+	         (header.n_slots & (header.n_slots - 1)) == 0 &&
+	         (guint64) st.st_size == index_size_for_slots (header.n_slots));
+
+	if (!valid) {
+		if (st.st_size == 0)
+			remove_legacy_cache_files (directory);
+
+		if (!reset_index (store, INITIAL_SLOTS, error))
+			goto error;
+		memset (store->header, 0, sizeof (IndexHeader));
+		store->header->n_slots = INITIAL_SLOTS;
+	} else if (!map_index (store, header.n_slots, error)) {
+		goto error;
+	}
+
+	if (fstat (store->data_fd, &st) < 0) {
+		set_error_from_errno (error, errno, "Failed to stat cache data",
+		                      store->data_path);
+		goto error;
+	}
+
+	if (!valid ||
+	    (store->header->flags & INDEX_FLAG_DIRTY) != 0 ||
+	    store->header->generation != store->data_generation ||
+	    store->header->data_size < sizeof (DataHeader) ||
+	    store->header->data_size > (guint64) st.st_size) {
+		if (!rebuild_index (store, error))
+			goto error;
+	} else if (store->header->data_size < (guint64) st.st_size) {
+		/* Drop a torn append. */
+		if (ftruncate (store->data_fd, store->header->data_size) < 0) {
+			set_error_from_errno (error, errno,
+			                      "Failed to truncate cache data",
+			                      store->data_path);
+			goto error;
+		}
+	}
+
+	unlock_index (store);
+
+	return store;
+
+error:
+	unlock_index (store);
+	_geocode_cache_store_free (store);
+
+	return NULL;
+}
+
+void
+_geocode_cache_store_free (GeocodeCacheStore *store)
+{
+	if (store == NULL)
+		return;
+
+	if (store->header != NULL)
+		munmap (store->header, store->map_size);
+	if (store->data_fd >= 0)
+		close (store->data_fd);
+	if (store->index_fd >= 0)
+		close (store->index_fd);
+
+	g_free (store->data_path);
+	g_free (store->index_path);
+	g_mutex_clear (&store->lock);
+	g_free (store);
+}
+
+/*
+ * _geocode_cache_store_lookup:
+ * @store: a #GeocodeCacheStore
+ * @key: canonical cache key
+ * @value: (out) (transfer full): return location for the cached value
+ *
+ * Looks up @key in the store.
+ *
+ * Returns: %TRUE if @key was found, %FALSE otherwise
+ */
+gboolean
+_geocode_cache_store_lookup (GeocodeCacheStore  *store,
+                             const char         *key,
+                             GBytes            **value)
+{
+	gsize key_len;
+	IndexSlot *slot;
+	gboolean found = FALSE;
+	RecordHeader header;
+	g_autoptr(GBytes) stored = NULL;
+
+	g_return_val_if_fail (store != NULL, FALSE);
+	g_return_val_if_fail (key != NULL, FALSE);
+	g_return_val_if_fail (value != NULL, FALSE);
+
+	key_len = strlen (key);
+
+	g_mutex_lock (&store->lock);
+
+	if (!lock_index (store, LOCK_SH)) {
+		g_mutex_unlock (&store->lock);
+		return FALSE;
+	}
+
+	if (refresh (store)) {
+		slot = find_slot (store, hash_key (key, key_len), key, key_len,
+		                  &found);
+
+		/* Expired entries are left for the eviction sweep. */
+		if (found && is_expired (slot->expires, now_seconds ()))
+			found = FALSE;
+
+		if (found)
+			found = read_record (store, slot->offset, &header, NULL,
+			                     &stored);
+
+		/* Only a shared lock is held, so other processes may be
+		 * setting this bit concurrently. */
+		if (found)
+			g_atomic_int_or (&slot->flags, SLOT_FLAG_REFERENCED);
+	}
+
+	unlock_index (store);
+	g_mutex_unlock (&store->lock);
+
+	if (!found)
+		return FALSE;
+
+	/* Decompress after dropping the locks. */
+	*value = decompress_value (header.codec, stored);
+
+	return (*value != NULL);
+}
+
+/* Rewrites the data file with only the records referenced by the index.
+ * Must be called with the index locked exclusively. */
+static gboolean
+compact (GeocodeCacheStore  *store,
+         GError            **error)
+{
+	g_autofree char *new_path = NULL;
+	g_autofree guint64 *new_offsets = NULL;
+	IndexSlot *slots = get_slots (store);
+	DataHeader data_header;
+	guint64 offset = sizeof (DataHeader);
+	guint32 i;
+	int fd;
+
+	g_debug ("Compacting cache data '%s'", store->data_path);
+
+	new_path = g_strconcat (store->data_path, ".new", NULL);
+	fd = g_open (new_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		set_error_from_errno (error, errno, "Failed to open cache data",
+		                      new_path);
+		return FALSE;
+	}
+
+	memcpy (data_header.magic, DATA_MAGIC, sizeof (data_header.magic));
+	data_header.generation = store->data_generation + 1;
+
+	if (!pwrite_all (fd, &data_header, sizeof (data_header), 0))
+		goto error;
+
+	/* Copy the live records across, without touching the index until the
+	 * new file is safely in place. */
+	new_offsets = g_new0 (guint64, store->header->n_slots);
+
+	for (i = 0; i < store->header->n_slots; i++) {
+		RecordHeader header;
+		g_autofree char *buf = NULL;
+		gsize size;
+
+		if (slots[i].hash == 0)
+			continue;
+
+		/* Its offset stays 0, which is the data file header, and the
+		 * slot is removed below. */
+		if (!read_record (store, slots[i].offset, &header, NULL, NULL))
+			continue;
+
+		size = record_size (&header);
+		buf = g_malloc (size);
+
+		if (!pread_all (store->data_fd, buf, size, slots[i].offset)) {
+			errno = EIO;
+			goto error;
+		}
+		if (!pwrite_all (fd, buf, size, offset))
+			goto error;
+
+		new_offsets[i] = offset;
+		offset += size;
+	}
+
+	if (fsync (fd) < 0)
+		goto error;
+
+	store->header->flags |= INDEX_FLAG_DIRTY;
+
+	if (g_rename (new_path, store->data_path) < 0)
+		goto error_dirty;
+
+	close (store->data_fd);
+	store->data_fd = fd;
+	store->data_generation = data_header.generation;
+
+	for (i = 0; i < store->header->n_slots; i++) {
+		if (slots[i].hash != 0)
+			slots[i].offset = new_offsets[i];
+	}
+
+	/* Remove the entries whose records could not be read, and so were not
+	 * copied. Removing one may shift another into its slot. */
+	for (i = 0; i < store->header->n_slots; i++) {
+		while (slots[i].hash != 0 && slots[i].offset == 0)
+			remove_slot (store, i);
+	}
+
+	store->header->data_size = offset;
+	store->header->live_bytes = offset - sizeof (DataHeader);
+	store->header->generation = store->data_generation;
+	store->header->flags &= ~INDEX_FLAG_DIRTY;
+
+	return TRUE;
+
+error_dirty:
+	store->header->flags &= ~INDEX_FLAG_DIRTY;
+error:
+	set_error_from_errno (error, errno, "Failed to write cache data",
+	                      new_path);
+	close (fd);
+	g_unlink (new_path);
+
+	return FALSE;
+}
+
+static gboolean
+needs_compaction (GeocodeCacheStore *store)
+{
+	return (store->header->data_size > COMPACTION_MIN_SIZE &&
+	        store->header->live_bytes < store->header->data_size / 2);
+}
+
+/*
+ * _geocode_cache_store_insert:
+ * @store: a #GeocodeCacheStore
+ * @key: canonical cache key
+ * @value: the value to cache for @key
+ * @expires: time when the entry expires, in seconds since the epoch, or 0
+ *    for it to never expire
+ * @error: return location for a #GError
+ *
+ * Appends @value to the store under @key, replacing any existing entry.
+ * The data file is compacted when more than half of it is garbage.
+ *
+ * This does not evict anything if the store goes over its limits; use
+ * _geocode_cache_store_is_over_limits() and _geocode_cache_store_evict().
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+_geocode_cache_store_insert (GeocodeCacheStore  *store,
+                             const char         *key,
+                             GBytes             *value,
+                             guint64             expires,
+                             GError            **error)
+{
+	g_autofree char *buf = NULL;
+	g_autoptr(GBytes) stored = NULL;
+	RecordHeader header;
+	GeocodeCacheCodec codec;
+	const char *value_data;
+	gsize key_len, value_len, size;
+	guint64 offset;
+	gboolean ret = FALSE;
+
+	g_return_val_if_fail (store != NULL, FALSE);
+	g_return_val_if_fail (key != NULL, FALSE);
+	g_return_val_if_fail (value != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* Compress before taking any locks. */
+	codec = g_atomic_int_get (&store->codec);
+	stored = compress_value (codec, value);
+	if (stored == NULL) {
+		codec = GEOCODE_CACHE_CODEC_NONE;
+		stored = g_bytes_ref (value);
+	}
+
+	key_len = strlen (key);
+	value_data = g_bytes_get_data (stored, &value_len);
+
+	if (key_len > G_MAXUINT32 || value_len > G_MAXUINT32) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+		             "Cache entry too large");
+		return FALSE;
+	}
+
+	header.magic = RECORD_MAGIC;
+	header.key_len = key_len;
+	header.value_len = value_len;
+	header.codec = codec;
+	header.expires = expires;
+	header.checksum = record_checksum (key, key_len, value_data, value_len,
+	                                   expires);
+
+	size = sizeof (header) + key_len + value_len;
+	buf = g_malloc (size);
+	memcpy (buf, &header, sizeof (header));
+	memcpy (buf + sizeof (header), key, key_len);
+	memcpy (buf + sizeof (header) + key_len, value_data, value_len);
+
+	g_mutex_lock (&store->lock);
+
+	if (!lock_index (store, LOCK_EX)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+		             "Failed to lock cache index '%s'", store->index_path);
+		g_mutex_unlock (&store->lock);
+		return FALSE;
+	}
+
+	if (!refresh (store) && !rebuild_index (store, error))
+		goto out;
+
+	if ((guint64) (store->header->n_used + 1) * 100 >
+	    (guint64) store->header->n_slots * MAX_LOAD_PERCENT) {
+		store->header->flags |= INDEX_FLAG_DIRTY;
+		if (!resize_index (store, store->header->n_slots * 2, error))
+			goto out;
+		store->header->flags &= ~INDEX_FLAG_DIRTY;
+	}
+
+	offset = store->header->data_size;
+
+	if (!pwrite_all (store->data_fd, buf, size, offset)) {
+		set_error_from_errno (error, errno, "Failed to write cache data",
+		                      store->data_path);
+		goto out;
+	}
+
+	/* Commit the record by publishing it in the index. */
+	store->header->data_size = offset + size;
+	index_record (store, key, offset, &header);
+
+	if (needs_compaction (store)) {
+		GError *local_error = NULL;
+
+		/* The insertion itself succeeded, so don’t fail it. */
+		if (!compact (store, &local_error)) {
+			g_warning ("%s", local_error->message);
+			g_error_free (local_error);
+		}
+	}
+
+	ret = TRUE;
+
+out:
+	unlock_index (store);
+	g_mutex_unlock (&store->lock);
+
+	return ret;
+}
+
+/*
+ * _geocode_cache_store_sync:
+ * @store: a #GeocodeCacheStore
+ * @error: return location for a #GError
+ *
+ * Flushes the data file and then the index to disk, so that all entries
+ * inserted so far survive a crash. Inserting does not do this itself, so that
+ * the cost of syncing can be shared by a batch of insertions.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+_geocode_cache_store_sync (GeocodeCacheStore  *store,
+                           GError            **error)
+{
+	gboolean ret = FALSE;
+
+	g_return_val_if_fail (store != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	g_mutex_lock (&store->lock);
+
+	if (!lock_index (store, LOCK_SH)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+		             "Failed to lock cache index '%s'", store->index_path);
+		g_mutex_unlock (&store->lock);
+		return FALSE;
+	}
+
+	refresh (store);
+
+	/* Sync the data before the index, so that the index never commits
+	 * records which are not on disk. */
+	if (fsync (store->data_fd) < 0) {
+		set_error_from_errno (error, errno, "Failed to sync cache data",
+		                      store->data_path);
+		goto out;
+	}
+
+	if (msync (store->header, store->map_size, MS_SYNC) < 0) {
+		set_error_from_errno (error, errno, "Failed to sync cache index",
+		                      store->index_path);
+		goto out;
+	}
+
+	ret = TRUE;
+
+out:
+	unlock_index (store);
+	g_mutex_unlock (&store->lock);
+
+	return ret;
+}
+
+/*
+ * _geocode_cache_store_compact:
+ * @store: a #GeocodeCacheStore
+ * @error: return location for a #GError
+ *
+ * Rewrites the data file to drop replaced records, regardless of how much of
+ * it is garbage.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+_geocode_cache_store_compact (GeocodeCacheStore  *store,
+                              GError            **error)
+{
+	gboolean ret;
+
+	g_return_val_if_fail (store != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	g_mutex_lock (&store->lock);
+
+	if (!lock_index (store, LOCK_EX)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+		             "Failed to lock cache index '%s'", store->index_path);
+		g_mutex_unlock (&store->lock);
+		return FALSE;
+	}
+
+	ret = ((refresh (store) || rebuild_index (store, error)) &&
+	       compact (store, error));
+
+	unlock_index (store);
+	g_mutex_unlock (&store->lock);
+
+	return ret;
+}
+
+/*
+ * _geocode_cache_store_codec_is_supported:
+ * @codec: a #GeocodeCacheCodec
+ *
+ * Checks whether this build of the library supports @codec.
+ *
+ * Returns: %TRUE if @codec is supported, %FALSE otherwise
+ */
+gboolean
+_geocode_cache_store_codec_is_supported (GeocodeCacheCodec codec)
+{
+	switch (codec) {
+	case GEOCODE_CACHE_CODEC_NONE:
+	case GEOCODE_CACHE_CODEC_ZLIB:
+		return TRUE;
+	case GEOCODE_CACHE_CODEC_LZ4:
+#ifdef HAVE_LZ4
+		return TRUE;
+#else
+		return FALSE;
+#endif
+	default:
+		return FALSE;
+	}
+}
+
+/*
+ * _geocode_cache_store_set_codec:
+ * @store: a #GeocodeCacheStore
+ * @codec: a supported #GeocodeCacheCodec
+ *
+ * Sets the codec used to compress new entries. Existing entries are left as
+ * they are, and can still be read.
+ */
+void
+_geocode_cache_store_set_codec (GeocodeCacheStore *store,
+                                GeocodeCacheCodec  codec)
+{
+	g_return_if_fail (store != NULL);
+	g_return_if_fail (_geocode_cache_store_codec_is_supported (codec));
+
+	g_atomic_int_set (&store->codec, codec);
+}
+
+/*
+ * _geocode_cache_store_set_limits:
+ * @store: a #GeocodeCacheStore
+ * @max_bytes: maximum total size of the entries, in bytes
+ * @max_entries: maximum number of entries
+ *
+ * Sets the limits which eviction keeps the store within. They apply to this
+ * process only: if several processes share the store, the smallest limits
+ * win over time.
+ */
+void
+_geocode_cache_store_set_limits (GeocodeCacheStore *store,
+                                 guint64            max_bytes,
+                                 guint              max_entries)
+{
+	g_return_if_fail (store != NULL);
+
+	g_mutex_lock (&store->lock);
+	store->max_bytes = max_bytes;
+	store->max_entries = max_entries;
+	g_mutex_unlock (&store->lock);
+}
+
+/* Must be called with the index locked. */
+static gboolean
+is_over_limits (GeocodeCacheStore *store)
+{
+	return (store->header->live_bytes > store->max_bytes ||
+	        store->header->n_used > store->max_entries);
+}
+
+/*
+ * _geocode_cache_store_is_over_limits:
+ * @store: a #GeocodeCacheStore
+ *
+ * Checks whether the store has grown past the limits set with
+ * _geocode_cache_store_set_limits(), and so needs entries evicting. This is
+ * only advisory: it does not lock the index against other processes.
+ *
+ * Returns: %TRUE if the store is over its limits, %FALSE otherwise
+ */
+gboolean
+_geocode_cache_store_is_over_limits (GeocodeCacheStore *store)
+{
+	gboolean ret;
+
+	g_return_val_if_fail (store != NULL, FALSE);
+
+	g_mutex_lock (&store->lock);
+	ret = is_over_limits (store);
+	g_mutex_unlock (&store->lock);
+
+	return ret;
+}
+
+/* Advances the clock hand by up to @max_steps slots, evicting expired
+ * entries, and unreferenced entries while the store is over its limits.
+ * Returns the number of steps taken. Must be called with the index locked
+ * exclusively. */
+static guint
+run_clock (GeocodeCacheStore *store,
+           guint              max_steps)
+{
+	IndexSlot *slots = get_slots (store);
+	guint32 mask = store->header->n_slots - 1;
+	guint64 now = now_seconds ();
+	guint steps;
+
+	/* Removing a slot may shift several others. */
+	store->header->flags |= INDEX_FLAG_DIRTY;
+
+	for (steps = 0; steps < max_steps && store->header->n_used > 0; steps++) {
+		guint32 hand = store->header->clock_hand & mask;
+		IndexSlot *slot = &slots[hand];
+
+		if (slot->hash != 0 &&
+		    (is_expired (slot->expires, now) ||
+		     (is_over_limits (store) &&
+		      (slot->flags & SLOT_FLAG_REFERENCED) == 0))) {
+			/* Another entry may have been shifted into this slot,
+			 * so look at it again without moving the hand. */
+			remove_slot (store, hand);
+			continue;
+		}
+
+		if (slot->hash != 0 && is_over_limits (store))
+			slot->flags &= ~SLOT_FLAG_REFERENCED;
+
+		store->header->clock_hand = (hand + 1) & mask;
+	}
+
+	store->header->flags &= ~INDEX_FLAG_DIRTY;
+
+	return steps;
+}
+
+/*
+ * _geocode_cache_store_request_sweep:
+ * @store: a #GeocodeCacheStore
+ *
+ * Requests that subsequent calls to _geocode_cache_store_evict() sweep the
+ * whole index once, to evict expired entries even if the store is within its
+ * limits.
+ */
+void
+_geocode_cache_store_request_sweep (GeocodeCacheStore *store)
+{
+	g_return_if_fail (store != NULL);
+
+	g_mutex_lock (&store->lock);
+	store->sweep_remaining = store->header->n_slots;
+	g_mutex_unlock (&store->lock);
+}
+
+/*
+ * _geocode_cache_store_evict:
+ * @store: a #GeocodeCacheStore
+ * @max_steps: maximum number of index slots to examine
+ *
+ * Runs one incremental step of eviction, examining at most @max_steps slots
+ * of the index, and compacts the data file if eviction has left too much
+ * garbage in it. This is meant to be called repeatedly from a background
+ * thread, so that the store is never locked for long.
+ *
+ * Returns: %TRUE if there is more eviction work to do, %FALSE otherwise
+ */
+gboolean
+_geocode_cache_store_evict (GeocodeCacheStore *store,
+                            guint              max_steps)
+{
+	GError *error = NULL;
+	gboolean more = FALSE;
+	guint steps;
+
+	g_return_val_if_fail (store != NULL, FALSE);
+
+	g_mutex_lock (&store->lock);
+
+	if (!lock_index (store, LOCK_EX)) {
+		g_mutex_unlock (&store->lock);
+		return FALSE;
+	}
+
+	if (!refresh (store) && !rebuild_index (store, &error))
+		goto out;
+
+	steps = run_clock (store, max_steps);
+	store->sweep_remaining -= MIN (steps, store->sweep_remaining);
+
+	if (needs_compaction (store) && !compact (store, &error))
+		goto out;
+
+	more = (store->header->n_used > 0 &&
+	        (is_over_limits (store) || store->sweep_remaining > 0));
+
+out:
+	if (error != NULL) {
+		g_warning ("Failed to evict from cache: %s", error->message);
+		g_error_free (error);
+	}
+
+	unlock_index (store);
+	g_mutex_unlock (&store->lock);
+
+	return more;
+}
+
+/*
+ * _geocode_cache_store_trim:
+ * @store: a #GeocodeCacheStore
+ * @error: return location for a #GError
+ *
+ * Synchronously evicts all expired entries, evicts entries until the store is
+ * within its limits, and compacts the data file to release the space they
+ * used.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+_geocode_cache_store_trim (GeocodeCacheStore  *store,
+                           GError            **error)
+{
+	gboolean ret = FALSE;
+
+	g_return_val_if_fail (store != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	g_mutex_lock (&store->lock);
+
+	if (!lock_index (store, LOCK_EX)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+		             "Failed to lock cache index '%s'", store->index_path);
+		g_mutex_unlock (&store->lock);
+		return FALSE;
+	}
+
+	if (!refresh (store) && !rebuild_index (store, error))
+		goto out;
+
+	/* One full revolution evicts everything expired; after that, each
+	 * revolution clears or evicts every referenced entry, so two more
+	 * always bring the store within its limits. */
+	run_clock (store, store->header->n_slots);
+	while (is_over_limits (store) && store->header->n_used > 0)
+		run_clock (store, store->header->n_slots);
+
+	store->sweep_remaining = 0;
+
+	if (store->header->data_size > sizeof (DataHeader) + store->header->live_bytes &&
+	    !compact (store, error))
+		goto out;
+
+	ret = TRUE;
+
+out:
+	unlock_index (store);
+	g_mutex_unlock (&store->lock);
+
+	return ret;
+}
+
+/*
+ * _geocode_cache_store_get_stats:
+ * @store: a #GeocodeCacheStore
+ * @n_entries: (out) (optional): return location for the number of entries
+ * @data_size: (out) (optional): return location for the size of the data
+ *    file, in bytes
+ * @live_bytes: (out) (optional): return location for the number of bytes of
+ *    the data file used by current entries
+ *
+ * Gets statistics about the store.
+ */
+void
+_geocode_cache_store_get_stats (GeocodeCacheStore *store,
+                                guint             *n_entries,
+                                guint64           *data_size,
+                                guint64           *live_bytes)
+{
+	g_return_if_fail (store != NULL);
+
+	g_mutex_lock (&store->lock);
+
+	if (lock_index (store, LOCK_SH)) {
+		refresh (store);
+
+		if (n_entries != NULL)
+			*n_entries = store->header->n_used;
+		if (data_size != NULL)
+			*data_size = store->header->data_size;
+		if (live_bytes != NULL)
+			*live_bytes = store->header->live_bytes;
+
+		unlock_index (store);
+	}
+
+	g_mutex_unlock (&store->lock);
+}
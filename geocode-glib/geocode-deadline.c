@@ -0,0 +1,204 @@
+/*
+ * Copyright 2026 The geocode-glib authors
+ *
+ * The geocode-glib library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The geocode-glib library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "geocode-glib-private.h"
+
+/*
+ * Bounds how long an operation may take, by cancelling it once a timeout
+ * expires. The operation is given a cancellable which is cancelled either by
+ * the timeout or by the caller's own cancellable, so backends need no support
+ * for deadlines beyond honouring cancellation; the resulting cancellation
+ * error is turned into a timeout error afterwards.
+ *
+ * Timeouts are dispatched from a main context serviced by a thread of its own,
+ * so that they also fire while a synchronous operation blocks the caller's
+ * thread.
+ */
+
+struct _GeocodeDeadline {
+	gint ref_count;
+	GCancellable *cancellable;  /* (owned) */
+	GCancellable *parent;  /* (owned) (nullable) */
+	gulong parent_cancelled_id;
+	GSource *timeout;  /* (owned) */
+	gint expired;  /* accessed atomically */
+};
+
+static gpointer
+run_deadline_context (gpointer data)
+{
+	GMainContext *context = data;
+
+	while (TRUE)
+		g_main_context_iteration (context, TRUE);
+
+	return NULL;
+}
+
+static GMainContext *
+get_deadline_context (void)
+{
+	static gsize initialized = 0;
+	static GMainContext *context = NULL;
+
+	if (g_once_init_enter (&initialized)) {
+		context = g_main_context_new ();
+		g_thread_unref (g_thread_new ("geocode-deadline",
+		                              run_deadline_context, context));
+		g_once_init_leave (&initialized, 1);
+	}
+
+	return context;
+}
+
+static GeocodeDeadline *
+deadline_ref (GeocodeDeadline *deadline)
+{
+	g_atomic_int_inc (&deadline->ref_count);
+	return deadline;
+}
+
+static void
+deadline_unref (GeocodeDeadline *deadline)
+{
+	if (!g_atomic_int_dec_and_test (&deadline->ref_count))
+		return;
+
+	g_object_unref (deadline->cancellable);
+	g_clear_object (&deadline->parent);
+	g_source_unref (deadline->timeout);
+	g_slice_free (GeocodeDeadline, deadline);
+}
+
+static gboolean
+on_deadline_expired (GeocodeDeadline *deadline)
+{
+	g_atomic_int_set (&deadline->expired, TRUE);
+	g_cancellable_cancel (deadline->cancellable);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+on_parent_cancelled (GCancellable *parent,
+                     GCancellable *cancellable)
+{
+	g_cancellable_cancel (cancellable);
+}
+
+/*
+ * _geocode_deadline_new:
+ * @timeout: time allowed for the operation, in milliseconds; must be non-zero
+ * @cancellable: (nullable): the caller's #GCancellable
+ *
+ * Starts a deadline for an operation, which should be passed the cancellable
+ * from _geocode_deadline_get_cancellable().
+ *
+ * Returns: (transfer full): a new #GeocodeDeadline
+ */
+GeocodeDeadline *
+_geocode_deadline_new (guint         timeout,
+                       GCancellable *cancellable)
+{
+	GeocodeDeadline *deadline;
+
+	g_return_val_if_fail (timeout > 0, NULL);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
+
+	deadline = g_slice_new0 (GeocodeDeadline);
+	deadline->ref_count = 1;
+	deadline->cancellable = g_cancellable_new ();
+
+	if (cancellable != NULL) {
+		deadline->parent = g_object_ref (cancellable);
+		deadline->parent_cancelled_id =
+		    g_cancellable_connect (cancellable,
+		                           G_CALLBACK (on_parent_cancelled),
+		                           deadline->cancellable, NULL);
+	}
+
+	deadline->timeout = g_timeout_source_new (timeout);
+	g_source_set_callback (deadline->timeout,
+	                       (GSourceFunc) on_deadline_expired,
+	                       deadline_ref (deadline),
+	                       (GDestroyNotify) deadline_unref);
+	g_source_attach (deadline->timeout, get_deadline_context ());
+
+	return deadline;
+}
+
+/*
+ * _geocode_deadline_free:
+ * @deadline: a #GeocodeDeadline
+ *
+ * Stops @deadline, once the operation has completed.
+ */
+void
+_geocode_deadline_free (GeocodeDeadline *deadline)
+{
+	if (deadline->parent != NULL)
+		g_cancellable_disconnect (deadline->parent,
+		                          deadline->parent_cancelled_id);
+
+	g_source_destroy (deadline->timeout);
+	deadline_unref (deadline);
+}
+
+/*
+ * _geocode_deadline_get_cancellable:
+ * @deadline: a #GeocodeDeadline
+ *
+ * Gets the cancellable to pass to the operation, which is cancelled when
+ * @deadline expires or the caller's cancellable is cancelled.
+ *
+ * Returns: (transfer none): a #GCancellable
+ */
+GCancellable *
+_geocode_deadline_get_cancellable (GeocodeDeadline *deadline)
+{
+	return deadline->cancellable;
+}
+
+/*
+ * _geocode_deadline_check_error:
+ * @deadline: a #GeocodeDeadline
+ * @error: (inout) (optional) (nullable): the error the operation failed with
+ *
+ * Replaces the %G_IO_ERROR_CANCELLED error the operation failed with by a
+ * %G_IO_ERROR_TIMED_OUT one if it was cancelled because @deadline expired,
+ * rather than by the caller.
+ */
+void
+_geocode_deadline_check_error (GeocodeDeadline  *deadline,
+                               GError          **error)
+{
+	if (error == NULL || *error == NULL ||
+	    !g_error_matches (*error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+	    !g_atomic_int_get (&deadline->expired) ||
+	    g_cancellable_is_cancelled (deadline->parent))
+		return;
+
+	g_clear_error (error);
+	g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+	                     "The geocoding operation timed out");
+}
@@ -0,0 +1,360 @@
+/*
+ * Copyright 2026 The geocode-glib authors
+ *
+ * The geocode-glib library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The geocode-glib library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "geocode-glib-private.h"
+
+/*
+ * Gives the places resulting from a search names which tell them apart, by
+ * appending to each name those parts of its address (its country, state and so
+ * on, down to its suburb) which differ from those of other places.
+ *
+ * The places are grouped by the value of each part of their address in turn,
+ * ignoring ASCII case, into a tree: a group for each value of the first part,
+ * within each of those a group for each value of the second part, and so on.
+ * A place which lacks a part is in a group of its own for it. A value is
+ * added to the name of the places in its group if a group next to it, before
+ * or after, has a value too. The places are returned in the order of the
+ * tree, so that places with the same address are together.
+ *
+ * As when the groups were found by going through them in turn, stopping at
+ * the first which lacks a value, a place is put in that group rather than
+ * one for its value which comes after it, or a new one. This loses parts of
+ * the names of some places, but is kept so that names do not change.
+ *
+ * The groups are kept in a flat array, with a hash table to find the group for
+ * a value within its parent group, so that adding a place takes constant time
+ * for each part of its address.
+ */
+
+#define NONE G_MAXUINT
+
+typedef struct {
+	char *value;  /* (nullable); as given for the first of its places */
+	guint parent;  /* NONE for the root */
+	guint prev, next;  /* siblings, or NONE */
+	guint first_child, last_child;  /* groups, or places at the last level */
+	guint first_without_value;  /* child group, or NONE */
+} Group;
+
+typedef struct {
+	GeocodePlace *place;  /* (owned) until finished */
+	guint next;  /* next place in the same group, or NONE */
+} Entry;
+
+struct _GeocodeDisambiguator {
+	guint n_levels;
+	GArray *groups;  /* (element-type Group); the root is the first */
+	GArray *entries;  /* (element-type Entry) */
+	guint *slots;  /* open addressed hash table of group index + 1, or 0 */
+	guint n_slots;  /* a power of two */
+	guint n_hashed;
+	gboolean finished;
+};
+
+#define GROUP(d, i) (&g_array_index ((d)->groups, Group, (i)))
+#define ENTRY(d, i) (&g_array_index ((d)->entries, Entry, (i)))
+
+/*
+ * _geocode_disambiguator_new:
+ * @n_levels: the number of parts of the address of each place
+ *
+ * Returns: (transfer full): a new #GeocodeDisambiguator
+ */
+GeocodeDisambiguator *
+_geocode_disambiguator_new (guint n_levels)
+{
+	GeocodeDisambiguator *disambiguator;
+	Group root = { NULL, NONE, NONE, NONE, NONE, NONE, NONE };
+
+	disambiguator = g_slice_new0 (GeocodeDisambiguator);
+	disambiguator->n_levels = n_levels;
+	disambiguator->groups = g_array_new (FALSE, FALSE, sizeof (Group));
+	disambiguator->entries = g_array_new (FALSE, FALSE, sizeof (Entry));
+	disambiguator->n_slots = 64;
+	disambiguator->slots = g_new0 (guint, disambiguator->n_slots);
+
+	g_array_append_val (disambiguator->groups, root);
+
+	return disambiguator;
+}
+
+/*
+ * _geocode_disambiguator_free:
+ * @disambiguator: a #GeocodeDisambiguator
+ *
+ * Frees @disambiguator, and the places added to it unless they were returned
+ * by _geocode_disambiguator_finish().
+ */
+void
+_geocode_disambiguator_free (GeocodeDisambiguator *disambiguator)
+{
+	guint i;
+
+	for (i = 0; i < disambiguator->groups->len; i++)
+		g_free (GROUP (disambiguator, i)->value);
+
+	if (!disambiguator->finished) {
+		for (i = 0; i < disambiguator->entries->len; i++)
+			g_object_unref (ENTRY (disambiguator, i)->place);
+	}
+
+	g_array_unref (disambiguator->groups);
+	g_array_unref (disambiguator->entries);
+	g_free (disambiguator->slots);
+	g_slice_free (GeocodeDisambiguator, disambiguator);
+}
+
+static guint
+hash_group (guint       parent,
+            const char *value)
+{
+	guint32 hash = 2166136261u ^ parent;
+
+	for (; *value != '\0'; value++)
+		hash = (hash ^ (guchar) g_ascii_tolower (*value)) * 16777619u;
+
+	return hash;
+}
+
+static void
+grow_slots (GeocodeDisambiguator *disambiguator)
+{
+	guint *old_slots = disambiguator->slots;
+	guint old_n_slots = disambiguator->n_slots, i;
+
+	disambiguator->n_slots *= 2;
+	disambiguator->slots = g_new0 (guint, disambiguator->n_slots);
+
+	for (i = 0; i < old_n_slots; i++) {
+		Group *group;
+		guint slot;
+
+		if (old_slots[i] == 0)
+			continue;
+
+		group = GROUP (disambiguator, old_slots[i] - 1);
+		slot = hash_group (group->parent, group->value) & (disambiguator->n_slots - 1);
+		while (disambiguator->slots[slot] != 0)
+			slot = (slot + 1) & (disambiguator->n_slots - 1);
+		disambiguator->slots[slot] = old_slots[i];
+	}
+
+	g_free (old_slots);
+}
+
+/* Appends a new group for @value, which takes ownership of it, to the
+ * children of @parent. */
+static guint
+append_group (GeocodeDisambiguator *disambiguator,
+              guint                 parent,
+              char                 *value)
+{
+	Group group = { value, parent, NONE, NONE, NONE, NONE, NONE };
+	guint index = disambiguator->groups->len;
+
+	group.prev = GROUP (disambiguator, parent)->last_child;
+	g_array_append_val (disambiguator->groups, group);
+
+	if (group.prev != NONE)
+		GROUP (disambiguator, group.prev)->next = index;
+	else
+		GROUP (disambiguator, parent)->first_child = index;
+	GROUP (disambiguator, parent)->last_child = index;
+
+	return index;
+}
+
+/* Finds the group for @value within @parent, creating it if need be. */
+static guint
+find_group (GeocodeDisambiguator *disambiguator,
+            guint                 parent,
+            const char           *value)
+{
+	guint first_without_value, slot, index;
+
+	first_without_value = GROUP (disambiguator, parent)->first_without_value;
+
+	if (value == NULL) {
+		index = append_group (disambiguator, parent, NULL);
+		if (first_without_value == NONE)
+			GROUP (disambiguator, parent)->first_without_value = index;
+		return index;
+	}
+
+	slot = hash_group (parent, value) & (disambiguator->n_slots - 1);
+
+	while (disambiguator->slots[slot] != 0) {
+		Group *group = GROUP (disambiguator, disambiguator->slots[slot] - 1);
+
+		if (group->parent == parent &&
+		    g_ascii_strcasecmp (group->value, value) == 0) {
+			index = disambiguator->slots[slot] - 1;
+
+			/* Groups are numbered in order within their parent. */
+			return MIN (index, first_without_value);
+		}
+
+		slot = (slot + 1) & (disambiguator->n_slots - 1);
+	}
+
+	if (first_without_value != NONE)
+		return first_without_value;
+
+	index = append_group (disambiguator, parent, g_strdup (value));
+	disambiguator->slots[slot] = index + 1;
+
+	if (++disambiguator->n_hashed * 2 > disambiguator->n_slots)
+		grow_slots (disambiguator);
+
+	return index;
+}
+
+/*
+ * _geocode_disambiguator_add:
+ * @disambiguator: a #GeocodeDisambiguator
+ * @place: (transfer full): a place
+ * @values: (array): the parts of the address of @place, from the largest, of
+ *    which there are as many as levels; each may be %NULL
+ *
+ * Adds a place to be named.
+ */
+void
+_geocode_disambiguator_add (GeocodeDisambiguator  *disambiguator,
+                            GeocodePlace          *place,
+                            const char           **values)
+{
+	Entry entry = { place, NONE };
+	guint group = 0, index, i;
+	Group *last;
+
+	g_return_if_fail (!disambiguator->finished);
+
+	for (i = 0; i < disambiguator->n_levels; i++)
+		group = find_group (disambiguator, group, values[i]);
+
+	index = disambiguator->entries->len;
+	g_array_append_val (disambiguator->entries, entry);
+
+	last = GROUP (disambiguator, group);
+	if (last->last_child != NONE)
+		ENTRY (disambiguator, last->last_child)->next = index;
+	else
+		last->first_child = index;
+	last->last_child = index;
+}
+
+/*
+ * _geocode_disambiguator_get_n_places:
+ * @disambiguator: a #GeocodeDisambiguator
+ *
+ * Returns: the number of places added
+ */
+guint
+_geocode_disambiguator_get_n_places (GeocodeDisambiguator *disambiguator)
+{
+	return disambiguator->entries->len;
+}
+
+static gboolean
+group_has_value (GeocodeDisambiguator *disambiguator,
+                 guint                 index)
+{
+	return index != NONE && GROUP (disambiguator, index)->value != NULL;
+}
+
+static void
+name_places (GeocodeDisambiguator  *disambiguator,
+             guint                  index,
+             guint                  level,
+             const char           **labels,
+             guint                  n_labels,
+             GString               *name,
+             GList                **places)
+{
+	Group *group = GROUP (disambiguator, index);
+	guint child;
+
+	if (group->value != NULL &&
+	    (group_has_value (disambiguator, group->prev) ||
+	     group_has_value (disambiguator, group->next)))
+		labels[n_labels++] = group->value;
+
+	if (level < disambiguator->n_levels) {
+		for (child = group->first_child; child != NONE; child = GROUP (disambiguator, child)->next)
+			name_places (disambiguator, child, level + 1,
+			             labels, n_labels, name, places);
+		return;
+	}
+
+	for (child = group->first_child; child != NONE; child = ENTRY (disambiguator, child)->next) {
+		GeocodePlace *place = ENTRY (disambiguator, child)->place;
+		const char *place_name = geocode_place_get_name (place);
+		guint i;
+
+		/* The most specific part of the address comes first. */
+		g_string_truncate (name, 0);
+		if (place_name != NULL) {
+			g_string_append (name, place_name);
+			for (i = n_labels; i > 0; i--) {
+				g_string_append (name, ", ");
+				g_string_append (name, labels[i - 1]);
+			}
+		}
+
+		geocode_place_set_name (place, name->str);
+		geocode_location_set_description (geocode_place_get_location (place),
+		                                  name->str);
+
+		*places = g_list_prepend (*places, place);
+	}
+}
+
+/*
+ * _geocode_disambiguator_finish:
+ * @disambiguator: a #GeocodeDisambiguator
+ *
+ * Names the places added to @disambiguator, once all of them have been.
+ *
+ * Returns: (element-type GeocodePlace) (transfer full): the places
+ */
+GList *
+_geocode_disambiguator_finish (GeocodeDisambiguator *disambiguator)
+{
+	const char **labels;
+	GString *name;
+	GList *places = NULL;
+
+	g_return_val_if_fail (!disambiguator->finished, NULL);
+
+	disambiguator->finished = TRUE;
+
+	labels = g_new (const char *, disambiguator->n_levels + 1);
+	name = g_string_new (NULL);
+
+	name_places (disambiguator, 0, 0, labels, 0, name, &places);
+
+	g_string_free (name, TRUE);
+	g_free (labels);
+
+	return g_list_reverse (places);
+}
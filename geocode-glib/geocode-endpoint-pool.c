@@ -0,0 +1,471 @@
+/*
+ * Copyright 2026 The geocode-glib authors
+ *
+ * The geocode-glib library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The geocode-glib library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "geocode-glib-private.h"
+
+/*
+ * Spreads requests over several replicas of a server, and keeps track of how
+ * healthy each of them is.
+ *
+ * For each endpoint, the pool keeps exponentially weighted moving averages of
+ * the latency of successful requests and of the rate of failed ones, and a
+ * window of recent latencies from which to estimate their 95th percentile.
+ * Requests go to the available endpoint with the lowest expected latency,
+ * taking into account the requests it already has outstanding and its error
+ * rate; ties are broken round-robin.
+ *
+ * Each endpoint has a circuit breaker. Once enough requests have failed for its
+ * error rate to cross ERROR_RATE_THRESHOLD, the circuit opens and the endpoint
+ * is not used until a cooldown has passed, which doubles each time it trips
+ * again in a row. After that the circuit is half-open: a single probe request
+ * is let through, which closes it again if it succeeds. If every endpoint is
+ * unavailable, the one whose cooldown ends soonest is used anyway, as failing
+ * requests without trying would be no better.
+ */
+
+#define EWMA_WEIGHT 0.2
+#define ERROR_RATE_THRESHOLD 0.5
+#define MIN_SAMPLES_TO_TRIP 5
+#define BASE_COOLDOWN (10 * G_TIME_SPAN_SECOND)
+#define MAX_COOLDOWN (5 * G_TIME_SPAN_MINUTE)
+
+/* Hedge delays are estimated from this many recent latencies, once there are
+ * at least MIN_HEDGE_SAMPLES of them. */
+#define LATENCY_WINDOW 64
+#define MIN_HEDGE_SAMPLES 20
+#define DEFAULT_HEDGE_DELAY G_TIME_SPAN_SECOND
+#define MIN_HEDGE_DELAY (10 * G_TIME_SPAN_MILLISECOND)
+
+typedef enum {
+	CIRCUIT_CLOSED,
+	CIRCUIT_OPEN,
+	CIRCUIT_HALF_OPEN,
+} CircuitState;
+
+typedef struct {
+	char *base_url;
+
+	gdouble latency;  /* µs; 0 until a request has succeeded */
+	gdouble error_rate;
+	guint n_samples;
+	guint n_outstanding;
+
+	CircuitState state;
+	gint64 open_until;  /* monotonic time */
+	guint n_trips;  /* in a row */
+
+	gint64 latencies[LATENCY_WINDOW];  /* ring buffer */
+	guint n_latencies;
+	guint next_latency;
+} Endpoint;
+
+struct _GeocodeEndpointPool {
+	GMutex lock;
+	Endpoint *endpoints;
+	guint n_endpoints;
+	guint next_start;  /* for round-robin */
+};
+
+/*
+ * _geocode_endpoint_pool_new:
+ * @base_urls: (array zero-terminated=1): base URLs of the endpoints; must not
+ *    be empty
+ *
+ * Creates a pool of endpoints, all of which start out healthy. The endpoints
+ * are numbered in the order of @base_urls.
+ *
+ * Returns: (transfer full): a new #GeocodeEndpointPool
+ */
+GeocodeEndpointPool *
+_geocode_endpoint_pool_new (const char * const *base_urls)
+{
+	GeocodeEndpointPool *pool;
+	guint i;
+
+	g_return_val_if_fail (base_urls != NULL && base_urls[0] != NULL, NULL);
+
+	pool = g_slice_new0 (GeocodeEndpointPool);
+	g_mutex_init (&pool->lock);
+	pool->n_endpoints = g_strv_length ((char **) base_urls);
+	pool->endpoints = g_new0 (Endpoint, pool->n_endpoints);
+
+	for (i = 0; i < pool->n_endpoints; i++)
+		pool->endpoints[i].base_url = g_strdup (base_urls[i]);
+
+	return pool;
+}
+
+void
+_geocode_endpoint_pool_free (GeocodeEndpointPool *pool)
+{
+	guint i;
+
+	for (i = 0; i < pool->n_endpoints; i++)
+		g_free (pool->endpoints[i].base_url);
+
+	g_free (pool->endpoints);
+	g_mutex_clear (&pool->lock);
+	g_slice_free (GeocodeEndpointPool, pool);
+}
+
+guint
+_geocode_endpoint_pool_get_n_endpoints (GeocodeEndpointPool *pool)
+{
+	return pool->n_endpoints;
+}
+
+const char *
+_geocode_endpoint_pool_get_base_url (GeocodeEndpointPool *pool,
+                                     guint                endpoint)
+{
+	g_return_val_if_fail (endpoint < pool->n_endpoints, NULL);
+
+	return pool->endpoints[endpoint].base_url;
+}
+
+/* Must be called with the pool lock held. Whether a request may be sent to
+ * @endpoint now, moving its circuit to half-open once its cooldown is over. */
+static gboolean
+endpoint_is_available (Endpoint *endpoint,
+                       gint64    now)
+{
+	if (endpoint->state == CIRCUIT_CLOSED)
+		return TRUE;
+
+	if (endpoint->state == CIRCUIT_OPEN) {
+		if (now < endpoint->open_until)
+			return FALSE;
+
+		g_debug ("Probing endpoint %s", endpoint->base_url);
+		endpoint->state = CIRCUIT_HALF_OPEN;
+	}
+
+	/* Only one probe at a time. */
+	return (endpoint->n_outstanding == 0);
+}
+
+static gdouble
+endpoint_get_score (Endpoint *endpoint)
+{
+	return (endpoint->latency + G_TIME_SPAN_MILLISECOND) *
+	       (endpoint->n_outstanding + 1) /
+	       (1.0 - 0.9 * endpoint->error_rate);
+}
+
+/* Must be called with the pool lock held. */
+static gint
+choose_endpoint (GeocodeEndpointPool *pool,
+                 gint                 exclude,
+                 gint64               now)
+{
+	gint best = -1;
+	gdouble best_score = G_MAXDOUBLE;
+	guint i;
+
+	for (i = 0; i < pool->n_endpoints; i++) {
+		guint index = (pool->next_start + i) % pool->n_endpoints;
+		Endpoint *endpoint = &pool->endpoints[index];
+		gdouble score;
+
+		if ((gint) index == exclude ||
+		    !endpoint_is_available (endpoint, now))
+			continue;
+
+		score = endpoint_get_score (endpoint);
+		if (score < best_score) {
+			best = index;
+			best_score = score;
+		}
+	}
+
+	return best;
+}
+
+/* Must be called with the pool lock held. */
+static void
+take_endpoint (GeocodeEndpointPool *pool,
+               guint                endpoint)
+{
+	pool->endpoints[endpoint].n_outstanding++;
+	pool->next_start = (pool->next_start + 1) % pool->n_endpoints;
+}
+
+/*
+ * _geocode_endpoint_pool_choose:
+ * @pool: a #GeocodeEndpointPool
+ * @exclude: an endpoint to avoid, such as one which just failed, or -1
+ *
+ * Chooses the endpoint to send a request to. @exclude is only chosen if no
+ * other endpoint is available. The request must be reported with
+ * _geocode_endpoint_pool_report() once it completes.
+ *
+ * Returns: the endpoint
+ */
+guint
+_geocode_endpoint_pool_choose (GeocodeEndpointPool *pool,
+                               gint                 exclude)
+{
+	gint64 now;
+	gint best;
+	guint i;
+
+	now = g_get_monotonic_time ();
+
+	g_mutex_lock (&pool->lock);
+
+	best = choose_endpoint (pool, exclude, now);
+
+	if (best < 0 && exclude >= 0 &&
+	    endpoint_is_available (&pool->endpoints[exclude], now))
+		best = exclude;
+
+	/* Nothing is available; use the endpoint which should recover
+	 * soonest. */
+	if (best < 0) {
+		best = 0;
+		for (i = 1; i < pool->n_endpoints; i++) {
+			if (pool->endpoints[i].open_until < pool->endpoints[best].open_until)
+				best = i;
+		}
+	}
+
+	take_endpoint (pool, best);
+
+	g_mutex_unlock (&pool->lock);
+
+	return best;
+}
+
+/*
+ * _geocode_endpoint_pool_choose_alternative:
+ * @pool: a #GeocodeEndpointPool
+ * @exclude: the endpoint to avoid
+ * @endpoint: (out): return location for the endpoint
+ *
+ * Chooses an endpoint other than @exclude to send a request to, if one is
+ * available, such as to send a hedged request to. The request must be reported
+ * with _geocode_endpoint_pool_report() once it completes.
+ *
+ * Returns: %TRUE if an endpoint was chosen, %FALSE otherwise
+ */
+gboolean
+_geocode_endpoint_pool_choose_alternative (GeocodeEndpointPool *pool,
+                                           guint                exclude,
+                                           guint               *endpoint)
+{
+	gint best;
+
+	g_mutex_lock (&pool->lock);
+
+	best = choose_endpoint (pool, exclude, g_get_monotonic_time ());
+	if (best >= 0)
+		take_endpoint (pool, best);
+
+	g_mutex_unlock (&pool->lock);
+
+	if (best < 0)
+		return FALSE;
+
+	*endpoint = best;
+	return TRUE;
+}
+
+/* Must be called with the pool lock held. */
+static void
+endpoint_trip (Endpoint *endpoint,
+               gint64    now)
+{
+	gint64 cooldown;
+
+	cooldown = MIN (BASE_COOLDOWN << MIN (endpoint->n_trips, 16), MAX_COOLDOWN);
+
+	g_debug ("Not using endpoint %s for %" G_GINT64_FORMAT " s (error rate %.2f)",
+	         endpoint->base_url, cooldown / G_TIME_SPAN_SECOND,
+	         endpoint->error_rate);
+
+	endpoint->state = CIRCUIT_OPEN;
+	endpoint->open_until = now + cooldown;
+	endpoint->n_trips++;
+}
+
+/*
+ * _geocode_endpoint_pool_report:
+ * @pool: a #GeocodeEndpointPool
+ * @endpoint: the endpoint the request was sent to
+ * @result: how the request went
+ * @latency: time the request took, in microseconds
+ *
+ * Reports the outcome of a request sent to an endpoint returned by
+ * _geocode_endpoint_pool_choose() or
+ * _geocode_endpoint_pool_choose_alternative(), to update its health.
+ * Cancelled requests say nothing about the endpoint's health.
+ */
+void
+_geocode_endpoint_pool_report (GeocodeEndpointPool   *pool,
+                               guint                  endpoint,
+                               GeocodeEndpointResult  result,
+                               gint64                 latency)
+{
+	Endpoint *e;
+	gboolean failed;
+	gint64 now;
+
+	g_return_if_fail (endpoint < pool->n_endpoints);
+
+	now = g_get_monotonic_time ();
+
+	g_mutex_lock (&pool->lock);
+
+	e = &pool->endpoints[endpoint];
+	e->n_outstanding--;
+
+	if (result == GEOCODE_ENDPOINT_CANCELLED) {
+		g_mutex_unlock (&pool->lock);
+		return;
+	}
+
+	failed = (result == GEOCODE_ENDPOINT_FAILURE);
+
+	if (e->n_samples == 0)
+		e->error_rate = failed ? 1.0 : 0.0;
+	else
+		e->error_rate += EWMA_WEIGHT * ((failed ? 1.0 : 0.0) - e->error_rate);
+	e->n_samples++;
+
+	if (!failed) {
+		if (e->latency == 0.0)
+			e->latency = latency;
+		else
+			e->latency += EWMA_WEIGHT * (latency - e->latency);
+
+		e->latencies[e->next_latency] = latency;
+		e->next_latency = (e->next_latency + 1) % LATENCY_WINDOW;
+		e->n_latencies = MIN (e->n_latencies + 1, LATENCY_WINDOW);
+	}
+
+	if (e->state == CIRCUIT_HALF_OPEN) {
+		if (failed) {
+			endpoint_trip (e, now);
+		} else {
+			g_debug ("Using endpoint %s again", e->base_url);
+			e->state = CIRCUIT_CLOSED;
+			e->n_trips = 0;
+			e->n_samples = 0;
+			e->error_rate = 0.0;
+		}
+	} else if (e->state == CIRCUIT_CLOSED && failed &&
+	           e->n_samples >= MIN_SAMPLES_TO_TRIP &&
+	           e->error_rate >= ERROR_RATE_THRESHOLD) {
+		endpoint_trip (e, now);
+	}
+
+	g_mutex_unlock (&pool->lock);
+}
+
+static gint
+compare_latencies (gconstpointer a,
+                   gconstpointer b)
+{
+	gint64 latency_a = *(const gint64 *) a;
+	gint64 latency_b = *(const gint64 *) b;
+
+	return (latency_a > latency_b) - (latency_a < latency_b);
+}
+
+/*
+ * _geocode_endpoint_pool_get_hedge_delay:
+ * @pool: a #GeocodeEndpointPool
+ * @endpoint: an endpoint
+ *
+ * Gets how long to wait for a response from @endpoint before sending a hedged
+ * request to another endpoint: the 95th percentile of its recent latencies,
+ * so that only the slowest requests are hedged.
+ *
+ * Returns: the delay, in microseconds
+ */
+gint64
+_geocode_endpoint_pool_get_hedge_delay (GeocodeEndpointPool *pool,
+                                        guint                endpoint)
+{
+	gint64 latencies[LATENCY_WINDOW];
+	Endpoint *e;
+	guint n;
+
+	g_return_val_if_fail (endpoint < pool->n_endpoints, DEFAULT_HEDGE_DELAY);
+
+	g_mutex_lock (&pool->lock);
+
+	e = &pool->endpoints[endpoint];
+	n = e->n_latencies;
+	memcpy (latencies, e->latencies, n * sizeof (*latencies));
+
+	g_mutex_unlock (&pool->lock);
+
+	if (n < MIN_HEDGE_SAMPLES)
+		return DEFAULT_HEDGE_DELAY;
+
+	qsort (latencies, n, sizeof (*latencies), compare_latencies);
+
+	return MAX (latencies[(guint) ceil (0.95 * n) - 1], MIN_HEDGE_DELAY);
+}
+
+/*
+ * _geocode_endpoint_pool_get_stats:
+ * @pool: a #GeocodeEndpointPool
+ * @endpoint: an endpoint
+ * @latency: (out) (optional): return location for the average latency of
+ *    successful requests, in microseconds, or 0 if there have been none
+ * @error_rate: (out) (optional): return location for the average rate of
+ *    failed requests, between 0 and 1
+ * @available: (out) (optional): return location for whether the circuit breaker
+ *    lets requests through to @endpoint
+ *
+ * Gets the health of @endpoint.
+ */
+void
+_geocode_endpoint_pool_get_stats (GeocodeEndpointPool *pool,
+                                  guint                endpoint,
+                                  gdouble             *latency,
+                                  gdouble             *error_rate,
+                                  gboolean            *available)
+{
+	Endpoint *e;
+
+	g_return_if_fail (endpoint < pool->n_endpoints);
+
+	g_mutex_lock (&pool->lock);
+
+	e = &pool->endpoints[endpoint];
+
+	if (latency != NULL)
+		*latency = e->latency;
+	if (error_rate != NULL)
+		*error_rate = e->error_rate;
+	if (available != NULL)
+		*available = (e->state != CIRCUIT_OPEN ||
+		              g_get_monotonic_time () >= e->open_until);
+
+	g_mutex_unlock (&pool->lock);
+}
@@ -46,6 +46,7 @@ struct _GeocodeForwardPrivate {
 	guint       answer_count;
 	GeocodeBoundingBox *search_area;
 	gboolean bounded;
+	guint       timeout;
 
 	GeocodeBackend  *backend;
 };
@@ -55,7 +56,8 @@ enum {
 
         PROP_ANSWER_COUNT,
         PROP_SEARCH_AREA,
-        PROP_BOUNDED
+        PROP_BOUNDED,
+        PROP_TIMEOUT
 };
 
 G_DEFINE_TYPE (GeocodeForward, geocode_forward, G_TYPE_OBJECT)
@@ -84,6 +86,11 @@ geocode_forward_get_property (GObject	 *object,
 					     geocode_forward_get_bounded (forward));
 			break;
 
+		case PROP_TIMEOUT:
+			g_value_set_uint (value,
+					  geocode_forward_get_timeout (forward));
+			break;
+
 		default:
 			/* We don't have any other property... */
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -115,6 +122,11 @@ geocode_forward_set_property(GObject	   *object,
 						     g_value_get_boolean (value));
 			break;
 
+		case PROP_TIMEOUT:
+			geocode_forward_set_timeout (forward,
+						     g_value_get_uint (value));
+			break;
+
 		default:
 			/* We don't have any other property... */
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -191,6 +203,25 @@ geocode_forward_class_init (GeocodeForwardClass *klass)
 				      G_PARAM_READWRITE |
 				      G_PARAM_STATIC_STRINGS);
 	g_object_class_install_property (gforward_class, PROP_BOUNDED, pspec);
+
+	/**
+	* GeocodeForward:timeout:
+	*
+	* The time a search may take, in milliseconds, after which it fails
+	* with a %G_IO_ERROR_TIMED_OUT error. If set to 0, searches are not
+	* given a deadline.
+	*
+	* Since: 3.27.1
+	*/
+	pspec = g_param_spec_uint ("timeout",
+				   "Timeout",
+				   "Deadline for searches in milliseconds, or 0",
+				   0,
+				   G_MAXUINT,
+				   0,
+				   G_PARAM_READWRITE |
+				   G_PARAM_STATIC_STRINGS);
+	g_object_class_install_property (gforward_class, PROP_TIMEOUT, pspec);
 }
 
 static void
@@ -294,14 +325,18 @@ backend_forward_search_ready (GeocodeBackend *backend,
                               GAsyncResult   *res,
                               GTask          *task)
 {
+	GeocodeDeadline *deadline = g_task_get_task_data (task);
 	GList *places;  /* (element-type GeocodePlace) */
 	GError *error = NULL;
 
 	places = geocode_backend_forward_search_finish (backend, res, &error);
-	if (places != NULL)
+	if (places != NULL) {
 		g_task_return_pointer (task, places, (GDestroyNotify) g_list_free);
-	else
+	} else {
+		if (deadline != NULL)
+			_geocode_deadline_check_error (deadline, &error);
 		g_task_return_error (task, error);
+	}
 	g_object_unref (task);
 }
 
@@ -317,7 +352,9 @@ backend_forward_search_ready (GeocodeBackend *backend,
  * thing synchronously.
  *
  * When the operation is finished, @callback will be called. You can then call
- * geocode_forward_search_finish() to get the result of the operation.
+ * geocode_forward_search_finish() to get the result of the operation. If the
+ * #GeocodeForward:timeout expires first, the search is cancelled and fails
+ * with a %G_IO_ERROR_TIMED_OUT error.
  **/
 void
 geocode_forward_search_async (GeocodeForward      *forward,
@@ -326,6 +363,7 @@ geocode_forward_search_async (GeocodeForward      *forward,
 			      gpointer             user_data)
 {
 	GTask *task;
+	GeocodeDeadline *deadline = NULL;
 
 	g_return_if_fail (GEOCODE_IS_FORWARD (forward));
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
@@ -334,6 +372,15 @@ geocode_forward_search_async (GeocodeForward      *forward,
 	g_assert (forward->priv->backend != NULL);
 
 	task = g_task_new (forward, cancellable, callback, user_data);
+
+	if (forward->priv->timeout > 0) {
+		deadline = _geocode_deadline_new (forward->priv->timeout,
+		                                  cancellable);
+		g_task_set_task_data (task, deadline,
+		                      (GDestroyNotify) _geocode_deadline_free);
+		cancellable = _geocode_deadline_get_cancellable (deadline);
+	}
+
 	geocode_backend_forward_search_async (forward->priv->backend,
 	                                      forward->priv->ht,
 	                                      cancellable,
@@ -376,7 +423,9 @@ geocode_forward_search_finish (GeocodeForward       *forward,
  * default the GNOME Nominatim server is used. See #GeocodeBackend for more
  * information.
  *
- * If no results are found, a %GEOCODE_ERROR_NO_MATCHES error is returned.
+ * If no results are found, a %GEOCODE_ERROR_NO_MATCHES error is returned. If
+ * the #GeocodeForward:timeout expires first, a %G_IO_ERROR_TIMED_OUT error is
+ * returned.
  *
  * Returns: (element-type GeocodePlace) (transfer full): A list of
  * places or %NULL in case of errors. Free the returned instances with
@@ -386,16 +435,34 @@ GList *
 geocode_forward_search (GeocodeForward      *forward,
 			GError             **error)
 {
+	GeocodeDeadline *deadline;
+	GList *places;  /* (element-type GeocodePlace) */
+	GError *local_error = NULL;
+
 	g_return_val_if_fail (GEOCODE_IS_FORWARD (forward), NULL);
 	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
 	ensure_backend (forward);
 	g_assert (forward->priv->backend != NULL);
 
-	return geocode_backend_forward_search (forward->priv->backend,
-	                                       forward->priv->ht,
-	                                       NULL,
-	                                       error);
+	if (forward->priv->timeout == 0)
+		return geocode_backend_forward_search (forward->priv->backend,
+		                                       forward->priv->ht,
+		                                       NULL,
+		                                       error);
+
+	deadline = _geocode_deadline_new (forward->priv->timeout, NULL);
+	places = geocode_backend_forward_search (forward->priv->backend,
+	                                         forward->priv->ht,
+	                                         _geocode_deadline_get_cancellable (deadline),
+	                                         &local_error);
+	if (local_error != NULL) {
+		_geocode_deadline_check_error (deadline, &local_error);
+		g_propagate_error (error, local_error);
+	}
+	_geocode_deadline_free (deadline);
+
+	return places;
 }
 
 /**
@@ -543,6 +610,48 @@ geocode_forward_get_bounded (GeocodeForward *forward)
 	return forward->priv->bounded;
 }
 
+/**
+ * geocode_forward_set_timeout:
+ * @forward: a #GeocodeForward representing a query
+ * @timeout: the deadline for searches in milliseconds, or 0 for none
+ *
+ * Sets the #GeocodeForward:timeout property that bounds how long searches
+ * may take.
+ *
+ * Since: 3.27.1
+ **/
+void
+geocode_forward_set_timeout (GeocodeForward *forward,
+			     guint           timeout)
+{
+	g_return_if_fail (GEOCODE_IS_FORWARD (forward));
+
+	if (forward->priv->timeout == timeout)
+		return;
+
+	forward->priv->timeout = timeout;
+	g_object_notify (G_OBJECT (forward), "timeout");
+}
+
+/**
+ * geocode_forward_get_timeout:
+ * @forward: a #GeocodeForward representing a query
+ *
+ * Gets the #GeocodeForward:timeout property that bounds how long searches
+ * may take.
+ *
+ * Returns: the deadline for searches in milliseconds, or 0 for none
+ *
+ * Since: 3.27.1
+ **/
+guint
+geocode_forward_get_timeout (GeocodeForward *forward)
+{
+	g_return_val_if_fail (GEOCODE_IS_FORWARD (forward), 0);
+
+	return forward->priv->timeout;
+}
+
 /**
  * geocode_forward_set_backend:
  * @forward: a #GeocodeForward representing a query
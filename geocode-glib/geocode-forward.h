@@ -78,6 +78,9 @@ void geocode_forward_set_search_area                 (GeocodeForward     *forwar
 gboolean geocode_forward_get_bounded                 (GeocodeForward *forward);
 void geocode_forward_set_bounded                     (GeocodeForward *forward,
 						      gboolean        bounded);
+guint geocode_forward_get_timeout                    (GeocodeForward *forward);
+void geocode_forward_set_timeout                     (GeocodeForward *forward,
+						      guint           timeout);
 
 void geocode_forward_search_async  (GeocodeForward       *forward,
 				    GCancellable        *cancellable,
@@ -28,11 +28,31 @@
 #include <json-glib/json-glib.h>
 #include <geocode-glib/geocode-location.h>
 #include <geocode-glib/geocode-place.h>
+#include <geocode-glib/geocode-backend.h>
 
 G_BEGIN_DECLS
 
 #define DEFAULT_ANSWER_COUNT 10
 
+#define GEOCODE_MEMORY_CACHE_DEFAULT_CAPACITY (1024 * 1024) /* bytes */
+#define GEOCODE_NEGATIVE_CACHE_DEFAULT_TTL (10 * 60) /* seconds */
+
+#define GEOCODE_REVERSE_CACHE_CAPACITY 4096 /* entries */
+#define GEOCODE_REVERSE_CACHE_DEFAULT_TTL (5 * 60) /* seconds */
+#define GEOCODE_REVERSE_CACHE_MAX_RADIUS GEOCODE_LOCATION_ACCURACY_STREET /* metres */
+
+#define GEOCODE_REQUEST_SCHEDULER_DEFAULT_MAX_QUEUED 256
+
+/* Version of the places stored in the on-disk cache. Bump this when a change
+ * to parsing changes the places produced for a response, so that places
+ * cached by earlier versions are not used. Changes to the serialized form
+ * itself are detected automatically. */
+#define GEOCODE_PLACE_CACHE_VERSION 2
+
+#define GEOCODE_CACHE_DEFAULT_TTL (7 * 24 * 60 * 60) /* seconds */
+#define GEOCODE_CACHE_DEFAULT_MAX_SIZE (64 * 1024 * 1024) /* bytes */
+#define GEOCODE_CACHE_DEFAULT_MAX_ENTRIES 100000
+
 typedef enum {
 	GEOCODE_GLIB_RESOLVE_FORWARD,
 	GEOCODE_GLIB_RESOLVE_REVERSE
@@ -41,16 +61,359 @@ typedef enum {
 GList      *_geocode_parse_search_json  (const char *contents,
 					 GError    **error);
 
+typedef enum {
+	GEOCODE_NOMINATIM_FIELD_NAME,
+	GEOCODE_NOMINATIM_FIELD_DISPLAY_NAME,
+	GEOCODE_NOMINATIM_FIELD_LATITUDE,
+	GEOCODE_NOMINATIM_FIELD_LONGITUDE,
+	GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_BOTTOM,
+	GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_TOP,
+	GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_LEFT,
+	GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_RIGHT,
+	GEOCODE_NOMINATIM_FIELD_CATEGORY,
+	GEOCODE_NOMINATIM_FIELD_TYPE,
+	GEOCODE_NOMINATIM_FIELD_PLACE_RANK,
+	GEOCODE_NOMINATIM_FIELD_OSM_ID,
+	GEOCODE_NOMINATIM_FIELD_OSM_TYPE,
+	GEOCODE_NOMINATIM_FIELD_HOUSE_NUMBER,
+	GEOCODE_NOMINATIM_FIELD_ROAD,
+	GEOCODE_NOMINATIM_FIELD_SUBURB,
+	GEOCODE_NOMINATIM_FIELD_VILLAGE,
+	GEOCODE_NOMINATIM_FIELD_CITY,
+	GEOCODE_NOMINATIM_FIELD_COUNTY,
+	GEOCODE_NOMINATIM_FIELD_STATE_DISTRICT,
+	GEOCODE_NOMINATIM_FIELD_STATE,
+	GEOCODE_NOMINATIM_FIELD_POSTCODE,
+	GEOCODE_NOMINATIM_FIELD_COUNTRY,
+	GEOCODE_NOMINATIM_FIELD_COUNTRY_CODE,
+	GEOCODE_NOMINATIM_FIELD_CONTINENT,
+	GEOCODE_NOMINATIM_FIELD_ERROR,
+	GEOCODE_NOMINATIM_N_FIELDS
+} GeocodeNominatimField;
+
+typedef struct _GeocodeNominatimResult GeocodeNominatimResult;
+
+GeocodeNominatimResult *_geocode_nominatim_result_new (void);
+void _geocode_nominatim_result_free (GeocodeNominatimResult *result);
+gboolean _geocode_nominatim_result_decode (GeocodeNominatimResult  *result,
+                                           const char              *json,
+                                           gsize                    length,
+                                           GError                 **error);
+const char *_geocode_nominatim_result_get (GeocodeNominatimResult *result,
+                                           GeocodeNominatimField   field);
+gboolean _geocode_nominatim_result_has_error (GeocodeNominatimResult *result);
+GeocodePlaceType _geocode_nominatim_result_get_place_type (GeocodeNominatimResult *result);
+
+typedef struct _GeocodeDisambiguator GeocodeDisambiguator;
+
+GeocodeDisambiguator *_geocode_disambiguator_new (guint n_levels);
+void _geocode_disambiguator_free (GeocodeDisambiguator *disambiguator);
+void _geocode_disambiguator_add (GeocodeDisambiguator  *disambiguator,
+                                 GeocodePlace          *place,
+                                 const char           **values);
+guint _geocode_disambiguator_get_n_places (GeocodeDisambiguator *disambiguator);
+GList *_geocode_disambiguator_finish (GeocodeDisambiguator *disambiguator);
+
+typedef struct _GeocodeSearchParser GeocodeSearchParser;
+typedef void (*GeocodeSearchResultFunc) (GeocodePlace *place,
+                                         gpointer      user_data);
+
+GeocodeSearchParser *_geocode_search_parser_new (void);
+void _geocode_search_parser_free (GeocodeSearchParser *parser);
+void _geocode_search_parser_set_result_func (GeocodeSearchParser     *parser,
+                                             GeocodeSearchResultFunc  func,
+                                             gpointer                 user_data);
+gboolean _geocode_search_parser_feed (GeocodeSearchParser  *parser,
+                                      const char           *data,
+                                      gsize                 length,
+                                      GError              **error);
+guint _geocode_search_parser_get_n_results (GeocodeSearchParser *parser);
+GList *_geocode_search_parser_finish (GeocodeSearchParser  *parser,
+                                      GError              **error);
+
 char       *_geocode_object_get_lang (void);
 
-char *_geocode_glib_cache_path_for_query (SoupMessage *query);
-gboolean _geocode_glib_cache_save (SoupMessage *query,
-                                   const char  *contents);
-gboolean _geocode_glib_cache_load (SoupMessage *query,
-                                   char       **contents);
+/* Metadata saved with values in the on-disk cache. */
+typedef struct {
+	char *etag;  /* (nullable) */
+	char *last_modified;  /* (nullable) */
+	gboolean stale;  /* set on load */
+	guint64 stale_at;  /* set on load; seconds since the epoch, or 0 for never */
+} GeocodeCacheInfo;
+
+void _geocode_cache_info_clear (GeocodeCacheInfo *info);
+
+char *_geocode_glib_cache_key_for_uri (SoupURI *uri);
+char *_geocode_glib_cache_key_split_for_uri (SoupURI  *uri,
+                                             char    **suffix);
+char *_geocode_glib_cache_key_encode_free_text (const char *text);
+gboolean _geocode_glib_cache_save (const char             *key,
+                                   GBytes                 *value,
+                                   guint                   ttl,
+                                   guint                   stale_ttl,
+                                   const GeocodeCacheInfo *info);
+gboolean _geocode_glib_cache_load (const char        *key,
+                                   GBytes           **value,
+                                   GeocodeCacheInfo  *info);
+void _geocode_glib_cache_set_limits (guint64 max_size,
+                                     guint   max_entries);
+void _geocode_glib_cache_get_limits (guint64 *max_size,
+                                     guint   *max_entries);
+void _geocode_glib_cache_set_compression (gboolean compression);
+gboolean _geocode_glib_cache_get_compression (void);
+gboolean _geocode_glib_cache_trim (GError **error);
+void _geocode_glib_cache_flush (void);
+void _geocode_glib_cache_get_stats (guint *hits,
+                                    guint *misses);
+typedef struct _GeocodeCacheStore GeocodeCacheStore;
+
+/* Codecs for values in the on-disk cache. The values are stored in the cache,
+ * so must not change. */
+typedef enum {
+	GEOCODE_CACHE_CODEC_NONE = 0,
+	GEOCODE_CACHE_CODEC_ZLIB = 1,
+	GEOCODE_CACHE_CODEC_LZ4 = 2,
+} GeocodeCacheCodec;
+
+#ifdef HAVE_LZ4
+#define GEOCODE_CACHE_DEFAULT_CODEC GEOCODE_CACHE_CODEC_LZ4
+#else
+#define GEOCODE_CACHE_DEFAULT_CODEC GEOCODE_CACHE_CODEC_ZLIB
+#endif
+
+GeocodeCacheStore *_geocode_cache_store_open (const char  *directory,
+                                              GError     **error);
+void _geocode_cache_store_free (GeocodeCacheStore *store);
+gboolean _geocode_cache_store_lookup (GeocodeCacheStore  *store,
+                                      const char         *key,
+                                      GBytes            **value);
+gboolean _geocode_cache_store_insert (GeocodeCacheStore  *store,
+                                      const char         *key,
+                                      GBytes             *value,
+                                      guint64             expires,
+                                      GError            **error);
+gboolean _geocode_cache_store_sync (GeocodeCacheStore  *store,
+                                    GError            **error);
+gboolean _geocode_cache_store_compact (GeocodeCacheStore  *store,
+                                       GError            **error);
+gboolean _geocode_cache_store_codec_is_supported (GeocodeCacheCodec codec);
+void _geocode_cache_store_set_codec (GeocodeCacheStore *store,
+                                     GeocodeCacheCodec  codec);
+void _geocode_cache_store_set_limits (GeocodeCacheStore *store,
+                                      guint64            max_bytes,
+                                      guint              max_entries);
+gboolean _geocode_cache_store_is_over_limits (GeocodeCacheStore *store);
+void _geocode_cache_store_request_sweep (GeocodeCacheStore *store);
+gboolean _geocode_cache_store_evict (GeocodeCacheStore *store,
+                                     guint              max_steps);
+gboolean _geocode_cache_store_trim (GeocodeCacheStore  *store,
+                                    GError            **error);
+void _geocode_cache_store_get_stats (GeocodeCacheStore *store,
+                                     guint             *n_entries,
+                                     guint64           *data_size,
+                                     guint64           *live_bytes);
+
 GHashTable *_geocode_glib_dup_hash_table (GHashTable *ht);
 gboolean _geocode_object_is_number_after_street (void);
 SoupSession *_geocode_glib_build_soup_session (const gchar *user_agent_override);
+gboolean _geocode_glib_parse_retry_after (const char *value,
+                                          gint64      now,
+                                          guint      *delay);
+
+GeocodePlace *_geocode_place_dup (GeocodePlace *place);
+
+/* The string fields of a #GeocodePlace, apart from its name. */
+typedef enum {
+	GEOCODE_PLACE_FIELD_STREET_ADDRESS,
+	GEOCODE_PLACE_FIELD_STREET,
+	GEOCODE_PLACE_FIELD_BUILDING,
+	GEOCODE_PLACE_FIELD_POSTAL_CODE,
+	GEOCODE_PLACE_FIELD_AREA,
+	GEOCODE_PLACE_FIELD_TOWN,
+	GEOCODE_PLACE_FIELD_COUNTY,
+	GEOCODE_PLACE_FIELD_STATE,
+	GEOCODE_PLACE_FIELD_ADMINISTRATIVE_AREA,
+	GEOCODE_PLACE_FIELD_COUNTRY_CODE,
+	GEOCODE_PLACE_FIELD_COUNTRY,
+	GEOCODE_PLACE_FIELD_CONTINENT,
+	GEOCODE_PLACE_FIELD_OSM_ID,
+	GEOCODE_PLACE_N_FIELDS
+} GeocodePlaceField;
+
+/* Everything needed to build a place at once; see _geocode_place_build(). */
+typedef struct {
+	const char *name;
+	GeocodePlaceType place_type;
+	GeocodePlaceOsmType osm_type;
+	const char *fields[GEOCODE_PLACE_N_FIELDS];  /* (nullable) elements */
+	gdouble latitude;
+	gdouble longitude;
+	gboolean has_bounding_box;
+	gdouble top, bottom, left, right;
+} GeocodePlaceBuilder;
+
+void _geocode_place_builder_init (GeocodePlaceBuilder *builder);
+GeocodePlace *_geocode_place_build (const GeocodePlaceBuilder *builder);
+gboolean _geocode_place_osm_type_from_nick (const char          *nick,
+                                            GeocodePlaceOsmType *osm_type);
+GeocodeLocation *_geocode_location_new (gdouble     latitude,
+                                        gdouble     longitude,
+                                        gdouble     accuracy,
+                                        const char *description);
+GHashTable *_geocode_coordinates_to_params (gdouble latitude,
+                                            gdouble longitude);
+gsize _geocode_place_get_memory_size (GeocodePlace *place);
+GBytes *_geocode_place_list_serialize (GList *places);
+gboolean _geocode_place_list_deserialize (GBytes  *bytes,
+                                          GList  **places);
+
+gboolean _geocode_memory_cache_lookup (const char  *key,
+                                       GList      **places,
+                                       GError     **error);
+void _geocode_memory_cache_insert (const char *key,
+                                   GList      *places,
+                                   guint       ttl);
+void _geocode_memory_cache_insert_error (const char   *key,
+                                         const GError *error,
+                                         guint         ttl);
+void _geocode_memory_cache_set_capacity (gsize capacity);
+gsize _geocode_memory_cache_get_capacity (void);
+void _geocode_memory_cache_clear (void);
+void _geocode_memory_cache_get_stats (guint *hits,
+                                      guint *misses,
+                                      gsize *size);
+
+gboolean _geocode_reverse_cache_lookup (const char  *scope,
+                                        gdouble      latitude,
+                                        gdouble      longitude,
+                                        guint        radius,
+                                        GList      **places);
+void _geocode_reverse_cache_insert (const char *scope,
+                                    gdouble     latitude,
+                                    gdouble     longitude,
+                                    guint       radius,
+                                    guint       ttl,
+                                    GList      *places);
+void _geocode_reverse_cache_get_cell (gdouble  latitude,
+                                      gdouble  longitude,
+                                      gdouble  size,
+                                      gint64  *row,
+                                      gint64  *column);
+void _geocode_reverse_cache_clear (void);
+void _geocode_reverse_cache_get_stats (guint *hits,
+                                       guint *misses,
+                                       guint *n_entries);
+
+typedef struct _GeocodeRequestScheduler GeocodeRequestScheduler;
+typedef struct _GeocodeScheduledRequest GeocodeScheduledRequest;
+typedef void (*GeocodeRequestFunc) (gpointer user_data);
+
+GeocodeRequestScheduler *_geocode_request_scheduler_new (void);
+void _geocode_request_scheduler_free (GeocodeRequestScheduler *scheduler);
+void _geocode_request_scheduler_set_rate (GeocodeRequestScheduler *scheduler,
+                                          gdouble                  rate,
+                                          guint                    burst);
+void _geocode_request_scheduler_get_rate (GeocodeRequestScheduler *scheduler,
+                                          gdouble                 *rate,
+                                          guint                   *burst);
+void _geocode_request_scheduler_set_max_queued (GeocodeRequestScheduler *scheduler,
+                                                guint                    max_queued);
+guint _geocode_request_scheduler_get_max_queued (GeocodeRequestScheduler *scheduler);
+gboolean _geocode_request_scheduler_submit (GeocodeRequestScheduler  *scheduler,
+                                            gint                      priority,
+                                            GeocodeRequestFunc        func,
+                                            gpointer                  user_data,
+                                            GeocodeScheduledRequest **request,
+                                            GError                  **error);
+gboolean _geocode_request_scheduler_cancel (GeocodeRequestScheduler *scheduler,
+                                            GeocodeScheduledRequest *request);
+void _geocode_request_scheduler_raise_priority (GeocodeRequestScheduler *scheduler,
+                                                GeocodeScheduledRequest *request,
+                                                gint                     priority);
+gboolean _geocode_request_scheduler_acquire (GeocodeRequestScheduler  *scheduler,
+                                             GCancellable             *cancellable,
+                                             GError                  **error);
+gboolean _geocode_request_scheduler_try_acquire (GeocodeRequestScheduler *scheduler);
+
+typedef struct _GeocodeEndpointPool GeocodeEndpointPool;
+
+typedef enum {
+	GEOCODE_ENDPOINT_SUCCESS,
+	GEOCODE_ENDPOINT_FAILURE,
+	GEOCODE_ENDPOINT_CANCELLED,
+} GeocodeEndpointResult;
+
+GeocodeEndpointPool *_geocode_endpoint_pool_new (const char * const *base_urls);
+void _geocode_endpoint_pool_free (GeocodeEndpointPool *pool);
+guint _geocode_endpoint_pool_get_n_endpoints (GeocodeEndpointPool *pool);
+const char *_geocode_endpoint_pool_get_base_url (GeocodeEndpointPool *pool,
+                                                 guint                endpoint);
+guint _geocode_endpoint_pool_choose (GeocodeEndpointPool *pool,
+                                     gint                 exclude);
+gboolean _geocode_endpoint_pool_choose_alternative (GeocodeEndpointPool *pool,
+                                                    guint                exclude,
+                                                    guint               *endpoint);
+void _geocode_endpoint_pool_report (GeocodeEndpointPool   *pool,
+                                    guint                  endpoint,
+                                    GeocodeEndpointResult  result,
+                                    gint64                 latency);
+gint64 _geocode_endpoint_pool_get_hedge_delay (GeocodeEndpointPool *pool,
+                                               guint                endpoint);
+void _geocode_endpoint_pool_get_stats (GeocodeEndpointPool *pool,
+                                       guint                endpoint,
+                                       gdouble             *latency,
+                                       gdouble             *error_rate,
+                                       gboolean            *available);
+
+typedef struct _GeocodeDeadline GeocodeDeadline;
+
+GeocodeDeadline *_geocode_deadline_new (guint         timeout,
+                                        GCancellable *cancellable);
+void _geocode_deadline_free (GeocodeDeadline *deadline);
+GCancellable *_geocode_deadline_get_cancellable (GeocodeDeadline *deadline);
+void _geocode_deadline_check_error (GeocodeDeadline  *deadline,
+                                    GError          **error);
+
+struct _GeocodeBatchResults {
+	gint ref_count;
+	guint n_items;
+	GList **places;  /* (element-type GeocodePlace) (owned) */
+	GError **errors;  /* (owned) (nullable) */
+};
+
+GeocodeBatchResults *_geocode_batch_results_new (guint n_items);
+
+typedef struct _GeocodeBatch GeocodeBatch;
+typedef void (*GeocodeBatchStartFunc) (gpointer             source_object,
+                                       gpointer             data,
+                                       GCancellable        *cancellable,
+                                       GAsyncReadyCallback  callback,
+                                       gpointer             user_data);
+typedef GList *(*GeocodeBatchFinishFunc) (gpointer       source_object,
+                                          GAsyncResult  *result,
+                                          GError       **error);
+
+GeocodeBatch *_geocode_batch_new (guint                  n_items,
+                                  GeocodeBatchStartFunc  start,
+                                  GeocodeBatchFinishFunc finish);
+guint _geocode_batch_add_request (GeocodeBatch   *batch,
+                                  gpointer        data,
+                                  GDestroyNotify  destroy,
+                                  guint           index_);
+void _geocode_batch_add_to_request (GeocodeBatch *batch,
+                                    guint         request,
+                                    guint         index_);
+void _geocode_batch_set_error (GeocodeBatch *batch,
+                               guint         index_,
+                               GError       *error);
+void _geocode_batch_run (GeocodeBatch        *batch,
+                         gpointer             source_object,
+                         guint                max_running,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data);
+GeocodeBatchResults *_geocode_batch_finish (GAsyncResult  *result,
+                                            GError       **error);
 
 G_END_DECLS
 
@@ -70,74 +70,768 @@ _geocode_glib_build_soup_session (const gchar *user_agent_override)
 	                                      user_agent, NULL);
 }
 
+/*
+ * _geocode_glib_parse_retry_after:
+ * @value: value of a `Retry-After` response header
+ * @now: current wall-clock time, in seconds since the epoch
+ * @delay: (out): return location for the delay, in seconds
+ *
+ * Parses a `Retry-After` header, which gives either a number of seconds or an
+ * HTTP date (RFC 7231, §7.1.3) after which a request may be retried. Dates in
+ * the past give a delay of 0.
+ *
+ * Returns: %TRUE if @value was valid, %FALSE otherwise
+ */
+gboolean
+_geocode_glib_parse_retry_after (const char *value,
+                                 gint64      now,
+                                 guint      *delay)
+{
+	SoupDate *date;
+	gint64 when;
+
+	g_return_val_if_fail (value != NULL, FALSE);
+	g_return_val_if_fail (delay != NULL, FALSE);
+
+	while (g_ascii_isspace (*value))
+		value++;
+
+	if (g_ascii_isdigit (*value)) {
+		guint64 seconds;
+		char *end;
+
+		seconds = g_ascii_strtoull (value, &end, 10);
+		while (g_ascii_isspace (*end))
+			end++;
+		if (*end != '\0')
+			return FALSE;
+
+		*delay = MIN (seconds, G_MAXUINT);
+		return TRUE;
+	}
+
+	date = soup_date_new_from_string (value);
+	if (date == NULL)
+		return FALSE;
+
+	when = soup_date_to_time_t (date);
+	soup_date_free (date);
+
+	*delay = CLAMP (when - now, 0, G_MAXUINT);
+	return TRUE;
+}
+
+/* Query parameters which do not affect the response, and so must not affect
+ * the cache key either. */
+static const char *cache_key_ignored_params[] = {
+	"email",
+};
+
+static gint cache_hits = 0;
+static gint cache_misses = 0;
+
+/* Eviction limits for the on-disk cache, protected by @cache_limits_lock. */
+static GMutex cache_limits_lock;
+static guint64 cache_max_size = GEOCODE_CACHE_DEFAULT_MAX_SIZE;
+static guint cache_max_entries = GEOCODE_CACHE_DEFAULT_MAX_ENTRIES;
+
+/* Whether to compress new entries in the on-disk cache. Accessed atomically. */
+static gint cache_compression = TRUE;
+
+/* How often the cache thread sweeps the cache for expired entries, and how
+ * many index slots it examines at a time, so that lookups from other threads
+ * are never blocked for long. */
+#define CACHE_SWEEP_INTERVAL (10 * 60) /* seconds */
+#define CACHE_EVICTION_BATCH 256 /* slots */
+
+/* Maximum number of writes waiting for the cache thread; more are dropped
+ * rather than letting a burst of queries use unbounded memory. */
+#define CACHE_MAX_PENDING_WRITES 1024
+
+/* Each value in the on-disk cache is saved in a record along with the time it
+ * goes stale and the validators of the response it came from, so that stale
+ * values can be returned while they are refreshed with a conditional request.
+ * The version distinguishes these records from the bare values saved by
+ * earlier releases, whose first field is 1. */
+#define CACHE_RECORD_VERSION 2
+#define CACHE_RECORD_TYPE "(utmsmsay)"
+
+typedef struct {
+	GBytes *value;
+	guint64 expires;
+} CacheWrite;
+
+/* All protected by @cache_thread_lock. Writes are queued in @pending_writes
+ * (key → CacheWrite), and moved to @in_flight_writes while the cache thread
+ * writes them out, so that lookups can see them in the meantime. */
+static GMutex cache_thread_lock;
+static GCond cache_thread_cond;
+static GCond cache_flushed_cond;
+static gboolean cache_maintenance_requested = FALSE;
+static GHashTable *pending_writes = NULL;
+static GHashTable *in_flight_writes = NULL;
+
+static gboolean
+is_ignored_cache_key_param (const char *key)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (cache_key_ignored_params); i++) {
+		if (g_str_equal (key, cache_key_ignored_params[i]))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Collapse runs of whitespace to a single space, strip leading and trailing
+ * whitespace, and case-fold, so that trivially different spellings of a
+ * free-text query share a cache entry. */
+static char *
+normalize_free_text (const char *text)
+{
+	GString *str;
+	g_autofree char *folded = NULL;
+	g_autofree char *normalized = NULL;
+	const char *p;
+	gboolean in_space = FALSE;
+
+	str = g_string_sized_new (strlen (text));
+
+	for (p = text; *p != '\0'; p = g_utf8_next_char (p)) {
+		gunichar c = g_utf8_get_char (p);
+
+		if (g_unichar_isspace (c)) {
+			in_space = TRUE;
+			continue;
+		}
+
+		if (in_space && str->len > 0)
+			g_string_append_c (str, ' ');
+		in_space = FALSE;
+
+		g_string_append_unichar (str, c);
+	}
+
+	folded = g_utf8_casefold (str->str, str->len);
+	g_string_free (str, TRUE);
+	normalized = g_utf8_normalize (folded, -1, G_NORMALIZE_ALL);
+
+	return (normalized != NULL) ? g_steal_pointer (&normalized) : g_steal_pointer (&folded);
+}
+
+/*
+ * _geocode_glib_cache_key_encode_free_text:
+ * @text: the value of a `q` parameter
+ *
+ * Returns: (transfer full): @text as it is in cache keys
+ */
+char *
+_geocode_glib_cache_key_encode_free_text (const char *text)
+{
+	g_autofree char *normalized = normalize_free_text (text);
+
+	return g_uri_escape_string (normalized, NULL, TRUE);
+}
+
+/* Builds the cache key for @uri. If @suffix is given, the key is split after
+ * the name of the `q` parameter, which must be there, and its value left
+ * out. */
+static char *
+build_cache_key (SoupURI  *uri,
+                 char    **suffix)
+{
+	g_autoptr (GHashTable) params = NULL;
+	g_autofree char *base = NULL;
+	SoupURI *base_uri;
+	GList *keys, *l;
+	GString *key;
+	const char *separator = "?";
+	gsize split = 0;
+
+	base_uri = soup_uri_copy (uri);
+	soup_uri_set_query (base_uri, NULL);
+	soup_uri_set_fragment (base_uri, NULL);
+	base = soup_uri_to_string (base_uri, FALSE);
+	soup_uri_free (base_uri);
+
+	key = g_string_new (base);
+
+	if (soup_uri_get_query (uri) != NULL)
+		params = soup_form_decode (soup_uri_get_query (uri));
+	else
+		params = g_hash_table_new (g_str_hash, g_str_equal);
+
+	keys = g_list_sort (g_hash_table_get_keys (params),
+	                    (GCompareFunc) g_strcmp0);
+
+	for (l = keys; l != NULL; l = l->next) {
+		const char *name = l->data;
+		const char *value = g_hash_table_lookup (params, name);
+		g_autofree char *normalized = NULL;
+		g_autofree char *escaped = NULL;
+
+		if (is_ignored_cache_key_param (name))
+			continue;
+
+		g_string_append_printf (key, "%s%s=", separator, name);
+		separator = "&";
+
+		if (g_str_equal (name, "q")) {
+			split = key->len;
+			escaped = _geocode_glib_cache_key_encode_free_text (value);
+		} else if (g_str_equal (name, "accept-language")) {
+			normalized = g_ascii_strdown (value, -1);
+			escaped = g_uri_escape_string (normalized, NULL, TRUE);
+		} else {
+			escaped = g_uri_escape_string (value, NULL, TRUE);
+		}
+
+		g_string_append (key, escaped);
+	}
+
+	g_list_free (keys);
+
+	if (suffix != NULL) {
+		if (split == 0) {
+			g_critical ("Cache key '%s' has no search terms", key->str);
+			split = key->len;
+		}
+
+		*suffix = g_strdup (key->str + split);
+		g_string_truncate (key, split);
+	}
+
+	return g_string_free (key, FALSE);
+}
+
+/*
+ * _geocode_glib_cache_key_for_uri:
+ * @uri: a query URI
+ *
+ * Builds a canonical key for the query @uri, which is the same for all
+ * semantically identical queries: parameters are sorted by name, parameters
+ * which do not affect the response (such as `email`) are dropped, and the
+ * free-text `q` and `accept-language` values are normalized.
+ *
+ * Returns: (transfer full): the cache key
+ */
+char *
+_geocode_glib_cache_key_for_uri (SoupURI *uri)
+{
+	return build_cache_key (uri, NULL);
+}
+
+/*
+ * _geocode_glib_cache_key_split_for_uri:
+ * @uri: a query URI with a `q` parameter
+ * @suffix: (out) (transfer full): return location for the end of the key
+ *
+ * Builds the cache key for @uri in two parts, around the value of its `q`
+ * parameter, so that the key for the same query with other search terms is
+ * the returned prefix, the terms as encoded by
+ * _geocode_glib_cache_key_encode_free_text(), and @suffix.
+ *
+ * Returns: (transfer full): the start of the key
+ */
 char *
-_geocode_glib_cache_path_for_query (SoupMessage *query)
-{
-	const char *filename;
-	char *path;
-        SoupURI *soup_uri;
-	char *uri;
-	GChecksum *sum;
-
-	/* Create cache directory */
-	path = g_build_filename (g_get_user_cache_dir (),
-				 "geocode-glib",
-				 NULL);
-	if (g_mkdir_with_parents (path, 0700) < 0) {
-		g_warning ("Failed to mkdir path '%s': %s", path, g_strerror (errno));
+_geocode_glib_cache_key_split_for_uri (SoupURI  *uri,
+                                       char    **suffix)
+{
+	g_return_val_if_fail (suffix != NULL, NULL);
+
+	return build_cache_key (uri, suffix);
+}
+
+/* Accounts for a lookup in the on-disk cache. */
+static void
+record_lookup (gboolean hit)
+{
+	if (hit)
+		g_atomic_int_inc (&cache_hits);
+	else
+		g_atomic_int_inc (&cache_misses);
+}
+
+static void
+cache_write_free (CacheWrite *write)
+{
+	g_bytes_unref (write->value);
+	g_slice_free (CacheWrite, write);
+}
+
+static GHashTable *
+cache_writes_new (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                              (GDestroyNotify) cache_write_free);
+}
+
+/* Writes a batch of queued entries to the store, and makes them durable with
+ * a single sync. */
+static void
+write_cache_entries (GeocodeCacheStore *store,
+                     GHashTable        *writes)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	GError *error = NULL;
+
+	g_hash_table_iter_init (&iter, writes);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		CacheWrite *write = value;
+
+		g_debug ("Saving cache entry '%s'", (const char *) key);
+		if (!_geocode_cache_store_insert (store, key, write->value,
+		                                  write->expires, &error)) {
+			g_debug ("Failed to save cache entry '%s': %s",
+			         (const char *) key, error->message);
+			g_clear_error (&error);
+		}
+	}
+
+	if (!_geocode_cache_store_sync (store, &error)) {
+		g_debug ("Failed to sync cache: %s", error->message);
+		g_clear_error (&error);
+	}
+}
+
+/* Does all writes and eviction for the on-disk cache, so that they never
+ * block the threads making queries. Entries are evicted whenever writes take
+ * the cache over its limits, and periodically to drop expired entries. */
+static gpointer
+cache_thread (gpointer data)
+{
+	GeocodeCacheStore *store = data;
+
+	for (;;) {
+		gint64 end_time;
+		gboolean requested;
+		GHashTable *writes;
+
+		end_time = g_get_monotonic_time () + CACHE_SWEEP_INTERVAL * G_TIME_SPAN_SECOND;
+
+		g_mutex_lock (&cache_thread_lock);
+		while (!cache_maintenance_requested &&
+		       g_hash_table_size (pending_writes) == 0 &&
+		       g_cond_wait_until (&cache_thread_cond,
+		                          &cache_thread_lock,
+		                          end_time));
+		requested = cache_maintenance_requested;
+		cache_maintenance_requested = FALSE;
+
+		writes = NULL;
+		if (g_hash_table_size (pending_writes) > 0) {
+			writes = in_flight_writes = pending_writes;
+			pending_writes = cache_writes_new ();
+		}
+		g_mutex_unlock (&cache_thread_lock);
+
+		if (writes != NULL) {
+			write_cache_entries (store, writes);
+
+			g_mutex_lock (&cache_thread_lock);
+			in_flight_writes = NULL;
+			g_cond_broadcast (&cache_flushed_cond);
+			g_mutex_unlock (&cache_thread_lock);
+
+			g_hash_table_unref (writes);
+		} else if (!requested) {
+			_geocode_cache_store_request_sweep (store);
+		}
+
+		while (_geocode_cache_store_evict (store, CACHE_EVICTION_BATCH))
+			g_thread_yield ();
+	}
+
+	return NULL;
+}
+
+static void
+request_cache_maintenance (void)
+{
+	g_mutex_lock (&cache_thread_lock);
+	cache_maintenance_requested = TRUE;
+	g_cond_signal (&cache_thread_cond);
+	g_mutex_unlock (&cache_thread_lock);
+}
+
+/* Returns the process-wide on-disk cache store, or %NULL if it could not be
+ * opened, in which case caching is disabled. */
+static GeocodeCacheStore *
+get_cache_store (void)
+{
+	static gsize initialized = 0;
+	static GeocodeCacheStore *store = NULL;
+
+	if (g_once_init_enter (&initialized)) {
+		char *path;
+		GError *error = NULL;
+
+		path = g_build_filename (g_get_user_cache_dir (),
+					 "geocode-glib",
+					 NULL);
+		store = _geocode_cache_store_open (path, &error);
+		if (store == NULL) {
+			g_warning ("Failed to open cache in '%s': %s", path, error->message);
+			g_error_free (error);
+		} else {
+			g_mutex_lock (&cache_limits_lock);
+			_geocode_cache_store_set_limits (store, cache_max_size,
+			                                 cache_max_entries);
+			g_mutex_unlock (&cache_limits_lock);
+
+			_geocode_cache_store_set_codec (store,
+			                                g_atomic_int_get (&cache_compression) ?
+			                                GEOCODE_CACHE_DEFAULT_CODEC :
+			                                GEOCODE_CACHE_CODEC_NONE);
+
+			pending_writes = cache_writes_new ();
+			g_thread_unref (g_thread_new ("geocode-cache",
+			                              cache_thread,
+			                              store));
+		}
 		g_free (path);
-		return NULL;
+
+		g_once_init_leave (&initialized, 1);
 	}
-	g_free (path);
 
-	/* Create path for query */
-	soup_uri = soup_message_get_uri (query);
-	uri = soup_uri_to_string (soup_uri, FALSE);
+	return store;
+}
 
-	sum = g_checksum_new (G_CHECKSUM_SHA256);
-	g_checksum_update (sum, (const guchar *) uri, strlen (uri));
+/*
+ * _geocode_cache_info_clear:
+ * @info: a #GeocodeCacheInfo
+ *
+ * Frees the contents of @info, and resets it.
+ */
+void
+_geocode_cache_info_clear (GeocodeCacheInfo *info)
+{
+	g_clear_pointer (&info->etag, g_free);
+	g_clear_pointer (&info->last_modified, g_free);
+	info->stale = FALSE;
+	info->stale_at = 0;
+}
 
-	filename = g_checksum_get_string (sum);
+static GBytes *
+pack_cache_record (GBytes                 *value,
+                   guint64                 stale_at,
+                   const GeocodeCacheInfo *info)
+{
+	g_autoptr(GVariant) record = NULL;
+
+	record = g_variant_ref_sink (g_variant_new ("(utmsms@ay)",
+	                                            CACHE_RECORD_VERSION,
+	                                            stale_at,
+	                                            (info != NULL) ? info->etag : NULL,
+	                                            (info != NULL) ? info->last_modified : NULL,
+	                                            g_variant_new_from_bytes (G_VARIANT_TYPE_BYTESTRING,
+	                                                                      value, TRUE)));
+
+	return g_variant_get_data_as_bytes (record);
+}
 
-	path = g_build_filename (g_get_user_cache_dir (),
-				 "geocode-glib",
-				 filename,
-				 NULL);
+/* Returns the value saved in @bytes, without copying it, or %NULL if @bytes is
+ * not a valid record. */
+static GBytes *
+unpack_cache_record (GBytes           *bytes,
+                     GeocodeCacheInfo *info)
+{
+	g_autoptr(GVariant) record = NULL;
+	g_autoptr(GVariant) value = NULL;
+	guint32 version;
+	guint64 stale_at;
+	char *etag, *last_modified;
+
+	record = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (CACHE_RECORD_TYPE),
+	                                                       bytes, FALSE));
+	if (!g_variant_is_normal_form (record))
+		return NULL;
+
+	g_variant_get (record, "(utmsms@ay)",
+	               &version, &stale_at, &etag, &last_modified, &value);
+
+	if (version != CACHE_RECORD_VERSION) {
+		g_free (etag);
+		g_free (last_modified);
+		return NULL;
+	}
 
-	g_checksum_free (sum);
-	g_free (uri);
+	if (info != NULL) {
+		info->etag = etag;
+		info->last_modified = last_modified;
+		info->stale = (stale_at != 0 &&
+		               stale_at <= (guint64) (g_get_real_time () / G_USEC_PER_SEC));
+		info->stale_at = stale_at;
+	} else {
+		g_free (etag);
+		g_free (last_modified);
+	}
 
-	return path;
+	return g_variant_get_data_as_bytes (value);
 }
 
+/*
+ * _geocode_glib_cache_save:
+ * @key: canonical query key (see _geocode_glib_cache_key_for_uri())
+ * @value: the value to cache
+ * @ttl: number of seconds after which the value goes stale, or 0 to keep it
+ *    until it is evicted to make room for others
+ * @stale_ttl: number of seconds for which to keep the value once it is stale
+ * @info: (nullable): validators of the response @value came from
+ *
+ * Queues @value to be saved in the on-disk cache. This never blocks on I/O:
+ * the write is done later by the cache thread, batched with others. Lookups
+ * see queued writes straight away.
+ *
+ * Returns: %TRUE if the write was queued, %FALSE otherwise
+ */
 gboolean
-_geocode_glib_cache_save (SoupMessage *query,
-			  const char  *contents)
+_geocode_glib_cache_save (const char             *key,
+                          GBytes                 *value,
+                          guint                   ttl,
+                          guint                   stale_ttl,
+                          const GeocodeCacheInfo *info)
 {
-	char *path;
-	gboolean ret;
+	GeocodeCacheStore *store;
+	CacheWrite *write;
+	guint64 stale_at;
+	g_autoptr(GBytes) record = NULL;
+	gboolean ret = FALSE;
+
+	store = get_cache_store ();
+	if (store == NULL)
+		return FALSE;
+
+	stale_at = (ttl > 0) ? g_get_real_time () / G_USEC_PER_SEC + ttl : 0;
+	record = pack_cache_record (value, stale_at, info);
+
+	g_mutex_lock (&cache_thread_lock);
+
+	if (g_hash_table_size (pending_writes) < CACHE_MAX_PENDING_WRITES ||
+	    g_hash_table_contains (pending_writes, key)) {
+		write = g_slice_new (CacheWrite);
+		write->value = g_bytes_ref (record);
+		write->expires = (ttl > 0) ? stale_at + stale_ttl : 0;
+
+		g_hash_table_replace (pending_writes, g_strdup (key), write);
+		g_cond_signal (&cache_thread_cond);
+		ret = TRUE;
+	} else {
+		g_debug ("Dropping cache entry '%s': too many pending writes", key);
+	}
 
-	path = _geocode_glib_cache_path_for_query (query);
-	g_debug ("Saving cache file '%s'", path);
-	ret = g_file_set_contents (path, contents, -1, NULL);
+	g_mutex_unlock (&cache_thread_lock);
 
-	g_free (path);
 	return ret;
 }
 
+/* Looks up @key in the writes which have not reached the store yet. */
+static gboolean
+lookup_pending_write (const char  *key,
+                      GBytes     **value)
+{
+	CacheWrite *write = NULL;
+
+	g_mutex_lock (&cache_thread_lock);
+
+	if (pending_writes != NULL)
+		write = g_hash_table_lookup (pending_writes, key);
+	if (write == NULL && in_flight_writes != NULL)
+		write = g_hash_table_lookup (in_flight_writes, key);
+
+	if (write != NULL)
+		*value = g_bytes_ref (write->value);
+
+	g_mutex_unlock (&cache_thread_lock);
+
+	return (write != NULL);
+}
+
+/*
+ * _geocode_glib_cache_flush:
+ *
+ * Blocks until all queued writes to the on-disk cache have been written.
+ */
+void
+_geocode_glib_cache_flush (void)
+{
+	if (get_cache_store () == NULL)
+		return;
+
+	g_mutex_lock (&cache_thread_lock);
+	while (g_hash_table_size (pending_writes) > 0 || in_flight_writes != NULL)
+		g_cond_wait (&cache_flushed_cond, &cache_thread_lock);
+	g_mutex_unlock (&cache_thread_lock);
+}
+
+/*
+ * _geocode_glib_cache_load:
+ * @key: canonical query key
+ * @value: (out) (transfer full): return location for the cached value
+ * @info: (out caller-allocates) (optional): return location for the validators
+ *    saved with the value and whether it is stale; free its contents with
+ *    _geocode_cache_info_clear()
+ *
+ * Looks up @key in the on-disk cache. Values which have gone stale are still
+ * returned until they expire, with @info->stale set.
+ *
+ * Returns: %TRUE if @key was found, %FALSE otherwise
+ */
 gboolean
-_geocode_glib_cache_load (SoupMessage *query,
-			  char  **contents)
+_geocode_glib_cache_load (const char        *key,
+                          GBytes           **value,
+                          GeocodeCacheInfo  *info)
 {
-	char *path;
-	gboolean ret;
+	GeocodeCacheStore *store;
+	g_autoptr(GBytes) record = NULL;
 
-	path = _geocode_glib_cache_path_for_query (query);
-	g_debug ("Loading cache file '%s'", path);
-	ret = g_file_get_contents (path, contents, NULL, NULL);
+	store = get_cache_store ();
+	g_debug ("Loading cache entry '%s'", key);
 
-	g_free (path);
-	return ret;
+	if (store != NULL &&
+	    (lookup_pending_write (key, &record) ||
+	     _geocode_cache_store_lookup (store, key, &record)))
+		*value = unpack_cache_record (record, info);
+	else
+		*value = NULL;
+
+	record_lookup (*value != NULL);
+
+	return (*value != NULL);
+}
+
+/*
+ * _geocode_glib_cache_set_limits:
+ * @max_size: maximum total size of the cached responses, in bytes
+ * @max_entries: maximum number of cached responses
+ *
+ * Sets the limits which the on-disk cache is kept within. Least recently used
+ * entries are evicted in the background when it grows past them.
+ */
+void
+_geocode_glib_cache_set_limits (guint64 max_size,
+                                guint   max_entries)
+{
+	GeocodeCacheStore *store;
+
+	g_mutex_lock (&cache_limits_lock);
+	cache_max_size = max_size;
+	cache_max_entries = max_entries;
+	g_mutex_unlock (&cache_limits_lock);
+
+	store = get_cache_store ();
+	if (store != NULL) {
+		_geocode_cache_store_set_limits (store, max_size, max_entries);
+		request_cache_maintenance ();
+	}
+}
+
+void
+_geocode_glib_cache_get_limits (guint64 *max_size,
+                                guint   *max_entries)
+{
+	g_mutex_lock (&cache_limits_lock);
+	if (max_size != NULL)
+		*max_size = cache_max_size;
+	if (max_entries != NULL)
+		*max_entries = cache_max_entries;
+	g_mutex_unlock (&cache_limits_lock);
+}
+
+/*
+ * _geocode_glib_cache_set_compression:
+ * @compression: whether to compress new entries
+ *
+ * Sets whether new entries in the on-disk cache are compressed, with the
+ * fastest codec available. Existing entries are not affected.
+ */
+void
+_geocode_glib_cache_set_compression (gboolean compression)
+{
+	GeocodeCacheStore *store;
+
+	g_atomic_int_set (&cache_compression, compression);
+
+	store = get_cache_store ();
+	if (store != NULL)
+		_geocode_cache_store_set_codec (store,
+		                                compression ?
+		                                GEOCODE_CACHE_DEFAULT_CODEC :
+		                                GEOCODE_CACHE_CODEC_NONE);
+}
+
+gboolean
+_geocode_glib_cache_get_compression (void)
+{
+	return g_atomic_int_get (&cache_compression);
+}
+
+/*
+ * _geocode_glib_cache_trim:
+ * @error: return location for a #GError
+ *
+ * Synchronously evicts expired entries from the on-disk cache, evicts least
+ * recently used entries until it is within its limits, and compacts it.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+_geocode_glib_cache_trim (GError **error)
+{
+	GeocodeCacheStore *store;
+
+	store = get_cache_store ();
+	if (store == NULL)
+		return TRUE;
+
+	_geocode_glib_cache_flush ();
+
+	return _geocode_cache_store_trim (store, error);
+}
+
+/*
+ * _geocode_glib_cache_get_stats:
+ * @hits: (out) (optional): return location for the number of cache hits
+ * @misses: (out) (optional): return location for the number of cache misses
+ *
+ * Gets the number of on-disk cache lookups which were answered from the cache
+ * and which were not, since the process started.
+ */
+void
+_geocode_glib_cache_get_stats (guint *hits,
+                               guint *misses)
+{
+	if (hits != NULL)
+		*hits = g_atomic_int_get (&cache_hits);
+	if (misses != NULL)
+		*misses = g_atomic_int_get (&cache_misses);
+}
+
+static GRegex *
+get_locale_regex (void)
+{
+	static gsize initialized = 0;
+	static GRegex *re = NULL;
+
+	if (g_once_init_enter (&initialized)) {
+		GError *error = NULL;
+
+		re = g_regex_new ("^(?P<language>[^_.@[:space:]]+)"
+				  "(_(?P<territory>[[:upper:]]+))?"
+				  "(\\.(?P<codeset>[-_0-9a-zA-Z]+))?"
+				  "(@(?P<modifier>[[:ascii:]]+))?$",
+				  G_REGEX_OPTIMIZE, 0, &error);
+		if (re == NULL) {
+			g_warning ("%s", error->message);
+			g_error_free (error);
+		}
+
+		g_once_init_leave (&initialized, 1);
+	}
+
+	return re;
 }
 
 static gboolean
@@ -148,22 +842,14 @@ parse_lang (const char *locale,
 	GRegex     *re;
 	GMatchInfo *match_info;
 	gboolean    res;
-	GError     *error;
 	gboolean    retval;
 
 	match_info = NULL;
 	retval = FALSE;
 
-	error = NULL;
-	re = g_regex_new ("^(?P<language>[^_.@[:space:]]+)"
-			  "(_(?P<territory>[[:upper:]]+))?"
-			  "(\\.(?P<codeset>[-_0-9a-zA-Z]+))?"
-			  "(@(?P<modifier>[[:ascii:]]+))?$",
-			  0, 0, &error);
-	if (re == NULL) {
-		g_warning ("%s", error->message);
+	re = get_locale_regex ();
+	if (re == NULL)
 		goto out;
-	}
 
 	if (!g_regex_match (re, locale, 0, &match_info) ||
 	    g_match_info_is_partial_match (match_info)) {
@@ -191,7 +877,6 @@ parse_lang (const char *locale,
 
 out:
 	g_match_info_free (match_info);
-	g_regex_unref (re);
 
 	return retval;
 }
@@ -217,10 +902,36 @@ geocode_object_get_lang_for_locale (const char *locale)
 	return ret;
 }
 
+/* The language for the locale last seen, which is only parsed again when the
+ * locale changes. Protected by @lang_lock. */
+static GMutex lang_lock;
+static char *cached_lang_locale = NULL;
+static char *cached_lang = NULL;
+
 char *
 _geocode_object_get_lang (void)
 {
-	return geocode_object_get_lang_for_locale (setlocale (LC_MESSAGES, NULL));
+	const char *locale;
+	char *ret;
+
+	locale = setlocale (LC_MESSAGES, NULL);
+	if (locale == NULL)
+		return NULL;
+
+	g_mutex_lock (&lang_lock);
+
+	if (g_strcmp0 (locale, cached_lang_locale) != 0) {
+		g_free (cached_lang_locale);
+		g_free (cached_lang);
+		cached_lang_locale = g_strdup (locale);
+		cached_lang = geocode_object_get_lang_for_locale (locale);
+	}
+
+	ret = g_strdup (cached_lang);
+
+	g_mutex_unlock (&lang_lock);
+
+	return ret;
 }
 
 #if defined(__GLIBC__) && !defined(__UCLIBC__)
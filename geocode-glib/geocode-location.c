@@ -26,6 +26,7 @@
 #include <math.h>
 #include <string.h>
 #include "geocode-location.h"
+#include "geocode-glib-private.h"
 
 #define EARTH_RADIUS_KM 6372.795
 
@@ -716,6 +717,36 @@ geocode_location_new_with_description (gdouble     latitude,
                              NULL);
 }
 
+/*
+ * _geocode_location_new:
+ * @latitude: a valid latitude
+ * @longitude: a valid longitude
+ * @accuracy: accuracy of location in meters
+ * @description: (nullable): a description for the location
+ *
+ * Creates a new #GeocodeLocation object, like
+ * geocode_location_new_with_description(), but setting its fields directly
+ * rather than as properties.
+ *
+ * Returns: (transfer full): a new #GeocodeLocation
+ */
+GeocodeLocation *
+_geocode_location_new (gdouble     latitude,
+                       gdouble     longitude,
+                       gdouble     accuracy,
+                       const char *description)
+{
+        GeocodeLocation *location;
+
+        location = g_object_new (GEOCODE_TYPE_LOCATION, NULL);
+        geocode_location_set_latitude (location, latitude);
+        geocode_location_set_longitude (location, longitude);
+        geocode_location_set_accuracy (location, accuracy);
+        location->priv->description = g_strdup (description);
+
+        return location;
+}
+
 /**
  * geocode_location_set_from_uri:
  * @loc: a #GeocodeLocation
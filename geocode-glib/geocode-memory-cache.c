@@ -0,0 +1,358 @@
+/*
+ * Copyright 2026 The geocode-glib authors
+ *
+ * The geocode-glib library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The geocode-glib library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301  USA.
+ */
+
+#include <string.h>
+
+#include "geocode-glib-private.h"
+
+/*
+ * A process-wide, thread-safe LRU cache of parsed query results, keyed by the
+ * canonical query key (see _geocode_glib_cache_key_for_uri()). It sits in
+ * front of the on-disk cache, so that repeated queries need neither file I/O
+ * nor JSON parsing.
+ *
+ * The cache is bounded by the estimated memory used by its entries rather
+ * than by their number, as result lists vary a lot in size. Cached places are
+ * never handed out directly: callers get deep copies, so they are free to
+ * modify the results they are given.
+ *
+ * Entries are reference counted so that a lookup only has to hold the lock
+ * for as long as it takes to find the entry; copying the places happens
+ * outside the lock, even if the entry is evicted concurrently.
+ *
+ * Entries go stale after the same time as in the on-disk cache, and are
+ * dropped when next looked up, so that the lookup falls through to the
+ * on-disk cache, which refreshes them. Queries which have no results are
+ * cached too, as negative entries holding the error to return. These expire
+ * after a short time, as the server may start returning results for them.
+ */
+
+typedef struct {
+	gint ref_count;
+	char *key;
+	GList *places;  /* (element-type GeocodePlace) (owned) */
+	GError *error;  /* (owned) (nullable); set for negative entries */
+	gint64 expires;  /* monotonic time at which it goes stale, or 0 for never */
+	gsize size;
+	GList link;  /* in lru_queue; data points to the entry itself */
+} CacheEntry;
+
+static GMutex cache_lock;
+static GHashTable *cache_entries = NULL;  /* (owned) key → (owned) CacheEntry */
+static GQueue lru_queue = G_QUEUE_INIT;  /* most recently used at the head */
+static gsize cache_size = 0;
+static gsize cache_capacity = GEOCODE_MEMORY_CACHE_DEFAULT_CAPACITY;
+static guint cache_hits = 0;
+static guint cache_misses = 0;
+
+static CacheEntry *
+cache_entry_ref (CacheEntry *entry)
+{
+	g_atomic_int_inc (&entry->ref_count);
+	return entry;
+}
+
+static void
+cache_entry_unref (CacheEntry *entry)
+{
+	if (!g_atomic_int_dec_and_test (&entry->ref_count))
+		return;
+
+	g_free (entry->key);
+	g_list_free_full (entry->places, g_object_unref);
+	g_clear_error (&entry->error);
+	g_slice_free (CacheEntry, entry);
+}
+
+static GList *
+places_list_dup (GList *places)
+{
+	GList *copy = NULL, *l;
+
+	for (l = places; l != NULL; l = l->next)
+		copy = g_list_prepend (copy, _geocode_place_dup (l->data));
+
+	return g_list_reverse (copy);
+}
+
+/* Must be called with @cache_lock held. */
+static void
+ensure_cache_entries (void)
+{
+	if (cache_entries == NULL)
+		cache_entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+		                                       NULL,
+		                                       (GDestroyNotify) cache_entry_unref);
+}
+
+/* Must be called with @cache_lock held. */
+static void
+remove_entry (CacheEntry *entry)
+{
+	g_queue_unlink (&lru_queue, &entry->link);
+	cache_size -= entry->size;
+
+	/* The hash table owns the key through the entry, so remove it last. */
+	g_hash_table_remove (cache_entries, entry->key);
+}
+
+/* Must be called with @cache_lock held. */
+static void
+evict_to_capacity (gsize capacity)
+{
+	while (cache_size > capacity && lru_queue.tail != NULL)
+		remove_entry (lru_queue.tail->data);
+}
+
+/*
+ * _geocode_memory_cache_lookup:
+ * @key: canonical query key
+ * @places: (out) (transfer full) (element-type GeocodePlace): return location
+ *    for copies of the cached places
+ * @error: return location for a #GError
+ *
+ * Looks up @key in the in-memory cache and, if found, marks it as most
+ * recently used and returns a deep copy of its places. If @key has a negative
+ * entry, @places is set to %NULL and its error is returned in @error. Stale
+ * entries are removed, and not returned.
+ *
+ * Returns: %TRUE on a cache hit, %FALSE otherwise
+ */
+gboolean
+_geocode_memory_cache_lookup (const char  *key,
+                              GList      **places,
+                              GError     **error)
+{
+	CacheEntry *entry = NULL;
+
+	g_return_val_if_fail (key != NULL, FALSE);
+	g_return_val_if_fail (places != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	g_mutex_lock (&cache_lock);
+
+	if (cache_entries != NULL)
+		entry = g_hash_table_lookup (cache_entries, key);
+
+	if (entry != NULL && entry->expires != 0 &&
+	    entry->expires <= g_get_monotonic_time ()) {
+		remove_entry (entry);
+		entry = NULL;
+	}
+
+	if (entry != NULL) {
+		g_queue_unlink (&lru_queue, &entry->link);
+		g_queue_push_head_link (&lru_queue, &entry->link);
+		cache_entry_ref (entry);
+		cache_hits++;
+	} else {
+		cache_misses++;
+	}
+
+	g_mutex_unlock (&cache_lock);
+
+	if (entry == NULL)
+		return FALSE;
+
+	if (entry->error != NULL) {
+		*places = NULL;
+		g_propagate_error (error, g_error_copy (entry->error));
+	} else {
+		*places = places_list_dup (entry->places);
+	}
+
+	cache_entry_unref (entry);
+
+	return TRUE;
+}
+
+static CacheEntry *
+cache_entry_new (const char *key)
+{
+	CacheEntry *entry;
+
+	entry = g_slice_new0 (CacheEntry);
+	entry->ref_count = 1;
+	entry->key = g_strdup (key);
+	entry->link.data = entry;
+	entry->size = sizeof (CacheEntry) + strlen (key) + 1;
+
+	return entry;
+}
+
+/* Adds @entry to the cache, replacing any existing entry for its key, and
+ * evicts least recently used entries until the cache fits in its capacity.
+ * Entries which are larger than the whole cache are not stored. */
+static void
+add_entry (CacheEntry *entry)
+{
+	CacheEntry *old_entry;
+	const char *key = entry->key;
+
+	g_mutex_lock (&cache_lock);
+
+	if (entry->size > cache_capacity) {
+		g_mutex_unlock (&cache_lock);
+		cache_entry_unref (entry);
+		return;
+	}
+
+	ensure_cache_entries ();
+
+	old_entry = g_hash_table_lookup (cache_entries, key);
+	if (old_entry != NULL)
+		remove_entry (old_entry);
+
+	g_hash_table_insert (cache_entries, entry->key, entry);
+	g_queue_push_head_link (&lru_queue, &entry->link);
+	cache_size += entry->size;
+
+	evict_to_capacity (cache_capacity);
+
+	g_mutex_unlock (&cache_lock);
+}
+
+/*
+ * _geocode_memory_cache_insert:
+ * @key: canonical query key
+ * @places: (transfer none) (element-type GeocodePlace): places to cache
+ * @ttl: number of seconds after which the entry goes stale, or 0 to keep it
+ *    until it is evicted to make room for others
+ *
+ * Caches a copy of @places under @key, replacing any existing entry.
+ */
+void
+_geocode_memory_cache_insert (const char *key,
+                              GList      *places,
+                              guint       ttl)
+{
+	CacheEntry *entry;
+	GList *l;
+
+	g_return_if_fail (key != NULL);
+
+	entry = cache_entry_new (key);
+	entry->places = places_list_dup (places);
+	if (ttl > 0)
+		entry->expires = g_get_monotonic_time () + (gint64) ttl * G_USEC_PER_SEC;
+
+	for (l = entry->places; l != NULL; l = l->next)
+		entry->size += sizeof (GList) + _geocode_place_get_memory_size (l->data);
+
+	add_entry (entry);
+}
+
+/*
+ * _geocode_memory_cache_insert_error:
+ * @key: canonical query key
+ * @error: error to return for @key
+ * @ttl: number of seconds for which to keep the entry; must be non-zero
+ *
+ * Caches a negative entry for @key, so that lookups of it fail with a copy of
+ * @error, until it expires after @ttl seconds. Any existing entry for @key is
+ * replaced.
+ */
+void
+_geocode_memory_cache_insert_error (const char   *key,
+                                    const GError *error,
+                                    guint         ttl)
+{
+	CacheEntry *entry;
+
+	g_return_if_fail (key != NULL);
+	g_return_if_fail (error != NULL);
+	g_return_if_fail (ttl > 0);
+
+	entry = cache_entry_new (key);
+	entry->error = g_error_copy (error);
+	entry->expires = g_get_monotonic_time () + (gint64) ttl * G_USEC_PER_SEC;
+	entry->size += sizeof (GError) + strlen (error->message) + 1;
+
+	add_entry (entry);
+}
+
+/*
+ * _geocode_memory_cache_set_capacity:
+ * @capacity: maximum estimated size of the cache, in bytes
+ *
+ * Sets the capacity of the in-memory cache, evicting entries if it is now
+ * over capacity. A capacity of zero empties the cache and stops anything
+ * being added to it.
+ */
+void
+_geocode_memory_cache_set_capacity (gsize capacity)
+{
+	g_mutex_lock (&cache_lock);
+	cache_capacity = capacity;
+	evict_to_capacity (cache_capacity);
+	g_mutex_unlock (&cache_lock);
+}
+
+gsize
+_geocode_memory_cache_get_capacity (void)
+{
+	gsize capacity;
+
+	g_mutex_lock (&cache_lock);
+	capacity = cache_capacity;
+	g_mutex_unlock (&cache_lock);
+
+	return capacity;
+}
+
+/*
+ * _geocode_memory_cache_clear:
+ *
+ * Removes all entries from the in-memory cache, and resets its statistics.
+ */
+void
+_geocode_memory_cache_clear (void)
+{
+	g_mutex_lock (&cache_lock);
+	evict_to_capacity (0);
+	cache_hits = 0;
+	cache_misses = 0;
+	g_mutex_unlock (&cache_lock);
+}
+
+/*
+ * _geocode_memory_cache_get_stats:
+ * @hits: (out) (optional): return location for the number of cache hits
+ * @misses: (out) (optional): return location for the number of cache misses
+ * @size: (out) (optional): return location for the estimated size of the
+ *    cache, in bytes
+ *
+ * Gets statistics about the in-memory cache.
+ */
+void
+_geocode_memory_cache_get_stats (guint *hits,
+                                 guint *misses,
+                                 gsize *size)
+{
+	g_mutex_lock (&cache_lock);
+
+	if (hits != NULL)
+		*hits = cache_hits;
+	if (misses != NULL)
+		*misses = cache_misses;
+	if (size != NULL)
+		*size = cache_size;
+
+	g_mutex_unlock (&cache_lock);
+}
@@ -116,6 +116,8 @@ struct _GeocodeMockBackend {
 	GPtrArray *forward_results;  /* (owned) (element-type owned GeocodeMockBackendQuery) */
 	GPtrArray *reverse_results;  /* (owned) (element-type owned GeocodeMockBackendQuery) */
 	GPtrArray *query_log;  /* (owned) (element-type owned GeocodeMockBackendQuery) */
+	GMutex query_log_lock;  /* held while appending to @query_log, which
+	                         * asynchronous queries do from their threads */
 };
 
 static void geocode_backend_iface_init (GeocodeBackendInterface *iface);
@@ -357,7 +359,9 @@ forward_or_reverse (GeocodeMockBackend  *self,
 	logged_query = geocode_mock_backend_query_new (params, TRUE,
 	                                               output_results,
 	                                               output_error);
+	g_mutex_lock (&self->query_log_lock);
 	g_ptr_array_add (self->query_log, g_steal_pointer (&logged_query));
+	g_mutex_unlock (&self->query_log_lock);
 
 	/* Output either the results or the error. */
 	g_assert ((output_results == NULL) != (output_error == NULL));
@@ -563,6 +567,7 @@ geocode_mock_backend_init (GeocodeMockBackend *self)
 	    g_ptr_array_new_with_free_func ((GDestroyNotify) geocode_mock_backend_query_free);
 	self->reverse_results =
 	    g_ptr_array_new_with_free_func ((GDestroyNotify) geocode_mock_backend_query_free);
+	g_mutex_init (&self->query_log_lock);
 }
 
 static void
@@ -572,6 +577,7 @@ geocode_mock_backend_finalize (GObject *object)
 
 	g_clear_pointer (&self->forward_results, g_ptr_array_unref);
 	g_clear_pointer (&self->reverse_results, g_ptr_array_unref);
+	g_mutex_clear (&self->query_log_lock);
 
 	G_OBJECT_CLASS (geocode_mock_backend_parent_class)->finalize (object);
 }
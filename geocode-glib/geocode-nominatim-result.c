@@ -0,0 +1,839 @@
+/*
+ * Copyright 2026 The geocode-glib authors
+ *
+ * The geocode-glib library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The geocode-glib library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "geocode-error.h"
+#include "geocode-glib-private.h"
+
+/*
+ * Decodes a single result, a JSON object, from a Nominatim response in one
+ * pass over its text. Only the members which geocode-glib uses are kept: each
+ * of them is looked up in a static dispatch table, and its value decoded
+ * straight into the field it maps to. Other members are skipped without being
+ * decoded.
+ *
+ * Values are stored, NUL-terminated, one after the other in a single buffer,
+ * which is reused for each result decoded, so that decoding a result does not
+ * usually allocate at all.
+ *
+ * As before, string values are kept unless empty, integer values are kept as
+ * their decimal representation, and other values are ignored. The members of
+ * the "address" object override those of the result itself, and the first of
+ * them gives the name of the place.
+ */
+
+/* Members which are not fields, but are handled specially. */
+enum {
+	MEMBER_ADDRESS = GEOCODE_NOMINATIM_N_FIELDS,
+	MEMBER_BOUNDINGBOX,
+	MEMBER_ERROR,
+	MEMBER_UNKNOWN,
+};
+
+typedef struct {
+	const char *name;
+	guint member;
+} Member;
+
+/*
+ * Members, and (category, type) pairs, are looked up in perfect hash tables:
+ * each key is hashed with FNV-1a from a seed chosen so that no two keys share
+ * a slot, so a lookup is one hash and one string comparison. When adding a
+ * key, its slot is the top bits of its hash; if the slot is taken, another
+ * seed must be found, and all the slots recomputed. The unit tests check that
+ * every key is found.
+ */
+#define FNV_PRIME 16777619u
+
+#define MEMBER_HASH_SEED 0x6bu
+#define MEMBER_HASH_BITS 6
+
+static const Member members[1 << MEMBER_HASH_BITS] = {
+	[62] = { "address", MEMBER_ADDRESS },
+	[3] = { "boundingbox", MEMBER_BOUNDINGBOX },
+	[25] = { "category", GEOCODE_NOMINATIM_FIELD_CATEGORY },
+	[11] = { "city", GEOCODE_NOMINATIM_FIELD_CITY },
+	[53] = { "continent", GEOCODE_NOMINATIM_FIELD_CONTINENT },
+	[37] = { "country", GEOCODE_NOMINATIM_FIELD_COUNTRY },
+	[6] = { "country_code", GEOCODE_NOMINATIM_FIELD_COUNTRY_CODE },
+	[23] = { "county", GEOCODE_NOMINATIM_FIELD_COUNTY },
+	[47] = { "display_name", GEOCODE_NOMINATIM_FIELD_DISPLAY_NAME },
+	[17] = { "error", MEMBER_ERROR },
+	[26] = { "house_number", GEOCODE_NOMINATIM_FIELD_HOUSE_NUMBER },
+	[31] = { "lat", GEOCODE_NOMINATIM_FIELD_LATITUDE },
+	[34] = { "lon", GEOCODE_NOMINATIM_FIELD_LONGITUDE },
+	[7] = { "name", GEOCODE_NOMINATIM_FIELD_NAME },
+	[13] = { "osm_id", GEOCODE_NOMINATIM_FIELD_OSM_ID },
+	[9] = { "osm_type", GEOCODE_NOMINATIM_FIELD_OSM_TYPE },
+	[14] = { "place_rank", GEOCODE_NOMINATIM_FIELD_PLACE_RANK },
+	[29] = { "postcode", GEOCODE_NOMINATIM_FIELD_POSTCODE },
+	[0] = { "road", GEOCODE_NOMINATIM_FIELD_ROAD },
+	[44] = { "state", GEOCODE_NOMINATIM_FIELD_STATE },
+	[5] = { "state_district", GEOCODE_NOMINATIM_FIELD_STATE_DISTRICT },
+	[33] = { "suburb", GEOCODE_NOMINATIM_FIELD_SUBURB },
+	[19] = { "type", GEOCODE_NOMINATIM_FIELD_TYPE },
+	[41] = { "village", GEOCODE_NOMINATIM_FIELD_VILLAGE },
+};
+
+/* Classified from the place rank rather than the type. */
+#define PLACE_TYPE_BY_RANK ((GeocodePlaceType) -1)
+
+/* The type of any other place with this category. */
+#define ANY_TYPE "*"
+
+#define PLACE_TYPE_HASH_SEED 0xacu
+#define PLACE_TYPE_HASH_BITS 7
+
+static const struct {
+	const char *category;
+	const char *type;
+	GeocodePlaceType place_type;
+} place_types[1 << PLACE_TYPE_HASH_BITS] = {
+	[60] = { "place", "house", GEOCODE_PLACE_TYPE_BUILDING },
+	[6] = { "place", "building", GEOCODE_PLACE_TYPE_BUILDING },
+	[70] = { "place", "residential", GEOCODE_PLACE_TYPE_BUILDING },
+	[107] = { "place", "plaza", GEOCODE_PLACE_TYPE_BUILDING },
+	[89] = { "place", "office", GEOCODE_PLACE_TYPE_BUILDING },
+	[10] = { "place", "estate", GEOCODE_PLACE_TYPE_ESTATE },
+	[100] = { "place", "town", GEOCODE_PLACE_TYPE_TOWN },
+	[52] = { "place", "city", GEOCODE_PLACE_TYPE_TOWN },
+	[66] = { "place", "hamlet", GEOCODE_PLACE_TYPE_TOWN },
+	[79] = { "place", "isolated_dwelling", GEOCODE_PLACE_TYPE_TOWN },
+	[81] = { "place", "village", GEOCODE_PLACE_TYPE_TOWN },
+	[120] = { "place", "suburb", GEOCODE_PLACE_TYPE_SUBURB },
+	[63] = { "place", "neighbourhood", GEOCODE_PLACE_TYPE_SUBURB },
+	[64] = { "place", "state", GEOCODE_PLACE_TYPE_STATE },
+	[9] = { "place", "region", GEOCODE_PLACE_TYPE_STATE },
+	[94] = { "place", "farm", GEOCODE_PLACE_TYPE_LAND_FEATURE },
+	[36] = { "place", "forest", GEOCODE_PLACE_TYPE_LAND_FEATURE },
+	[41] = { "place", "valey", GEOCODE_PLACE_TYPE_LAND_FEATURE },
+	[122] = { "place", "park", GEOCODE_PLACE_TYPE_LAND_FEATURE },
+	[11] = { "place", "hill", GEOCODE_PLACE_TYPE_LAND_FEATURE },
+	[16] = { "place", "island", GEOCODE_PLACE_TYPE_ISLAND },
+	[37] = { "place", "islet", GEOCODE_PLACE_TYPE_ISLAND },
+	[24] = { "place", "country", GEOCODE_PLACE_TYPE_COUNTRY },
+	[3] = { "place", "continent", GEOCODE_PLACE_TYPE_CONTINENT },
+	[112] = { "place", "lake", GEOCODE_PLACE_TYPE_DRAINAGE },
+	[101] = { "place", "bay", GEOCODE_PLACE_TYPE_DRAINAGE },
+	[74] = { "place", "river", GEOCODE_PLACE_TYPE_DRAINAGE },
+	[65] = { "place", "sea", GEOCODE_PLACE_TYPE_SEA },
+	[0] = { "place", "ocean", GEOCODE_PLACE_TYPE_OCEAN },
+	[7] = { "highway", "motorway", GEOCODE_PLACE_TYPE_MOTORWAY },
+	[13] = { "highway", "bus_stop", GEOCODE_PLACE_TYPE_BUS_STOP },
+	[118] = { "highway", "*", GEOCODE_PLACE_TYPE_STREET },
+	[104] = { "railway", "station", GEOCODE_PLACE_TYPE_RAILWAY_STATION },
+	[109] = { "railway", "halt", GEOCODE_PLACE_TYPE_RAILWAY_STATION },
+	[96] = { "railway", "tram_stop", GEOCODE_PLACE_TYPE_LIGHT_RAIL_STATION },
+	[14] = { "waterway", "*", GEOCODE_PLACE_TYPE_DRAINAGE },
+	[51] = { "boundary", "administrative", PLACE_TYPE_BY_RANK },
+	[119] = { "amenity", "school", GEOCODE_PLACE_TYPE_SCHOOL },
+	[116] = { "amenity", "place_of_worship", GEOCODE_PLACE_TYPE_PLACE_OF_WORSHIP },
+	[82] = { "amenity", "restaurant", GEOCODE_PLACE_TYPE_RESTAURANT },
+	[87] = { "amenity", "bar", GEOCODE_PLACE_TYPE_BAR },
+	[73] = { "amenity", "pub", GEOCODE_PLACE_TYPE_BAR },
+	[83] = { "aeroway", "aerodrome", GEOCODE_PLACE_TYPE_AIRPORT },
+};
+
+/* The fields set from the elements of the "boundingbox" array, in order. */
+static const GeocodeNominatimField bounding_box_fields[] = {
+	GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_BOTTOM,
+	GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_TOP,
+	GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_LEFT,
+	GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_RIGHT,
+};
+
+G_STATIC_ASSERT (GEOCODE_NOMINATIM_N_FIELDS <= 32);
+
+struct _GeocodeNominatimResult {
+	GString *values;  /* NUL-terminated values of the fields */
+	gssize offsets[GEOCODE_NOMINATIM_N_FIELDS];  /* into @values, or -1 */
+	guint32 from_address;  /* bit mask of the fields set from the address */
+	gboolean has_error;
+	GString *scratch;  /* for member names, and building values */
+};
+
+typedef struct {
+	GeocodeNominatimResult *result;
+	const char *p;
+	const char *end;
+} Decoder;
+
+/*
+ * _geocode_nominatim_result_new:
+ *
+ * Creates a result to decode into, which may be reused for several results in
+ * turn.
+ *
+ * Returns: (transfer full): a new #GeocodeNominatimResult
+ */
+GeocodeNominatimResult *
+_geocode_nominatim_result_new (void)
+{
+	GeocodeNominatimResult *result;
+	guint i;
+
+	result = g_slice_new0 (GeocodeNominatimResult);
+	result->values = g_string_sized_new (1024);
+	result->scratch = g_string_new (NULL);
+
+	for (i = 0; i < GEOCODE_NOMINATIM_N_FIELDS; i++)
+		result->offsets[i] = -1;
+
+	return result;
+}
+
+void
+_geocode_nominatim_result_free (GeocodeNominatimResult *result)
+{
+	g_string_free (result->values, TRUE);
+	g_string_free (result->scratch, TRUE);
+	g_slice_free (GeocodeNominatimResult, result);
+}
+
+static void
+result_reset (GeocodeNominatimResult *result)
+{
+	guint i;
+
+	g_string_truncate (result->values, 0);
+	for (i = 0; i < GEOCODE_NOMINATIM_N_FIELDS; i++)
+		result->offsets[i] = -1;
+	result->from_address = 0;
+	result->has_error = FALSE;
+}
+
+/*
+ * _geocode_nominatim_result_get:
+ * @result: a #GeocodeNominatimResult
+ * @field: the field to get
+ *
+ * Returns: (transfer none) (nullable): the value of @field, or %NULL if it is
+ *    not set
+ */
+const char *
+_geocode_nominatim_result_get (GeocodeNominatimResult *result,
+                               GeocodeNominatimField   field)
+{
+	g_return_val_if_fail (field < GEOCODE_NOMINATIM_N_FIELDS, NULL);
+
+	if (result->offsets[field] < 0)
+		return NULL;
+
+	return result->values->str + result->offsets[field];
+}
+
+/*
+ * _geocode_nominatim_result_has_error:
+ * @result: a #GeocodeNominatimResult
+ *
+ * Gets whether the response was an error rather than a result, in which case
+ * its message, if any, is in %GEOCODE_NOMINATIM_FIELD_ERROR.
+ *
+ * Returns: %TRUE if the response has an "error" member
+ */
+gboolean
+_geocode_nominatim_result_has_error (GeocodeNominatimResult *result)
+{
+	return result->has_error;
+}
+
+/* Sets @field to the value at @offset in the result's values, unless it was
+ * set from the address and this value is not. */
+static void
+set_field (GeocodeNominatimResult *result,
+           guint                   field,
+           gssize                  offset,
+           gboolean                from_address)
+{
+	guint32 bit = 1u << field;
+
+	if (!from_address && (result->from_address & bit) != 0)
+		return;
+
+	result->offsets[field] = offset;
+	if (from_address)
+		result->from_address |= bit;
+}
+
+static gboolean
+fail (Decoder  *decoder,
+      GError  **error)
+{
+	g_set_error_literal (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE,
+	                     "Invalid JSON in result");
+	return FALSE;
+}
+
+static void
+skip_whitespace (Decoder *decoder)
+{
+	while (decoder->p < decoder->end &&
+	       (*decoder->p == ' ' || *decoder->p == '\t' ||
+	        *decoder->p == '\n' || *decoder->p == '\r'))
+		decoder->p++;
+}
+
+static gboolean
+expect (Decoder *decoder,
+        char     c)
+{
+	skip_whitespace (decoder);
+
+	if (decoder->p >= decoder->end || *decoder->p != c)
+		return FALSE;
+
+	decoder->p++;
+	return TRUE;
+}
+
+static gint
+parse_hex4 (const char *p)
+{
+	gint value = 0, i;
+
+	for (i = 0; i < 4; i++) {
+		gint digit = g_ascii_xdigit_value (p[i]);
+
+		if (digit < 0)
+			return -1;
+		value = value * 16 + digit;
+	}
+
+	return value;
+}
+
+/* Decodes the string at the decoder's position, after its opening quote,
+ * appending it to @out if that is non-%NULL. */
+static gboolean
+decode_string (Decoder  *decoder,
+               GString  *out,
+               GError  **error)
+{
+	const char *p = decoder->p, *run = p;
+
+	while (p < decoder->end) {
+		gunichar c;
+		gint unit;
+
+		if (*p == '"') {
+			if (out != NULL)
+				g_string_append_len (out, run, p - run);
+			decoder->p = p + 1;
+			return TRUE;
+		}
+
+		if ((guchar) *p < 0x20)
+			return fail (decoder, error);
+
+		if (*p != '\\') {
+			p++;
+			continue;
+		}
+
+		if (out != NULL)
+			g_string_append_len (out, run, p - run);
+
+		if (decoder->end - p < 2)
+			return fail (decoder, error);
+
+		switch (p[1]) {
+		case '"': c = '"'; break;
+		case '\\': c = '\\'; break;
+		case '/': c = '/'; break;
+		case 'b': c = '\b'; break;
+		case 'f': c = '\f'; break;
+		case 'n': c = '\n'; break;
+		case 'r': c = '\r'; break;
+		case 't': c = '\t'; break;
+		case 'u':
+			if (decoder->end - p < 6 || (unit = parse_hex4 (p + 2)) < 0)
+				return fail (decoder, error);
+			c = unit;
+			p += 4;
+
+			/* A surrogate pair. */
+			if (c >= 0xd800 && c < 0xdc00) {
+				if (decoder->end - p < 8 || p[2] != '\\' || p[3] != 'u' ||
+				    (unit = parse_hex4 (p + 4)) < 0xdc00 || unit >= 0xe000)
+					return fail (decoder, error);
+				c = 0x10000 + ((c - 0xd800) << 10) + (unit - 0xdc00);
+				p += 6;
+			} else if (c >= 0xdc00 && c < 0xe000) {
+				return fail (decoder, error);
+			}
+			break;
+		default:
+			return fail (decoder, error);
+		}
+
+		if (out != NULL) {
+			char utf8[6];
+
+			g_string_append_len (out, utf8, g_unichar_to_utf8 (c, utf8));
+		}
+
+		p += 2;
+		run = p;
+	}
+
+	return fail (decoder, error);
+}
+
+/* Scans the number at the decoder's position, returning its length and
+ * whether it is an integer. */
+static gboolean
+scan_number (Decoder   *decoder,
+             gsize     *length,
+             gboolean  *is_integer,
+             GError   **error)
+{
+	const char *p = decoder->p;
+
+	*is_integer = TRUE;
+
+	if (p < decoder->end && *p == '-')
+		p++;
+	if (p >= decoder->end || !g_ascii_isdigit (*p))
+		return fail (decoder, error);
+
+	while (p < decoder->end) {
+		if (*p == '.' || *p == 'e' || *p == 'E' ||
+		    ((*p == '+' || *p == '-') && (p[-1] == 'e' || p[-1] == 'E')))
+			*is_integer = FALSE;
+		else if (!g_ascii_isdigit (*p))
+			break;
+		p++;
+	}
+
+	*length = p - decoder->p;
+	decoder->p = p;
+
+	return TRUE;
+}
+
+static gboolean
+skip_literal (Decoder    *decoder,
+              const char *literal,
+              GError    **error)
+{
+	gsize length = strlen (literal);
+
+	if ((gsize) (decoder->end - decoder->p) < length ||
+	    memcmp (decoder->p, literal, length) != 0)
+		return fail (decoder, error);
+
+	decoder->p += length;
+	return TRUE;
+}
+
+static gboolean skip_value (Decoder  *decoder,
+                            guint     depth,
+                            GError  **error);
+
+/* Skips the elements of an array, or the members of an object, after the
+ * opening bracket. */
+static gboolean
+skip_container (Decoder  *decoder,
+                char      close,
+                guint     depth,
+                GError  **error)
+{
+	if (depth > 64)
+		return fail (decoder, error);
+
+	if (expect (decoder, close))
+		return TRUE;
+
+	do {
+		if (close == '}') {
+			if (!expect (decoder, '"'))
+				return fail (decoder, error);
+			if (!decode_string (decoder, NULL, error))
+				return FALSE;
+			if (!expect (decoder, ':'))
+				return fail (decoder, error);
+		}
+
+		if (!skip_value (decoder, depth + 1, error))
+			return FALSE;
+	} while (expect (decoder, ','));
+
+	return expect (decoder, close) || fail (decoder, error);
+}
+
+static gboolean
+skip_value (Decoder  *decoder,
+            guint     depth,
+            GError  **error)
+{
+	gsize length;
+	gboolean is_integer;
+
+	skip_whitespace (decoder);
+
+	if (decoder->p >= decoder->end)
+		return fail (decoder, error);
+
+	switch (*decoder->p++) {
+	case '"':
+		return decode_string (decoder, NULL, error);
+	case '{':
+		return skip_container (decoder, '}', depth, error);
+	case '[':
+		return skip_container (decoder, ']', depth, error);
+	case 't':
+		return skip_literal (decoder, "rue", error);
+	case 'f':
+		return skip_literal (decoder, "alse", error);
+	case 'n':
+		return skip_literal (decoder, "ull", error);
+	default:
+		decoder->p--;
+		return scan_number (decoder, &length, &is_integer, error);
+	}
+}
+
+/* Decodes a string or integer value at the decoder's position into the
+ * result's values. Sets @offset to its offset, or to -1 if the value is an
+ * empty string or of another type, which is skipped. */
+static gboolean
+decode_scalar (Decoder   *decoder,
+               gboolean   keep_numbers,
+               gssize    *offset,
+               GError   **error)
+{
+	GString *values = decoder->result->values;
+	gsize start = values->len, length;
+	gboolean is_integer;
+
+	*offset = -1;
+
+	skip_whitespace (decoder);
+
+	if (decoder->p < decoder->end && *decoder->p == '"') {
+		decoder->p++;
+		if (!decode_string (decoder, values, error))
+			return FALSE;
+
+		if (values->len == start)
+			return TRUE;
+	} else if (decoder->p < decoder->end &&
+	           (*decoder->p == '-' || g_ascii_isdigit (*decoder->p))) {
+		const char *number = decoder->p;
+
+		if (!scan_number (decoder, &length, &is_integer, error))
+			return FALSE;
+
+		if (!is_integer && !keep_numbers)
+			return TRUE;
+
+		g_string_append_len (values, number, length);
+	} else {
+		return skip_value (decoder, 1, error);
+	}
+
+	g_string_append_c (values, '\0');
+	*offset = start;
+
+	return TRUE;
+}
+
+/* Decodes the "boundingbox" array: south, north, west and east. Its elements
+ * may be strings or numbers. */
+static gboolean
+decode_bounding_box (Decoder   *decoder,
+                     gboolean   from_address,
+                     GError   **error)
+{
+	guint i = 0;
+
+	if (!expect (decoder, '['))
+		return skip_value (decoder, 1, error);
+
+	if (expect (decoder, ']'))
+		return TRUE;
+
+	do {
+		gssize offset;
+
+		if (i >= G_N_ELEMENTS (bounding_box_fields)) {
+			if (!skip_value (decoder, 1, error))
+				return FALSE;
+			continue;
+		}
+
+		if (!decode_scalar (decoder, TRUE, &offset, error))
+			return FALSE;
+
+		if (offset >= 0)
+			set_field (decoder->result, bounding_box_fields[i],
+			           offset, from_address);
+		i++;
+	} while (expect (decoder, ','));
+
+	return expect (decoder, ']') || fail (decoder, error);
+}
+
+static guint32
+hash_string (guint32     hash,
+             const char *s)
+{
+	for (; *s != '\0'; s++)
+		hash = (hash ^ (guchar) *s) * FNV_PRIME;
+
+	return hash;
+}
+
+/* Decodes the name of the member at the decoder's position, and looks up
+ * which member it is. Sets @house_number if it is "house_number". */
+static gboolean
+decode_member_name (Decoder   *decoder,
+                    guint     *member,
+                    gboolean  *house_number,
+                    GError   **error)
+{
+	GString *scratch = decoder->result->scratch;
+	const Member *found;
+	guint32 slot;
+
+	if (!expect (decoder, '"'))
+		return fail (decoder, error);
+
+	g_string_truncate (scratch, 0);
+	if (!decode_string (decoder, scratch, error))
+		return FALSE;
+
+	if (!expect (decoder, ':'))
+		return fail (decoder, error);
+
+	slot = hash_string (MEMBER_HASH_SEED, scratch->str) >> (32 - MEMBER_HASH_BITS);
+	found = &members[slot];
+	*member = (found->name != NULL && strcmp (found->name, scratch->str) == 0) ?
+	          found->member : MEMBER_UNKNOWN;
+	*house_number = (*member == GEOCODE_NOMINATIM_FIELD_HOUSE_NUMBER);
+
+	return TRUE;
+}
+
+/* Sets the name of the place to @house_number and @road, in the order used by
+ * the locale. */
+static void
+set_street_name (GeocodeNominatimResult *result,
+                 gssize                  house_number,
+                 gssize                  road)
+{
+	GString *name = result->scratch;
+	gboolean number_after;
+	gsize offset;
+
+	/* Built separately, as appending to the values may move them. */
+	number_after = _geocode_object_is_number_after_street ();
+	g_string_truncate (name, 0);
+	g_string_append (name, result->values->str + (number_after ? road : house_number));
+	g_string_append_c (name, ' ');
+	g_string_append (name, result->values->str + (number_after ? house_number : road));
+
+	offset = result->values->len;
+	g_string_append_len (result->values, name->str, name->len + 1);
+
+	set_field (result, GEOCODE_NOMINATIM_FIELD_NAME, offset, TRUE);
+}
+
+/* Decodes the members of an object, after its opening brace: either the
+ * result itself, or its address. */
+static gboolean
+decode_object (Decoder   *decoder,
+               gboolean   is_address,
+               GError   **error)
+{
+	GeocodeNominatimResult *result = decoder->result;
+	gssize house_number = -1;
+	guint i = 0;
+
+	if (expect (decoder, '}'))
+		return TRUE;
+
+	do {
+		guint member;
+		gboolean is_house_number;
+		gssize offset;
+
+		if (!decode_member_name (decoder, &member, &is_house_number, error))
+			return FALSE;
+
+		if (member == MEMBER_ADDRESS && !is_address) {
+			if (expect (decoder, '{')) {
+				if (!decode_object (decoder, TRUE, error))
+					return FALSE;
+			} else if (!skip_value (decoder, 1, error)) {
+				return FALSE;
+			}
+		} else if (member == MEMBER_BOUNDINGBOX) {
+			if (!decode_bounding_box (decoder, is_address, error))
+				return FALSE;
+		} else if (member == MEMBER_ERROR && !is_address) {
+			result->has_error = TRUE;
+			if (!decode_scalar (decoder, FALSE, &offset, error))
+				return FALSE;
+			if (offset >= 0)
+				set_field (result, GEOCODE_NOMINATIM_FIELD_ERROR, offset, FALSE);
+		} else if (member < GEOCODE_NOMINATIM_N_FIELDS ||
+		           (is_address && i == 0)) {
+			/* Since Nominatim doesn't give us a short name, the
+			 * first component of the address is used as the name,
+			 * whatever it is. */
+			if (!decode_scalar (decoder, FALSE, &offset, error))
+				return FALSE;
+
+			if (offset >= 0) {
+				if (member < GEOCODE_NOMINATIM_N_FIELDS)
+					set_field (result, member, offset, is_address);
+
+				if (is_address && i == 0) {
+					if (is_house_number)
+						house_number = offset;
+					else
+						set_field (result, GEOCODE_NOMINATIM_FIELD_NAME,
+						           offset, TRUE);
+				} else if (house_number >= 0 &&
+				           member == GEOCODE_NOMINATIM_FIELD_ROAD) {
+					set_street_name (result, house_number, offset);
+				}
+			}
+		} else if (!skip_value (decoder, 1, error)) {
+			return FALSE;
+		}
+
+		i++;
+	} while (expect (decoder, ','));
+
+	return expect (decoder, '}') || fail (decoder, error);
+}
+
+/*
+ * _geocode_nominatim_result_decode:
+ * @result: a #GeocodeNominatimResult
+ * @json: (array length=length): the text of a result, a JSON object
+ * @length: length of @json in bytes
+ * @error: return location for a #GError
+ *
+ * Decodes a result, replacing whatever @result held before.
+ *
+ * Returns: %TRUE on success, %FALSE if @json is not a valid result
+ */
+gboolean
+_geocode_nominatim_result_decode (GeocodeNominatimResult  *result,
+                                  const char              *json,
+                                  gsize                    length,
+                                  GError                 **error)
+{
+	Decoder decoder = { result, json, json + length };
+
+	result_reset (result);
+
+	if (!g_utf8_validate (json, length, NULL)) {
+		g_set_error_literal (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE,
+		                     "Result is not valid UTF-8");
+		return FALSE;
+	}
+
+	if (!expect (&decoder, '{')) {
+		g_set_error_literal (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE,
+		                     "Result is not an object");
+		return FALSE;
+	}
+
+	if (!decode_object (&decoder, FALSE, error))
+		return FALSE;
+
+	skip_whitespace (&decoder);
+	if (decoder.p != decoder.end)
+		return fail (&decoder, error);
+
+	return TRUE;
+}
+
+static GeocodePlaceType
+lookup_place_type (const char *category,
+                   const char *type)
+{
+	guint32 hash, slot;
+
+	hash = hash_string (PLACE_TYPE_HASH_SEED, category);
+	hash = (hash ^ '/') * FNV_PRIME;
+	slot = hash_string (hash, type) >> (32 - PLACE_TYPE_HASH_BITS);
+
+	if (place_types[slot].category != NULL &&
+	    strcmp (place_types[slot].category, category) == 0 &&
+	    strcmp (place_types[slot].type, type) == 0)
+		return place_types[slot].place_type;
+
+	return GEOCODE_PLACE_TYPE_UNKNOWN;
+}
+
+/*
+ * _geocode_nominatim_result_get_place_type:
+ * @result: a #GeocodeNominatimResult
+ *
+ * Classifies the place described by @result from its category and type.
+ *
+ * Returns: the type of the place, or %GEOCODE_PLACE_TYPE_UNKNOWN
+ */
+GeocodePlaceType
+_geocode_nominatim_result_get_place_type (GeocodeNominatimResult *result)
+{
+	const char *category, *type, *place_rank;
+	GeocodePlaceType place_type = GEOCODE_PLACE_TYPE_UNKNOWN;
+
+	category = _geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_CATEGORY);
+	type = _geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_TYPE);
+
+	if (category == NULL)
+		return GEOCODE_PLACE_TYPE_UNKNOWN;
+
+	if (type != NULL)
+		place_type = lookup_place_type (category, type);
+	if (place_type == GEOCODE_PLACE_TYPE_UNKNOWN)
+		place_type = lookup_place_type (category, ANY_TYPE);
+
+	if (place_type != PLACE_TYPE_BY_RANK)
+		return place_type;
+
+	place_rank = _geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_PLACE_RANK);
+
+	switch (place_rank != NULL ? atoi (place_rank) : 0) {
+	case 28:
+		return GEOCODE_PLACE_TYPE_BUILDING;
+	case 16:
+		return GEOCODE_PLACE_TYPE_TOWN;
+	case 12:
+		return GEOCODE_PLACE_TYPE_COUNTY;
+	case 10:
+	case 8:
+		return GEOCODE_PLACE_TYPE_STATE;
+	case 4:
+		return GEOCODE_PLACE_TYPE_COUNTRY;
+	default:
+		return GEOCODE_PLACE_TYPE_UNKNOWN;
+	}
+}
@@ -50,14 +50,121 @@ typedef enum {
 	PROP_BASE_URL = 1,
 	PROP_MAINTAINER_EMAIL_ADDRESS,
 	PROP_USER_AGENT,
+	PROP_MAX_CONNECTIONS,
+	PROP_MAX_CONNECTIONS_PER_HOST,
+	PROP_IDLE_TIMEOUT,
+	PROP_MEMORY_CACHE_ENABLED,
+	PROP_CACHE_TTL,
+	PROP_NEGATIVE_CACHE_TTL,
+	PROP_CACHE_ENABLED,
+	PROP_REVERSE_CACHE_RADIUS,
+	PROP_REVERSE_CACHE_TTL,
+	PROP_STALE_WHILE_REVALIDATE,
+	PROP_RATE_LIMIT,
+	PROP_RATE_LIMIT_BURST,
+	PROP_MAX_QUEUED_QUERIES,
+	PROP_MAX_QUERY_ATTEMPTS,
+	PROP_RETRY_DELAY,
+	PROP_RETRY_JITTER,
+	PROP_BASE_URLS,
+	PROP_HEDGE_REQUESTS,
+	PROP_LANGUAGE,
 } GeocodeNominatimProperty;
 
-static GParamSpec *properties[PROP_USER_AGENT + 1];
+static GParamSpec *properties[PROP_LANGUAGE + 1];
+
+#define DEFAULT_MAX_CONNECTIONS          10
+#define DEFAULT_MAX_CONNECTIONS_PER_HOST 2
+#define DEFAULT_IDLE_TIMEOUT             60 /* seconds */
+#define DEFAULT_MAX_QUERY_ATTEMPTS       3
+#define DEFAULT_RETRY_DELAY              1000 /* milliseconds */
+#define DEFAULT_RETRY_JITTER             50 /* percent */
+
+/* Failed requests are not retried after longer than this, whatever the server
+ * asks for. */
+#define MAX_RETRY_DELAY                  60 /* seconds */
 
 typedef struct {
 	char *base_url;
 	char *maintainer_email_address;
 	char *user_agent;
+
+	/* Replicas of the service which queries are spread over, starting
+	 * with @base_url. Query URIs, and so cache keys, are always built
+	 * for @base_url, and rewritten for the endpoint they are sent to. */
+	char **base_urls;
+	GeocodeEndpointPool *endpoints;
+
+	/* Whether to send a duplicate of slow requests to another endpoint.
+	 * Accessed atomically. */
+	gint hedge_requests;
+
+	/* Language to request results in, overriding that of the locale.
+	 * Protected by @language_lock. */
+	GMutex language_lock;
+	char *language;
+
+	/* Shared by the sync and async query paths so that connections are
+	 * kept alive and reused between requests. Created lazily, and
+	 * protected by @session_lock as queries may come from any thread. */
+	GMutex session_lock;
+	SoupSession *soup_session;
+	guint max_connections;
+	guint max_connections_per_host;
+	guint idle_timeout;
+
+	/* Limits the rate of requests made by the default query
+	 * implementations. */
+	GeocodeRequestScheduler *scheduler;
+
+	/* Retry policy for the requests made by the default query
+	 * implementations: the maximum number of attempts at each query, the
+	 * delay before the first retry in milliseconds (doubled for each
+	 * subsequent one), and the percentage of the delay which is random.
+	 * Accessed atomically. */
+	guint max_query_attempts;
+	guint retry_delay;
+	guint retry_jitter;
+
+	/* Number of requests which failed, and how many of those were
+	 * retried. Accessed atomically. */
+	guint n_failed_attempts;
+	guint n_retries;
+
+	/* Whether to use the process-wide cache of parsed results. Accessed
+	 * atomically. */
+	gint memory_cache_enabled;
+
+	/* Whether to use the on-disk cache of results. Accessed atomically. */
+	gint cache_enabled;
+
+	/* Lifetime of responses saved in the on-disk cache, in seconds.
+	 * Accessed atomically. */
+	guint cache_ttl;
+
+	/* Number of seconds for which stale results in the on-disk cache are
+	 * returned while they are refreshed, or 0 to not return them.
+	 * Accessed atomically. */
+	guint stale_while_revalidate;
+
+	/* Lifetime of in-memory entries for queries with no results, in
+	 * seconds, or 0 to not cache them. Accessed atomically. */
+	guint negative_cache_ttl;
+
+	/* Distance in metres within which reverse geocoding results are
+	 * reused for nearby locations, or 0 to not reuse them; and the number
+	 * of seconds for which they are. Accessed atomically. */
+	guint reverse_cache_radius;
+	guint reverse_cache_ttl;
+
+	/* Asynchronous queries waiting for a response, so that identical
+	 * concurrent queries share a single request. Maps canonical query
+	 * keys to InFlightQuery. Protected by @in_flight_lock. */
+	GHashTable *in_flight_queries;
+
+	/* Keys of the stale cache entries being refreshed, so that each is
+	 * only refreshed once at a time. Protected by @in_flight_lock. */
+	GHashTable *refreshing_keys;
 } GeocodeNominatimPrivate;
 
 static void geocode_backend_iface_init (GeocodeBackendInterface *iface);
@@ -69,9 +176,6 @@ G_DEFINE_TYPE_WITH_CODE (GeocodeNominatim, geocode_nominatim, G_TYPE_OBJECT,
 
 /******************************************************************************/
 
-static void _geocode_read_nominatim_attributes (JsonReader *reader,
-                                                GHashTable *ht);
-
 static struct {
 	const char *tp_attr;
 	const char *gc_attr; /* NULL to ignore */
@@ -160,6 +264,26 @@ geocode_forward_fill_params (GHashTable *params)
 	return params_out;
 }
 
+/* Returns the language to request results in, as a value for the
+ * `accept-language` parameter, or %NULL if it is unknown. */
+static char *
+get_language (GeocodeNominatim *self)
+{
+	GeocodeNominatimPrivate *priv;
+	char *language;
+
+	priv = geocode_nominatim_get_instance_private (self);
+
+	g_mutex_lock (&priv->language_lock);
+	language = g_strdup (priv->language);
+	g_mutex_unlock (&priv->language_lock);
+
+	if (language == NULL)
+		language = _geocode_object_get_lang ();
+
+	return language;
+}
+
 static gchar *
 get_search_uri_for_params (GeocodeNominatim  *self,
                            GHashTable        *params,
@@ -211,7 +335,7 @@ get_search_uri_for_params (GeocodeNominatim  *self,
 
 	lang = NULL;
 	if (g_hash_table_lookup (ht, "accept-language") == NULL) {
-		lang = _geocode_object_get_lang ();
+		lang = get_language (self);
 		if (lang)
 			g_hash_table_insert (ht, (gpointer) "accept-language", lang);
 	}
@@ -244,980 +368,2693 @@ get_search_uri_for_params (GeocodeNominatim  *self,
 	return uri;
 }
 
-static struct {
-	const char *nominatim_attr;
-        const char *place_prop; /* NULL to ignore */
+static const struct {
+	GeocodeNominatimField field;
+	GeocodePlaceField place_field;
 } nominatim_to_place_map[] = {
-        { "license", NULL },
-        { "osm_id", "osm-id" },
-        { "lat", NULL },
-        { "lon", NULL },
-        { "display_name", NULL },
-        { "house_number", "building" },
-        { "road", "street" },
-        { "suburb", "area" },
-        { "city",  "town" },
-        { "village",  "town" },
-        { "county", "county" },
-        { "state_district", "administrative-area" },
-        { "state", "state" },
-        { "postcode", "postal-code" },
-        { "country", "country" },
-        { "country_code", "country-code" },
-        { "continent", "continent" },
-        { "address", NULL },
+	{ GEOCODE_NOMINATIM_FIELD_OSM_ID, GEOCODE_PLACE_FIELD_OSM_ID },
+	{ GEOCODE_NOMINATIM_FIELD_HOUSE_NUMBER, GEOCODE_PLACE_FIELD_BUILDING },
+	{ GEOCODE_NOMINATIM_FIELD_ROAD, GEOCODE_PLACE_FIELD_STREET },
+	{ GEOCODE_NOMINATIM_FIELD_SUBURB, GEOCODE_PLACE_FIELD_AREA },
+	/* Where both are given, the city wins over the village. */
+	{ GEOCODE_NOMINATIM_FIELD_VILLAGE, GEOCODE_PLACE_FIELD_TOWN },
+	{ GEOCODE_NOMINATIM_FIELD_CITY, GEOCODE_PLACE_FIELD_TOWN },
+	{ GEOCODE_NOMINATIM_FIELD_COUNTY, GEOCODE_PLACE_FIELD_COUNTY },
+	{ GEOCODE_NOMINATIM_FIELD_STATE_DISTRICT, GEOCODE_PLACE_FIELD_ADMINISTRATIVE_AREA },
+	{ GEOCODE_NOMINATIM_FIELD_STATE, GEOCODE_PLACE_FIELD_STATE },
+	{ GEOCODE_NOMINATIM_FIELD_POSTCODE, GEOCODE_PLACE_FIELD_POSTAL_CODE },
+	{ GEOCODE_NOMINATIM_FIELD_COUNTRY, GEOCODE_PLACE_FIELD_COUNTRY },
+	{ GEOCODE_NOMINATIM_FIELD_COUNTRY_CODE, GEOCODE_PLACE_FIELD_COUNTRY_CODE },
+	{ GEOCODE_NOMINATIM_FIELD_CONTINENT, GEOCODE_PLACE_FIELD_CONTINENT },
 };
 
 static void
-fill_place_from_entry (const char   *key,
-                       const char   *value,
-                       GeocodePlace *place)
+fill_builder_from_result (GeocodePlaceBuilder    *builder,
+                          GeocodeNominatimResult *result)
 {
+        const char *value;
         guint i;
 
         for (i = 0; i < G_N_ELEMENTS (nominatim_to_place_map); i++) {
-                if (g_str_equal (key, nominatim_to_place_map[i].nominatim_attr)){
-                        g_object_set (G_OBJECT (place),
-                                      nominatim_to_place_map[i].place_prop,
-                                      value,
-                                      NULL);
-                        break;
-                }
+                value = _geocode_nominatim_result_get (result,
+                                                       nominatim_to_place_map[i].field);
+                if (value != NULL)
+                        builder->fields[nominatim_to_place_map[i].place_field] = value;
         }
 
-        if (g_str_equal (key, "osm_type")) {
-                gpointer ref = g_type_class_ref (geocode_place_osm_type_get_type ());
-                GEnumClass *class = G_ENUM_CLASS (ref);
-                GEnumValue *evalue = g_enum_get_value_by_nick (class, value);
-
-                if (evalue)
-                        g_object_set (G_OBJECT (place), "osm-type", evalue->value, NULL);
-                else
-                        g_warning ("Unsupported osm-type %s", value);
-
-                g_type_class_unref (ref);
-        }
+        value = _geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_OSM_TYPE);
+        if (value != NULL &&
+            !_geocode_place_osm_type_from_nick (value, &builder->osm_type))
+                g_warning ("Unsupported osm-type %s", value);
 }
 
-static gboolean
-node_free_func (GNode    *node,
-		gpointer  user_data)
+/* Parses a coordinate of a result, which is 0 if missing. */
+static gdouble
+get_coordinate (GeocodeNominatimResult *result,
+                GeocodeNominatimField   field)
 {
-	/* Leaf nodes are GeocodeLocation objects
-	 * which we reuse for the results */
-	if (G_NODE_IS_LEAF (node) == FALSE)
-		g_free (node->data);
+        const char *value = _geocode_nominatim_result_get (result, field);
 
-	return FALSE;
+        return (value != NULL) ? g_ascii_strtod (value, NULL) : 0.0;
 }
 
-static const char *place_attributes[] = {
-	"country",
-	"state",
-	"county",
-	"state_district",
-	"postcode",
-	"city",
-	"suburb",
-	"village",
+/* The parts of the address which tell places apart; see
+ * _geocode_disambiguator_add(). */
+static const GeocodeNominatimField place_attributes[] = {
+	GEOCODE_NOMINATIM_FIELD_COUNTRY,
+	GEOCODE_NOMINATIM_FIELD_STATE,
+	GEOCODE_NOMINATIM_FIELD_COUNTY,
+	GEOCODE_NOMINATIM_FIELD_STATE_DISTRICT,
+	GEOCODE_NOMINATIM_FIELD_POSTCODE,
+	GEOCODE_NOMINATIM_FIELD_CITY,
+	GEOCODE_NOMINATIM_FIELD_SUBURB,
+	GEOCODE_NOMINATIM_FIELD_VILLAGE,
 };
 
-static GeocodePlaceType
-get_place_type_from_attributes (GHashTable *ht)
-{
-        char *category, *type;
-        GeocodePlaceType place_type = GEOCODE_PLACE_TYPE_UNKNOWN;
-
-        category = g_hash_table_lookup (ht, "category");
-        type = g_hash_table_lookup (ht, "type");
-
-        if (g_strcmp0 (category, "place") == 0) {
-                if (g_strcmp0 (type, "house") == 0 ||
-                    g_strcmp0 (type, "building") == 0 ||
-                    g_strcmp0 (type, "residential") == 0 ||
-                    g_strcmp0 (type, "plaza") == 0 ||
-                    g_strcmp0 (type, "office") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_BUILDING;
-                else if (g_strcmp0 (type, "estate") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_ESTATE;
-                else if (g_strcmp0 (type, "town") == 0 ||
-                         g_strcmp0 (type, "city") == 0 ||
-                         g_strcmp0 (type, "hamlet") == 0 ||
-                         g_strcmp0 (type, "isolated_dwelling") == 0 ||
-                         g_strcmp0 (type, "village") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_TOWN;
-                else if (g_strcmp0 (type, "suburb") == 0 ||
-                         g_strcmp0 (type, "neighbourhood") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_SUBURB;
-                else if (g_strcmp0 (type, "state") == 0 ||
-                         g_strcmp0 (type, "region") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_STATE;
-                else if (g_strcmp0 (type, "farm") == 0 ||
-                         g_strcmp0 (type, "forest") == 0 ||
-                         g_strcmp0 (type, "valey") == 0 ||
-                         g_strcmp0 (type, "park") == 0 ||
-                         g_strcmp0 (type, "hill") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_LAND_FEATURE;
-                else if (g_strcmp0 (type, "island") == 0 ||
-                         g_strcmp0 (type, "islet") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_ISLAND;
-                else if (g_strcmp0 (type, "country") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_COUNTRY;
-                else if (g_strcmp0 (type, "continent") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_CONTINENT;
-                else if (g_strcmp0 (type, "lake") == 0 ||
-                         g_strcmp0 (type, "bay") == 0 ||
-                         g_strcmp0 (type, "river") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_DRAINAGE;
-                else if (g_strcmp0 (type, "sea") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_SEA;
-                else if (g_strcmp0 (type, "ocean") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_OCEAN;
-        } else if (g_strcmp0 (category, "highway") == 0) {
-                if (g_strcmp0 (type, "motorway") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_MOTORWAY;
-                else if (g_strcmp0 (type, "bus_stop") == 0)
-                        place_type =  GEOCODE_PLACE_TYPE_BUS_STOP;
-                else
-                        place_type =  GEOCODE_PLACE_TYPE_STREET;
-        } else if (g_strcmp0 (category, "railway") == 0) {
-                if (g_strcmp0 (type, "station") == 0 ||
-                    g_strcmp0 (type, "halt") == 0)
-                        place_type = GEOCODE_PLACE_TYPE_RAILWAY_STATION;
-                else if (g_strcmp0 (type, "tram_stop") == 0)
-                        place_type = GEOCODE_PLACE_TYPE_LIGHT_RAIL_STATION;
-        } else if (g_strcmp0 (category, "waterway") == 0) {
-                place_type =  GEOCODE_PLACE_TYPE_DRAINAGE;
-        } else if (g_strcmp0 (category, "boundary") == 0) {
-                if (g_strcmp0 (type, "administrative") == 0) {
-                        const char *place_rank;
-                        int rank;
-
-                        place_rank = g_hash_table_lookup (ht, "place_rank");
-                        rank = place_rank ? atoi (place_rank) : 0;
-                        if (rank < 2)
-                                place_type =  GEOCODE_PLACE_TYPE_UNKNOWN;
-
-                        if (rank == 28)
-                                place_type =  GEOCODE_PLACE_TYPE_BUILDING;
-                        else if (rank == 16)
-                                place_type =  GEOCODE_PLACE_TYPE_TOWN;
-                        else if (rank == 12)
-                                place_type =  GEOCODE_PLACE_TYPE_COUNTY;
-                        else if (rank == 10 || rank == 8)
-                                place_type =  GEOCODE_PLACE_TYPE_STATE;
-                        else if (rank == 4)
-                                place_type =  GEOCODE_PLACE_TYPE_COUNTRY;
-                }
-        } else if (g_strcmp0 (category, "amenity") == 0) {
-                if (g_strcmp0 (type, "school") == 0)
-                        place_type = GEOCODE_PLACE_TYPE_SCHOOL;
-                else if (g_strcmp0 (type, "place_of_worship") == 0)
-                        place_type = GEOCODE_PLACE_TYPE_PLACE_OF_WORSHIP;
-                else if (g_strcmp0 (type, "restaurant") == 0)
-                        place_type = GEOCODE_PLACE_TYPE_RESTAURANT;
-                else if (g_strcmp0 (type, "bar") == 0 ||
-                         g_strcmp0 (type, "pub") == 0)
-                        place_type = GEOCODE_PLACE_TYPE_BAR;
-        } else if (g_strcmp0 (category, "aeroway") == 0) {
-                if (g_strcmp0 (type, "aerodrome") == 0)
-                        place_type = GEOCODE_PLACE_TYPE_AIRPORT;
-        }
-
-        return place_type;
-}
-
 static GeocodePlace *
-_geocode_create_place_from_attributes (GHashTable *ht)
+create_place_from_result (GeocodeNominatimResult *result)
 {
+        GeocodePlaceBuilder builder;
         GeocodePlace *place;
-        GeocodeLocation *loc = NULL;
-        const char *name, *street, *building, *bbox_corner;
-        GeocodePlaceType place_type;
-        gdouble longitude, latitude;
+        const char *street, *building;
+        char *address = NULL;
 
-        place_type = get_place_type_from_attributes (ht);
+        _geocode_place_builder_init (&builder);
 
-        name = g_hash_table_lookup (ht, "name");
-        if (name == NULL)
-                name = g_hash_table_lookup (ht, "display_name");
+        builder.place_type = _geocode_nominatim_result_get_place_type (result);
 
-        place = geocode_place_new (name, place_type);
+        builder.name = _geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_NAME);
+        if (builder.name == NULL)
+                builder.name = _geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_DISPLAY_NAME);
 
         /* If one corner exists, then all exists */
-        bbox_corner = g_hash_table_lookup (ht, "boundingbox-top");
-        if (bbox_corner != NULL) {
-            GeocodeBoundingBox *bbox;
-            gdouble top, bottom, left, right;
-
-            top = g_ascii_strtod (bbox_corner, NULL);
-
-            bbox_corner = g_hash_table_lookup (ht, "boundingbox-bottom");
-            bottom = g_ascii_strtod (bbox_corner, NULL);
-
-            bbox_corner = g_hash_table_lookup (ht, "boundingbox-left");
-            left = g_ascii_strtod (bbox_corner, NULL);
-
-            bbox_corner = g_hash_table_lookup (ht, "boundingbox-right");
-            right = g_ascii_strtod (bbox_corner, NULL);
-
-            bbox = geocode_bounding_box_new (top, bottom, left, right);
-            geocode_place_set_bounding_box (place, bbox);
-            g_object_unref (bbox);
+        if (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_TOP) != NULL) {
+            builder.has_bounding_box = TRUE;
+            builder.top = get_coordinate (result, GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_TOP);
+            builder.bottom = get_coordinate (result, GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_BOTTOM);
+            builder.left = get_coordinate (result, GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_LEFT);
+            builder.right = get_coordinate (result, GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_RIGHT);
         }
 
         /* Nominatim doesn't give us street addresses as such */
-        street = g_hash_table_lookup (ht, "road");
-        building = g_hash_table_lookup (ht, "house_number");
+        street = _geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_ROAD);
+        building = _geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_HOUSE_NUMBER);
         if (street != NULL && building != NULL) {
-            char *address;
             gboolean number_after;
 
             number_after = _geocode_object_is_number_after_street ();
             address = g_strdup_printf ("%s %s",
                                        number_after ? street : building,
                                        number_after ? building : street);
-            geocode_place_set_street_address (place, address);
-            g_free (address);
+            builder.fields[GEOCODE_PLACE_FIELD_STREET_ADDRESS] = address;
         }
 
-        g_hash_table_foreach (ht, (GHFunc) fill_place_from_entry, place);
+        fill_builder_from_result (&builder, result);
 
-        /* Get latitude and longitude and create GeocodeLocation object. */
-        longitude = g_ascii_strtod (g_hash_table_lookup (ht, "lon"), NULL);
-        latitude = g_ascii_strtod (g_hash_table_lookup (ht, "lat"), NULL);
-        name = geocode_place_get_name (place);
+        builder.latitude = get_coordinate (result, GEOCODE_NOMINATIM_FIELD_LATITUDE);
+        builder.longitude = get_coordinate (result, GEOCODE_NOMINATIM_FIELD_LONGITUDE);
 
-        loc = geocode_location_new_with_description (latitude,
-                                                     longitude,
-                                                     GEOCODE_LOCATION_ACCURACY_UNKNOWN,
-                                                     name);
-        geocode_place_set_location (place, loc);
-        g_object_unref (loc);
+        place = _geocode_place_build (&builder);
+        g_free (address);
 
         return place;
 }
 
-static void
-insert_place_into_tree (GNode *place_tree, GHashTable *ht)
+/* Returns: (transfer none): the place added */
+static GeocodePlace *
+add_place_from_result (GeocodeDisambiguator   *disambiguator,
+                       GeocodeNominatimResult *result)
 {
-	GNode *start = place_tree;
-        GeocodePlace *place = NULL;
-	char *attr_val = NULL;
+	const char *values[G_N_ELEMENTS (place_attributes)];
+	GeocodePlace *place;
 	guint i;
 
-	for (i = 0; i < G_N_ELEMENTS (place_attributes); i++) {
-		GNode *child = NULL;
-
-		attr_val = g_hash_table_lookup (ht, place_attributes[i]);
-		if (!attr_val) {
-			/* Add a dummy node if the attribute value is not
-			 * available for the place */
-			child = g_node_insert_data (start, -1, NULL);
-		} else {
-			/* If the attr value (eg for country United States)
-			 * already exists, then keep on adding other attributes under that node. */
-			child = g_node_first_child (start);
-			while (child &&
-			       child->data &&
-			       g_ascii_strcasecmp (child->data, attr_val) != 0) {
-				child = g_node_next_sibling (child);
-			}
-			if (!child) {
-				/* create a new node */
-				child = g_node_insert_data (start, -1, g_strdup (attr_val));
-			}
-		}
-		start = child;
-	}
+	for (i = 0; i < G_N_ELEMENTS (place_attributes); i++)
+		values[i] = _geocode_nominatim_result_get (result, place_attributes[i]);
 
-        place = _geocode_create_place_from_attributes (ht);
+	place = create_place_from_result (result);
+	_geocode_disambiguator_add (disambiguator, place, values);
 
-        /* The leaf node of the tree is the GeocodePlace object, containing
-         * associated GeocodePlace object */
-	g_node_insert_data (start, -1, place);
+	return place;
 }
 
-static void
-make_place_list_from_tree (GNode  *node,
-                           char  **s_array,
-                           GList **place_list,
-                           int     i)
+/* Parses a search response incrementally, as it arrives. The response is
+ * expected to be an array of results: each of them is parsed, and its place
+ * created, as soon as the whole of it has arrived, so that only the result
+ * being received is buffered. Anything other than an array, such as an error
+ * object, is buffered whole and parsed once it has all arrived.
+ *
+ * Each place can be handed over as soon as it is created, with
+ * _geocode_search_parser_set_result_func(). Its display name is only final
+ * once the response is complete, as it depends on the other results. */
+typedef enum {
+	SEARCH_PARSER_START,
+	SEARCH_PARSER_RESULTS,
+	SEARCH_PARSER_END,
+	SEARCH_PARSER_DOCUMENT,
+	SEARCH_PARSER_FAILED,
+} SearchParserState;
+
+struct _GeocodeSearchParser {
+	SearchParserState state;
+	GeocodeNominatimResult *result;  /* reused for each result */
+	GString *buffer;  /* the result being received, or the document */
+	guint depth;  /* of nesting within the result */
+	gboolean in_string;
+	gboolean escaped;
+	GeocodeDisambiguator *disambiguator;
+	guint n_results;
+	GeocodeSearchResultFunc result_func;  /* (nullable) */
+	gpointer result_data;
+};
+
+/*
+ * _geocode_search_parser_new:
+ *
+ * Creates a parser for a search response which arrives in chunks, to be
+ * passed to _geocode_search_parser_feed() in turn.
+ *
+ * Returns: (transfer full): a new #GeocodeSearchParser
+ */
+GeocodeSearchParser *
+_geocode_search_parser_new (void)
 {
-	GNode *child;
+	GeocodeSearchParser *parser;
 
-	if (node == NULL)
-		return;
+	parser = g_slice_new0 (GeocodeSearchParser);
+	parser->state = SEARCH_PARSER_START;
+	parser->result = _geocode_nominatim_result_new ();
+	parser->buffer = g_string_new (NULL);
+	parser->disambiguator = _geocode_disambiguator_new (G_N_ELEMENTS (place_attributes));
 
-	if (G_NODE_IS_LEAF (node)) {
-		GPtrArray *rev_s_array;
-		GeocodePlace *place;
-		GeocodeLocation *loc;
-		char *name;
-		int counter = 0;
-
-		rev_s_array = g_ptr_array_new ();
-
-		/* If leaf node, then add all the attributes in the s_array
-		 * and set it to the description of the loc object */
-		place = (GeocodePlace *) node->data;
-		name = (char *) geocode_place_get_name (place);
-		loc = geocode_place_get_location (place);
-
-		/* To print the attributes in a meaningful manner
-		 * reverse the s_array */
-		g_ptr_array_add (rev_s_array, (gpointer) name);
-		for (counter = 1; counter <= i; counter++)
-			g_ptr_array_add (rev_s_array, s_array[i - counter]);
-		g_ptr_array_add (rev_s_array, NULL);
-		name = g_strjoinv (", ", (char **) rev_s_array->pdata);
-		g_ptr_array_unref (rev_s_array);
-
-		geocode_place_set_name (place, name);
-		geocode_location_set_description (loc, name);
-		g_free (name);
-
-		*place_list = g_list_prepend (*place_list, place);
-	} else {
-                GNode *prev, *next;
+	return parser;
+}
 
-                prev = g_node_prev_sibling (node);
-                next = g_node_next_sibling (node);
+void
+_geocode_search_parser_free (GeocodeSearchParser *parser)
+{
+	/* The places are only handed over by _geocode_search_parser_finish(). */
+	_geocode_disambiguator_free (parser->disambiguator);
+	_geocode_nominatim_result_free (parser->result);
+	g_string_free (parser->buffer, TRUE);
+	g_slice_free (GeocodeSearchParser, parser);
+}
 
-		/* If there are other attributes with a different value,
-		 * add those attributes to the string to differentiate them */
-		if (node->data && ((prev && prev->data) || (next && next->data))) {
-                        s_array[i] = node->data;
-                        i++;
-		}
+/*
+ * _geocode_search_parser_set_result_func:
+ * @parser: a #GeocodeSearchParser
+ * @func: (nullable): function to call with each result as it is parsed
+ * @user_data: data to pass to @func
+ *
+ * Sets a function to be called from _geocode_search_parser_feed() with the
+ * place of each result, in the order of the response, as soon as the whole of
+ * the result has arrived. The place belongs to @parser, and is the one which
+ * _geocode_search_parser_finish() returns; its name and the description of
+ * its location are changed then, to tell it apart from the other results.
+ */
+void
+_geocode_search_parser_set_result_func (GeocodeSearchParser     *parser,
+                                        GeocodeSearchResultFunc  func,
+                                        gpointer                 user_data)
+{
+	parser->result_func = func;
+	parser->result_data = user_data;
+}
+
+/* Whether @parser's buffer holds nothing but whitespace. */
+static gboolean
+search_parser_buffer_is_blank (GeocodeSearchParser *parser)
+{
+	gsize i;
+
+	for (i = 0; i < parser->buffer->len; i++) {
+		if (!g_ascii_isspace (parser->buffer->str[i]))
+			return FALSE;
 	}
 
-	for (child = node->children; child != NULL; child = child->next)
-		make_place_list_from_tree (child, s_array, place_list, i);
+	return TRUE;
 }
 
-GList *
-_geocode_parse_search_json (const char *contents,
-			     GError    **error)
+/* Decodes the result in @parser's buffer, which is complete, and creates its
+ * place. */
+static gboolean
+search_parser_add_result (GeocodeSearchParser  *parser,
+                          GError              **error)
 {
-	GList *ret;
-	JsonParser *parser;
-	JsonNode *root;
-	JsonReader *reader;
-	const GError *err = NULL;
-	int num_places, i;
-	GNode *place_tree;
-	char *s_array[G_N_ELEMENTS (place_attributes)];
+	GeocodePlace *place;
 
-	g_debug ("%s: contents = %s", G_STRFUNC, contents);
+	if (search_parser_buffer_is_blank (parser)) {
+		g_set_error_literal (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE,
+		                     "Missing search result");
+		return FALSE;
+	}
 
-	ret = NULL;
+	if (!_geocode_nominatim_result_decode (parser->result,
+	                                       parser->buffer->str,
+	                                       parser->buffer->len,
+	                                       error))
+		return FALSE;
 
-	parser = json_parser_new ();
-	if (json_parser_load_from_data (parser, contents, -1, error) == FALSE) {
-		g_object_unref (parser);
-		return ret;
-	}
+	g_string_truncate (parser->buffer, 0);
 
-	root = json_parser_get_root (parser);
-	reader = json_reader_new (root);
+	place = add_place_from_result (parser->disambiguator, parser->result);
+	parser->n_results++;
 
-	num_places = json_reader_count_elements (reader);
-	if (num_places < 0)
-		goto parse;
-        if (num_places == 0) {
-	        g_set_error_literal (error,
-                                     GEOCODE_ERROR,
-                                     GEOCODE_ERROR_NO_MATCHES,
-                                     "No matches found for request");
-		goto no_results;
-        }
+	if (parser->result_func != NULL)
+		parser->result_func (place, parser->result_data);
 
-	place_tree = g_node_new (NULL);
+	return TRUE;
+}
 
-	for (i = 0; i < num_places; i++) {
-		GHashTable *ht;
+/*
+ * _geocode_search_parser_feed:
+ * @parser: a #GeocodeSearchParser
+ * @data: (array length=length): the next chunk of the response
+ * @length: length of @data, in bytes
+ * @error: return location for a #GError
+ *
+ * Parses the results completed by @data. Once this fails, @parser must only
+ * be freed.
+ *
+ * Returns: %TRUE on success, %FALSE if the response cannot be parsed
+ */
+gboolean
+_geocode_search_parser_feed (GeocodeSearchParser  *parser,
+                             const char           *data,
+                             gsize                 length,
+                             GError              **error)
+{
+	gsize i, start = 0;
 
-		json_reader_read_element (reader, i);
+	g_return_val_if_fail (parser->state != SEARCH_PARSER_FAILED, FALSE);
 
-                ht = g_hash_table_new_full (g_str_hash, g_str_equal,
-				            g_free, g_free);
-                _geocode_read_nominatim_attributes (reader, ht);
+	/* Not an array of results, so only parsed once it has all arrived. */
+	if (parser->state == SEARCH_PARSER_DOCUMENT) {
+		g_string_append_len (parser->buffer, data, length);
+		return TRUE;
+	}
 
-		/* Populate the tree with place details */
-		insert_place_into_tree (place_tree, ht);
+	for (i = 0; i < length; i++) {
+		char c = data[i];
 
-		g_hash_table_unref (ht);
+		switch (parser->state) {
+		case SEARCH_PARSER_START:
+			if (g_ascii_isspace (c))
+				break;
 
-		json_reader_end_element (reader);
-	}
+			if (c == '[') {
+				parser->state = SEARCH_PARSER_RESULTS;
+				start = i + 1;
+				break;
+			}
 
-	make_place_list_from_tree (place_tree, s_array, &ret, 0);
+			parser->state = SEARCH_PARSER_DOCUMENT;
+			g_string_append_len (parser->buffer, data + i, length - i);
+			return TRUE;
+
+		case SEARCH_PARSER_RESULTS:
+			if (parser->in_string) {
+				if (parser->escaped)
+					parser->escaped = FALSE;
+				else if (c == '\\')
+					parser->escaped = TRUE;
+				else if (c == '"')
+					parser->in_string = FALSE;
+			} else if (c == '"') {
+				parser->in_string = TRUE;
+			} else if (c == '{' || c == '[') {
+				parser->depth++;
+			} else if ((c == '}' || c == ']') && parser->depth > 0) {
+				parser->depth--;
+			} else if (parser->depth == 0 && (c == ',' || c == ']')) {
+				/* The end of a result, or of the results. */
+				g_string_append_len (parser->buffer, data + start, i - start);
+				start = i + 1;
+
+				if (c == ']' && parser->n_results == 0 &&
+				    search_parser_buffer_is_blank (parser)) {
+					parser->state = SEARCH_PARSER_END;
+					break;
+				}
+
+				if (!search_parser_add_result (parser, error)) {
+					parser->state = SEARCH_PARSER_FAILED;
+					return FALSE;
+				}
+
+				if (c == ']')
+					parser->state = SEARCH_PARSER_END;
+			}
+			break;
 
-	g_node_traverse (place_tree,
-			 G_IN_ORDER,
-			 G_TRAVERSE_ALL,
-			 -1,
-			 (GNodeTraverseFunc) node_free_func,
-			 NULL);
+		case SEARCH_PARSER_END:
+			if (!g_ascii_isspace (c)) {
+				g_set_error_literal (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE,
+				                     "Unexpected data after search results");
+				parser->state = SEARCH_PARSER_FAILED;
+				return FALSE;
+			}
+			break;
 
-	g_node_destroy (place_tree);
+		case SEARCH_PARSER_DOCUMENT:
+		case SEARCH_PARSER_FAILED:
+		default:
+			g_assert_not_reached ();
+		}
+	}
 
-	g_object_unref (parser);
-	g_object_unref (reader);
-	ret = g_list_reverse (ret);
+	if (parser->state == SEARCH_PARSER_RESULTS)
+		g_string_append_len (parser->buffer, data + start, length - start);
 
-	return ret;
-parse:
-	err = json_reader_get_error (reader);
-	g_set_error_literal (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE, err->message);
-no_results:
-	g_object_unref (parser);
-	g_object_unref (reader);
-	return NULL;
+	return TRUE;
 }
 
-static GList *
-geocode_nominatim_forward_search (GeocodeBackend  *backend,
-                                  GHashTable      *params,
-                                  GCancellable    *cancellable,
-                                  GError         **error)
+/*
+ * _geocode_search_parser_get_n_results:
+ * @parser: a #GeocodeSearchParser
+ *
+ * Returns: the number of results parsed so far
+ */
+guint
+_geocode_search_parser_get_n_results (GeocodeSearchParser *parser)
 {
-	GeocodeNominatim *self = GEOCODE_NOMINATIM (backend);
-	char *contents;
-	GHashTable *transformed_params = NULL;  /* (utf8, utf8) */
-	GList *result = NULL;  /* (element-type GeocodePlace) */
-	gchar *uri = NULL;
+	return parser->n_results;
+}
 
-	transformed_params = geocode_forward_fill_params (params);
-	uri = get_search_uri_for_params (self, transformed_params, error);
-	g_hash_table_unref (transformed_params);
+/* Fails with the reason why the whole response in @parser's buffer, which is
+ * not an array, is not a valid search response. */
+static void
+search_parser_check_document (GeocodeSearchParser  *parser,
+                              GError              **error)
+{
+	g_autoptr (JsonParser) json_parser = NULL;
+	JsonReader *reader;
 
-	if (uri == NULL)
-		return NULL;
+	json_parser = json_parser_new ();
+	if (!json_parser_load_from_data (json_parser,
+	                                 parser->buffer->str,
+	                                 parser->buffer->len,
+	                                 error))
+		return;
 
-	contents = GEOCODE_NOMINATIM_GET_CLASS (self)->query (self,
-	                                                      uri,
-	                                                      cancellable,
-	                                                      error);
-	if (contents != NULL) {
-		result = _geocode_parse_search_json (contents, error);
-		g_free (contents);
-	}
+	reader = json_reader_new (json_parser_get_root (json_parser));
 
-	g_free (uri);
+	if (json_reader_count_elements (reader) < 0)
+		g_set_error_literal (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE,
+		                     json_reader_get_error (reader)->message);
+	else
+		g_set_error_literal (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE,
+		                     "Unexpected search response");
 
-	return result;
+	g_object_unref (reader);
 }
 
-static void
-on_forward_query_ready (GeocodeNominatim *self,
-                        GAsyncResult     *res,
-                        GTask            *task)
+/*
+ * _geocode_search_parser_finish:
+ * @parser: a #GeocodeSearchParser
+ * @error: return location for a #GError
+ *
+ * Completes parsing once the whole response has been fed to @parser, and
+ * gives the results their display names, which depend on all of them.
+ *
+ * If there are no results, a %GEOCODE_ERROR_NO_MATCHES error is returned.
+ *
+ * Returns: (element-type GeocodePlace) (transfer full): the results, or %NULL
+ */
+GList *
+_geocode_search_parser_finish (GeocodeSearchParser  *parser,
+                               GError              **error)
 {
-	GError *error = NULL;
-	char *contents;
-	GList *places;  /* (element-type GeocodePlace) */
+	g_return_val_if_fail (parser->state != SEARCH_PARSER_FAILED, NULL);
 
-	contents = GEOCODE_NOMINATIM_GET_CLASS (self)->query_finish (GEOCODE_NOMINATIM (self), res, &error);
-	if (contents == NULL) {
-		g_task_return_error (task, error);
-		g_object_unref (task);
-		return;
+	switch (parser->state) {
+	case SEARCH_PARSER_START:
+	case SEARCH_PARSER_DOCUMENT:
+		search_parser_check_document (parser, error);
+		return NULL;
+	case SEARCH_PARSER_RESULTS:
+		g_set_error_literal (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE,
+		                     "Unexpected end of search results");
+		return NULL;
+	case SEARCH_PARSER_END:
+		break;
+	case SEARCH_PARSER_FAILED:
+	default:
+		g_assert_not_reached ();
 	}
 
-	places = _geocode_parse_search_json (contents, &error);
-	g_free (contents);
-
-	if (places == NULL) {
-		g_task_return_error (task, error);
-		g_object_unref (task);
-		return;
-	}
+        if (parser->n_results == 0) {
+	        g_set_error_literal (error,
+                                     GEOCODE_ERROR,
+                                     GEOCODE_ERROR_NO_MATCHES,
+                                     "No matches found for request");
+		return NULL;
+        }
 
-	g_task_return_pointer (task, places, (GDestroyNotify) g_list_free);
-	g_object_unref (task);
+	return _geocode_disambiguator_finish (parser->disambiguator);
 }
 
-static void
-geocode_nominatim_forward_search_async (GeocodeBackend      *backend,
-                                        GHashTable          *params,
-                                        GCancellable        *cancellable,
-                                        GAsyncReadyCallback  callback,
-                                        gpointer             user_data)
+GList *
+_geocode_parse_search_json (const char *contents,
+			     GError    **error)
 {
-	GeocodeNominatim *self = GEOCODE_NOMINATIM (backend);
-	GTask *task;
-	GHashTable *transformed_params = NULL;  /* (utf8, utf8) */
-	gchar *uri = NULL;
-	GError *error = NULL;
+	GeocodeSearchParser *parser;
+	GList *ret = NULL;
 
-	transformed_params = geocode_forward_fill_params (params);
-	uri = get_search_uri_for_params (self, transformed_params, &error);
-	g_hash_table_unref (transformed_params);
+	g_debug ("%s: contents = %s", G_STRFUNC, contents);
 
-	if (error != NULL) {
-		g_task_report_error (self, callback, user_data, NULL, error);
-		return;
-	}
+	parser = _geocode_search_parser_new ();
 
-	task = g_task_new (self, cancellable, callback, user_data);
-	GEOCODE_NOMINATIM_GET_CLASS (self)->query_async (self,
-	                                                 uri,
-	                                                 cancellable,
-	                                                 (GAsyncReadyCallback) on_forward_query_ready,
-	                                                 g_object_ref (task));
-	g_object_unref (task);
-	g_free (uri);
-}
+	if (_geocode_search_parser_feed (parser, contents, strlen (contents), error))
+		ret = _geocode_search_parser_finish (parser, error);
 
-static GList *
-geocode_nominatim_forward_search_finish (GeocodeBackend  *backend,
-                                         GAsyncResult    *res,
-                                         GError         **error)
-{
-	return g_task_propagate_pointer (G_TASK (res), error);
-}
+	_geocode_search_parser_free (parser);
 
-/******************************************************************************/
+	return ret;
+}
 
 static void
-copy_item (char       *key,
-           char       *value,
-           GHashTable *ret)
+places_list_free (GList *places)
 {
-	g_hash_table_insert (ret, key, value);
+	g_list_free_full (places, g_object_unref);
 }
 
-GHashTable *
-_geocode_glib_dup_hash_table (GHashTable *ht)
+/* Returns the key under which results for @uri are cached, which is @key if
+ * that is given, or %NULL if @self caches results neither in memory nor on
+ * disk. */
+static char *
+get_cache_key (GeocodeNominatim *self,
+               const char       *uri,
+               const char       *key)
 {
-	GHashTable *ret;
+	GeocodeNominatimPrivate *priv;
+	SoupURI *soup_uri;
+	char *cache_key;
 
-	ret = g_hash_table_new (g_str_hash, g_str_equal);
-	g_hash_table_foreach (ht, (GHFunc) copy_item, ret);
+	priv = geocode_nominatim_get_instance_private (self);
 
-	return ret;
+	if (!g_atomic_int_get (&priv->memory_cache_enabled) &&
+	    !g_atomic_int_get (&priv->cache_enabled))
+		return NULL;
+
+	if (key != NULL)
+		return g_strdup (key);
+
+	soup_uri = soup_uri_new (uri);
+	if (soup_uri == NULL)
+		return NULL;
+
+	cache_key = _geocode_glib_cache_key_for_uri (soup_uri);
+	soup_uri_free (soup_uri);
+
+	return cache_key;
 }
 
-static gchar *
-get_resolve_uri_for_params (GeocodeNominatim  *self,
-                            GHashTable        *orig_ht,
-                            GError           **error)
+static void refresh_cached_places (GeocodeNominatim       *self,
+                                   const char             *key,
+                                   const char             *uri,
+                                   GeocodeLookupType       type,
+                                   gboolean                synchronous,
+                                   GBytes                 *value,
+                                   const GeocodeCacheInfo *info);
+
+/* Looks up the results cached for @key, in memory and then on disk. Results
+ * found on disk are added to the in-memory cache, unless they are stale, in
+ * which case they are refreshed in the background by querying @uri. If the
+ * query is known to have no results, @places is set to %NULL and @error is
+ * set. @synchronous is set for lookups made by synchronous queries, whose
+ * thread-default main context may never be iterated.
+ *
+ * Returns: %TRUE if results were found, %FALSE otherwise */
+static gboolean
+lookup_cached_places (GeocodeNominatim   *self,
+                      const char         *key,
+                      const char         *uri,
+                      GeocodeLookupType   type,
+                      gboolean            synchronous,
+                      GList             **places,
+                      GError            **error)
 {
-	GHashTable *ht;
-	char *locale;
-	char *params, *uri;
 	GeocodeNominatimPrivate *priv;
-	const GValue *lat, *lon;
-	char lat_str[G_ASCII_DTOSTR_BUF_SIZE];
-	char lon_str[G_ASCII_DTOSTR_BUF_SIZE];
+	gboolean memory_cache_enabled;
+	GeocodeCacheInfo info = { NULL, };
+	GBytes *value;
+	gboolean found;
 
 	priv = geocode_nominatim_get_instance_private (self);
 
-	/* Make sure we have both lat and lon. */
-	lat = g_hash_table_lookup (orig_ht, "lat");
-	lon = g_hash_table_lookup (orig_ht, "lon");
+	if (key == NULL)
+		return FALSE;
 
-	if (lat == NULL || lon == NULL) {
-		g_set_error_literal (error, GEOCODE_ERROR, GEOCODE_ERROR_INVALID_ARGUMENTS,
-		                     "Only following parameters supported: lat, lon");
+	memory_cache_enabled = g_atomic_int_get (&priv->memory_cache_enabled);
 
-		return NULL;
-	}
+	if (memory_cache_enabled &&
+	    _geocode_memory_cache_lookup (key, places, error))
+		return TRUE;
 
-	ht = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, NULL);
+	if (!g_atomic_int_get (&priv->cache_enabled) ||
+	    !_geocode_glib_cache_load (key, &value, &info))
+		return FALSE;
 
-	g_ascii_dtostr (lat_str, G_ASCII_DTOSTR_BUF_SIZE,
-	                g_value_get_double (lat));
-	g_ascii_dtostr (lon_str, G_ASCII_DTOSTR_BUF_SIZE,
-	                g_value_get_double (lon));
+	/* Stale entries are only used if they can be refreshed in the
+	 * background. Entries saved by an incompatible version are ignored,
+	 * and replaced once the query has been made again. */
+	if (info.stale && g_atomic_int_get (&priv->stale_while_revalidate) == 0)
+		found = FALSE;
+	else
+		found = _geocode_place_list_deserialize (value, places);
 
-	g_hash_table_insert (ht, (gpointer) "lat", lat_str);
-	g_hash_table_insert (ht, (gpointer) "lon", lon_str);
+	if (found && info.stale) {
+		refresh_cached_places (self, key, uri, type, synchronous,
+		                       value, &info);
+	} else if (found && memory_cache_enabled) {
+		guint ttl = 0;
 
-	g_hash_table_insert (ht, (gpointer) "format", (gpointer) "json");
-	g_hash_table_insert (ht, (gpointer) "email",
-	                     (gpointer) priv->maintainer_email_address);
-	g_hash_table_insert (ht, (gpointer) "addressdetails", (gpointer) "1");
+		/* Kept in memory until the record goes stale. */
+		if (info.stale_at != 0) {
+			gint64 now = g_get_real_time () / G_USEC_PER_SEC;
 
-	locale = NULL;
-	if (g_hash_table_lookup (ht, "accept-language") == NULL) {
-		locale = _geocode_object_get_lang ();
-		if (locale)
-			g_hash_table_insert (ht, (gpointer) "accept-language", locale);
+			ttl = CLAMP ((gint64) info.stale_at - now, 1, G_MAXUINT);
+		}
+
+		_geocode_memory_cache_insert (key, *places, ttl);
 	}
 
-	{
-		GHashTableIter iter;
-		gpointer key, value;
+	g_bytes_unref (value);
+	_geocode_cache_info_clear (&info);
 
-		g_hash_table_iter_init (&iter, ht);
-		while (g_hash_table_iter_next (&iter, &key, &value))
-			g_debug ("%s: %s = %s", G_STRFUNC, (const gchar *) key, (const gchar *) value);
-	}
+	return found;
+}
 
-	params = soup_form_encode_hash (ht);
-	g_hash_table_unref (ht);
-	g_free (locale);
+/* Saves @value, the serialized results for @key, in the on-disk cache. */
+static void
+save_cached_value (GeocodeNominatim       *self,
+                   const char             *key,
+                   GBytes                 *value,
+                   const GeocodeCacheInfo *info)
+{
+	GeocodeNominatimPrivate *priv;
 
-	uri = g_strdup_printf ("%s/reverse?%s", priv->base_url, params);
-	g_free (params);
+	priv = geocode_nominatim_get_instance_private (self);
 
-	return uri;
+	_geocode_glib_cache_save (key, value,
+	                          g_atomic_int_get (&priv->cache_ttl),
+	                          g_atomic_int_get (&priv->stale_while_revalidate),
+	                          info);
 }
 
-static gchar *
-geocode_nominatim_query_finish (GeocodeNominatim  *self,
-                                GAsyncResult      *res,
-                                GError           **error)
+/* Caches @places as the results for @key, in memory and on disk. @info holds
+ * the validators of the response they came from, if any. */
+static void
+cache_places (GeocodeNominatim       *self,
+              const char             *key,
+              GList                  *places,
+              const GeocodeCacheInfo *info)
 {
-	return g_task_propagate_pointer (G_TASK (res), error);
+	GeocodeNominatimPrivate *priv;
+
+	priv = geocode_nominatim_get_instance_private (self);
+
+	if (key == NULL)
+		return;
+
+	if (g_atomic_int_get (&priv->memory_cache_enabled))
+		_geocode_memory_cache_insert (key, places,
+		                              g_atomic_int_get (&priv->cache_ttl));
+
+	if (g_atomic_int_get (&priv->cache_enabled)) {
+		g_autoptr(GBytes) value = _geocode_place_list_serialize (places);
+
+		save_cached_value (self, key, value, info);
+	}
 }
 
+/* Sets @info to the validators in the response to @message. */
 static void
-on_query_data_loaded (SoupSession *session,
-                      SoupMessage *query,
-                      GTask       *task)
+cache_info_init_from_message (GeocodeCacheInfo *info,
+                              SoupMessage      *message)
 {
-	char *contents;
+	info->etag = g_strdup (soup_message_headers_get_one (message->response_headers,
+	                                                     "ETag"));
+	info->last_modified = g_strdup (soup_message_headers_get_one (message->response_headers,
+	                                                              "Last-Modified"));
+}
 
-	if (query->status_code != SOUP_STATUS_OK)
-		g_task_return_new_error (task,
-		                         G_IO_ERROR,
-		                         G_IO_ERROR_FAILED,
-		                         "%s",
-		                         query->reason_phrase ? query->reason_phrase : "Query failed");
-	else {
-		contents = g_strndup (query->response_body->data, query->response_body->length);
-		_geocode_glib_cache_save (query, contents);
-		g_task_return_pointer (task, contents, g_free);
-	}
+static GeocodeCacheInfo *
+cache_info_copy (const GeocodeCacheInfo *info)
+{
+	GeocodeCacheInfo *copy;
 
-	g_object_unref (task);
+	copy = g_slice_new0 (GeocodeCacheInfo);
+	copy->etag = g_strdup (info->etag);
+	copy->last_modified = g_strdup (info->last_modified);
+
+	return copy;
+}
+
+static void
+cache_info_free (GeocodeCacheInfo *info)
+{
+	_geocode_cache_info_clear (info);
+	g_slice_free (GeocodeCacheInfo, info);
 }
 
+/* Caches @error for @key if it says that the query has no results, rather
+ * than that it failed, so that repeating the query fails straight away. */
 static void
-on_cache_data_loaded (GFile        *cache,
-                      GAsyncResult *res,
-                      GTask        *task)
+cache_negative_result (GeocodeNominatim *self,
+                       const char       *key,
+                       const GError     *error)
 {
-	GeocodeNominatim *self;
 	GeocodeNominatimPrivate *priv;
-	char *contents;
-	SoupSession *soup_session;
+	guint ttl;
 
-	self = g_task_get_source_object (task);
 	priv = geocode_nominatim_get_instance_private (self);
+	ttl = g_atomic_int_get (&priv->negative_cache_ttl);
 
-	if (g_file_load_contents_finish (cache,
-	                                 res,
-	                                 &contents,
-	                                 NULL,
-	                                 NULL,
-	                                 NULL)) {
-		g_task_return_pointer (task, contents, g_free);
-		g_object_unref (task);
+	if (key == NULL || ttl == 0 ||
+	    !g_atomic_int_get (&priv->memory_cache_enabled))
 		return;
-	}
 
-	soup_session = _geocode_glib_build_soup_session (priv->user_agent);
-	soup_session_queue_message (soup_session,
-	                            g_object_ref (g_task_get_task_data (task)),
-	                            (SoupSessionCallback) on_query_data_loaded,
-	                            task);
-	g_object_unref (soup_session);
+	if (g_error_matches (error, GEOCODE_ERROR, GEOCODE_ERROR_NO_MATCHES) ||
+	    g_error_matches (error, GEOCODE_ERROR, GEOCODE_ERROR_NOT_SUPPORTED))
+		_geocode_memory_cache_insert_error (key, error, ttl);
 }
 
-static void
-geocode_nominatim_query_async (GeocodeNominatim    *self,
-                               const gchar         *uri,
-                               GCancellable        *cancellable,
-                               GAsyncReadyCallback  callback,
-                               gpointer             user_data)
+/* Identifies the results of reverse geocoding queries made by @self, apart
+ * from the location, for the spatial reverse geocoding cache. */
+static char *
+get_reverse_cache_scope (GeocodeNominatim *self)
 {
-	GTask *task;
-	SoupSession *soup_session;
-	SoupMessage *soup_query;
-	char *cache_path;
 	GeocodeNominatimPrivate *priv;
+	g_autofree char *locale = NULL;
 
 	priv = geocode_nominatim_get_instance_private (self);
+	locale = get_language (self);
 
-	g_debug ("%s: uri = %s", G_STRFUNC, uri);
+	return g_strdup_printf ("%s#%s", priv->base_url,
+	                        (locale != NULL) ? locale : "");
+}
 
-	task = g_task_new (self, cancellable, callback, user_data);
+/* Looks up the results of reverse geocoding a location near to the one at
+ * @latitude and @longitude, if @self reuses results for nearby locations.
+ *
+ * Returns: %TRUE if results were found, %FALSE otherwise */
+static gboolean
+lookup_nearby_places (GeocodeNominatim  *self,
+                      gdouble            latitude,
+                      gdouble            longitude,
+                      GList            **places)
+{
+	GeocodeNominatimPrivate *priv;
+	g_autofree char *scope = NULL;
+	guint radius;
 
-	soup_query = soup_message_new (SOUP_METHOD_GET, uri);
-	g_task_set_task_data (task, soup_query, g_object_unref);
+	priv = geocode_nominatim_get_instance_private (self);
+	radius = g_atomic_int_get (&priv->reverse_cache_radius);
 
-	cache_path = _geocode_glib_cache_path_for_query (soup_query);
-	if (cache_path != NULL) {
-		GFile *cache;
+	if (radius == 0)
+		return FALSE;
 
-		cache = g_file_new_for_path (cache_path);
-		g_file_load_contents_async (cache,
-		                            cancellable,
-		                            (GAsyncReadyCallback) on_cache_data_loaded,
-		                            task);
-		g_object_unref (cache);
-		g_free (cache_path);
-		return;
-	}
+	scope = get_reverse_cache_scope (self);
 
-	soup_session = _geocode_glib_build_soup_session (priv->user_agent);
-	soup_session_queue_message (soup_session,
-	                            g_object_ref (soup_query),
-	                            (SoupSessionCallback) on_query_data_loaded,
-	                            task);
-	g_object_unref (soup_session);
+	return _geocode_reverse_cache_lookup (scope, latitude, longitude,
+	                                      radius, places);
 }
 
-static gchar *
-geocode_nominatim_query (GeocodeNominatim  *self,
-                         const gchar       *uri,
-                         GCancellable      *cancellable,
-                         GError           **error)
+/* Caches @places as the result of reverse geocoding the location at
+ * @latitude and @longitude, if @self reuses results for nearby locations. */
+static void
+cache_nearby_places (GeocodeNominatim *self,
+                     gdouble           latitude,
+                     gdouble           longitude,
+                     GList            *places)
 {
-	SoupSession *soup_session;
-	SoupMessage *soup_query;
-	char *contents;
 	GeocodeNominatimPrivate *priv;
+	g_autofree char *scope = NULL;
+	guint radius;
 
 	priv = geocode_nominatim_get_instance_private (self);
+	radius = g_atomic_int_get (&priv->reverse_cache_radius);
 
-	g_debug ("%s: uri = %s", G_STRFUNC, uri);
+	if (radius == 0)
+		return;
 
-	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+	scope = get_reverse_cache_scope (self);
+	_geocode_reverse_cache_insert (scope, latitude, longitude, radius,
+	                               g_atomic_int_get (&priv->reverse_cache_ttl),
+	                               places);
+}
+
+static gchar *geocode_nominatim_query (GeocodeNominatim  *self,
+                                       const gchar       *uri,
+                                       GCancellable      *cancellable,
+                                       GError           **error);
+static void geocode_nominatim_query_async (GeocodeNominatim    *self,
+                                           const gchar         *uri,
+                                           GCancellable        *cancellable,
+                                           GAsyncReadyCallback  callback,
+                                           gpointer             user_data);
+static gboolean run_query (GeocodeNominatim  *self,
+                           const gchar       *uri,
+                           GCancellable      *cancellable,
+                           char             **contents,
+                           GList            **places,
+                           GeocodeCacheInfo  *info,
+                           GError           **error);
+static void start_query (GeocodeNominatim    *self,
+                         const gchar         *uri,
+                         const char          *key,
+                         gboolean             parse_search,
+                         gint                 priority,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data);
+
+/* Returns the validators of the response which the result @res of a query
+ * came from, if the query was made by start_query() rather than a subclass. */
+static const GeocodeCacheInfo *
+get_query_cache_info (GAsyncResult *res)
+{
+	if (!g_async_result_is_tagged (res, start_query) &&
+	    !g_async_result_is_tagged (res, geocode_nominatim_query_async))
 		return NULL;
 
-	soup_session = _geocode_glib_build_soup_session (priv->user_agent);
-	soup_query = soup_message_new (SOUP_METHOD_GET, uri);
+	return g_task_get_task_data (G_TASK (res));
+}
 
-	if (_geocode_glib_cache_load (soup_query, &contents) == FALSE) {
-		if (soup_session_send_message (soup_session, soup_query) != SOUP_STATUS_OK) {
-			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-			                     soup_query->reason_phrase ? soup_query->reason_phrase : "Query failed");
-			contents = NULL;
-		} else {
-			contents = g_strndup (soup_query->response_body->data, soup_query->response_body->length);
-			_geocode_glib_cache_save (soup_query, contents);
-		}
+/* Makes the search query @uri, or gets its results from the cache. @key is
+ * the canonical key of @uri, if it is known already. */
+static GList *
+search_for_uri (GeocodeNominatim  *self,
+                const char        *uri,
+                const char        *key,
+                GCancellable      *cancellable,
+                GError           **error)
+{
+	char *contents;
+	GList *result = NULL;  /* (element-type GeocodePlace) */
+	g_autofree gchar *cache_key = NULL;
+	GeocodeCacheInfo info = { NULL, };
+	GError *local_error = NULL;
+
+	cache_key = get_cache_key (self, uri, key);
+	if (lookup_cached_places (self, cache_key, uri, GEOCODE_GLIB_RESOLVE_FORWARD,
+	                          TRUE, &result, error))
+		return result;
+
+	/* Results are parsed as the response arrives, unless a subclass
+	 * overrides the query vfunc, which returns the whole of it. */
+	if (GEOCODE_NOMINATIM_GET_CLASS (self)->query == geocode_nominatim_query) {
+		run_query (self, uri, cancellable, NULL, &result, &info, &local_error);
+	} else {
+		contents = GEOCODE_NOMINATIM_GET_CLASS (self)->query (self,
+		                                                      uri,
+		                                                      cancellable,
+		                                                      error);
+		if (contents == NULL)
+			return NULL;
+
+		result = _geocode_parse_search_json (contents, &local_error);
+		g_free (contents);
 	}
 
-	g_object_unref (soup_query);
-	g_object_unref (soup_session);
+	if (result == NULL) {
+		cache_negative_result (self, cache_key, local_error);
+		g_propagate_error (error, local_error);
+		return NULL;
+	}
 
-	return contents;
-}
+	cache_places (self, cache_key, result, &info);
+	_geocode_cache_info_clear (&info);
 
-/******************************************************************************/
+	return result;
+}
 
 static GList *
-geocode_nominatim_reverse_resolve_finish (GeocodeBackend  *backend,
-                                          GAsyncResult    *res,
-                                          GError         **error)
+geocode_nominatim_forward_search (GeocodeBackend  *backend,
+                                  GHashTable      *params,
+                                  GCancellable    *cancellable,
+                                  GError         **error)
 {
-	return g_task_propagate_pointer (G_TASK (res), error);
+	GeocodeNominatim *self = GEOCODE_NOMINATIM (backend);
+	GHashTable *transformed_params = NULL;  /* (utf8, utf8) */
+	g_autofree gchar *uri = NULL;
+
+	transformed_params = geocode_forward_fill_params (params);
+	uri = get_search_uri_for_params (self, transformed_params, error);
+	g_hash_table_unref (transformed_params);
+
+	if (uri == NULL)
+		return NULL;
+
+	return search_for_uri (self, uri, NULL, cancellable, error);
 }
 
 static void
-insert_bounding_box_element (GHashTable *ht,
-                             GType       value_type,
-                             const char *name,
-                             JsonReader *reader)
-{
-	if (value_type == G_TYPE_STRING) {
-		const char *bbox_val;
-
-		bbox_val = json_reader_get_string_value (reader);
-		g_hash_table_insert (ht, g_strdup (name), g_strdup (bbox_val));
-	} else if (value_type == G_TYPE_DOUBLE) {
-		gdouble bbox_val;
-
-		bbox_val = json_reader_get_double_value (reader);
-		g_hash_table_insert(ht, g_strdup (name), g_strdup_printf ("%lf", bbox_val));
-	} else if (value_type == G_TYPE_INT64) {
-		gint64 bbox_val;
-
-		bbox_val = json_reader_get_double_value (reader);
-		g_hash_table_insert(ht, g_strdup (name), g_strdup_printf ("%"G_GINT64_FORMAT, bbox_val));
+on_forward_query_ready (GeocodeNominatim *self,
+                        GAsyncResult     *res,
+                        GTask            *task)
+{
+	GError *error = NULL;
+	char *contents;
+	GList *places;  /* (element-type GeocodePlace) */
+
+	if (g_async_result_is_tagged (res, start_query)) {
+		/* Parsed as the response arrived. */
+		places = g_task_propagate_pointer (G_TASK (res), &error);
 	} else {
-		g_debug ("Unhandled node type %s for %s", g_type_name (value_type), name);
+		contents = GEOCODE_NOMINATIM_GET_CLASS (self)->query_finish (GEOCODE_NOMINATIM (self), res, &error);
+		if (contents == NULL) {
+			g_task_return_error (task, error);
+			g_object_unref (task);
+			return;
+		}
+
+		places = _geocode_parse_search_json (contents, &error);
+		g_free (contents);
+	}
+
+	if (places == NULL) {
+		cache_negative_result (self, g_task_get_task_data (task), error);
+		g_task_return_error (task, error);
+		g_object_unref (task);
+		return;
 	}
+
+	cache_places (self, g_task_get_task_data (task), places,
+	              get_query_cache_info (res));
+
+	g_task_return_pointer (task, places, (GDestroyNotify) g_list_free);
+	g_object_unref (task);
 }
 
+/* Starts the search query @uri, or gets its results from the cache; finish
+ * with g_task_propagate_pointer(). @key is the canonical key of @uri, if it
+ * is known already. If the request is rate limited, it is queued with
+ * @priority. */
 static void
-_geocode_read_nominatim_attributes (JsonReader *reader,
-                                    GHashTable *ht)
+search_for_uri_with_priority_async (GeocodeNominatim    *self,
+                                    const char          *uri,
+                                    const char          *key,
+                                    gint                 priority,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
 {
-	char **members;
-	guint i;
-	gboolean is_address;
-	const char *house_number = NULL;
+	GTask *task;
+	gchar *cache_key = NULL;
+	GList *places = NULL;  /* (element-type GeocodePlace) */
+	GError *error = NULL;
 
-	is_address = (g_strcmp0 (json_reader_get_member_name (reader), "address") == 0);
+	task = g_task_new (self, cancellable, callback, user_data);
 
-	members = json_reader_list_members (reader);
-	if (members == NULL) {
-		json_reader_end_member (reader);
+	cache_key = get_cache_key (self, uri, key);
+	if (lookup_cached_places (self, cache_key, uri, GEOCODE_GLIB_RESOLVE_FORWARD,
+	                          FALSE, &places, &error)) {
+		if (error != NULL)
+			g_task_return_error (task, error);
+		else
+			g_task_return_pointer (task, places,
+			                       (GDestroyNotify) places_list_free);
+		g_object_unref (task);
+		g_free (cache_key);
 		return;
 	}
 
-	for (i = 0; members[i] != NULL; i++) {
-		char *value = NULL;
+	g_task_set_task_data (task, cache_key, g_free);
+
+	/* Results are parsed as the response arrives, unless a subclass
+	 * overrides the query vfuncs, which return the whole of it. The key
+	 * is only computed once, if it is not known. */
+	if (GEOCODE_NOMINATIM_GET_CLASS (self)->query_async == geocode_nominatim_query_async)
+		start_query (self, uri, (cache_key != NULL) ? cache_key : key,
+		             TRUE, priority, cancellable,
+		             (GAsyncReadyCallback) on_forward_query_ready,
+		             g_object_ref (task));
+	else
+		GEOCODE_NOMINATIM_GET_CLASS (self)->query_async (self,
+		                                                 uri,
+		                                                 cancellable,
+		                                                 (GAsyncReadyCallback) on_forward_query_ready,
+		                                                 g_object_ref (task));
+	g_object_unref (task);
+}
 
-		json_reader_read_member (reader, members[i]);
+static void
+search_for_uri_async (GeocodeNominatim    *self,
+                      const char          *uri,
+                      GCancellable        *cancellable,
+                      GAsyncReadyCallback  callback,
+                      gpointer             user_data)
+{
+	search_for_uri_with_priority_async (self, uri, NULL, G_PRIORITY_DEFAULT,
+	                                    cancellable, callback, user_data);
+}
 
-		if (json_reader_is_value (reader)) {
-			JsonNode *node = json_reader_get_value (reader);
-			if (json_node_get_value_type (node) == G_TYPE_STRING) {
-				value = g_strdup (json_node_get_string (node));
-				if (value && *value == '\0')
-					g_clear_pointer (&value, g_free);
-			} else if (json_node_get_value_type (node) == G_TYPE_INT64) {
-				gint64 int_value = json_node_get_int (node);
-				value = g_strdup_printf ("%"G_GINT64_FORMAT, int_value);
-			}
-		}
+static void
+geocode_nominatim_forward_search_async (GeocodeBackend      *backend,
+                                        GHashTable          *params,
+                                        GCancellable        *cancellable,
+                                        GAsyncReadyCallback  callback,
+                                        gpointer             user_data)
+{
+	GeocodeNominatim *self = GEOCODE_NOMINATIM (backend);
+	GHashTable *transformed_params = NULL;  /* (utf8, utf8) */
+	g_autofree gchar *uri = NULL;
+	GError *error = NULL;
 
-		if (value != NULL) {
-			g_hash_table_insert (ht, g_strdup (members[i]), value);
-
-			if (i == 0 && is_address) {
-				if (g_strcmp0 (members[i], "house_number") != 0)
-					/* Since Nominatim doesn't give us a short name,
-					 * we use the first component of address as name.
-					 */
-					g_hash_table_insert (ht, g_strdup ("name"), g_strdup (value));
-				else
-					house_number = value;
-			} else if (house_number != NULL && g_strcmp0 (members[i], "road") == 0) {
-				gboolean number_after;
-				char *name;
-
-				number_after = _geocode_object_is_number_after_street ();
-				name = g_strdup_printf ("%s %s",
-				                        number_after ? value : house_number,
-				                        number_after ? house_number : value);
-				g_hash_table_insert (ht, g_strdup ("name"), name);
-			}
-		} else if (g_strcmp0 (members[i], "boundingbox") == 0) {
-			JsonNode *node;
-			GType value_type;
+	transformed_params = geocode_forward_fill_params (params);
+	uri = get_search_uri_for_params (self, transformed_params, &error);
+	g_hash_table_unref (transformed_params);
+
+	if (error != NULL) {
+		g_task_report_error (self, callback, user_data, NULL, error);
+		return;
+	}
 
-			json_reader_read_element (reader, 0);
-			node = json_reader_get_value (reader);
-			value_type = json_node_get_value_type (node);
+	search_for_uri_async (self, uri, cancellable, callback, user_data);
+}
 
-			insert_bounding_box_element (ht, value_type, "boundingbox-bottom", reader);
-			json_reader_end_element (reader);
+static GList *
+geocode_nominatim_forward_search_finish (GeocodeBackend  *backend,
+                                         GAsyncResult    *res,
+                                         GError         **error)
+{
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
 
-			json_reader_read_element (reader, 1);
-			insert_bounding_box_element (ht, value_type, "boundingbox-top", reader);
-			json_reader_end_element (reader);
+static GList *
+search_for_uri_finish (GeocodeNominatim  *self,
+                       GAsyncResult      *result,
+                       GError           **error)
+{
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
 
-			json_reader_read_element (reader, 2);
-			insert_bounding_box_element (ht, value_type, "boundingbox-left", reader);
-			json_reader_end_element (reader);
+/* Identifies the search query @uri, so that identical queries in a batch are
+ * only made once. */
+static char *
+get_batch_key (const char *uri)
+{
+	SoupURI *soup_uri;
+	char *key;
 
-			json_reader_read_element (reader, 3);
-			insert_bounding_box_element (ht, value_type, "boundingbox-right", reader);
-			json_reader_end_element (reader);
-		}
-		json_reader_end_member (reader);
-	}
+	soup_uri = soup_uri_new (uri);
+	if (soup_uri == NULL)
+		return g_strdup (uri);
 
-	g_strfreev (members);
+	key = _geocode_glib_cache_key_for_uri (soup_uri);
+	soup_uri_free (soup_uri);
 
-	if (json_reader_read_member (reader, "address"))
-		_geocode_read_nominatim_attributes (reader, ht);
-	json_reader_end_member (reader);
+	return key;
 }
 
-static GHashTable *
-resolve_json (const char  *contents,
-              GError     **error)
+/* Searches for each distinct query of the batch once, keeping as many of
+ * them running as there are connections to the service, so that the pooled
+ * connections are kept busy without queueing more requests than they can
+ * take. */
+static void
+geocode_nominatim_forward_search_batch_async (GeocodeBackend      *backend,
+                                              GPtrArray           *params,
+                                              GCancellable        *cancellable,
+                                              GAsyncReadyCallback  callback,
+                                              gpointer             user_data)
 {
-	GHashTable *ret = NULL;
-	JsonParser *parser;
-	JsonNode *root;
-	JsonReader *reader;
+	GeocodeNominatim *self = GEOCODE_NOMINATIM (backend);
+	GeocodeNominatimPrivate *priv;
+	GeocodeBatch *batch;
+	g_autoptr (GHashTable) requests = NULL;  /* (element-type utf8 guint) */
+	guint max_running, i;
 
-	g_debug ("%s: contents = %s", G_STRFUNC, contents);
+	priv = geocode_nominatim_get_instance_private (self);
 
-	parser = json_parser_new ();
-	if (json_parser_load_from_data (parser, contents, -1, error) == FALSE) {
-		g_object_unref (parser);
-		return ret;
-	}
+	batch = _geocode_batch_new (params->len,
+	                            (GeocodeBatchStartFunc) search_for_uri_async,
+	                            (GeocodeBatchFinishFunc) search_for_uri_finish);
+	requests = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
-	root = json_parser_get_root (parser);
-	reader = json_reader_new (root);
+	for (i = 0; i < params->len; i++) {
+		GHashTable *transformed_params = NULL;  /* (utf8, utf8) */
+		char *uri, *key;
+		gpointer request;
+		GError *error = NULL;
 
-	if (json_reader_read_member (reader, "error")) {
-		const char *msg;
+		transformed_params = geocode_forward_fill_params (g_ptr_array_index (params, i));
+		uri = get_search_uri_for_params (self, transformed_params, &error);
+		g_hash_table_unref (transformed_params);
 
-		msg = json_reader_get_string_value (reader);
-		json_reader_end_member (reader);
-		if (msg && *msg == '\0')
-			msg = NULL;
+		if (uri == NULL) {
+			_geocode_batch_set_error (batch, i, error);
+			continue;
+		}
 
-		g_set_error_literal (error,
-		                     GEOCODE_ERROR,
-		                     GEOCODE_ERROR_NOT_SUPPORTED,
-		                     msg ? msg : "Query not supported");
-		g_object_unref (parser);
-		g_object_unref (reader);
-		return NULL;
+		key = get_batch_key (uri);
+
+		if (g_hash_table_lookup_extended (requests, key, NULL, &request)) {
+			_geocode_batch_add_to_request (batch, GPOINTER_TO_UINT (request), i);
+			g_free (key);
+			g_free (uri);
+		} else {
+			request = GUINT_TO_POINTER (_geocode_batch_add_request (batch, uri, g_free, i));
+			g_hash_table_insert (requests, key, request);
+		}
 	}
 
-	ret = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
-	_geocode_read_nominatim_attributes (reader, ret);
+	g_mutex_lock (&priv->session_lock);
+	max_running = MIN (priv->max_connections,
+	                   priv->max_connections_per_host *
+	                   _geocode_endpoint_pool_get_n_endpoints (priv->endpoints));
+	g_mutex_unlock (&priv->session_lock);
 
-	g_object_unref (parser);
-	g_object_unref (reader);
+	_geocode_batch_run (batch, self, MAX (max_running, 1),
+	                    cancellable, callback, user_data);
+}
 
-	return ret;
+static GeocodeBatchResults *
+geocode_nominatim_forward_search_batch_finish (GeocodeBackend  *backend,
+                                               GAsyncResult    *result,
+                                               GError         **error)
+{
+	return _geocode_batch_finish (result, error);
 }
 
+/******************************************************************************/
+
 static void
-places_list_free (GList *places)
+copy_item (char       *key,
+           char       *value,
+           GHashTable *ret)
 {
-	g_list_free_full (places, g_object_unref);
+	g_hash_table_insert (ret, key, value);
 }
 
-static void
-on_reverse_query_ready (GeocodeNominatim *self,
-                        GAsyncResult     *res,
-                        GTask            *task)
+GHashTable *
+_geocode_glib_dup_hash_table (GHashTable *ht)
 {
-	GError *error = NULL;
-	char *contents;
-	g_autoptr (GeocodePlace) place = NULL;
-	GHashTable *attributes;
+	GHashTable *ret;
 
-	contents = GEOCODE_NOMINATIM_GET_CLASS (self)->query_finish (GEOCODE_NOMINATIM (self), res, &error);
-	if (contents == NULL) {
-		g_task_return_error (task, error);
-		g_object_unref (task);
-		return;
-	}
+	ret = g_hash_table_new (g_str_hash, g_str_equal);
+	g_hash_table_foreach (ht, (GHFunc) copy_item, ret);
 
-	attributes = resolve_json (contents, &error);
-	g_free (contents);
+	return ret;
+}
 
-	if (attributes == NULL) {
-		g_task_return_error (task, error);
-		g_object_unref (task);
-		return;
-	}
+static gchar *
+get_resolve_uri_for_params (GeocodeNominatim  *self,
+                            GHashTable        *orig_ht,
+                            GError           **error)
+{
+	GHashTable *ht;
+	char *locale;
+	char *params, *uri;
+	GeocodeNominatimPrivate *priv;
+	const GValue *lat, *lon;
+	char lat_str[G_ASCII_DTOSTR_BUF_SIZE];
+	char lon_str[G_ASCII_DTOSTR_BUF_SIZE];
 
-	place = _geocode_create_place_from_attributes (attributes);
-	g_hash_table_unref (attributes);
+	priv = geocode_nominatim_get_instance_private (self);
 
-	g_task_return_pointer (task,
-	                       g_list_prepend (NULL, g_object_ref (place)),
+	/* Make sure we have both lat and lon. */
+	lat = g_hash_table_lookup (orig_ht, "lat");
+	lon = g_hash_table_lookup (orig_ht, "lon");
+
+	if (lat == NULL || lon == NULL) {
+		g_set_error_literal (error, GEOCODE_ERROR, GEOCODE_ERROR_INVALID_ARGUMENTS,
+		                     "Only following parameters supported: lat, lon");
+
+		return NULL;
+	}
+
+	ht = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, NULL);
+
+	g_ascii_dtostr (lat_str, G_ASCII_DTOSTR_BUF_SIZE,
+	                g_value_get_double (lat));
+	g_ascii_dtostr (lon_str, G_ASCII_DTOSTR_BUF_SIZE,
+	                g_value_get_double (lon));
+
+	g_hash_table_insert (ht, (gpointer) "lat", lat_str);
+	g_hash_table_insert (ht, (gpointer) "lon", lon_str);
+
+	g_hash_table_insert (ht, (gpointer) "format", (gpointer) "json");
+	g_hash_table_insert (ht, (gpointer) "email",
+	                     (gpointer) priv->maintainer_email_address);
+	g_hash_table_insert (ht, (gpointer) "addressdetails", (gpointer) "1");
+
+	locale = NULL;
+	if (g_hash_table_lookup (ht, "accept-language") == NULL) {
+		locale = get_language (self);
+		if (locale)
+			g_hash_table_insert (ht, (gpointer) "accept-language", locale);
+	}
+
+	{
+		GHashTableIter iter;
+		gpointer key, value;
+
+		g_hash_table_iter_init (&iter, ht);
+		while (g_hash_table_iter_next (&iter, &key, &value))
+			g_debug ("%s: %s = %s", G_STRFUNC, (const gchar *) key, (const gchar *) value);
+	}
+
+	params = soup_form_encode_hash (ht);
+	g_hash_table_unref (ht);
+	g_free (locale);
+
+	uri = g_strdup_printf ("%s/reverse?%s", priv->base_url, params);
+	g_free (params);
+
+	return uri;
+}
+
+/* Returns a new reference to the shared session, creating it if needed. */
+static SoupSession *
+get_soup_session (GeocodeNominatim *self)
+{
+	GeocodeNominatimPrivate *priv;
+	SoupSession *soup_session;
+
+	priv = geocode_nominatim_get_instance_private (self);
+
+	g_mutex_lock (&priv->session_lock);
+	if (priv->soup_session == NULL) {
+		priv->soup_session = _geocode_glib_build_soup_session (priv->user_agent);
+		g_object_set (G_OBJECT (priv->soup_session),
+		              SOUP_SESSION_MAX_CONNS, priv->max_connections,
+		              SOUP_SESSION_MAX_CONNS_PER_HOST, priv->max_connections_per_host,
+		              SOUP_SESSION_IDLE_TIMEOUT, priv->idle_timeout,
+		              NULL);
+	}
+	soup_session = g_object_ref (priv->soup_session);
+	g_mutex_unlock (&priv->session_lock);
+
+	return soup_session;
+}
+
+/* Applies a connection pool setting to the session, if it exists yet. */
+static void
+update_soup_session (GeocodeNominatim *self,
+                     const char       *property_name,
+                     guint             value)
+{
+	GeocodeNominatimPrivate *priv;
+
+	priv = geocode_nominatim_get_instance_private (self);
+
+	g_mutex_lock (&priv->session_lock);
+	if (priv->soup_session != NULL)
+		g_object_set (G_OBJECT (priv->soup_session),
+		              property_name, value, NULL);
+	g_mutex_unlock (&priv->session_lock);
+}
+
+static gchar *
+geocode_nominatim_query_finish (GeocodeNominatim  *self,
+                                GAsyncResult      *res,
+                                GError           **error)
+{
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/* An HTTP query shared by all the identical asynchronous queries issued while
+ * it is in flight. The query is only cancelled once all the queries waiting on
+ * it have been cancelled.
+ *
+ * Each attempt at the query sends a request to one of the endpoints, and, when
+ * hedging, possibly a duplicate request to another one; the first successful
+ * response wins. Failed attempts may be retried. Requests in flight and the
+ * retry and hedge sources each hold a reference to the query; the reference
+ * it is created with is dropped once its result has been returned, or it has
+ * been withdrawn. */
+typedef struct {
+	gint ref_count;
+	GeocodeNominatim *self;  /* (owned) */
+	char *key;
+	char *uri;  /* for the primary endpoint */
+	SoupSession *session;  /* (owned) */
+	GMainContext *context;  /* (owned); which its requests are queued from */
+	GList *requests;  /* (element-type QueryRequest); in flight */
+	GList *waiters;  /* (element-type QueryWaiter) */
+	GeocodeScheduledRequest *scheduled;  /* (nullable); while rate limited */
+	GSource *retry_source;  /* (owned) (nullable); while waiting to retry */
+	GSource *hedge_source;  /* (owned) (nullable); while waiting to hedge */
+	guint attempt;  /* starting from 1 */
+	guint endpoint;  /* of the first request of the latest attempt */
+	gint priority;  /* of its most urgent waiter, when queued */
+	gboolean parse_search;  /* returns places rather than contents */
+	gboolean completed;
+} InFlightQuery;
+
+/* Parses the search results in a response as it arrives, rather than
+ * buffering the whole of it. */
+typedef struct {
+	SoupMessage *message;  /* (unowned) */
+	GeocodeSearchParser *parser;  /* (owned) */
+	gulong got_chunk_id;
+	GError *error;  /* (owned) (nullable) */
+} ResponseParser;
+
+/* A request sent to an endpoint for an InFlightQuery. The response to a
+ * search is parsed as it arrives, rather than buffered. */
+typedef struct {
+	InFlightQuery *query;  /* (owned) */
+	SoupMessage *message;  /* (owned) */
+	guint endpoint;
+	gint64 start_time;  /* monotonic */
+	ResponseParser *parser;  /* (owned) (nullable) */
+} QueryRequest;
+
+typedef struct {
+	GTask *task;  /* (owned) (nullable) */
+	GCancellable *cancellable;  /* (unowned) (nullable) */
+	gulong cancelled_id;
+	InFlightQuery *query;  /* (nullable) */
+	gboolean cancelled;
+} QueryWaiter;
+
+/* Protects the in-flight queries of all instances, and their waiters. */
+static GMutex in_flight_lock;
+
+static void
+query_waiter_free (QueryWaiter *waiter)
+{
+	g_clear_object (&waiter->task);
+	g_slice_free (QueryWaiter, waiter);
+}
+
+/* Detaches @waiter from its cancellable, which frees it. */
+static void
+query_waiter_release (QueryWaiter *waiter)
+{
+	if (waiter->cancellable != NULL)
+		g_cancellable_disconnect (waiter->cancellable,
+		                          waiter->cancelled_id);
+	else
+		query_waiter_free (waiter);
+}
+
+static InFlightQuery *
+in_flight_query_ref (InFlightQuery *query)
+{
+	g_atomic_int_inc (&query->ref_count);
+	return query;
+}
+
+static void
+in_flight_query_unref (InFlightQuery *query)
+{
+	if (!g_atomic_int_dec_and_test (&query->ref_count))
+		return;
+
+	g_object_unref (query->self);
+	g_free (query->key);
+	g_free (query->uri);
+	g_object_unref (query->session);
+	g_main_context_unref (query->context);
+	g_slice_free (InFlightQuery, query);
+}
+
+/* Failed responses are not parsed. */
+static void
+on_response_got_chunk (SoupMessage    *message,
+                       SoupBuffer     *chunk,
+                       ResponseParser *parser)
+{
+	if (message->status_code != SOUP_STATUS_OK || parser->error != NULL)
+		return;
+
+	_geocode_search_parser_feed (parser->parser, chunk->data,
+	                             chunk->length, &parser->error);
+}
+
+static ResponseParser *
+response_parser_new (SoupMessage *message)
+{
+	ResponseParser *parser;
+
+	parser = g_slice_new0 (ResponseParser);
+	parser->message = message;
+	parser->parser = _geocode_search_parser_new ();
+
+	soup_message_body_set_accumulate (message->response_body, FALSE);
+	parser->got_chunk_id = g_signal_connect (message, "got-chunk",
+	                                         G_CALLBACK (on_response_got_chunk),
+	                                         parser);
+
+	return parser;
+}
+
+/* Returns the places in the whole of a successful response. */
+static GList *
+response_parser_finish (ResponseParser  *parser,
+                        GError         **error)
+{
+	if (parser->error != NULL) {
+		g_propagate_error (error, g_steal_pointer (&parser->error));
+		return NULL;
+	}
+
+	return _geocode_search_parser_finish (parser->parser, error);
+}
+
+static void
+response_parser_free (ResponseParser *parser)
+{
+	g_signal_handler_disconnect (parser->message, parser->got_chunk_id);
+	_geocode_search_parser_free (parser->parser);
+	g_clear_error (&parser->error);
+	g_slice_free (ResponseParser, parser);
+}
+
+static void
+query_request_free (QueryRequest *request)
+{
+	g_clear_pointer (&request->parser, response_parser_free);
+	in_flight_query_unref (request->query);
+	g_object_unref (request->message);
+	g_slice_free (QueryRequest, request);
+}
+
+/* Must be called with @in_flight_lock held. */
+static void
+in_flight_query_unregister (InFlightQuery *query)
+{
+	GeocodeNominatimPrivate *priv;
+
+	priv = geocode_nominatim_get_instance_private (query->self);
+
+	if (g_hash_table_lookup (priv->in_flight_queries, query->key) == query)
+		g_hash_table_remove (priv->in_flight_queries, query->key);
+}
+
+/* Must be called with @in_flight_lock held. Unregisters @query, so that no
+ * more queries join it, and detaches and returns its waiters. */
+static GList *
+in_flight_query_steal_waiters (InFlightQuery *query)
+{
+	GList *waiters, *l;
+
+	in_flight_query_unregister (query);
+	waiters = g_steal_pointer (&query->waiters);
+	for (l = waiters; l != NULL; l = l->next)
+		((QueryWaiter *) l->data)->query = NULL;
+
+	return waiters;
+}
+
+static GList *
+places_list_dup (GList *places)
+{
+	GList *copy = NULL, *l;
+
+	for (l = places; l != NULL; l = l->next)
+		copy = g_list_prepend (copy, _geocode_place_dup (l->data));
+
+	return g_list_reverse (copy);
+}
+
+/* Returns either @contents, @places or @error to each of @waiters, and frees
+ * them. */
+static void
+query_waiters_return (GList                  *waiters,
+                      const char             *contents,
+                      GList                  *places,
+                      const GeocodeCacheInfo *info,
+                      const GError           *error)
+{
+	GList *l;
+
+	for (l = waiters; l != NULL; l = l->next) {
+		QueryWaiter *waiter = l->data;
+		GTask *task = g_steal_pointer (&waiter->task);
+
+		query_waiter_release (waiter);
+
+		/* For get_query_cache_info(). */
+		if (info != NULL)
+			g_task_set_task_data (task, cache_info_copy (info),
+			                      (GDestroyNotify) cache_info_free);
+
+		if (contents != NULL)
+			g_task_return_pointer (task, g_strdup (contents), g_free);
+		else if (places != NULL)
+			g_task_return_pointer (task, places_list_dup (places),
+			                       (GDestroyNotify) places_list_free);
+		else
+			g_task_return_error (task, g_error_copy (error));
+
+		g_object_unref (task);
+	}
+
+	g_list_free (waiters);
+}
+
+/* Must be called with @in_flight_lock held. Returns new references to the
+ * messages of the requests in flight for @query, to be passed to
+ * cancel_messages() once the lock is released. */
+static GList *
+in_flight_query_get_messages (InFlightQuery *query)
+{
+	GList *messages = NULL, *l;
+
+	for (l = query->requests; l != NULL; l = l->next)
+		messages = g_list_prepend (messages,
+		                           g_object_ref (((QueryRequest *) l->data)->message));
+
+	return messages;
+}
+
+static void
+cancel_messages (SoupSession *session,
+                 GList       *messages)
+{
+	GList *l;
+
+	for (l = messages; l != NULL; l = l->next) {
+		soup_session_cancel_message (session, l->data, SOUP_STATUS_CANCELLED);
+		g_object_unref (l->data);
+	}
+
+	g_list_free (messages);
+}
+
+typedef struct {
+	SoupSession *session;  /* (owned) */
+	GList *messages;  /* (owned) (element-type SoupMessage) */
+} CancelMessagesData;
+
+static gboolean
+cancel_messages_cb (CancelMessagesData *data)
+{
+	cancel_messages (data->session, g_steal_pointer (&data->messages));
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+cancel_messages_data_free (CancelMessagesData *data)
+{
+	g_object_unref (data->session);
+	g_slice_free (CancelMessagesData, data);
+}
+
+/* Like cancel_messages(), but in @context, which the messages were queued
+ * from: the session is not thread safe, and cancellables may be cancelled
+ * from other threads, such as the one expiring deadlines. If the calling
+ * thread owns @context, the messages are cancelled straight away. */
+static void
+cancel_messages_in_context (GMainContext *context,
+                            SoupSession  *session,
+                            GList        *messages)
+{
+	CancelMessagesData *data;
+
+	data = g_slice_new0 (CancelMessagesData);
+	data->session = g_object_ref (session);
+	data->messages = messages;
+
+	g_main_context_invoke_full (context, G_PRIORITY_DEFAULT,
+	                            (GSourceFunc) cancel_messages_cb, data,
+	                            (GDestroyNotify) cancel_messages_data_free);
+}
+
+static void
+destroy_source (GSource *source)
+{
+	if (source != NULL) {
+		g_source_destroy (source);
+		g_source_unref (source);
+	}
+}
+
+/* Must be called with @in_flight_lock held. Creates a timeout which calls
+ * @func with a reference to @query, in the thread-default main context. */
+static GSource *
+in_flight_query_add_timeout (InFlightQuery *query,
+                             gint64         delay,
+                             GSourceFunc    func)
+{
+	GSource *source;
+
+	source = g_timeout_source_new (delay / G_TIME_SPAN_MILLISECOND);
+	g_source_set_callback (source, func, in_flight_query_ref (query),
+	                       (GDestroyNotify) in_flight_query_unref);
+	g_source_attach (source, g_main_context_get_thread_default ());
+
+	return source;
+}
+
+static void
+on_query_cancelled (GCancellable *cancellable,
+                    QueryWaiter  *waiter)
+{
+	InFlightQuery *query;
+	InFlightQuery *withdrawn_query = NULL;
+	GTask *task = NULL;
+	SoupSession *session = NULL;
+	GMainContext *context = NULL;
+	GList *messages = NULL;
+	GSource *retry_source = NULL;
+	GSource *hedge_source = NULL;
+
+	g_mutex_lock (&in_flight_lock);
+
+	waiter->cancelled = TRUE;
+	query = waiter->query;
+
+	if (query != NULL) {
+		query->waiters = g_list_remove (query->waiters, waiter);
+		waiter->query = NULL;
+		task = g_steal_pointer (&waiter->task);
+
+		/* Nobody is waiting for the response any more. Requests in
+		 * flight are cancelled, and on_query_data_loaded() then
+		 * completes the query. A query which is still queued by the
+		 * rate limiter, or waiting to be retried, is withdrawn without
+		 * touching the network; one being dispatched is dropped by
+		 * send_scheduled_query(). */
+		if (query->waiters == NULL) {
+			GeocodeNominatimPrivate *priv;
+
+			priv = geocode_nominatim_get_instance_private (query->self);
+			in_flight_query_unregister (query);
+
+			if (query->requests != NULL) {
+				session = g_object_ref (query->session);
+				context = g_main_context_ref (query->context);
+				messages = in_flight_query_get_messages (query);
+				hedge_source = g_steal_pointer (&query->hedge_source);
+			} else if (query->retry_source != NULL) {
+				retry_source = g_steal_pointer (&query->retry_source);
+				query->completed = TRUE;
+				withdrawn_query = query;
+			} else if (_geocode_request_scheduler_cancel (priv->scheduler,
+			                                              query->scheduled)) {
+				query->completed = TRUE;
+				withdrawn_query = query;
+			}
+		}
+	}
+
+	g_mutex_unlock (&in_flight_lock);
+
+	if (task != NULL) {
+		g_task_return_error_if_cancelled (task);
+		g_object_unref (task);
+	}
+
+	if (session != NULL) {
+		cancel_messages_in_context (context, session, messages);
+		g_main_context_unref (context);
+		g_object_unref (session);
+	}
+
+	destroy_source (hedge_source);
+	destroy_source (retry_source);
+
+	if (withdrawn_query != NULL)
+		in_flight_query_unref (withdrawn_query);
+}
+
+/* Returns @uri, built for the primary endpoint, for sending to @endpoint. */
+static char *
+get_uri_for_endpoint (GeocodeNominatim *self,
+                      const char       *uri,
+                      guint             endpoint)
+{
+	GeocodeNominatimPrivate *priv;
+
+	priv = geocode_nominatim_get_instance_private (self);
+
+	if (endpoint == 0 || !g_str_has_prefix (uri, priv->base_url))
+		return g_strdup (uri);
+
+	return g_strconcat (_geocode_endpoint_pool_get_base_url (priv->endpoints, endpoint),
+	                    uri + strlen (priv->base_url),
+	                    NULL);
+}
+
+/* What the response in @message says about the health of the endpoint which
+ * sent it. */
+static GeocodeEndpointResult
+get_endpoint_result (SoupMessage *message)
+{
+	if (message->status_code == SOUP_STATUS_CANCELLED)
+		return GEOCODE_ENDPOINT_CANCELLED;
+
+	if (SOUP_STATUS_IS_TRANSPORT_ERROR (message->status_code) ||
+	    SOUP_STATUS_IS_SERVER_ERROR (message->status_code) ||
+	    message->status_code == 429 /* Too Many Requests */)
+		return GEOCODE_ENDPOINT_FAILURE;
+
+	return GEOCODE_ENDPOINT_SUCCESS;
+}
+
+/* Whether a request which got the response in @message may be retried: only
+ * idempotent requests may be, and only after errors which may be transient. */
+static gboolean
+is_retryable (SoupMessage *message)
+{
+	if (message->method != SOUP_METHOD_GET &&
+	    message->method != SOUP_METHOD_HEAD)
+		return FALSE;
+
+	switch (message->status_code) {
+	case SOUP_STATUS_CANT_CONNECT:
+	case SOUP_STATUS_IO_ERROR:
+	case SOUP_STATUS_REQUEST_TIMEOUT:
+	case 429: /* Too Many Requests */
+	case SOUP_STATUS_BAD_GATEWAY:
+	case SOUP_STATUS_SERVICE_UNAVAILABLE:
+	case SOUP_STATUS_GATEWAY_TIMEOUT:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/* Works out whether to retry a request which failed with the response in
+ * @message, as attempt number @attempt at its query, and if so, the delay
+ * before retrying in microseconds. */
+static gboolean
+get_retry_delay (GeocodeNominatim *self,
+                 SoupMessage      *message,
+                 guint             attempt,
+                 gint64           *delay)
+{
+	GeocodeNominatimPrivate *priv;
+	const char *retry_after;
+	guint seconds, jitter;
+	gint64 backoff;
+
+	priv = geocode_nominatim_get_instance_private (self);
+
+	if (attempt >= g_atomic_int_get (&priv->max_query_attempts) ||
+	    !is_retryable (message))
+		return FALSE;
+
+	/* The server knows best when it will be able to answer. If that is
+	 * too far off, give up rather than hold the query up. */
+	retry_after = soup_message_headers_get_one (message->response_headers,
+	                                            "Retry-After");
+	if (retry_after != NULL &&
+	    _geocode_glib_parse_retry_after (retry_after,
+	                                     g_get_real_time () / G_USEC_PER_SEC,
+	                                     &seconds)) {
+		if (seconds > MAX_RETRY_DELAY)
+			return FALSE;
+
+		*delay = (gint64) seconds * G_USEC_PER_SEC;
+		return TRUE;
+	}
+
+	/* Otherwise back off exponentially, with some randomness so that
+	 * clients which failed together do not all retry together. */
+	backoff = (gint64) g_atomic_int_get (&priv->retry_delay) * G_TIME_SPAN_MILLISECOND;
+	backoff = MIN (backoff << MIN (attempt - 1, 20),
+	               MAX_RETRY_DELAY * G_USEC_PER_SEC);
+	jitter = g_atomic_int_get (&priv->retry_jitter);
+
+	*delay = backoff - (gint64) (backoff * jitter / 100.0 * g_random_double ());
+	return TRUE;
+}
+
+static void on_query_data_loaded (SoupSession  *session,
+                                  SoupMessage  *message,
+                                  QueryRequest *request);
+
+/* Must be called with @in_flight_lock held, so that the request cannot be
+ * cancelled before it is queued. The callback is never called from within
+ * this function. */
+static void
+send_request (InFlightQuery *query,
+              guint          endpoint)
+{
+	QueryRequest *request;
+	g_autofree char *uri = NULL;
+
+	uri = get_uri_for_endpoint (query->self, query->uri, endpoint);
+
+	request = g_slice_new0 (QueryRequest);
+	request->query = in_flight_query_ref (query);
+	request->message = soup_message_new (SOUP_METHOD_GET, uri);
+	request->endpoint = endpoint;
+	request->start_time = g_get_monotonic_time ();
+
+	if (query->parse_search)
+		request->parser = response_parser_new (request->message);
+
+	query->requests = g_list_prepend (query->requests, request);
+
+	soup_session_queue_message (query->session,
+	                            g_object_ref (request->message),
+	                            (SoupSessionCallback) on_query_data_loaded,
+	                            request);
+}
+
+static gboolean
+on_query_hedge_timeout (InFlightQuery *query)
+{
+	GeocodeNominatimPrivate *priv;
+	guint endpoint;
+
+	priv = geocode_nominatim_get_instance_private (query->self);
+
+	g_mutex_lock (&in_flight_lock);
+
+	/* Withdrawn as it was being dispatched. */
+	if (query->hedge_source != g_main_current_source ()) {
+		g_mutex_unlock (&in_flight_lock);
+		return G_SOURCE_REMOVE;
+	}
+
+	g_clear_pointer (&query->hedge_source, g_source_unref);
+
+	/* A hedged request is only worth sending straight away, and to a
+	 * healthy endpoint. */
+	if (query->requests != NULL && query->waiters != NULL &&
+	    _geocode_endpoint_pool_choose_alternative (priv->endpoints,
+	                                               query->endpoint,
+	                                               &endpoint)) {
+		if (_geocode_request_scheduler_try_acquire (priv->scheduler)) {
+			g_debug ("Hedging query '%s' to %s", query->key,
+			         _geocode_endpoint_pool_get_base_url (priv->endpoints,
+			                                              endpoint));
+			send_request (query, endpoint);
+		} else {
+			_geocode_endpoint_pool_report (priv->endpoints, endpoint,
+			                               GEOCODE_ENDPOINT_CANCELLED, 0);
+		}
+	}
+
+	g_mutex_unlock (&in_flight_lock);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Must be called with @in_flight_lock held, so that the request cannot be
+ * cancelled before it is queued. Makes an attempt at @query. */
+static void
+send_query (InFlightQuery *query)
+{
+	GeocodeNominatimPrivate *priv;
+
+	priv = geocode_nominatim_get_instance_private (query->self);
+
+	/* Retries go elsewhere than the endpoint which failed, if possible. */
+	query->endpoint = _geocode_endpoint_pool_choose (priv->endpoints,
+	                                                 (query->attempt > 1) ? (gint) query->endpoint : -1);
+	send_request (query, query->endpoint);
+
+	if (g_atomic_int_get (&priv->hedge_requests) &&
+	    _geocode_endpoint_pool_get_n_endpoints (priv->endpoints) > 1) {
+		gint64 delay;
+
+		delay = _geocode_endpoint_pool_get_hedge_delay (priv->endpoints,
+		                                                query->endpoint);
+		query->hedge_source = in_flight_query_add_timeout (query, delay,
+		                                                   (GSourceFunc) on_query_hedge_timeout);
+	}
+}
+
+/* Sends a query once the rate limiter allows it. */
+static void
+send_scheduled_query (InFlightQuery *query)
+{
+	g_mutex_lock (&in_flight_lock);
+
+	query->scheduled = NULL;
+
+	/* All the queries waiting for it were cancelled while it was being
+	 * dispatched. */
+	if (query->waiters == NULL) {
+		query->completed = TRUE;
+		g_mutex_unlock (&in_flight_lock);
+		in_flight_query_unref (query);
+		return;
+	}
+
+	send_query (query);
+
+	g_mutex_unlock (&in_flight_lock);
+}
+
+static gboolean
+on_query_retry_timeout (InFlightQuery *query)
+{
+	GeocodeNominatimPrivate *priv;
+	GList *waiters;
+	GError *error = NULL;
+
+	priv = geocode_nominatim_get_instance_private (query->self);
+
+	g_mutex_lock (&in_flight_lock);
+
+	/* Withdrawn by on_query_cancelled() as it was being dispatched. */
+	if (query->retry_source != g_main_current_source ()) {
+		g_mutex_unlock (&in_flight_lock);
+		return G_SOURCE_REMOVE;
+	}
+
+	g_clear_pointer (&query->retry_source, g_source_unref);
+	query->attempt++;
+
+	/* Retries are rate limited like any other request. */
+	if (_geocode_request_scheduler_submit (priv->scheduler,
+	                                       query->priority,
+	                                       (GeocodeRequestFunc) send_scheduled_query,
+	                                       query,
+	                                       &query->scheduled,
+	                                       &error)) {
+		if (query->scheduled == NULL)
+			send_query (query);
+
+		g_mutex_unlock (&in_flight_lock);
+		return G_SOURCE_REMOVE;
+	}
+
+	query->completed = TRUE;
+	waiters = in_flight_query_steal_waiters (query);
+
+	g_mutex_unlock (&in_flight_lock);
+
+	query_waiters_return (waiters, NULL, NULL, NULL, error);
+	g_error_free (error);
+	in_flight_query_unref (query);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+on_query_data_loaded (SoupSession  *session,
+                      SoupMessage  *message,
+                      QueryRequest *request)
+{
+	InFlightQuery *query = request->query;
+	GeocodeNominatimPrivate *priv;
+	GList *waiters, *losers;
+	GSource *hedge_source;
+	char *contents = NULL;
+	GList *places = NULL;  /* (element-type GeocodePlace) */
+	GeocodeCacheInfo info = { NULL, };
+	GError *error = NULL;
+	gint64 delay;
+
+	priv = geocode_nominatim_get_instance_private (query->self);
+
+	_geocode_endpoint_pool_report (priv->endpoints, request->endpoint,
+	                               get_endpoint_result (message),
+	                               g_get_monotonic_time () - request->start_time);
+
+	if (message->status_code != SOUP_STATUS_OK &&
+	    message->status_code != SOUP_STATUS_CANCELLED)
+		g_atomic_int_inc (&priv->n_failed_attempts);
+
+	g_mutex_lock (&in_flight_lock);
+
+	query->requests = g_list_remove (query->requests, request);
+
+	/* The loser of a hedged query. */
+	if (query->completed) {
+		g_mutex_unlock (&in_flight_lock);
+		query_request_free (request);
+		return;
+	}
+
+	if (message->status_code != SOUP_STATUS_OK) {
+		/* Another request for the query may still succeed. */
+		if (query->requests != NULL) {
+			g_mutex_unlock (&in_flight_lock);
+			query_request_free (request);
+			return;
+		}
+
+		if (query->waiters != NULL &&
+		    get_retry_delay (query->self, message, query->attempt, &delay)) {
+			g_debug ("Retrying query '%s' in %" G_GINT64_FORMAT " ms (attempt %u failed with status %u)",
+			         query->key, delay / G_TIME_SPAN_MILLISECOND,
+			         query->attempt, message->status_code);
+
+			g_atomic_int_inc (&priv->n_retries);
+			hedge_source = g_steal_pointer (&query->hedge_source);
+			query->retry_source = in_flight_query_add_timeout (query, delay,
+			                                                   (GSourceFunc) on_query_retry_timeout);
+
+			g_mutex_unlock (&in_flight_lock);
+
+			destroy_source (hedge_source);
+			query_request_free (request);
+			return;
+		}
+	}
+
+	/* This response is the result of the query. Any other requests for it
+	 * are cancelled. */
+	query->completed = TRUE;
+	waiters = in_flight_query_steal_waiters (query);
+	losers = in_flight_query_get_messages (query);
+	hedge_source = g_steal_pointer (&query->hedge_source);
+
+	g_mutex_unlock (&in_flight_lock);
+
+	destroy_source (hedge_source);
+	cancel_messages (query->session, losers);
+
+	if (message->status_code != SOUP_STATUS_OK)
+		error = g_error_new_literal (G_IO_ERROR,
+		                             G_IO_ERROR_FAILED,
+		                             message->reason_phrase ? message->reason_phrase : "Query failed");
+	else if (request->parser != NULL)
+		places = response_parser_finish (request->parser, &error);
+	else
+		contents = g_strndup (message->response_body->data,
+		                      message->response_body->length);
+
+	if (error == NULL)
+		cache_info_init_from_message (&info, message);
+
+	query_waiters_return (waiters, contents, places, &info, error);
+
+	_geocode_cache_info_clear (&info);
+	g_free (contents);
+	places_list_free (places);
+	g_clear_error (&error);
+	in_flight_query_unref (query);
+	query_request_free (request);
+}
+
+/* Joins the query in flight for @uri, or starts it. @key is the canonical key
+ * of @uri, or %NULL to compute it. If @parse_search is set, the response is
+ * parsed as search results as it arrives, and the task returns a list of
+ * places rather than the contents. If the request is rate limited, it is
+ * queued with @priority; joining a queued query with a more urgent @priority
+ * moves it up the queue. */
+static void
+start_query (GeocodeNominatim    *self,
+             const gchar         *uri,
+             const char          *key,
+             gboolean             parse_search,
+             gint                 priority,
+             GCancellable        *cancellable,
+             GAsyncReadyCallback  callback,
+             gpointer             user_data)
+{
+	GeocodeNominatimPrivate *priv;
+	GTask *task;
+	SoupURI *soup_uri;
+	QueryWaiter *waiter;
+	InFlightQuery *query;
+	char *query_key;
+	GError *error = NULL;
+
+	priv = geocode_nominatim_get_instance_private (self);
+
+	task = g_task_new (self, cancellable, callback, user_data);
+	if (parse_search)
+		g_task_set_source_tag (task, start_query);
+	else
+		g_task_set_source_tag (task, geocode_nominatim_query_async);
+
+	waiter = g_slice_new0 (QueryWaiter);
+	waiter->task = task;
+
+	/* Connected before the waiter is attached to a query, as the handler
+	 * is called straight away if @cancellable is already cancelled. */
+	if (cancellable != NULL) {
+		waiter->cancellable = cancellable;
+		waiter->cancelled_id = g_cancellable_connect (cancellable,
+		                                              G_CALLBACK (on_query_cancelled),
+		                                              waiter,
+		                                              (GDestroyNotify) query_waiter_free);
+	}
+
+	if (key != NULL) {
+		query_key = g_strdup (key);
+	} else {
+		soup_uri = soup_uri_new (uri);
+		query_key = _geocode_glib_cache_key_for_uri (soup_uri);
+		soup_uri_free (soup_uri);
+	}
+
+	/* Queries returning places are only joined by queries which do too. */
+	if (parse_search) {
+		char *places_key = g_strconcat ("places:", query_key, NULL);
+
+		g_free (query_key);
+		query_key = places_key;
+	}
+
+	g_mutex_lock (&in_flight_lock);
+
+	if (waiter->cancelled) {
+		g_mutex_unlock (&in_flight_lock);
+
+		g_task_return_error_if_cancelled (task);
+		query_waiter_release (waiter);
+		g_free (query_key);
+		return;
+	}
+
+	query = g_hash_table_lookup (priv->in_flight_queries, query_key);
+	if (query != NULL) {
+		g_debug ("Joining in-flight query '%s'", query_key);
+		g_free (query_key);
+
+		if (priority < query->priority) {
+			query->priority = priority;
+			if (query->scheduled != NULL)
+				_geocode_request_scheduler_raise_priority (priv->scheduler,
+				                                           query->scheduled,
+				                                           priority);
+		}
+	} else {
+		query = g_slice_new0 (InFlightQuery);
+		query->ref_count = 1;
+		query->self = g_object_ref (self);
+		query->key = query_key;
+		query->uri = g_strdup (uri);
+		query->session = get_soup_session (self);
+		query->context = g_main_context_ref_thread_default ();
+		query->attempt = 1;
+		query->priority = priority;
+		query->parse_search = parse_search;
+
+		if (!_geocode_request_scheduler_submit (priv->scheduler,
+		                                        priority,
+		                                        (GeocodeRequestFunc) send_scheduled_query,
+		                                        query,
+		                                        &query->scheduled,
+		                                        &error)) {
+			g_mutex_unlock (&in_flight_lock);
+
+			task = g_steal_pointer (&waiter->task);
+			query_waiter_release (waiter);
+			g_task_return_error (task, error);
+			g_object_unref (task);
+			in_flight_query_unref (query);
+			return;
+		}
+
+		g_hash_table_insert (priv->in_flight_queries, query->key, query);
+
+		if (query->scheduled == NULL)
+			send_query (query);
+	}
+
+	query->waiters = g_list_prepend (query->waiters, waiter);
+	waiter->query = query;
+
+	g_mutex_unlock (&in_flight_lock);
+}
+
+static void
+geocode_nominatim_query_async (GeocodeNominatim    *self,
+                               const gchar         *uri,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+	g_debug ("%s: uri = %s", G_STRFUNC, uri);
+
+	start_query (self, uri, NULL, FALSE, G_PRIORITY_DEFAULT, cancellable,
+	             callback, user_data);
+}
+
+typedef struct {
+	SoupSession *session;
+	SoupMessage *message;
+} SyncRequest;
+
+static void
+on_sync_request_cancelled (GCancellable *cancellable,
+                           SyncRequest  *request)
+{
+	/* Safe from another thread for messages sent synchronously. */
+	soup_session_cancel_message (request->session, request->message,
+	                             SOUP_STATUS_CANCELLED);
+}
+
+/* Sends @message synchronously, cancelling it if @cancellable is cancelled
+ * while it is in flight. Returns %FALSE, without sending it, if @cancellable
+ * was already cancelled. */
+static gboolean
+send_message_sync (SoupSession   *session,
+                   SoupMessage   *message,
+                   GCancellable  *cancellable,
+                   GError       **error)
+{
+	SyncRequest request = { session, message };
+	gulong cancelled_id = 0;
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+
+	if (cancellable != NULL)
+		cancelled_id = g_cancellable_connect (cancellable,
+		                                      G_CALLBACK (on_sync_request_cancelled),
+		                                      &request, NULL);
+
+	soup_session_send_message (session, message);
+
+	g_cancellable_disconnect (cancellable, cancelled_id);
+
+	return TRUE;
+}
+
+typedef struct {
+	GMutex lock;
+	GCond cond;
+	gboolean cancelled;
+} RetryWait;
+
+static void
+on_retry_wait_cancelled (GCancellable *cancellable,
+                         RetryWait    *wait)
+{
+	g_mutex_lock (&wait->lock);
+	wait->cancelled = TRUE;
+	g_cond_broadcast (&wait->cond);
+	g_mutex_unlock (&wait->lock);
+}
+
+/* Blocks for @delay microseconds before a synchronous query is retried, unless
+ * @cancellable is cancelled first. */
+static gboolean
+wait_for_retry (gint64         delay,
+                GCancellable  *cancellable,
+                GError       **error)
+{
+	RetryWait wait = { 0, };
+	gint64 end_time;
+	gulong cancelled_id = 0;
+
+	g_mutex_init (&wait.lock);
+	g_cond_init (&wait.cond);
+
+	end_time = g_get_monotonic_time () + delay;
+
+	if (cancellable != NULL)
+		cancelled_id = g_cancellable_connect (cancellable,
+		                                      G_CALLBACK (on_retry_wait_cancelled),
+		                                      &wait, NULL);
+
+	g_mutex_lock (&wait.lock);
+	while (!wait.cancelled &&
+	       g_cond_wait_until (&wait.cond, &wait.lock, end_time));
+	g_mutex_unlock (&wait.lock);
+
+	if (cancellable != NULL)
+		g_cancellable_disconnect (cancellable, cancelled_id);
+
+	g_cond_clear (&wait.cond);
+	g_mutex_clear (&wait.lock);
+
+	return !g_cancellable_set_error_if_cancelled (cancellable, error);
+}
+
+/* Makes a query synchronously, retrying it if needed. The response is either
+ * returned in @contents, or, if @places is non-%NULL, parsed as search results
+ * as it arrives and returned in @places. Its validators are returned in @info,
+ * if non-%NULL. */
+static gboolean
+run_query (GeocodeNominatim  *self,
+           const gchar       *uri,
+           GCancellable      *cancellable,
+           char             **contents,
+           GList            **places,
+           GeocodeCacheInfo  *info,
+           GError           **error)
+{
+	GeocodeNominatimPrivate *priv;
+	SoupSession *soup_session;
+	SoupMessage *soup_query = NULL;
+	ResponseParser *parser = NULL;
+	gboolean ret = FALSE;
+	guint attempt, endpoint = 0;
+
+	priv = geocode_nominatim_get_instance_private (self);
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+
+	soup_session = get_soup_session (self);
+
+	for (attempt = 1; ; attempt++) {
+		g_autofree char *endpoint_uri = NULL;
+		gint64 start_time, delay;
+
+		if (!_geocode_request_scheduler_acquire (priv->scheduler, cancellable, error))
+			break;
+
+		/* Retries go elsewhere than the endpoint which failed, if
+		 * possible. */
+		endpoint = _geocode_endpoint_pool_choose (priv->endpoints,
+		                                          (attempt > 1) ? (gint) endpoint : -1);
+		endpoint_uri = get_uri_for_endpoint (self, uri, endpoint);
+		soup_query = soup_message_new (SOUP_METHOD_GET, endpoint_uri);
+		if (places != NULL)
+			parser = response_parser_new (soup_query);
+
+		start_time = g_get_monotonic_time ();
+		if (!send_message_sync (soup_session, soup_query, cancellable, error))
+			break;
+		_geocode_endpoint_pool_report (priv->endpoints, endpoint,
+		                               get_endpoint_result (soup_query),
+		                               g_get_monotonic_time () - start_time);
+
+		if (soup_query->status_code == SOUP_STATUS_CANCELLED) {
+			if (!g_cancellable_set_error_if_cancelled (cancellable, error))
+				g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+				                     "Query was cancelled");
+			break;
+		}
+
+		if (soup_query->status_code == SOUP_STATUS_OK) {
+			if (parser != NULL) {
+				*places = response_parser_finish (parser, error);
+				ret = (*places != NULL);
+			} else {
+				*contents = g_strndup (soup_query->response_body->data, soup_query->response_body->length);
+				ret = TRUE;
+			}
+
+			if (ret && info != NULL)
+				cache_info_init_from_message (info, soup_query);
+			break;
+		}
+
+		g_atomic_int_inc (&priv->n_failed_attempts);
+
+		if (!get_retry_delay (self, soup_query, attempt, &delay)) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			                     soup_query->reason_phrase ? soup_query->reason_phrase : "Query failed");
+			break;
+		}
+
+		g_debug ("Retrying query '%s' in %" G_GINT64_FORMAT " ms (attempt %u failed with status %u)",
+		         uri, delay / G_TIME_SPAN_MILLISECOND,
+		         attempt, soup_query->status_code);
+
+		g_atomic_int_inc (&priv->n_retries);
+		g_clear_pointer (&parser, response_parser_free);
+		g_clear_object (&soup_query);
+
+		if (!wait_for_retry (delay, cancellable, error))
+			break;
+	}
+
+	g_clear_pointer (&parser, response_parser_free);
+	g_clear_object (&soup_query);
+	g_object_unref (soup_session);
+
+	return ret;
+}
+
+static gchar *
+geocode_nominatim_query (GeocodeNominatim  *self,
+                         const gchar       *uri,
+                         GCancellable      *cancellable,
+                         GError           **error)
+{
+	char *contents = NULL;
+
+	g_debug ("%s: uri = %s", G_STRFUNC, uri);
+
+	run_query (self, uri, cancellable, &contents, NULL, NULL, error);
+
+	return contents;
+}
+
+/******************************************************************************/
+
+static GList *
+geocode_nominatim_reverse_resolve_finish (GeocodeBackend  *backend,
+                                          GAsyncResult    *res,
+                                          GError         **error)
+{
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/* Parses the response to a reverse geocoding query. */
+static GeocodePlace *
+resolve_json (const char  *contents,
+              GError     **error)
+{
+	GeocodeNominatimResult *result;
+	GeocodePlace *place = NULL;
+
+	g_debug ("%s: contents = %s", G_STRFUNC, contents);
+
+	result = _geocode_nominatim_result_new ();
+
+	if (!_geocode_nominatim_result_decode (result, contents, strlen (contents), error)) {
+		/* Nothing to do. */
+	} else if (_geocode_nominatim_result_has_error (result)) {
+		const char *msg;
+
+		msg = _geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_ERROR);
+		g_set_error_literal (error,
+		                     GEOCODE_ERROR,
+		                     GEOCODE_ERROR_NOT_SUPPORTED,
+		                     msg ? msg : "Query not supported");
+	} else {
+		place = create_place_from_result (result);
+	}
+
+	_geocode_nominatim_result_free (result);
+
+	return place;
+}
+
+/* Parses a response to a query of the given @type into a list of places. */
+static GList *
+parse_places (GeocodeLookupType   type,
+              const char         *contents,
+              GError            **error)
+{
+	GeocodePlace *place;
+
+	if (type == GEOCODE_GLIB_RESOLVE_FORWARD)
+		return _geocode_parse_search_json (contents, error);
+
+	place = resolve_json (contents, error);
+	if (place == NULL)
+		return NULL;
+
+	return g_list_prepend (NULL, place);
+}
+
+/* A background refresh of a stale entry in the on-disk cache. */
+typedef struct {
+	GeocodeNominatim *self;  /* (owned) */
+	char *key;
+	char *uri;
+	GeocodeLookupType type;
+	GBytes *value;  /* (owned); the stale value, kept if it is still valid */
+	GeocodeCacheInfo info;  /* validators of the stale value */
+	guint endpoint;  /* once sent */
+	gint64 start_time;
+} CacheRefresh;
+
+static void
+cache_refresh_free (CacheRefresh *refresh)
+{
+	GeocodeNominatimPrivate *priv;
+
+	priv = geocode_nominatim_get_instance_private (refresh->self);
+
+	g_mutex_lock (&in_flight_lock);
+	g_hash_table_remove (priv->refreshing_keys, refresh->key);
+	g_mutex_unlock (&in_flight_lock);
+
+	g_object_unref (refresh->self);
+	g_free (refresh->key);
+	g_free (refresh->uri);
+	g_bytes_unref (refresh->value);
+	_geocode_cache_info_clear (&refresh->info);
+	g_slice_free (CacheRefresh, refresh);
+}
+
+static void
+cache_refresh_complete (CacheRefresh           *refresh,
+                        const char             *contents,
+                        const GeocodeCacheInfo *info)
+{
+	GList *places;  /* (element-type GeocodePlace) */
+	GError *error = NULL;
+
+	places = parse_places (refresh->type, contents, &error);
+
+	if (places == NULL) {
+		g_debug ("Failed to refresh cache entry '%s': %s",
+		         refresh->key, error->message);
+		cache_negative_result (refresh->self, refresh->key, error);
+		g_error_free (error);
+		return;
+	}
+
+	cache_places (refresh->self, refresh->key, places, info);
+	places_list_free (places);
+}
+
+static void
+on_refresh_query_ready (GeocodeNominatim *self,
+                        GAsyncResult     *res,
+                        CacheRefresh     *refresh)
+{
+	char *contents;
+	GError *error = NULL;
+
+	contents = GEOCODE_NOMINATIM_GET_CLASS (self)->query_finish (self, res, &error);
+
+	if (contents != NULL) {
+		cache_refresh_complete (refresh, contents, get_query_cache_info (res));
+		g_free (contents);
+	} else {
+		g_debug ("Failed to refresh cache entry '%s': %s",
+		         refresh->key, error->message);
+		g_error_free (error);
+	}
+
+	cache_refresh_free (refresh);
+}
+
+static void
+on_refresh_message_done (SoupSession  *session,
+                         SoupMessage  *message,
+                         CacheRefresh *refresh)
+{
+	GeocodeNominatimPrivate *priv;
+	GeocodeCacheInfo info = { NULL, };
+
+	priv = geocode_nominatim_get_instance_private (refresh->self);
+	_geocode_endpoint_pool_report (priv->endpoints, refresh->endpoint,
+	                               get_endpoint_result (message),
+	                               g_get_monotonic_time () - refresh->start_time);
+
+	cache_info_init_from_message (&info, message);
+
+	if (message->status_code == SOUP_STATUS_NOT_MODIFIED) {
+		g_debug ("Cache entry '%s' is still valid", refresh->key);
+
+		/* A 304 response need not repeat the validators. */
+		if (info.etag == NULL)
+			info.etag = g_strdup (refresh->info.etag);
+		if (info.last_modified == NULL)
+			info.last_modified = g_strdup (refresh->info.last_modified);
+
+		save_cached_value (refresh->self, refresh->key, refresh->value,
+		                   &info);
+	} else if (message->status_code == SOUP_STATUS_OK) {
+		g_autofree char *contents = NULL;
+
+		contents = g_strndup (message->response_body->data,
+		                      message->response_body->length);
+		cache_refresh_complete (refresh, contents, &info);
+	} else {
+		g_debug ("Failed to refresh cache entry '%s': %s",
+		         refresh->key, message->reason_phrase);
+	}
+
+	_geocode_cache_info_clear (&info);
+	cache_refresh_free (refresh);
+}
+
+/* Sends a conditional request for the results being refreshed, once the rate
+ * limiter allows it. */
+static void
+send_refresh (CacheRefresh *refresh)
+{
+	GeocodeNominatimPrivate *priv;
+	SoupSession *session;
+	SoupMessage *message;
+	g_autofree char *uri = NULL;
+
+	priv = geocode_nominatim_get_instance_private (refresh->self);
+
+	refresh->endpoint = _geocode_endpoint_pool_choose (priv->endpoints, -1);
+	refresh->start_time = g_get_monotonic_time ();
+	uri = get_uri_for_endpoint (refresh->self, refresh->uri, refresh->endpoint);
+
+	message = soup_message_new (SOUP_METHOD_GET, uri);
+	if (refresh->info.etag != NULL)
+		soup_message_headers_append (message->request_headers,
+		                             "If-None-Match", refresh->info.etag);
+	if (refresh->info.last_modified != NULL)
+		soup_message_headers_append (message->request_headers,
+		                             "If-Modified-Since", refresh->info.last_modified);
+
+	session = get_soup_session (refresh->self);
+	soup_session_queue_message (session, message,
+	                            (SoupSessionCallback) on_refresh_message_done,
+	                            refresh);
+	g_object_unref (session);
+}
+
+static gpointer
+run_refresh_context (gpointer data)
+{
+	GMainContext *context = data;
+
+	g_main_context_push_thread_default (context);
+
+	while (TRUE)
+		g_main_context_iteration (context, TRUE);
+
+	return NULL;
+}
+
+/* The main context which refreshes for synchronous queries are made from. It
+ * is serviced by a thread of its own, as the callers' thread-default contexts
+ * may never be iterated. */
+static GMainContext *
+get_refresh_context (void)
+{
+	static gsize initialized = 0;
+	static GMainContext *context = NULL;
+
+	if (g_once_init_enter (&initialized)) {
+		context = g_main_context_new ();
+		g_thread_unref (g_thread_new ("geocode-refresh",
+		                              run_refresh_context, context));
+		g_once_init_leave (&initialized, 1);
+	}
+
+	return context;
+}
+
+static gboolean
+start_refresh (CacheRefresh *refresh)
+{
+	GeocodeNominatim *self = refresh->self;
+	GeocodeNominatimPrivate *priv;
+	GeocodeScheduledRequest *scheduled;
+	GError *error = NULL;
+
+	priv = geocode_nominatim_get_instance_private (self);
+
+	/* Conditional requests need access to the HTTP headers, which the
+	 * query vfuncs do not give, so subclasses which override them get a
+	 * plain query. */
+	if (GEOCODE_NOMINATIM_GET_CLASS (self)->query_async != geocode_nominatim_query_async) {
+		GEOCODE_NOMINATIM_GET_CLASS (self)->query_async (self, refresh->uri, NULL,
+		                                                 (GAsyncReadyCallback) on_refresh_query_ready,
+		                                                 refresh);
+		return G_SOURCE_REMOVE;
+	}
+
+	/* Refreshes are not urgent, so queries go first. */
+	if (!_geocode_request_scheduler_submit (priv->scheduler, G_PRIORITY_LOW,
+	                                        (GeocodeRequestFunc) send_refresh,
+	                                        refresh, &scheduled, &error)) {
+		g_debug ("Failed to refresh cache entry '%s': %s",
+		         refresh->key, error->message);
+		g_error_free (error);
+		cache_refresh_free (refresh);
+		return G_SOURCE_REMOVE;
+	}
+
+	if (scheduled == NULL)
+		send_refresh (refresh);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Refreshes the stale results cached for @key in the background, unless they
+ * are already being refreshed. The request is conditional on the validators
+ * in @info, so that the server need not send the results again if they have
+ * not changed; in that case, @value is saved again as it is. If @synchronous
+ * is set, the refresh is made from a private main context rather than the
+ * thread-default one. */
+static void
+refresh_cached_places (GeocodeNominatim       *self,
+                       const char             *key,
+                       const char             *uri,
+                       GeocodeLookupType       type,
+                       gboolean                synchronous,
+                       GBytes                 *value,
+                       const GeocodeCacheInfo *info)
+{
+	GeocodeNominatimPrivate *priv;
+	CacheRefresh *refresh;
+	gboolean refreshing;
+
+	priv = geocode_nominatim_get_instance_private (self);
+
+	g_mutex_lock (&in_flight_lock);
+	refreshing = g_hash_table_contains (priv->refreshing_keys, key);
+	if (!refreshing)
+		g_hash_table_add (priv->refreshing_keys, g_strdup (key));
+	g_mutex_unlock (&in_flight_lock);
+
+	if (refreshing)
+		return;
+
+	g_debug ("Refreshing stale cache entry '%s'", key);
+
+	refresh = g_slice_new0 (CacheRefresh);
+	refresh->self = g_object_ref (self);
+	refresh->key = g_strdup (key);
+	refresh->uri = g_strdup (uri);
+	refresh->type = type;
+	refresh->value = g_bytes_ref (value);
+	refresh->info.etag = g_strdup (info->etag);
+	refresh->info.last_modified = g_strdup (info->last_modified);
+
+	if (synchronous)
+		g_main_context_invoke (get_refresh_context (),
+		                       (GSourceFunc) start_refresh, refresh);
+	else
+		start_refresh (refresh);
+}
+
+typedef struct {
+	char *key;  /* (nullable) */
+	gdouble latitude;
+	gdouble longitude;
+} ReverseQueryData;
+
+static void
+reverse_query_data_free (ReverseQueryData *data)
+{
+	g_free (data->key);
+	g_slice_free (ReverseQueryData, data);
+}
+
+static void
+on_reverse_query_ready (GeocodeNominatim *self,
+                        GAsyncResult     *res,
+                        GTask            *task)
+{
+	ReverseQueryData *data = g_task_get_task_data (task);
+	GError *error = NULL;
+	char *contents;
+	g_autoptr (GeocodePlace) place = NULL;
+	GList *places;  /* (element-type GeocodePlace) */
+
+	contents = GEOCODE_NOMINATIM_GET_CLASS (self)->query_finish (GEOCODE_NOMINATIM (self), res, &error);
+	if (contents == NULL) {
+		g_task_return_error (task, error);
+		g_object_unref (task);
+		return;
+	}
+
+	place = resolve_json (contents, &error);
+	g_free (contents);
+
+	if (place == NULL) {
+		cache_negative_result (self, data->key, error);
+		g_task_return_error (task, error);
+		g_object_unref (task);
+		return;
+	}
+
+	places = g_list_prepend (NULL, g_object_ref (place));
+
+	cache_places (self, data->key, places, get_query_cache_info (res));
+	cache_nearby_places (self, data->latitude, data->longitude, places);
+
+	g_task_return_pointer (task, places,
 	                       (GDestroyNotify) places_list_free);
 	g_object_unref (task);
 }
@@ -1231,6 +3068,8 @@ geocode_nominatim_reverse_resolve_async (GeocodeBackend      *self,
 {
 	GTask *task;
 	gchar *uri = NULL;
+	ReverseQueryData *data;
+	GList *places = NULL;  /* (element-type GeocodePlace) */
 	GError *error = NULL;
 
 	g_return_if_fail (GEOCODE_IS_BACKEND (self));
@@ -1244,87 +3083,701 @@ geocode_nominatim_reverse_resolve_async (GeocodeBackend      *self,
 		return;
 	}
 
-	task = g_task_new (self, cancellable, callback, user_data);
-	GEOCODE_NOMINATIM_GET_CLASS (self)->query_async (GEOCODE_NOMINATIM (self),
-	                                                 uri,
-	                                                 cancellable,
-	                                                 (GAsyncReadyCallback) on_reverse_query_ready,
-	                                                 g_object_ref (task));
-	g_object_unref (task);
-	g_free (uri);
+	task = g_task_new (self, cancellable, callback, user_data);
+
+	data = g_slice_new0 (ReverseQueryData);
+	data->key = get_cache_key (GEOCODE_NOMINATIM (self), uri, NULL);
+	data->latitude = g_value_get_double (g_hash_table_lookup (params, "lat"));
+	data->longitude = g_value_get_double (g_hash_table_lookup (params, "lon"));
+	g_task_set_task_data (task, data,
+	                      (GDestroyNotify) reverse_query_data_free);
+
+	if (lookup_cached_places (GEOCODE_NOMINATIM (self), data->key, uri,
+	                          GEOCODE_GLIB_RESOLVE_REVERSE, FALSE,
+	                          &places, &error) ||
+	    lookup_nearby_places (GEOCODE_NOMINATIM (self),
+	                          data->latitude, data->longitude, &places)) {
+		if (error != NULL)
+			g_task_return_error (task, error);
+		else
+			g_task_return_pointer (task, places,
+			                       (GDestroyNotify) places_list_free);
+		g_object_unref (task);
+		g_free (uri);
+		return;
+	}
+
+	GEOCODE_NOMINATIM_GET_CLASS (self)->query_async (GEOCODE_NOMINATIM (self),
+	                                                 uri,
+	                                                 cancellable,
+	                                                 (GAsyncReadyCallback) on_reverse_query_ready,
+	                                                 g_object_ref (task));
+	g_object_unref (task);
+	g_free (uri);
+}
+
+static GList *
+geocode_nominatim_reverse_resolve (GeocodeBackend  *self,
+                                   GHashTable      *params,
+                                   GCancellable    *cancellable,
+                                   GError         **error)
+{
+	char *contents = NULL;
+	g_autoptr (GeocodePlace) place = NULL;
+	gchar *uri = NULL;
+	g_autofree gchar *key = NULL;
+	gdouble latitude, longitude;
+	GList *places = NULL;  /* (element-type GeocodePlace) */
+	GeocodeCacheInfo info = { NULL, };
+	GError *local_error = NULL;
+
+	g_return_val_if_fail (GEOCODE_IS_BACKEND (self), NULL);
+	g_return_val_if_fail (params != NULL, NULL);
+
+	uri = get_resolve_uri_for_params (GEOCODE_NOMINATIM (self), params,
+	                                  error);
+
+	if (uri == NULL)
+		return NULL;
+
+	latitude = g_value_get_double (g_hash_table_lookup (params, "lat"));
+	longitude = g_value_get_double (g_hash_table_lookup (params, "lon"));
+
+	key = get_cache_key (GEOCODE_NOMINATIM (self), uri, NULL);
+	if (lookup_cached_places (GEOCODE_NOMINATIM (self), key, uri,
+	                          GEOCODE_GLIB_RESOLVE_REVERSE, TRUE,
+	                          &places, error) ||
+	    lookup_nearby_places (GEOCODE_NOMINATIM (self),
+	                          latitude, longitude, &places)) {
+		g_free (uri);
+		return places;
+	}
+
+	/* The validators of the response are only known if the query vfunc
+	 * is not overridden. */
+	if (GEOCODE_NOMINATIM_GET_CLASS (self)->query == geocode_nominatim_query)
+		run_query (GEOCODE_NOMINATIM (self), uri, cancellable, &contents,
+		           NULL, &info, error);
+	else
+		contents = GEOCODE_NOMINATIM_GET_CLASS (self)->query (GEOCODE_NOMINATIM (self),
+		                                                      uri,
+		                                                      cancellable,
+		                                                      error);
+	g_free (uri);
+
+	if (contents == NULL)
+		return NULL;
+
+	place = resolve_json (contents, &local_error);
+	g_free (contents);
+
+	if (place == NULL) {
+		cache_negative_result (GEOCODE_NOMINATIM (self), key, local_error);
+		g_propagate_error (error, local_error);
+		_geocode_cache_info_clear (&info);
+		return NULL;
+	}
+
+	places = g_list_prepend (NULL, g_object_ref (place));
+
+	cache_places (GEOCODE_NOMINATIM (self), key, places, &info);
+	_geocode_cache_info_clear (&info);
+	cache_nearby_places (GEOCODE_NOMINATIM (self), latitude, longitude,
+	                     places);
+
+	return places;
+}
+
+/******************************************************************************/
+
+G_LOCK_DEFINE_STATIC (backend_nominatim_gnome_lock);
+static GWeakRef backend_nominatim_gnome;
+
+/**
+ * geocode_nominatim_get_gnome:
+ *
+ * Gets a reference to the default Nominatim server on nominatim.gnome.org.
+ *
+ * This function is thread-safe.
+ *
+ * Returns: (transfer full): a new #GeocodeNominatim. Use g_object_unref() when done.
+ *
+ * Since: 3.23.1
+ */
+GeocodeNominatim *
+geocode_nominatim_get_gnome (void)
+{
+	GeocodeNominatim *backend;
+
+	G_LOCK (backend_nominatim_gnome_lock);
+	backend = g_weak_ref_get (&backend_nominatim_gnome);
+	if (backend == NULL) {
+		backend = geocode_nominatim_new ("https://nominatim.gnome.org",
+		                                 "zeeshanak@gnome.org");
+		g_weak_ref_set (&backend_nominatim_gnome, backend);
+	}
+	G_UNLOCK (backend_nominatim_gnome_lock);
+
+	return backend;
+}
+
+/**
+ * geocode_nominatim_set_memory_cache_size:
+ * @size: maximum size of the in-memory result cache, in bytes
+ *
+ * Sets the approximate maximum number of bytes of memory used by the
+ * in-memory result cache. Least recently used results are evicted to stay
+ * within this limit; 0 empties the cache. The default is 1 MiB.
+ *
+ * The cache is shared by all the #GeocodeNominatim instances in the process,
+ * so this applies to all of them. See #GeocodeNominatim:memory-cache-enabled.
+ *
+ * Since: 3.27.1
+ */
+void
+geocode_nominatim_set_memory_cache_size (gsize size)
+{
+	_geocode_memory_cache_set_capacity (size);
+}
+
+/**
+ * geocode_nominatim_get_memory_cache_size:
+ *
+ * Gets the maximum size of the in-memory result cache. See
+ * geocode_nominatim_set_memory_cache_size().
+ *
+ * Returns: the maximum size of the cache, in bytes
+ * Since: 3.27.1
+ */
+gsize
+geocode_nominatim_get_memory_cache_size (void)
+{
+	return _geocode_memory_cache_get_capacity ();
+}
+
+/**
+ * geocode_nominatim_set_cache_limits:
+ * @max_size: approximate maximum size of the on-disk cache, in bytes
+ * @max_entries: maximum number of responses in the on-disk cache
+ *
+ * Sets the limits which the on-disk cache of responses is kept within. When
+ * the cache grows past either, least recently used responses are evicted in
+ * the background. The defaults are 64 MiB and 100000 responses. See also
+ * geocode_nominatim_trim_cache().
+ *
+ * The on-disk cache is shared by all the #GeocodeNominatim instances in the
+ * process, so this applies to all of them.
+ *
+ * Since: 3.27.1
+ */
+void
+geocode_nominatim_set_cache_limits (guint64 max_size,
+                                    guint   max_entries)
+{
+	_geocode_glib_cache_set_limits (max_size, max_entries);
+}
+
+/**
+ * geocode_nominatim_get_cache_limits:
+ * @max_size: (out) (optional): return location for the maximum size of the
+ *    on-disk cache, in bytes
+ * @max_entries: (out) (optional): return location for the maximum number of
+ *    responses in the on-disk cache
+ *
+ * Gets the limits which the on-disk cache is kept within. See
+ * geocode_nominatim_set_cache_limits().
+ *
+ * Since: 3.27.1
+ */
+void
+geocode_nominatim_get_cache_limits (guint64 *max_size,
+                                    guint   *max_entries)
+{
+	_geocode_glib_cache_get_limits (max_size, max_entries);
+}
+
+/**
+ * geocode_nominatim_set_cache_compression:
+ * @compression: whether to compress responses saved in the on-disk cache
+ *
+ * Sets whether responses saved in the on-disk cache are compressed, using the
+ * fastest codec the library was built with. This trades a little CPU time on
+ * each cache hit for a much smaller cache. Changing this does not affect
+ * responses which are already cached. The default is %TRUE.
+ *
+ * The on-disk cache is shared by all the #GeocodeNominatim instances in the
+ * process, so this applies to all of them.
+ *
+ * Since: 3.27.1
+ */
+void
+geocode_nominatim_set_cache_compression (gboolean compression)
+{
+	_geocode_glib_cache_set_compression (compression);
+}
+
+/**
+ * geocode_nominatim_get_cache_compression:
+ *
+ * Gets whether responses saved in the on-disk cache are compressed. See
+ * geocode_nominatim_set_cache_compression().
+ *
+ * Returns: %TRUE if cached responses are compressed, %FALSE otherwise
+ * Since: 3.27.1
+ */
+gboolean
+geocode_nominatim_get_cache_compression (void)
+{
+	return _geocode_glib_cache_get_compression ();
+}
+
+/**
+ * geocode_nominatim_trim_cache:
+ * @error: return location for a #GError, or %NULL
+ *
+ * Synchronously trims the on-disk cache of Nominatim responses: expired
+ * responses are removed, least recently used ones are removed until the
+ * cache is within the limits set with geocode_nominatim_set_cache_limits(),
+ * and the space they used is released. The on-disk cache is shared by all
+ * the #GeocodeNominatim instances in the process.
+ *
+ * The cache is trimmed in the background as needed anyway; this is useful to
+ * release disk space at a known time. It may block for a while on large
+ * caches, so should not be called from the main thread.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 3.27.1
+ */
+gboolean
+geocode_nominatim_trim_cache (GError **error)
+{
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	return _geocode_glib_cache_trim (error);
+}
+
+/**
+ * geocode_nominatim_get_retry_stats:
+ * @self: a #GeocodeNominatim
+ * @n_failed_attempts: (out) (optional): return location for the number of
+ *    requests which failed
+ * @n_retries: (out) (optional): return location for the number of failed
+ *    requests which were retried
+ *
+ * Gets counters of the requests to the Nominatim server which have failed
+ * since @self was created, for monitoring. Cancelled requests are not counted.
+ * The number of queries which failed, rather than being retried, is
+ * @n_failed_attempts minus @n_retries.
+ *
+ * Only requests made by the default #GeocodeNominatimClass.query and
+ * #GeocodeNominatimClass.query_async implementations are counted.
+ *
+ * Since: 3.27.1
+ */
+void
+geocode_nominatim_get_retry_stats (GeocodeNominatim *self,
+                                   guint            *n_failed_attempts,
+                                   guint            *n_retries)
+{
+	GeocodeNominatimPrivate *priv;
+
+	g_return_if_fail (GEOCODE_IS_NOMINATIM (self));
+
+	priv = geocode_nominatim_get_instance_private (self);
+
+	if (n_failed_attempts != NULL)
+		*n_failed_attempts = g_atomic_int_get (&priv->n_failed_attempts);
+	if (n_retries != NULL)
+		*n_retries = g_atomic_int_get (&priv->n_retries);
+}
+
+struct _GeocodePreparedSearch {
+	gint ref_count;
+	GeocodeNominatim *backend;  /* (owned) */
+
+	/* The query URI up to its search terms, as `BASE/search?PARAMS&`. */
+	char *uri_prefix;
+
+	/* The canonical key of its queries, before and after their search
+	 * terms; see _geocode_glib_cache_key_split_for_uri(). */
+	char *key_prefix;
+	char *key_suffix;
+
+	gint priority;  /* atomic */
+};
+
+G_DEFINE_BOXED_TYPE (GeocodePreparedSearch, geocode_prepared_search,
+                     geocode_prepared_search_ref,
+                     geocode_prepared_search_unref)
+
+/* The parameters of a Nominatim search, other than its terms, which may be
+ * fixed in a prepared one; see
+ * https://nominatim.org/release-docs/develop/api/Search/ */
+static gboolean
+is_valid_search_parameter (const char *name,
+                           const char *value)
+{
+	char *end;
+	guint i;
+
+	if (g_str_equal (name, "limit")) {
+		guint64 limit = g_ascii_strtoull (value, &end, 10);
+
+		return (end != value && *end == '\0' && limit > 0 && limit <= G_MAXUINT);
+	} else if (g_str_equal (name, "bounded")) {
+		return (g_str_equal (value, "0") || g_str_equal (value, "1"));
+	} else if (g_str_equal (name, "viewbox")) {
+		/* Four coordinates, separated by commas. */
+		for (i = 0; i < 4; i++) {
+			g_ascii_strtod (value, &end);
+			if (end == value || *end != ((i < 3) ? ',' : '\0'))
+				return FALSE;
+			value = end + 1;
+		}
+
+		return TRUE;
+	} else if (g_str_equal (name, "countrycodes")) {
+		for (; *value != '\0'; value++) {
+			if (!g_ascii_isalpha (*value) && *value != ',')
+				return FALSE;
+		}
+
+		return TRUE;
+	} else if (g_str_equal (name, "accept-language")) {
+		return (*value != '\0');
+	}
+
+	return FALSE;
+}
+
+/**
+ * geocode_nominatim_prepare_search:
+ * @self: a #GeocodeNominatim
+ * @params: (element-type utf8 utf8) (nullable): the fixed parameters of the
+ *    query
+ * @error: return location for a #GError, or %NULL
+ *
+ * Prepares a forward search query which only varies in its search terms, for
+ * making it many times with geocode_nominatim_search_prepared(). The fixed
+ * parameters of the query are checked and encoded once, here, rather than
+ * for each search.
+ *
+ * @params maps the names of
+ * [Nominatim search parameters](https://nominatim.org/release-docs/develop/api/Search/)
+ * to their values; those supported are `limit`, `bounded`, `viewbox`,
+ * `countrycodes` and `accept-language`. If not given, up to 10 results are
+ * returned, not bounded to the `viewbox`, in the language given by
+ * #GeocodeNominatim:language as it is when the query is prepared.
+ *
+ * Returns: (transfer full): the prepared query, or %NULL if @params are
+ *    invalid, in which case @error is set to
+ *    %GEOCODE_ERROR_INVALID_ARGUMENTS
+ *
+ * Since: 3.27.1
+ */
+GeocodePreparedSearch *
+geocode_nominatim_prepare_search (GeocodeNominatim  *self,
+                                  GHashTable        *params,
+                                  GError           **error)
+{
+	GeocodeNominatimPrivate *priv;
+	GeocodePreparedSearch *search;
+	g_autoptr (GHashTable) ht = NULL;
+	g_autofree char *language = NULL;
+	g_autofree char *encoded_params = NULL;
+	g_autofree char *empty_uri = NULL;
+	SoupURI *soup_uri;
+
+	g_return_val_if_fail (GEOCODE_IS_NOMINATIM (self), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	priv = geocode_nominatim_get_instance_private (self);
+
+	ht = g_hash_table_new (g_str_hash, g_str_equal);
+
+	if (params != NULL) {
+		GHashTableIter iter;
+		const char *name, *value;
+
+		g_hash_table_iter_init (&iter, params);
+		while (g_hash_table_iter_next (&iter, (gpointer *) &name, (gpointer *) &value)) {
+			if (!g_utf8_validate (value, -1, NULL) ||
+			    !is_valid_search_parameter (name, value)) {
+				g_set_error (error, GEOCODE_ERROR, GEOCODE_ERROR_INVALID_ARGUMENTS,
+				             "Invalid search parameter: %s", name);
+				return NULL;
+			}
+
+			g_hash_table_insert (ht, (gpointer) name, (gpointer) value);
+		}
+	}
+
+	g_hash_table_insert (ht, (gpointer) "format", (gpointer) "jsonv2");
+	g_hash_table_insert (ht, (gpointer) "email", (gpointer) priv->maintainer_email_address);
+	g_hash_table_insert (ht, (gpointer) "addressdetails", (gpointer) "1");
+
+	if (!g_hash_table_contains (ht, "limit"))
+		g_hash_table_insert (ht, (gpointer) "limit",
+		                     (gpointer) G_STRINGIFY (DEFAULT_ANSWER_COUNT));
+	if (!g_hash_table_contains (ht, "bounded"))
+		g_hash_table_insert (ht, (gpointer) "bounded", (gpointer) "0");
+
+	if (!g_hash_table_contains (ht, "accept-language")) {
+		language = get_language (self);
+		if (language != NULL)
+			g_hash_table_insert (ht, (gpointer) "accept-language", language);
+	}
+
+	encoded_params = soup_form_encode_hash (ht);
+
+	search = g_slice_new0 (GeocodePreparedSearch);
+	search->ref_count = 1;
+	search->backend = g_object_ref (self);
+	search->uri_prefix = g_strdup_printf ("%s/search?%s&", priv->base_url,
+	                                      encoded_params);
+	search->priority = G_PRIORITY_DEFAULT;
+
+	/* So that the key of each search is found without parsing its URI. */
+	empty_uri = g_strconcat (search->uri_prefix, "q=", NULL);
+	soup_uri = soup_uri_new (empty_uri);
+	if (soup_uri != NULL) {
+		search->key_prefix = _geocode_glib_cache_key_split_for_uri (soup_uri,
+		                                                            &search->key_suffix);
+		soup_uri_free (soup_uri);
+	}
+
+	return search;
+}
+
+/**
+ * geocode_prepared_search_ref:
+ * @search: a #GeocodePreparedSearch
+ *
+ * Returns: (transfer full): @search
+ *
+ * Since: 3.27.1
+ */
+GeocodePreparedSearch *
+geocode_prepared_search_ref (GeocodePreparedSearch *search)
+{
+	g_return_val_if_fail (search != NULL, NULL);
+
+	g_atomic_int_inc (&search->ref_count);
+
+	return search;
+}
+
+/**
+ * geocode_prepared_search_unref:
+ * @search: (transfer full): a #GeocodePreparedSearch
+ *
+ * Releases a reference to @search, freeing it if it was the last.
+ *
+ * Since: 3.27.1
+ */
+void
+geocode_prepared_search_unref (GeocodePreparedSearch *search)
+{
+	g_return_if_fail (search != NULL);
+
+	if (!g_atomic_int_dec_and_test (&search->ref_count))
+		return;
+
+	g_object_unref (search->backend);
+	g_free (search->uri_prefix);
+	g_free (search->key_prefix);
+	g_free (search->key_suffix);
+	g_slice_free (GeocodePreparedSearch, search);
+}
+
+/**
+ * geocode_prepared_search_set_priority:
+ * @search: a #GeocodePreparedSearch
+ * @priority: the priority of searches made with @search, as for #GSource
+ *    priorities
+ *
+ * Sets the priority of asynchronous searches made with @search, which
+ * orders them among the other queries of its #GeocodeNominatim waiting to be
+ * sent because of its #GeocodeNominatim:rate-limit. Queries with a lower
+ * value are sent first, and queries with the same priority in the order they
+ * were made. The default is %G_PRIORITY_DEFAULT, as for all other queries;
+ * background cache refreshes are made at %G_PRIORITY_LOW.
+ *
+ * Searches which are already queued are not affected. A search which joins
+ * an identical query in flight moves it up the queue, if it is more urgent.
+ *
+ * Since: 3.27.1
+ */
+void
+geocode_prepared_search_set_priority (GeocodePreparedSearch *search,
+                                      gint                   priority)
+{
+	g_return_if_fail (search != NULL);
+
+	g_atomic_int_set (&search->priority, priority);
+}
+
+/**
+ * geocode_prepared_search_get_priority:
+ * @search: a #GeocodePreparedSearch
+ *
+ * Gets the priority of asynchronous searches made with @search. See
+ * geocode_prepared_search_set_priority().
+ *
+ * Returns: the priority of searches made with @search
+ *
+ * Since: 3.27.1
+ */
+gint
+geocode_prepared_search_get_priority (GeocodePreparedSearch *search)
+{
+	g_return_val_if_fail (search != NULL, G_PRIORITY_DEFAULT);
+
+	return g_atomic_int_get (&search->priority);
+}
+
+/* Returns the URI of @search for @text, and its canonical key in @key, or
+ * %NULL if @text is invalid. */
+static char *
+get_prepared_search_uri (GeocodePreparedSearch  *search,
+                         const char             *text,
+                         char                  **key,
+                         GError                **error)
+{
+	g_autofree char *encoded_text = NULL;
+	g_autofree char *key_text = NULL;
+
+	if (*text == '\0' || !g_utf8_validate (text, -1, NULL)) {
+		g_set_error_literal (error, GEOCODE_ERROR, GEOCODE_ERROR_INVALID_ARGUMENTS,
+		                     "The search terms must be non-empty UTF-8");
+		return NULL;
+	}
+
+	encoded_text = soup_form_encode ("q", text, NULL);
+
+	/* Left to be computed from the URI if the base URL cannot be parsed. */
+	if (search->key_prefix != NULL) {
+		key_text = _geocode_glib_cache_key_encode_free_text (text);
+		*key = g_strconcat (search->key_prefix, key_text,
+		                    search->key_suffix, NULL);
+	} else {
+		*key = NULL;
+	}
+
+	return g_strconcat (search->uri_prefix, encoded_text, NULL);
 }
 
-static GList *
-geocode_nominatim_reverse_resolve (GeocodeBackend  *self,
-                                   GHashTable      *params,
-                                   GCancellable    *cancellable,
-                                   GError         **error)
+/**
+ * geocode_nominatim_search_prepared:
+ * @self: a #GeocodeNominatim
+ * @search: a query prepared by geocode_nominatim_prepare_search() on @self
+ * @text: the search terms
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Searches for places matching @text, with the parameters of @search. The
+ * results are the same as those of a #GeocodeForward search for @text with
+ * those parameters, and are cached in the same way.
+ *
+ * Returns: (element-type GeocodePlace) (transfer full): the places found, or
+ *    %NULL on error
+ *
+ * Since: 3.27.1
+ */
+GList *
+geocode_nominatim_search_prepared (GeocodeNominatim       *self,
+                                   GeocodePreparedSearch  *search,
+                                   const char             *text,
+                                   GCancellable           *cancellable,
+                                   GError                **error)
 {
-	char *contents;
-	GHashTable *result = NULL;
-	g_autoptr (GeocodePlace) place = NULL;
-	gchar *uri = NULL;
-
-	g_return_val_if_fail (GEOCODE_IS_BACKEND (self), NULL);
-	g_return_val_if_fail (params != NULL, NULL);
+	g_autofree char *uri = NULL;
+	g_autofree char *key = NULL;
 
-	uri = get_resolve_uri_for_params (GEOCODE_NOMINATIM (self), params,
-	                                  error);
+	g_return_val_if_fail (GEOCODE_IS_NOMINATIM (self), NULL);
+	g_return_val_if_fail (search != NULL && search->backend == self, NULL);
+	g_return_val_if_fail (text != NULL, NULL);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
+	uri = get_prepared_search_uri (search, text, &key, error);
 	if (uri == NULL)
 		return NULL;
 
-	contents = GEOCODE_NOMINATIM_GET_CLASS (self)->query (GEOCODE_NOMINATIM (self),
-	                                                      uri,
-	                                                      cancellable,
-	                                                      error);
-	if (contents != NULL) {
-		result = resolve_json (contents, error);
-		g_free (contents);
-	}
+	return search_for_uri (self, uri, key, cancellable, error);
+}
 
-	g_free (uri);
+/**
+ * geocode_nominatim_search_prepared_async:
+ * @self: a #GeocodeNominatim
+ * @search: a query prepared by geocode_nominatim_prepare_search() on @self
+ * @text: the search terms
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the search is complete
+ * @user_data: the data to pass to @callback
+ *
+ * Asynchronously searches for places matching @text, with the parameters of
+ * @search. See geocode_nominatim_search_prepared() for the synchronous
+ * version.
+ *
+ * When the search is complete, @callback will be called. You can then call
+ * geocode_nominatim_search_prepared_finish() to get the result of the
+ * operation.
+ *
+ * Since: 3.27.1
+ */
+void
+geocode_nominatim_search_prepared_async (GeocodeNominatim       *self,
+                                         GeocodePreparedSearch  *search,
+                                         const char             *text,
+                                         GCancellable           *cancellable,
+                                         GAsyncReadyCallback     callback,
+                                         gpointer                user_data)
+{
+	g_autofree char *uri = NULL;
+	g_autofree char *key = NULL;
+	GError *error = NULL;
 
-	if (result == NULL)
-		return NULL;
+	g_return_if_fail (GEOCODE_IS_NOMINATIM (self));
+	g_return_if_fail (search != NULL && search->backend == self);
+	g_return_if_fail (text != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
 
-	place = _geocode_create_place_from_attributes (result);
-	g_hash_table_unref (result);
+	uri = get_prepared_search_uri (search, text, &key, &error);
+	if (uri == NULL) {
+		g_task_report_error (self, callback, user_data,
+		                     geocode_nominatim_search_prepared_async, error);
+		return;
+	}
 
-	return g_list_prepend (NULL, g_object_ref (place));
+	search_for_uri_with_priority_async (self, uri, key,
+	                                    g_atomic_int_get (&search->priority),
+	                                    cancellable, callback, user_data);
 }
 
-/******************************************************************************/
-
-G_LOCK_DEFINE_STATIC (backend_nominatim_gnome_lock);
-static GWeakRef backend_nominatim_gnome;
-
 /**
- * geocode_nominatim_get_gnome:
- *
- * Gets a reference to the default Nominatim server on nominatim.gnome.org.
+ * geocode_nominatim_search_prepared_finish:
+ * @self: a #GeocodeNominatim
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError, or %NULL
  *
- * This function is thread-safe.
+ * Finishes a search started with geocode_nominatim_search_prepared_async().
  *
- * Returns: (transfer full): a new #GeocodeNominatim. Use g_object_unref() when done.
+ * Returns: (element-type GeocodePlace) (transfer full): the places found, or
+ *    %NULL on error
  *
- * Since: 3.23.1
+ * Since: 3.27.1
  */
-GeocodeNominatim *
-geocode_nominatim_get_gnome (void)
+GList *
+geocode_nominatim_search_prepared_finish (GeocodeNominatim  *self,
+                                          GAsyncResult      *result,
+                                          GError           **error)
 {
-	GeocodeNominatim *backend;
-
-	G_LOCK (backend_nominatim_gnome_lock);
-	backend = g_weak_ref_get (&backend_nominatim_gnome);
-	if (backend == NULL) {
-		backend = geocode_nominatim_new ("https://nominatim.gnome.org",
-		                                 "zeeshanak@gnome.org");
-		g_weak_ref_set (&backend_nominatim_gnome, backend);
-	}
-	G_UNLOCK (backend_nominatim_gnome_lock);
+	g_return_val_if_fail (GEOCODE_IS_NOMINATIM (self), NULL);
+	g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-	return backend;
+	return g_task_propagate_pointer (G_TASK (result), error);
 }
 
 /******************************************************************************/
@@ -1358,21 +3811,63 @@ geocode_nominatim_new (const char *base_url,
 static void
 geocode_nominatim_init (GeocodeNominatim *object)
 {
+	GeocodeNominatimPrivate *priv;
+
+	priv = geocode_nominatim_get_instance_private (object);
+
+	g_mutex_init (&priv->session_lock);
+	g_mutex_init (&priv->language_lock);
+	priv->max_connections = DEFAULT_MAX_CONNECTIONS;
+	priv->max_connections_per_host = DEFAULT_MAX_CONNECTIONS_PER_HOST;
+	priv->idle_timeout = DEFAULT_IDLE_TIMEOUT;
+	priv->scheduler = _geocode_request_scheduler_new ();
+	priv->max_query_attempts = DEFAULT_MAX_QUERY_ATTEMPTS;
+	priv->retry_delay = DEFAULT_RETRY_DELAY;
+	priv->retry_jitter = DEFAULT_RETRY_JITTER;
+	priv->memory_cache_enabled = TRUE;
+	priv->cache_enabled = TRUE;
+	priv->cache_ttl = GEOCODE_CACHE_DEFAULT_TTL;
+	priv->negative_cache_ttl = GEOCODE_NEGATIVE_CACHE_DEFAULT_TTL;
+	priv->reverse_cache_ttl = GEOCODE_REVERSE_CACHE_DEFAULT_TTL;
+	priv->in_flight_queries = g_hash_table_new (g_str_hash, g_str_equal);
+	priv->refreshing_keys = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                               g_free, NULL);
 }
 
 static void
 geocode_nominatim_constructed (GObject *object)
 {
 	GeocodeNominatimPrivate *priv;
+	GPtrArray *endpoints;
+	guint i;
 
 	/* Chain up. */
 	G_OBJECT_CLASS (geocode_nominatim_parent_class)->constructed (object);
 
 	priv = geocode_nominatim_get_instance_private (GEOCODE_NOMINATIM (object));
 
+	/* Without a base URL, the first of the base URLs is the primary
+	 * endpoint. */
+	if (priv->base_url == NULL && priv->base_urls != NULL)
+		priv->base_url = g_strdup (priv->base_urls[0]);
+
 	/* Ensure our mandatory construction properties have been passed. */
 	g_assert (priv->base_url != NULL);
 	g_assert (priv->maintainer_email_address != NULL);
+
+	endpoints = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (endpoints, g_strdup (priv->base_url));
+
+	for (i = 0; priv->base_urls != NULL && priv->base_urls[i] != NULL; i++) {
+		if (!g_str_equal (priv->base_urls[i], priv->base_url))
+			g_ptr_array_add (endpoints, g_strdup (priv->base_urls[i]));
+	}
+
+	g_ptr_array_add (endpoints, NULL);
+
+	g_strfreev (priv->base_urls);
+	priv->base_urls = (char **) g_ptr_array_free (endpoints, FALSE);
+	priv->endpoints = _geocode_endpoint_pool_new ((const char * const *) priv->base_urls);
 }
 
 static void
@@ -1389,12 +3884,82 @@ geocode_nominatim_get_property (GObject    *object,
 	case PROP_BASE_URL:
 		g_value_set_string (value, priv->base_url);
 		break;
+	case PROP_BASE_URLS:
+		g_value_set_boxed (value, priv->base_urls);
+		break;
+	case PROP_HEDGE_REQUESTS:
+		g_value_set_boolean (value, g_atomic_int_get (&priv->hedge_requests));
+		break;
+	case PROP_LANGUAGE:
+		g_mutex_lock (&priv->language_lock);
+		g_value_set_string (value, priv->language);
+		g_mutex_unlock (&priv->language_lock);
+		break;
 	case PROP_MAINTAINER_EMAIL_ADDRESS:
 		g_value_set_string (value, priv->maintainer_email_address);
 		break;
 	case PROP_USER_AGENT:
 		g_value_set_string (value, priv->user_agent);
 		break;
+	case PROP_MAX_CONNECTIONS:
+		g_value_set_uint (value, priv->max_connections);
+		break;
+	case PROP_MAX_CONNECTIONS_PER_HOST:
+		g_value_set_uint (value, priv->max_connections_per_host);
+		break;
+	case PROP_IDLE_TIMEOUT:
+		g_value_set_uint (value, priv->idle_timeout);
+		break;
+	case PROP_MEMORY_CACHE_ENABLED:
+		g_value_set_boolean (value,
+		                     g_atomic_int_get (&priv->memory_cache_enabled));
+		break;
+	case PROP_CACHE_TTL:
+		g_value_set_uint (value, g_atomic_int_get (&priv->cache_ttl));
+		break;
+	case PROP_NEGATIVE_CACHE_TTL:
+		g_value_set_uint (value, g_atomic_int_get (&priv->negative_cache_ttl));
+		break;
+	case PROP_CACHE_ENABLED:
+		g_value_set_boolean (value,
+		                     g_atomic_int_get (&priv->cache_enabled));
+		break;
+	case PROP_REVERSE_CACHE_RADIUS:
+		g_value_set_uint (value, g_atomic_int_get (&priv->reverse_cache_radius));
+		break;
+	case PROP_REVERSE_CACHE_TTL:
+		g_value_set_uint (value, g_atomic_int_get (&priv->reverse_cache_ttl));
+		break;
+	case PROP_STALE_WHILE_REVALIDATE:
+		g_value_set_uint (value, g_atomic_int_get (&priv->stale_while_revalidate));
+		break;
+	case PROP_RATE_LIMIT: {
+		gdouble rate;
+
+		_geocode_request_scheduler_get_rate (priv->scheduler, &rate, NULL);
+		g_value_set_double (value, rate);
+		break;
+	}
+	case PROP_RATE_LIMIT_BURST: {
+		guint burst;
+
+		_geocode_request_scheduler_get_rate (priv->scheduler, NULL, &burst);
+		g_value_set_uint (value, burst);
+		break;
+	}
+	case PROP_MAX_QUEUED_QUERIES:
+		g_value_set_uint (value,
+		                  _geocode_request_scheduler_get_max_queued (priv->scheduler));
+		break;
+	case PROP_MAX_QUERY_ATTEMPTS:
+		g_value_set_uint (value, g_atomic_int_get (&priv->max_query_attempts));
+		break;
+	case PROP_RETRY_DELAY:
+		g_value_set_uint (value, g_atomic_int_get (&priv->retry_delay));
+		break;
+	case PROP_RETRY_JITTER:
+		g_value_set_uint (value, g_atomic_int_get (&priv->retry_jitter));
+		break;
 	default:
 		/* We don't have any other property... */
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -1418,6 +3983,32 @@ geocode_nominatim_set_property (GObject      *object,
 		g_assert (priv->base_url == NULL);
 		priv->base_url = g_value_dup_string (value);
 		break;
+	case PROP_BASE_URLS:
+		/* Construct only. */
+		g_assert (priv->base_urls == NULL);
+		priv->base_urls = g_value_dup_boxed (value);
+		break;
+	case PROP_HEDGE_REQUESTS:
+		if (g_atomic_int_get (&priv->hedge_requests) != g_value_get_boolean (value)) {
+			g_atomic_int_set (&priv->hedge_requests, g_value_get_boolean (value));
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_LANGUAGE: {
+		gboolean changed;
+
+		g_mutex_lock (&priv->language_lock);
+		changed = (g_strcmp0 (priv->language, g_value_get_string (value)) != 0);
+		if (changed) {
+			g_free (priv->language);
+			priv->language = g_value_dup_string (value);
+		}
+		g_mutex_unlock (&priv->language_lock);
+
+		if (changed)
+			g_object_notify_by_pspec (object, pspec);
+		break;
+	}
 	case PROP_MAINTAINER_EMAIL_ADDRESS:
 		/* Construct only. */
 		g_assert (priv->maintainer_email_address == NULL);
@@ -1425,12 +4016,135 @@ geocode_nominatim_set_property (GObject      *object,
 		break;
 	case PROP_USER_AGENT:
 		if (g_strcmp0 (priv->user_agent, g_value_get_string (value)) != 0) {
+			/* The user agent is baked into the session; drop it so
+			 * the next query builds a new one. Queued messages keep
+			 * the old session alive until they complete. */
+			g_mutex_lock (&priv->session_lock);
 			g_free (priv->user_agent);
 			priv->user_agent = g_value_dup_string (value);
+			g_clear_object (&priv->soup_session);
+			g_mutex_unlock (&priv->session_lock);
+
 			g_object_notify_by_pspec (object,
 			                          properties[PROP_USER_AGENT]);
 		}
 		break;
+	case PROP_MAX_CONNECTIONS:
+		if (priv->max_connections != g_value_get_uint (value)) {
+			priv->max_connections = g_value_get_uint (value);
+			update_soup_session (GEOCODE_NOMINATIM (object),
+			                     SOUP_SESSION_MAX_CONNS,
+			                     priv->max_connections);
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_MAX_CONNECTIONS_PER_HOST:
+		if (priv->max_connections_per_host != g_value_get_uint (value)) {
+			priv->max_connections_per_host = g_value_get_uint (value);
+			update_soup_session (GEOCODE_NOMINATIM (object),
+			                     SOUP_SESSION_MAX_CONNS_PER_HOST,
+			                     priv->max_connections_per_host);
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_IDLE_TIMEOUT:
+		if (priv->idle_timeout != g_value_get_uint (value)) {
+			priv->idle_timeout = g_value_get_uint (value);
+			update_soup_session (GEOCODE_NOMINATIM (object),
+			                     SOUP_SESSION_IDLE_TIMEOUT,
+			                     priv->idle_timeout);
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_MEMORY_CACHE_ENABLED:
+		if (g_atomic_int_get (&priv->memory_cache_enabled) != g_value_get_boolean (value)) {
+			g_atomic_int_set (&priv->memory_cache_enabled,
+			                  g_value_get_boolean (value));
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_CACHE_TTL:
+		if (g_atomic_int_get (&priv->cache_ttl) != g_value_get_uint (value)) {
+			g_atomic_int_set (&priv->cache_ttl, g_value_get_uint (value));
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_NEGATIVE_CACHE_TTL:
+		if (g_atomic_int_get (&priv->negative_cache_ttl) != g_value_get_uint (value)) {
+			g_atomic_int_set (&priv->negative_cache_ttl, g_value_get_uint (value));
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_CACHE_ENABLED:
+		if (g_atomic_int_get (&priv->cache_enabled) != g_value_get_boolean (value)) {
+			g_atomic_int_set (&priv->cache_enabled,
+			                  g_value_get_boolean (value));
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_REVERSE_CACHE_RADIUS:
+		if (g_atomic_int_get (&priv->reverse_cache_radius) != g_value_get_uint (value)) {
+			g_atomic_int_set (&priv->reverse_cache_radius, g_value_get_uint (value));
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_REVERSE_CACHE_TTL:
+		if (g_atomic_int_get (&priv->reverse_cache_ttl) != g_value_get_uint (value)) {
+			g_atomic_int_set (&priv->reverse_cache_ttl, g_value_get_uint (value));
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_STALE_WHILE_REVALIDATE:
+		if (g_atomic_int_get (&priv->stale_while_revalidate) != g_value_get_uint (value)) {
+			g_atomic_int_set (&priv->stale_while_revalidate, g_value_get_uint (value));
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_RATE_LIMIT:
+	case PROP_RATE_LIMIT_BURST: {
+		gdouble rate;
+		guint burst;
+
+		_geocode_request_scheduler_get_rate (priv->scheduler, &rate, &burst);
+
+		if (property_id == PROP_RATE_LIMIT &&
+		    rate != g_value_get_double (value))
+			rate = g_value_get_double (value);
+		else if (property_id == PROP_RATE_LIMIT_BURST &&
+		         burst != g_value_get_uint (value))
+			burst = g_value_get_uint (value);
+		else
+			break;
+
+		_geocode_request_scheduler_set_rate (priv->scheduler, rate, burst);
+		g_object_notify_by_pspec (object, pspec);
+		break;
+	}
+	case PROP_MAX_QUEUED_QUERIES:
+		if (_geocode_request_scheduler_get_max_queued (priv->scheduler) != g_value_get_uint (value)) {
+			_geocode_request_scheduler_set_max_queued (priv->scheduler,
+			                                           g_value_get_uint (value));
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_MAX_QUERY_ATTEMPTS:
+		if (g_atomic_int_get (&priv->max_query_attempts) != g_value_get_uint (value)) {
+			g_atomic_int_set (&priv->max_query_attempts, g_value_get_uint (value));
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_RETRY_DELAY:
+		if (g_atomic_int_get (&priv->retry_delay) != g_value_get_uint (value)) {
+			g_atomic_int_set (&priv->retry_delay, g_value_get_uint (value));
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
+	case PROP_RETRY_JITTER:
+		if (g_atomic_int_get (&priv->retry_jitter) != g_value_get_uint (value)) {
+			g_atomic_int_set (&priv->retry_jitter, g_value_get_uint (value));
+			g_object_notify_by_pspec (object, pspec);
+		}
+		break;
 	default:
 		/* We don't have any other property... */
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -1446,8 +4160,24 @@ geocode_nominatim_finalize (GObject *object)
 	priv = geocode_nominatim_get_instance_private (GEOCODE_NOMINATIM (object));
 
 	g_free (priv->base_url);
+	g_strfreev (priv->base_urls);
 	g_free (priv->maintainer_email_address);
 	g_free (priv->user_agent);
+	g_free (priv->language);
+	g_mutex_clear (&priv->language_lock);
+
+	_geocode_endpoint_pool_free (priv->endpoints);
+
+	g_clear_object (&priv->soup_session);
+	g_mutex_clear (&priv->session_lock);
+
+	/* Queued requests hold a reference, so none are left. */
+	_geocode_request_scheduler_free (priv->scheduler);
+
+	/* Each in-flight query and refresh holds a reference, so there are
+	 * none left. */
+	g_hash_table_unref (priv->in_flight_queries);
+	g_hash_table_unref (priv->refreshing_keys);
 
 	G_OBJECT_CLASS (geocode_nominatim_parent_class)->finalize (object);
 }
@@ -1462,6 +4192,9 @@ geocode_backend_iface_init (GeocodeBackendInterface *iface)
 	iface->reverse_resolve        = geocode_nominatim_reverse_resolve;
 	iface->reverse_resolve_async  = geocode_nominatim_reverse_resolve_async;
 	iface->reverse_resolve_finish = geocode_nominatim_reverse_resolve_finish;
+
+	iface->forward_search_batch_async  = geocode_nominatim_forward_search_batch_async;
+	iface->forward_search_batch_finish = geocode_nominatim_forward_search_batch_finish;
 }
 
 static void
@@ -1482,7 +4215,8 @@ geocode_nominatim_class_init (GeocodeNominatimClass *klass)
 	 * GeocodeNominatim:base-url:
 	 *
 	 * The base URL of the Nominatim service, for example
-	 * `https://nominatim.example.org`.
+	 * `https://nominatim.example.org`. If it is not set, the first of
+	 * #GeocodeNominatim:base-urls is used.
 	 *
 	 * Since: 3.23.1
 	 */
@@ -1536,6 +4270,417 @@ geocode_nominatim_class_init (GeocodeNominatimClass *klass)
 	                                                   (G_PARAM_READWRITE |
 	                                                    G_PARAM_STATIC_STRINGS));
 
+	/**
+	 * GeocodeNominatim:max-connections:
+	 *
+	 * Maximum number of concurrent HTTP(S) connections the backend keeps
+	 * open to the Nominatim service. Connections are pooled and kept
+	 * alive between queries, from both the synchronous and asynchronous
+	 * APIs, so that consecutive lookups do not pay for a new TCP and TLS
+	 * handshake each time.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_MAX_CONNECTIONS] =
+	    g_param_spec_uint ("max-connections",
+	                       "Maximum connections",
+	                       "Maximum number of concurrent connections",
+	                       1, G_MAXUINT,
+	                       DEFAULT_MAX_CONNECTIONS,
+	                       (G_PARAM_READWRITE |
+	                        G_PARAM_EXPLICIT_NOTIFY |
+	                        G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:max-connections-per-host:
+	 *
+	 * Maximum number of concurrent HTTP(S) connections the backend keeps
+	 * open to a single host. See #GeocodeNominatim:max-connections.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_MAX_CONNECTIONS_PER_HOST] =
+	    g_param_spec_uint ("max-connections-per-host",
+	                       "Maximum connections per host",
+	                       "Maximum number of concurrent connections to a single host",
+	                       1, G_MAXUINT,
+	                       DEFAULT_MAX_CONNECTIONS_PER_HOST,
+	                       (G_PARAM_READWRITE |
+	                        G_PARAM_EXPLICIT_NOTIFY |
+	                        G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:idle-timeout:
+	 *
+	 * Number of seconds after which an idle pooled connection is closed,
+	 * or 0 to keep idle connections open until the server closes them.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_IDLE_TIMEOUT] =
+	    g_param_spec_uint ("idle-timeout",
+	                       "Idle timeout",
+	                       "Seconds after which idle connections are closed",
+	                       0, G_MAXUINT,
+	                       DEFAULT_IDLE_TIMEOUT,
+	                       (G_PARAM_READWRITE |
+	                        G_PARAM_EXPLICIT_NOTIFY |
+	                        G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:memory-cache-enabled:
+	 *
+	 * Whether to keep parsed query results in memory, so that repeated
+	 * queries are answered without reading the on-disk cache or parsing
+	 * the server response again. Results are always returned as new
+	 * #GeocodePlace instances, so callers may modify them freely.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_MEMORY_CACHE_ENABLED] =
+	    g_param_spec_boolean ("memory-cache-enabled",
+	                          "Memory cache enabled",
+	                          "Whether to cache parsed results in memory",
+	                          TRUE,
+	                          (G_PARAM_READWRITE |
+	                           G_PARAM_EXPLICIT_NOTIFY |
+	                           G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:cache-enabled:
+	 *
+	 * Whether to keep query results in the on-disk cache, which is shared
+	 * with other processes and persists between runs. Results are stored
+	 * as parsed places rather than as server responses, so a cache hit
+	 * involves no JSON parsing.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_CACHE_ENABLED] =
+	    g_param_spec_boolean ("cache-enabled",
+	                          "Cache enabled",
+	                          "Whether to cache results on disk",
+	                          TRUE,
+	                          (G_PARAM_READWRITE |
+	                           G_PARAM_EXPLICIT_NOTIFY |
+	                           G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:cache-ttl:
+	 *
+	 * Number of seconds for which results from the Nominatim service are
+	 * kept in the on-disk cache, or 0 to keep them until they are evicted
+	 * to make room for others. The lifetime is recorded with each entry
+	 * when it is saved, so changing this does not affect existing ones.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_CACHE_TTL] =
+	    g_param_spec_uint ("cache-ttl",
+	                       "Cache TTL",
+	                       "Seconds for which responses are cached on disk",
+	                       0, G_MAXUINT,
+	                       GEOCODE_CACHE_DEFAULT_TTL,
+	                       (G_PARAM_READWRITE |
+	                        G_PARAM_EXPLICIT_NOTIFY |
+	                        G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:negative-cache-ttl:
+	 *
+	 * Number of seconds for which queries that have no results are
+	 * remembered in memory, so that repeating them fails immediately with
+	 * the same error, or 0 to not remember them. This only applies when
+	 * #GeocodeNominatim:memory-cache-enabled is %TRUE.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_NEGATIVE_CACHE_TTL] =
+	    g_param_spec_uint ("negative-cache-ttl",
+	                       "Negative cache TTL",
+	                       "Seconds for which queries with no results are cached in memory",
+	                       0, G_MAXUINT,
+	                       GEOCODE_NEGATIVE_CACHE_DEFAULT_TTL,
+	                       (G_PARAM_READWRITE |
+	                        G_PARAM_EXPLICIT_NOTIFY |
+	                        G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:reverse-cache-radius:
+	 *
+	 * Distance in metres within which the result of reverse geocoding a
+	 * location is reused for other locations, or 0 to only reuse results
+	 * for exactly the same location. This suits applications which
+	 * resolve a stream of position fixes, where successive fixes are
+	 * close together but never equal; the radius should be no larger than
+	 * the accuracy needed of the results.
+	 *
+	 * Results are kept in memory for #GeocodeNominatim:reverse-cache-ttl
+	 * seconds, and are shared by all #GeocodeNominatim instances in the
+	 * process which use the same server and radius.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_REVERSE_CACHE_RADIUS] =
+	    g_param_spec_uint ("reverse-cache-radius",
+	                       "Reverse cache radius",
+	                       "Distance in metres within which reverse geocoding results are reused",
+	                       0, GEOCODE_REVERSE_CACHE_MAX_RADIUS,
+	                       0,
+	                       (G_PARAM_READWRITE |
+	                        G_PARAM_EXPLICIT_NOTIFY |
+	                        G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:reverse-cache-ttl:
+	 *
+	 * Number of seconds for which reverse geocoding results are reused for
+	 * nearby locations. See #GeocodeNominatim:reverse-cache-radius.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_REVERSE_CACHE_TTL] =
+	    g_param_spec_uint ("reverse-cache-ttl",
+	                       "Reverse cache TTL",
+	                       "Seconds for which reverse geocoding results are reused for nearby locations",
+	                       1, G_MAXUINT,
+	                       GEOCODE_REVERSE_CACHE_DEFAULT_TTL,
+	                       (G_PARAM_READWRITE |
+	                        G_PARAM_EXPLICIT_NOTIFY |
+	                        G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:stale-while-revalidate:
+	 *
+	 * Number of seconds after results in the on-disk cache go stale (see
+	 * #GeocodeNominatim:cache-ttl) during which they are still returned,
+	 * or 0 to never return stale results. A stale result is returned
+	 * straight away, and refreshed in the background with a request made
+	 * in the thread-default main context; the request is conditional
+	 * where the server gave validators (ETag or Last-Modified) with the
+	 * results, so that unchanged results are not sent again.
+	 *
+	 * This keeps slow responses from the server off the query path for
+	 * frequent queries. It is recorded with each entry when it is saved,
+	 * so changing this does not affect how long existing entries are kept.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_STALE_WHILE_REVALIDATE] =
+	    g_param_spec_uint ("stale-while-revalidate",
+	                       "Stale while revalidate",
+	                       "Seconds for which stale cached results are returned while they are refreshed",
+	                       0, G_MAXUINT,
+	                       0,
+	                       (G_PARAM_READWRITE |
+	                        G_PARAM_EXPLICIT_NOTIFY |
+	                        G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:rate-limit:
+	 *
+	 * Maximum sustained number of requests per second to send to the
+	 * Nominatim server, or 0 for no limit. Servers generally have a usage
+	 * policy; the public OpenStreetMap instance allows at most one request
+	 * per second.
+	 *
+	 * Asynchronous queries over the limit are queued, with background
+	 * cache refreshes (see #GeocodeNominatim:stale-while-revalidate) after
+	 * queries, and sent from the thread-default main context. Cancelling a
+	 * queued query withdraws it without sending anything. Synchronous
+	 * queries over the limit block.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_RATE_LIMIT] =
+	    g_param_spec_double ("rate-limit",
+	                         "Rate limit",
+	                         "Maximum number of requests per second",
+	                         0.0, G_MAXDOUBLE,
+	                         0.0,
+	                         (G_PARAM_READWRITE |
+	                          G_PARAM_EXPLICIT_NOTIFY |
+	                          G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:rate-limit-burst:
+	 *
+	 * Maximum number of requests which may be sent together, after a quiet
+	 * period, without waiting for #GeocodeNominatim:rate-limit.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_RATE_LIMIT_BURST] =
+	    g_param_spec_uint ("rate-limit-burst",
+	                       "Rate limit burst",
+	                       "Maximum number of requests sent together",
+	                       1, G_MAXUINT,
+	                       1,
+	                       (G_PARAM_READWRITE |
+	                        G_PARAM_EXPLICIT_NOTIFY |
+	                        G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:max-queued-queries:
+	 *
+	 * Maximum number of asynchronous queries which may wait for
+	 * #GeocodeNominatim:rate-limit, or 0 for no limit. Queries made when
+	 * the queue is full fail straight away with %G_IO_ERROR_BUSY, rather
+	 * than waiting behind a backlog.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_MAX_QUEUED_QUERIES] =
+	    g_param_spec_uint ("max-queued-queries",
+	                       "Maximum queued queries",
+	                       "Maximum number of queries waiting to be sent",
+	                       0, G_MAXUINT,
+	                       GEOCODE_REQUEST_SCHEDULER_DEFAULT_MAX_QUEUED,
+	                       (G_PARAM_READWRITE |
+	                        G_PARAM_EXPLICIT_NOTIFY |
+	                        G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:max-query-attempts:
+	 *
+	 * Maximum number of requests to make for each query, including the
+	 * first one. Requests which fail in a way which may be transient, such
+	 * as with a `503 Service Unavailable` or `429 Too Many Requests`
+	 * status or a connection failure, are retried until this many have
+	 * been made; set it to 1 to never retry. Only idempotent requests are
+	 * retried.
+	 *
+	 * Retries wait for the delay given by the server in a `Retry-After`
+	 * header, or failing that, back off exponentially from
+	 * #GeocodeNominatim:retry-delay. A request is not retried if the server
+	 * asks for a delay of more than a minute. Asynchronous queries wait
+	 * from the thread-default main context, without blocking a thread.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_MAX_QUERY_ATTEMPTS] =
+	    g_param_spec_uint ("max-query-attempts",
+	                       "Maximum query attempts",
+	                       "Maximum number of requests to make for each query",
+	                       1, G_MAXUINT,
+	                       DEFAULT_MAX_QUERY_ATTEMPTS,
+	                       (G_PARAM_READWRITE |
+	                        G_PARAM_EXPLICIT_NOTIFY |
+	                        G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:retry-delay:
+	 *
+	 * Delay before retrying a failed request for the first time, in
+	 * milliseconds, when the server does not give one. The delay is
+	 * doubled for each subsequent retry, up to a minute.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_RETRY_DELAY] =
+	    g_param_spec_uint ("retry-delay",
+	                       "Retry delay",
+	                       "Delay before retrying a failed request, in milliseconds",
+	                       0, G_MAXUINT,
+	                       DEFAULT_RETRY_DELAY,
+	                       (G_PARAM_READWRITE |
+	                        G_PARAM_EXPLICIT_NOTIFY |
+	                        G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:retry-jitter:
+	 *
+	 * Percentage of the #GeocodeNominatim:retry-delay backoff which is
+	 * randomized, so that clients which failed at the same time do not all
+	 * retry at the same time.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_RETRY_JITTER] =
+	    g_param_spec_uint ("retry-jitter",
+	                       "Retry jitter",
+	                       "Percentage of the retry delay which is random",
+	                       0, 100,
+	                       DEFAULT_RETRY_JITTER,
+	                       (G_PARAM_READWRITE |
+	                        G_PARAM_EXPLICIT_NOTIFY |
+	                        G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:base-urls:
+	 *
+	 * Base URLs of replicas of the Nominatim service, which requests are
+	 * spread over. If #GeocodeNominatim:base-url is not set, it is the
+	 * first of them; otherwise it is added to them. When read, this gives
+	 * all the replicas, starting with #GeocodeNominatim:base-url.
+	 *
+	 * The latency and error rate of each replica are tracked, and requests
+	 * go to the one expected to answer soonest. A replica whose requests
+	 * keep failing is not used for a while, and then probed with a single
+	 * request before being used again. Failed requests are retried on
+	 * another replica where possible.
+	 *
+	 * Queries are built for #GeocodeNominatim:base-url, and rewritten for
+	 * the replica they are sent to, so they are cached together whichever
+	 * replica answers them. The replicas must all give the same results.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_BASE_URLS] =
+	    g_param_spec_boxed ("base-urls",
+	                        "Base URLs",
+	                        "Base URLs of replicas of the Nominatim service",
+	                        G_TYPE_STRV,
+	                        (G_PARAM_READWRITE |
+	                         G_PARAM_CONSTRUCT_ONLY |
+	                         G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:hedge-requests:
+	 *
+	 * Whether to send a duplicate of a request to a second replica, when
+	 * the first has not answered it within the 95th percentile of its
+	 * recent response times. The first successful response is used, and
+	 * the other request is cancelled. This cuts the tail latency of
+	 * queries, at the cost of a few percent more requests. Hedged requests
+	 * are only sent when #GeocodeNominatim:rate-limit allows one straight
+	 * away.
+	 *
+	 * This has no effect with a single replica (see
+	 * #GeocodeNominatim:base-urls), or on synchronous queries.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_HEDGE_REQUESTS] =
+	    g_param_spec_boolean ("hedge-requests",
+	                          "Hedge requests",
+	                          "Whether to send duplicates of slow requests to another replica",
+	                          FALSE,
+	                          (G_PARAM_READWRITE |
+	                           G_PARAM_EXPLICIT_NOTIFY |
+	                           G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * GeocodeNominatim:language:
+	 *
+	 * Language to request the names in results in, as an
+	 * [RFC 3066](https://tools.ietf.org/html/rfc3066) language tag such as
+	 * `en-GB`, or a comma-separated list of them in order of preference.
+	 * If %NULL, the language of the locale set for `LC_MESSAGES` is used.
+	 *
+	 * A `language` parameter given to a forward query takes precedence.
+	 *
+	 * Since: 3.27.1
+	 */
+	properties[PROP_LANGUAGE] =
+	    g_param_spec_string ("language",
+	                         "Language",
+	                         "Language to request results in",
+	                         NULL,
+	                         (G_PARAM_READWRITE |
+	                          G_PARAM_EXPLICIT_NOTIFY |
+	                          G_PARAM_STATIC_STRINGS));
+
 	g_object_class_install_properties (object_class,
 	                                   G_N_ELEMENTS (properties), properties);
 }
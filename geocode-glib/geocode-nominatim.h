@@ -91,6 +91,72 @@ GeocodeNominatim *geocode_nominatim_new (const gchar *base_url,
 
 GeocodeNominatim *geocode_nominatim_get_gnome (void);
 
+void  geocode_nominatim_set_memory_cache_size (gsize size);
+gsize geocode_nominatim_get_memory_cache_size (void);
+
+void geocode_nominatim_set_cache_limits (guint64  max_size,
+                                         guint    max_entries);
+void geocode_nominatim_get_cache_limits (guint64 *max_size,
+                                         guint   *max_entries);
+
+void     geocode_nominatim_set_cache_compression (gboolean compression);
+gboolean geocode_nominatim_get_cache_compression (void);
+
+gboolean geocode_nominatim_trim_cache (GError **error);
+
+void geocode_nominatim_get_retry_stats (GeocodeNominatim *self,
+                                        guint            *n_failed_attempts,
+                                        guint            *n_retries);
+
+/**
+ * GeocodePreparedSearch:
+ *
+ * A forward search query of a #GeocodeNominatim, prepared by
+ * geocode_nominatim_prepare_search() to be made repeatedly for different
+ * search terms. All its fields are private.
+ *
+ * Since: 3.27.1
+ */
+typedef struct _GeocodePreparedSearch GeocodePreparedSearch;
+
+/**
+ * GEOCODE_TYPE_PREPARED_SEARCH:
+ *
+ * See #GeocodePreparedSearch.
+ *
+ * Since: 3.27.1
+ */
+#define GEOCODE_TYPE_PREPARED_SEARCH (geocode_prepared_search_get_type ())
+
+GType geocode_prepared_search_get_type (void) G_GNUC_CONST;
+
+GeocodePreparedSearch *geocode_prepared_search_ref   (GeocodePreparedSearch *search);
+void                   geocode_prepared_search_unref (GeocodePreparedSearch *search);
+
+void geocode_prepared_search_set_priority (GeocodePreparedSearch *search,
+                                           gint                   priority);
+gint geocode_prepared_search_get_priority (GeocodePreparedSearch *search);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GeocodePreparedSearch, geocode_prepared_search_unref)
+
+GeocodePreparedSearch *geocode_nominatim_prepare_search         (GeocodeNominatim       *self,
+                                                                 GHashTable             *params,
+                                                                 GError                **error);
+GList                 *geocode_nominatim_search_prepared        (GeocodeNominatim       *self,
+                                                                 GeocodePreparedSearch  *search,
+                                                                 const char             *text,
+                                                                 GCancellable           *cancellable,
+                                                                 GError                **error);
+void                   geocode_nominatim_search_prepared_async  (GeocodeNominatim       *self,
+                                                                 GeocodePreparedSearch  *search,
+                                                                 const char             *text,
+                                                                 GCancellable           *cancellable,
+                                                                 GAsyncReadyCallback     callback,
+                                                                 gpointer                user_data);
+GList                 *geocode_nominatim_search_prepared_finish (GeocodeNominatim       *self,
+                                                                 GAsyncResult           *result,
+                                                                 GError                **error);
+
 G_END_DECLS
 
 #endif /* GEOCODE_NOMINATIM_H */
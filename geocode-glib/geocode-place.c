@@ -21,6 +21,7 @@
 
  */
 
+#include <string.h>
 #include <gio/gio.h>
 #include <geocode-glib/geocode-place.h>
 #include <geocode-glib/geocode-bounding-box.h>
@@ -1312,3 +1313,414 @@ geocode_place_get_osm_type (GeocodePlace *place)
 
         return place->priv->osm_type;
 }
+
+static GeocodeLocation *
+location_dup (GeocodeLocation *location)
+{
+        return g_object_new (GEOCODE_TYPE_LOCATION,
+                             "latitude", geocode_location_get_latitude (location),
+                             "longitude", geocode_location_get_longitude (location),
+                             "altitude", geocode_location_get_altitude (location),
+                             "accuracy", geocode_location_get_accuracy (location),
+                             "crs", geocode_location_get_crs (location),
+                             "description", geocode_location_get_description (location),
+                             "timestamp", geocode_location_get_timestamp (location),
+                             NULL);
+}
+
+/*
+ * _geocode_place_dup:
+ * @place: A place
+ *
+ * Makes a deep copy of @place, so that modifying the copy (or its location)
+ * does not affect the original. Bounding boxes are immutable, so are shared.
+ *
+ * Returns: (transfer full): a new #GeocodePlace equal to @place
+ */
+GeocodePlace *
+_geocode_place_dup (GeocodePlace *place)
+{
+        GeocodePlace *copy;
+        GeocodePlacePrivate *priv;
+
+        g_return_val_if_fail (GEOCODE_IS_PLACE (place), NULL);
+
+        priv = place->priv;
+
+        copy = geocode_place_new (priv->name, priv->place_type);
+
+        if (priv->location != NULL)
+                copy->priv->location = location_dup (priv->location);
+        if (priv->bbox != NULL)
+                copy->priv->bbox = g_object_ref (priv->bbox);
+
+        copy->priv->street_address = g_strdup (priv->street_address);
+        copy->priv->street = g_strdup (priv->street);
+        copy->priv->building = g_strdup (priv->building);
+        copy->priv->postal_code = g_strdup (priv->postal_code);
+        copy->priv->area = g_strdup (priv->area);
+        copy->priv->town = g_strdup (priv->town);
+        copy->priv->county = g_strdup (priv->county);
+        copy->priv->state = g_strdup (priv->state);
+        copy->priv->admin_area = g_strdup (priv->admin_area);
+        copy->priv->country_code = g_strdup (priv->country_code);
+        copy->priv->country = g_strdup (priv->country);
+        copy->priv->continent = g_strdup (priv->continent);
+        copy->priv->osm_id = g_strdup (priv->osm_id);
+        copy->priv->osm_type = priv->osm_type;
+
+        return copy;
+}
+
+/* The offsets of the string fields in #GeocodePlacePrivate, by
+ * #GeocodePlaceField. */
+static const gsize field_offsets[GEOCODE_PLACE_N_FIELDS] = {
+        G_STRUCT_OFFSET (GeocodePlacePrivate, street_address),
+        G_STRUCT_OFFSET (GeocodePlacePrivate, street),
+        G_STRUCT_OFFSET (GeocodePlacePrivate, building),
+        G_STRUCT_OFFSET (GeocodePlacePrivate, postal_code),
+        G_STRUCT_OFFSET (GeocodePlacePrivate, area),
+        G_STRUCT_OFFSET (GeocodePlacePrivate, town),
+        G_STRUCT_OFFSET (GeocodePlacePrivate, county),
+        G_STRUCT_OFFSET (GeocodePlacePrivate, state),
+        G_STRUCT_OFFSET (GeocodePlacePrivate, admin_area),
+        G_STRUCT_OFFSET (GeocodePlacePrivate, country_code),
+        G_STRUCT_OFFSET (GeocodePlacePrivate, country),
+        G_STRUCT_OFFSET (GeocodePlacePrivate, continent),
+        G_STRUCT_OFFSET (GeocodePlacePrivate, osm_id),
+};
+
+/*
+ * _geocode_place_builder_init:
+ * @builder: a #GeocodePlaceBuilder
+ *
+ * Initializes @builder to describe an unnamed place of unknown type, with no
+ * fields set, at latitude and longitude zero.
+ */
+void
+_geocode_place_builder_init (GeocodePlaceBuilder *builder)
+{
+        memset (builder, 0, sizeof (*builder));
+        builder->place_type = GEOCODE_PLACE_TYPE_UNKNOWN;
+        builder->osm_type = GEOCODE_PLACE_OSM_TYPE_UNKNOWN;
+}
+
+/*
+ * _geocode_place_build:
+ * @builder: a #GeocodePlaceBuilder
+ *
+ * Creates a place, and its location and bounding box, from @builder. The
+ * fields are set directly, rather than as properties: this is used to create
+ * the places for each result of a response, for which the property machinery
+ * would be much of the cost. As nothing else can have a reference to the new
+ * place yet, there is nothing to notify.
+ *
+ * The location is described by the name of the place.
+ *
+ * Returns: (transfer full): a new #GeocodePlace
+ */
+GeocodePlace *
+_geocode_place_build (const GeocodePlaceBuilder *builder)
+{
+        GeocodePlace *place;
+        GeocodePlacePrivate *priv;
+        guint i;
+
+        place = g_object_new (GEOCODE_TYPE_PLACE, NULL);
+        priv = place->priv;
+
+        priv->name = g_strdup (builder->name);
+        priv->place_type = builder->place_type;
+        priv->osm_type = builder->osm_type;
+
+        for (i = 0; i < GEOCODE_PLACE_N_FIELDS; i++)
+                G_STRUCT_MEMBER (char *, priv, field_offsets[i]) = g_strdup (builder->fields[i]);
+
+        priv->location = _geocode_location_new (builder->latitude,
+                                                builder->longitude,
+                                                GEOCODE_LOCATION_ACCURACY_UNKNOWN,
+                                                builder->name);
+
+        if (builder->has_bounding_box)
+                priv->bbox = geocode_bounding_box_new (builder->top,
+                                                       builder->bottom,
+                                                       builder->left,
+                                                       builder->right);
+
+        return place;
+}
+
+/*
+ * _geocode_place_osm_type_from_nick:
+ * @nick: the nickname of a #GeocodePlaceOsmType, such as "node"
+ * @osm_type: (out): return location for the OSM type
+ *
+ * Looks up an OSM type by the name OpenStreetMap gives it. The enum class is
+ * only looked up once.
+ *
+ * Returns: %TRUE if @nick is a known OSM type, %FALSE otherwise
+ */
+gboolean
+_geocode_place_osm_type_from_nick (const char          *nick,
+                                   GeocodePlaceOsmType *osm_type)
+{
+        static GEnumClass *osm_type_class = NULL;
+        GEnumValue *value;
+
+        if (g_once_init_enter (&osm_type_class))
+                g_once_init_leave (&osm_type_class,
+                                   g_type_class_ref (geocode_place_osm_type_get_type ()));
+
+        value = g_enum_get_value_by_nick (osm_type_class, nick);
+        if (value == NULL)
+                return FALSE;
+
+        *osm_type = value->value;
+        return TRUE;
+}
+
+static gsize
+strsize0 (const char *str)
+{
+        return (str != NULL) ? strlen (str) + 1 : 0;
+}
+
+/*
+ * _geocode_place_get_memory_size:
+ * @place: A place
+ *
+ * Estimates the number of bytes of heap memory used by @place, including its
+ * location and bounding box. This is used to bound the size of in-memory
+ * caches, so only needs to be approximately right.
+ *
+ * Returns: the estimated size of @place, in bytes
+ */
+gsize
+_geocode_place_get_memory_size (GeocodePlace *place)
+{
+        GeocodePlacePrivate *priv;
+        gsize size;
+
+        g_return_val_if_fail (GEOCODE_IS_PLACE (place), 0);
+
+        priv = place->priv;
+
+        size = sizeof (GeocodePlace) + sizeof (GeocodePlacePrivate);
+
+        if (priv->location != NULL)
+                /* GeocodeLocationPrivate is opaque here; it holds seven
+                 * scalar fields and a description. */
+                size += sizeof (GeocodeLocation) + 8 * sizeof (gdouble) +
+                        strsize0 (geocode_location_get_description (priv->location));
+        if (priv->bbox != NULL)
+                size += sizeof (GeocodeBoundingBox) + 4 * sizeof (gdouble);
+
+        size += strsize0 (priv->name);
+        size += strsize0 (priv->street_address);
+        size += strsize0 (priv->street);
+        size += strsize0 (priv->building);
+        size += strsize0 (priv->postal_code);
+        size += strsize0 (priv->area);
+        size += strsize0 (priv->town);
+        size += strsize0 (priv->county);
+        size += strsize0 (priv->state);
+        size += strsize0 (priv->admin_area);
+        size += strsize0 (priv->country_code);
+        size += strsize0 (priv->country);
+        size += strsize0 (priv->continent);
+        size += strsize0 (priv->osm_id);
+
+        return size;
+}
+
+/* Serialized form of a place; see _geocode_place_list_serialize(). The
+ * strings are, in order: name, street address, street, building, postal code,
+ * area, town, county, state, administrative area, country code, country,
+ * continent and OSM ID. */
+#define LOCATION_VARIANT_TYPE "(ddddumst)"
+#define BBOX_VARIANT_TYPE "(dddd)"
+#define PLACE_VARIANT_TYPE \
+        "(u" "m" LOCATION_VARIANT_TYPE "m" BBOX_VARIANT_TYPE "u" \
+        "msmsmsmsmsmsmsmsmsmsmsmsmsms)"
+#define PLACE_LIST_VARIANT_TYPE "(ua" PLACE_VARIANT_TYPE ")"
+
+static GVariant *
+serialize_place (GeocodePlace *place)
+{
+        GeocodePlacePrivate *priv = place->priv;
+        GVariant *location = NULL, *bbox = NULL;
+
+        if (priv->location != NULL)
+                location = g_variant_new ("(ddddumst)",
+                                          geocode_location_get_latitude (priv->location),
+                                          geocode_location_get_longitude (priv->location),
+                                          geocode_location_get_altitude (priv->location),
+                                          geocode_location_get_accuracy (priv->location),
+                                          (guint32) geocode_location_get_crs (priv->location),
+                                          geocode_location_get_description (priv->location),
+                                          geocode_location_get_timestamp (priv->location));
+        if (priv->bbox != NULL)
+                bbox = g_variant_new ("(dddd)",
+                                      geocode_bounding_box_get_top (priv->bbox),
+                                      geocode_bounding_box_get_bottom (priv->bbox),
+                                      geocode_bounding_box_get_left (priv->bbox),
+                                      geocode_bounding_box_get_right (priv->bbox));
+
+        return g_variant_new (PLACE_VARIANT_TYPE,
+                              (guint32) priv->place_type,
+                              g_variant_new_maybe (G_VARIANT_TYPE (LOCATION_VARIANT_TYPE), location),
+                              g_variant_new_maybe (G_VARIANT_TYPE (BBOX_VARIANT_TYPE), bbox),
+                              (guint32) priv->osm_type,
+                              priv->name,
+                              priv->street_address,
+                              priv->street,
+                              priv->building,
+                              priv->postal_code,
+                              priv->area,
+                              priv->town,
+                              priv->county,
+                              priv->state,
+                              priv->admin_area,
+                              priv->country_code,
+                              priv->country,
+                              priv->continent,
+                              priv->osm_id);
+}
+
+static GeocodePlace *
+deserialize_place (GVariant *variant)
+{
+        GeocodePlace *place;
+        GeocodePlacePrivate *priv;
+        g_autoptr(GVariant) location = NULL, bbox = NULL;
+        g_autoptr(GVariant) location_value = NULL, bbox_value = NULL;
+        guint32 place_type, osm_type;
+
+        place = g_object_new (GEOCODE_TYPE_PLACE, NULL);
+        priv = place->priv;
+
+        g_variant_get (variant, PLACE_VARIANT_TYPE,
+                       &place_type,
+                       &location,
+                       &bbox,
+                       &osm_type,
+                       &priv->name,
+                       &priv->street_address,
+                       &priv->street,
+                       &priv->building,
+                       &priv->postal_code,
+                       &priv->area,
+                       &priv->town,
+                       &priv->county,
+                       &priv->state,
+                       &priv->admin_area,
+                       &priv->country_code,
+                       &priv->country,
+                       &priv->continent,
+                       &priv->osm_id);
+
+        priv->place_type = place_type;
+        priv->osm_type = osm_type;
+
+        location_value = g_variant_get_maybe (location);
+        if (location_value != NULL) {
+                gdouble latitude, longitude, altitude, accuracy;
+                guint32 crs;
+                const char *description;
+                guint64 timestamp;
+
+                g_variant_get (location_value, "(ddddum&st)",
+                               &latitude, &longitude, &altitude, &accuracy,
+                               &crs, &description, &timestamp);
+                priv->location = g_object_new (GEOCODE_TYPE_LOCATION,
+                                               "latitude", latitude,
+                                               "longitude", longitude,
+                                               "altitude", altitude,
+                                               "accuracy", accuracy,
+                                               "crs", crs,
+                                               "description", description,
+                                               "timestamp", timestamp,
+                                               NULL);
+        }
+
+        bbox_value = g_variant_get_maybe (bbox);
+        if (bbox_value != NULL) {
+                gdouble top, bottom, left, right;
+
+                g_variant_get (bbox_value, "(dddd)",
+                               &top, &bottom, &left, &right);
+                priv->bbox = geocode_bounding_box_new (top, bottom, left, right);
+        }
+
+        return place;
+}
+
+/*
+ * _geocode_place_list_serialize:
+ * @places: (element-type GeocodePlace): a list of places
+ *
+ * Serializes @places into a compact binary form, for caching. The form
+ * includes %GEOCODE_PLACE_CACHE_VERSION, so that places cached by a version
+ * of the library which parses responses differently are not used.
+ *
+ * Returns: (transfer full): the serialized places
+ */
+GBytes *
+_geocode_place_list_serialize (GList *places)
+{
+        GVariantBuilder builder;
+        g_autoptr(GVariant) variant = NULL;
+        GList *l;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" PLACE_VARIANT_TYPE));
+        for (l = places; l != NULL; l = l->next)
+                g_variant_builder_add_value (&builder, serialize_place (l->data));
+
+        variant = g_variant_ref_sink (g_variant_new ("(u@a" PLACE_VARIANT_TYPE ")",
+                                                     (guint32) GEOCODE_PLACE_CACHE_VERSION,
+                                                     g_variant_builder_end (&builder)));
+
+        return g_variant_get_data_as_bytes (variant);
+}
+
+/*
+ * _geocode_place_list_deserialize:
+ * @bytes: places serialized by _geocode_place_list_serialize()
+ * @places: (out) (transfer full) (element-type GeocodePlace): return location
+ *    for the places
+ *
+ * Deserializes a list of places. @bytes may come from an untrusted source:
+ * if it is not in the current serialized form, this fails.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+_geocode_place_list_deserialize (GBytes  *bytes,
+                                 GList  **places)
+{
+        g_autoptr(GVariant) variant = NULL;
+        g_autoptr(GVariant) array = NULL;
+        GVariantIter iter;
+        GVariant *child;
+        guint32 version;
+        GList *list = NULL;
+
+        variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (PLACE_LIST_VARIANT_TYPE),
+                                                                bytes, FALSE));
+        if (!g_variant_is_normal_form (variant))
+                return FALSE;
+
+        g_variant_get (variant, "(u@a" PLACE_VARIANT_TYPE ")", &version, &array);
+        if (version != GEOCODE_PLACE_CACHE_VERSION)
+                return FALSE;
+
+        g_variant_iter_init (&iter, array);
+        while ((child = g_variant_iter_next_value (&iter)) != NULL) {
+                list = g_list_prepend (list, deserialize_place (child));
+                g_variant_unref (child);
+        }
+
+        *places = g_list_reverse (list);
+
+        return TRUE;
+}
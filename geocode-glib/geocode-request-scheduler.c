@@ -0,0 +1,582 @@
+/*
+ * Copyright 2026 The geocode-glib authors
+ *
+ * The geocode-glib library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The geocode-glib library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "geocode-glib-private.h"
+
+/*
+ * Limits the rate at which requests are sent to a server, so that clients
+ * stay within its usage policy.
+ *
+ * The rate is enforced with a token bucket: tokens are added at the given
+ * rate, up to the burst size, and each request takes one. A request which
+ * arrives when there is a token, and nothing else is waiting, may be sent
+ * straight away. Otherwise it is queued, ordered by priority and then by
+ * arrival, and sent once a token is available. Each queued request is sent
+ * from the thread-default main context it was submitted from; the timeout
+ * which finds the requests to send is attached to the context of the one at
+ * the head of the queue when it is armed.
+ *
+ * The queue is bounded: requests submitted when it is full fail straight away
+ * rather than waiting behind a backlog which would take too long to clear.
+ * Queued requests can be withdrawn, so cancelling a query which has not been
+ * sent yet costs nothing.
+ *
+ * Synchronous requests cannot be queued; they reserve a token, possibly going
+ * into debt, and block until the debt is paid off.
+ */
+
+struct _GeocodeScheduledRequest {
+	gint priority;
+	guint64 sequence;
+	GMainContext *context;  /* (owned) */
+	GeocodeRequestFunc func;
+	gpointer user_data;
+};
+
+struct _GeocodeRequestScheduler {
+	GMutex lock;
+	GCond cond;
+
+	gdouble rate;  /* tokens per second, or 0 for no limit */
+	guint burst;
+	guint max_queued;  /* 0 for no limit */
+
+	gdouble tokens;  /* may be negative while synchronous requests wait */
+	gint64 last_refill;  /* monotonic time */
+
+	GQueue queue;  /* (element-type GeocodeScheduledRequest) sorted */
+	guint64 next_sequence;
+
+	GSource *timeout;  /* (owned) (nullable) */
+};
+
+static void
+scheduled_request_free (GeocodeScheduledRequest *request)
+{
+	g_main_context_unref (request->context);
+	g_slice_free (GeocodeScheduledRequest, request);
+}
+
+static gint
+compare_requests (gconstpointer a,
+                  gconstpointer b,
+                  gpointer      user_data)
+{
+	const GeocodeScheduledRequest *request_a = a;
+	const GeocodeScheduledRequest *request_b = b;
+
+	if (request_a->priority != request_b->priority)
+		return (request_a->priority < request_b->priority) ? -1 : 1;
+
+	return (request_a->sequence < request_b->sequence) ? -1 : 1;
+}
+
+/*
+ * _geocode_request_scheduler_new:
+ *
+ * Creates a scheduler which does not limit the rate of requests.
+ *
+ * Returns: (transfer full): a new #GeocodeRequestScheduler
+ */
+GeocodeRequestScheduler *
+_geocode_request_scheduler_new (void)
+{
+	GeocodeRequestScheduler *scheduler;
+
+	scheduler = g_slice_new0 (GeocodeRequestScheduler);
+	g_mutex_init (&scheduler->lock);
+	g_cond_init (&scheduler->cond);
+	scheduler->burst = 1;
+	scheduler->max_queued = GEOCODE_REQUEST_SCHEDULER_DEFAULT_MAX_QUEUED;
+	scheduler->tokens = 1;
+	scheduler->last_refill = g_get_monotonic_time ();
+	g_queue_init (&scheduler->queue);
+
+	return scheduler;
+}
+
+/*
+ * _geocode_request_scheduler_free:
+ * @scheduler: a #GeocodeRequestScheduler
+ *
+ * Frees @scheduler. Requests still queued are dropped without being sent.
+ */
+void
+_geocode_request_scheduler_free (GeocodeRequestScheduler *scheduler)
+{
+	if (scheduler->timeout != NULL) {
+		g_source_destroy (scheduler->timeout);
+		g_source_unref (scheduler->timeout);
+	}
+
+	g_queue_free_full (&scheduler->queue,
+	                   (GDestroyNotify) scheduled_request_free);
+	g_queue_init (&scheduler->queue);
+
+	g_cond_clear (&scheduler->cond);
+	g_mutex_clear (&scheduler->lock);
+	g_slice_free (GeocodeRequestScheduler, scheduler);
+}
+
+/* Must be called with @scheduler->lock held. */
+static void
+refill (GeocodeRequestScheduler *scheduler)
+{
+	gint64 now = g_get_monotonic_time ();
+
+	if (scheduler->rate > 0) {
+		scheduler->tokens += (now - scheduler->last_refill) * scheduler->rate / G_USEC_PER_SEC;
+		scheduler->tokens = MIN (scheduler->tokens, scheduler->burst);
+	}
+
+	scheduler->last_refill = now;
+}
+
+/* Must be called with @scheduler->lock held, after refill(). Returns the
+ * number of microseconds until there is a token, or 0 if there is one. */
+static gint64
+get_wait_time (GeocodeRequestScheduler *scheduler)
+{
+	if (scheduler->rate <= 0 || scheduler->tokens >= 1)
+		return 0;
+
+	return (gint64) ((1 - scheduler->tokens) * G_USEC_PER_SEC / scheduler->rate) + 1;
+}
+
+static gboolean
+send_request (gpointer data)
+{
+	GeocodeScheduledRequest *request = data;
+
+	request->func (request->user_data);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean dispatch (gpointer data);
+
+/* Must be called with @scheduler->lock held. Arms the timeout to dispatch the
+ * request at the head of the queue, if it is not armed already. */
+static void
+schedule_dispatch (GeocodeRequestScheduler *scheduler)
+{
+	GeocodeScheduledRequest *head;
+	gint64 wait_time;
+
+	if (scheduler->timeout != NULL || g_queue_is_empty (&scheduler->queue))
+		return;
+
+	head = g_queue_peek_head (&scheduler->queue);
+
+	refill (scheduler);
+	wait_time = get_wait_time (scheduler);
+
+	scheduler->timeout = g_timeout_source_new ((wait_time + 999) / 1000);
+	g_source_set_callback (scheduler->timeout, dispatch, scheduler, NULL);
+	g_source_attach (scheduler->timeout, head->context);
+}
+
+/* Sends as many queued requests as there are tokens for. */
+static gboolean
+dispatch (gpointer data)
+{
+	GeocodeRequestScheduler *scheduler = data;
+	GQueue ready = G_QUEUE_INIT;
+	GeocodeScheduledRequest *request;
+
+	g_mutex_lock (&scheduler->lock);
+
+	/* The timeout may have been replaced by another thread while this was
+	 * being dispatched. */
+	if (scheduler->timeout != g_main_current_source ()) {
+		g_mutex_unlock (&scheduler->lock);
+		return G_SOURCE_REMOVE;
+	}
+
+	g_source_unref (scheduler->timeout);
+	scheduler->timeout = NULL;
+
+	refill (scheduler);
+
+	while (!g_queue_is_empty (&scheduler->queue) &&
+	       get_wait_time (scheduler) == 0) {
+		g_queue_push_tail (&ready, g_queue_pop_head (&scheduler->queue));
+		if (scheduler->rate > 0)
+			scheduler->tokens -= 1;
+	}
+
+	schedule_dispatch (scheduler);
+
+	g_mutex_unlock (&scheduler->lock);
+
+	/* Called without the lock held, as they may submit more requests.
+	 * Requests submitted from this context are sent straight away; the
+	 * others are sent from their own contexts, as they may belong to other
+	 * threads. */
+	while ((request = g_queue_pop_head (&ready)) != NULL)
+		g_main_context_invoke_full (request->context, G_PRIORITY_DEFAULT,
+		                            send_request, request,
+		                            (GDestroyNotify) scheduled_request_free);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Must be called with @scheduler->lock held. Re-arms the timeout, after the
+ * rate or the queue changed. */
+static void
+reschedule_dispatch (GeocodeRequestScheduler *scheduler)
+{
+	if (scheduler->timeout != NULL) {
+		g_source_destroy (scheduler->timeout);
+		g_source_unref (scheduler->timeout);
+		scheduler->timeout = NULL;
+	}
+
+	schedule_dispatch (scheduler);
+}
+
+/*
+ * _geocode_request_scheduler_set_rate:
+ * @scheduler: a #GeocodeRequestScheduler
+ * @rate: maximum sustained number of requests per second, or 0 for no limit
+ * @burst: maximum number of requests which may be sent at once after a quiet
+ *    period; must be non-zero
+ *
+ * Sets the rate at which requests are sent.
+ */
+void
+_geocode_request_scheduler_set_rate (GeocodeRequestScheduler *scheduler,
+                                     gdouble                  rate,
+                                     guint                    burst)
+{
+	g_return_if_fail (rate >= 0);
+	g_return_if_fail (burst > 0);
+
+	g_mutex_lock (&scheduler->lock);
+
+	refill (scheduler);
+
+	/* Lifting or imposing a limit starts with a full bucket. */
+	if (scheduler->rate > 0 && rate > 0)
+		scheduler->tokens = MIN (scheduler->tokens, burst);
+	else
+		scheduler->tokens = burst;
+
+	scheduler->rate = rate;
+	scheduler->burst = burst;
+
+	reschedule_dispatch (scheduler);
+	g_cond_broadcast (&scheduler->cond);
+
+	g_mutex_unlock (&scheduler->lock);
+}
+
+void
+_geocode_request_scheduler_get_rate (GeocodeRequestScheduler *scheduler,
+                                     gdouble                 *rate,
+                                     guint                   *burst)
+{
+	g_mutex_lock (&scheduler->lock);
+
+	if (rate != NULL)
+		*rate = scheduler->rate;
+	if (burst != NULL)
+		*burst = scheduler->burst;
+
+	g_mutex_unlock (&scheduler->lock);
+}
+
+/*
+ * _geocode_request_scheduler_set_max_queued:
+ * @scheduler: a #GeocodeRequestScheduler
+ * @max_queued: maximum number of queued requests, or 0 for no limit
+ *
+ * Sets how many requests may wait to be sent. Requests already queued are
+ * kept, even if there are now too many of them.
+ */
+void
+_geocode_request_scheduler_set_max_queued (GeocodeRequestScheduler *scheduler,
+                                           guint                    max_queued)
+{
+	g_mutex_lock (&scheduler->lock);
+	scheduler->max_queued = max_queued;
+	g_mutex_unlock (&scheduler->lock);
+}
+
+guint
+_geocode_request_scheduler_get_max_queued (GeocodeRequestScheduler *scheduler)
+{
+	guint max_queued;
+
+	g_mutex_lock (&scheduler->lock);
+	max_queued = scheduler->max_queued;
+	g_mutex_unlock (&scheduler->lock);
+
+	return max_queued;
+}
+
+/*
+ * _geocode_request_scheduler_submit:
+ * @scheduler: a #GeocodeRequestScheduler
+ * @priority: priority of the request, as for #GSource priorities
+ * @func: function to call to send the request, if it is queued
+ * @user_data: data to pass to @func
+ * @request: (out) (transfer none): return location for the queued request,
+ *    or %NULL if it may be sent straight away
+ * @error: return location for a #GError
+ *
+ * Submits a request to be sent. If there is a token for it, and no request is
+ * waiting, @request is set to %NULL and the caller should send it straight
+ * away; @func is not called. Otherwise the request is queued, and @func is
+ * called from the thread-default main context of the caller of this function
+ * to send it when its turn comes, unless it is cancelled first with
+ * _geocode_request_scheduler_cancel().
+ *
+ * Returns: %TRUE if the request may be sent or was queued, %FALSE with
+ *    %G_IO_ERROR_BUSY if the queue is full
+ */
+gboolean
+_geocode_request_scheduler_submit (GeocodeRequestScheduler  *scheduler,
+                                   gint                      priority,
+                                   GeocodeRequestFunc        func,
+                                   gpointer                  user_data,
+                                   GeocodeScheduledRequest **request,
+                                   GError                  **error)
+{
+	GeocodeScheduledRequest *queued;
+
+	g_return_val_if_fail (func != NULL, FALSE);
+	g_return_val_if_fail (request != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	g_mutex_lock (&scheduler->lock);
+
+	refill (scheduler);
+
+	if (g_queue_is_empty (&scheduler->queue) &&
+	    get_wait_time (scheduler) == 0) {
+		if (scheduler->rate > 0)
+			scheduler->tokens -= 1;
+		g_mutex_unlock (&scheduler->lock);
+
+		*request = NULL;
+		return TRUE;
+	}
+
+	if (scheduler->max_queued > 0 &&
+	    scheduler->queue.length >= scheduler->max_queued) {
+		g_mutex_unlock (&scheduler->lock);
+
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_BUSY,
+		             "Too many queries waiting to be sent");
+		return FALSE;
+	}
+
+	queued = g_slice_new0 (GeocodeScheduledRequest);
+	queued->priority = priority;
+	queued->sequence = scheduler->next_sequence++;
+	queued->context = g_main_context_ref_thread_default ();
+	queued->func = func;
+	queued->user_data = user_data;
+
+	g_queue_insert_sorted (&scheduler->queue, queued, compare_requests, NULL);
+
+	/* A new head may need a different timeout context. */
+	if (g_queue_peek_head (&scheduler->queue) == queued)
+		reschedule_dispatch (scheduler);
+
+	g_mutex_unlock (&scheduler->lock);
+
+	*request = queued;
+	return TRUE;
+}
+
+/*
+ * _geocode_request_scheduler_cancel:
+ * @scheduler: a #GeocodeRequestScheduler
+ * @request: a request returned by _geocode_request_scheduler_submit()
+ *
+ * Withdraws @request from the queue, if it is still waiting, so that its
+ * function is never called.
+ *
+ * Returns: %TRUE if @request was withdrawn, %FALSE if its function has been
+ *    or is about to be called
+ */
+gboolean
+_geocode_request_scheduler_cancel (GeocodeRequestScheduler *scheduler,
+                                   GeocodeScheduledRequest *request)
+{
+	GList *link;
+
+	g_mutex_lock (&scheduler->lock);
+
+	link = g_queue_find (&scheduler->queue, request);
+	if (link != NULL) {
+		gboolean was_head = (link == scheduler->queue.head);
+
+		g_queue_delete_link (&scheduler->queue, link);
+		scheduled_request_free (request);
+
+		if (was_head)
+			reschedule_dispatch (scheduler);
+	}
+
+	g_mutex_unlock (&scheduler->lock);
+
+	return (link != NULL);
+}
+
+/*
+ * _geocode_request_scheduler_raise_priority:
+ * @scheduler: a #GeocodeRequestScheduler
+ * @request: a request returned by _geocode_request_scheduler_submit()
+ * @priority: the new priority of the request
+ *
+ * Moves @request up the queue to @priority, if it is still waiting and
+ * @priority is more urgent than its own. Its place among requests of
+ * @priority is the one it would have had if submitted with it.
+ */
+void
+_geocode_request_scheduler_raise_priority (GeocodeRequestScheduler *scheduler,
+                                           GeocodeScheduledRequest *request,
+                                           gint                     priority)
+{
+	GList *link;
+
+	g_mutex_lock (&scheduler->lock);
+
+	link = g_queue_find (&scheduler->queue, request);
+	if (link != NULL && priority < request->priority) {
+		g_queue_delete_link (&scheduler->queue, link);
+		request->priority = priority;
+		g_queue_insert_sorted (&scheduler->queue, request,
+		                       compare_requests, NULL);
+
+		/* A new head may need a different timeout context. */
+		if (g_queue_peek_head (&scheduler->queue) == request)
+			reschedule_dispatch (scheduler);
+	}
+
+	g_mutex_unlock (&scheduler->lock);
+}
+
+static void
+on_acquire_cancelled (GCancellable            *cancellable,
+                      GeocodeRequestScheduler *scheduler)
+{
+	g_mutex_lock (&scheduler->lock);
+	g_cond_broadcast (&scheduler->cond);
+	g_mutex_unlock (&scheduler->lock);
+}
+
+/*
+ * _geocode_request_scheduler_acquire:
+ * @scheduler: a #GeocodeRequestScheduler
+ * @cancellable: (nullable): a #GCancellable
+ * @error: return location for a #GError
+ *
+ * Blocks until a synchronous request may be sent. Queued requests are not
+ * overtaken: the token is reserved straight away, so they wait for longer.
+ *
+ * Returns: %TRUE if the request may be sent, %FALSE if @cancellable was
+ *    cancelled
+ */
+gboolean
+_geocode_request_scheduler_acquire (GeocodeRequestScheduler  *scheduler,
+                                    GCancellable             *cancellable,
+                                    GError                  **error)
+{
+	gulong cancelled_id = 0;
+	gboolean cancelled = FALSE;
+
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	if (cancellable != NULL)
+		cancelled_id = g_cancellable_connect (cancellable,
+		                                      G_CALLBACK (on_acquire_cancelled),
+		                                      scheduler, NULL);
+
+	g_mutex_lock (&scheduler->lock);
+
+	refill (scheduler);
+	if (scheduler->rate > 0)
+		scheduler->tokens -= 1;
+
+	/* Wait until the bucket is out of debt. */
+	while (scheduler->rate > 0 && scheduler->tokens < 0) {
+		gint64 end_time;
+
+		if (g_cancellable_is_cancelled (cancellable)) {
+			scheduler->tokens += 1;
+			cancelled = TRUE;
+			break;
+		}
+
+		end_time = g_get_monotonic_time () +
+		           (gint64) (-scheduler->tokens * G_USEC_PER_SEC / scheduler->rate) + 1;
+		g_cond_wait_until (&scheduler->cond, &scheduler->lock, end_time);
+		refill (scheduler);
+	}
+
+	g_mutex_unlock (&scheduler->lock);
+
+	g_cancellable_disconnect (cancellable, cancelled_id);
+
+	if (cancelled) {
+		g_cancellable_set_error_if_cancelled (cancellable, error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * _geocode_request_scheduler_try_acquire:
+ * @scheduler: a #GeocodeRequestScheduler
+ *
+ * Takes a token for a request which is only worth sending straight away, such
+ * as a hedged duplicate of another request, if one is available and nothing
+ * is queued.
+ *
+ * Returns: %TRUE if the request may be sent, %FALSE otherwise
+ */
+gboolean
+_geocode_request_scheduler_try_acquire (GeocodeRequestScheduler *scheduler)
+{
+	gboolean acquired = FALSE;
+
+	g_mutex_lock (&scheduler->lock);
+
+	refill (scheduler);
+
+	if (g_queue_is_empty (&scheduler->queue) &&
+	    get_wait_time (scheduler) == 0) {
+		if (scheduler->rate > 0)
+			scheduler->tokens -= 1;
+		acquired = TRUE;
+	}
+
+	g_mutex_unlock (&scheduler->lock);
+
+	return acquired;
+}
@@ -0,0 +1,394 @@
+/*
+ * Copyright 2026 The geocode-glib authors
+ *
+ * The geocode-glib library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The geocode-glib library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301  USA.
+ */
+
+#include <math.h>
+
+#include "geocode-glib-private.h"
+
+/*
+ * A process-wide, thread-safe cache of recent reverse geocoding results,
+ * indexed by location rather than by query, so that resolving a location
+ * close to one which was recently resolved needs no request. This matters
+ * for devices reporting their position every few seconds: successive fixes
+ * are never exactly equal, so they never share an entry in the query caches.
+ *
+ * Entries are filed in a grid of cells whose height is the lookup radius, and
+ * whose width is adjusted for the latitude of their row so that they are
+ * roughly square. A lookup only has to look at the few cells which overlap
+ * the circle around the location, and returns the nearest entry within it.
+ * Near the poles and across the antimeridian, nearby entries may be missed;
+ * that only costs a query.
+ *
+ * Entries are only returned for lookups with the same scope (which identifies
+ * the server and language of the results) and radius as they were inserted
+ * with. They expire after a short time, and the least recently used entries
+ * are evicted once the cache holds GEOCODE_REVERSE_CACHE_CAPACITY entries.
+ */
+
+#define EARTH_RADIUS_M 6372795.0 /* as in geocode-location.c */
+#define METRES_PER_DEGREE (EARTH_RADIUS_M * G_PI / 180.0)
+
+/* Cells further poleward than this are treated as if they were at this
+ * latitude, to keep their width finite. */
+#define MAX_CELL_LATITUDE 89.0
+
+typedef struct {
+	char *cell;  /* key of the cell the entry is in */
+	gdouble latitude;
+	gdouble longitude;
+	GList *places;  /* (element-type GeocodePlace) (owned) */
+	gint64 expires;  /* monotonic time */
+	GList link;  /* in lru_queue; data points to the entry itself */
+} CacheEntry;
+
+static GMutex cache_lock;
+static GHashTable *cache_cells = NULL;  /* (owned) cell key → (owned) GPtrArray of CacheEntry */
+static GQueue lru_queue = G_QUEUE_INIT;  /* most recently used at the head */
+static guint cache_hits = 0;
+static guint cache_misses = 0;
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+	g_free (entry->cell);
+	g_list_free_full (entry->places, g_object_unref);
+	g_slice_free (CacheEntry, entry);
+}
+
+static GList *
+places_list_dup (GList *places)
+{
+	GList *copy = NULL, *l;
+
+	for (l = places; l != NULL; l = l->next)
+		copy = g_list_prepend (copy, _geocode_place_dup (l->data));
+
+	return g_list_reverse (copy);
+}
+
+/* Distance in metres between two locations, computed as in
+ * geocode_location_get_distance_from(). */
+static gdouble
+get_distance (gdouble lat1,
+              gdouble lon1,
+              gdouble lat2,
+              gdouble lon2)
+{
+	gdouble dlat, dlon, a;
+
+	dlat = (lat2 - lat1) * G_PI / 180.0;
+	dlon = (lon2 - lon1) * G_PI / 180.0;
+	lat1 = lat1 * G_PI / 180.0;
+	lat2 = lat2 * G_PI / 180.0;
+
+	a = sin (dlat / 2) * sin (dlat / 2) +
+	    sin (dlon / 2) * sin (dlon / 2) * cos (lat1) * cos (lat2);
+
+	return EARTH_RADIUS_M * 2 * atan2 (sqrt (a), sqrt (1 - a));
+}
+
+/* Width in degrees of the cells in @row, for cells @cell_height degrees high. */
+static gdouble
+get_cell_width (gint64  row,
+                gdouble cell_height)
+{
+	gdouble latitude;
+
+	latitude = fabs ((row + 0.5) * cell_height);
+	latitude = MIN (latitude, MAX_CELL_LATITUDE);
+
+	return cell_height / cos (latitude * G_PI / 180.0);
+}
+
+static char *
+get_cell_key (const char *scope,
+              guint       radius,
+              gint64      row,
+              gint64      column)
+{
+	return g_strdup_printf ("%u:%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ":%s",
+	                        radius, row, column, scope);
+}
+
+/* Must be called with @cache_lock held. */
+static void
+remove_entry (CacheEntry *entry)
+{
+	GPtrArray *cell;
+
+	g_queue_unlink (&lru_queue, &entry->link);
+
+	cell = g_hash_table_lookup (cache_cells, entry->cell);
+	g_ptr_array_remove_fast (cell, entry);
+
+	if (cell->len == 0)
+		g_hash_table_remove (cache_cells, entry->cell);
+
+	cache_entry_free (entry);
+}
+
+/* Must be called with @cache_lock held. */
+static void
+evict_to_capacity (guint capacity)
+{
+	while (lru_queue.length > capacity)
+		remove_entry (lru_queue.tail->data);
+}
+
+/* Must be called with @cache_lock held. Returns the nearest unexpired entry
+ * in @cell_key within @radius metres of the location, or @nearest if there is
+ * none nearer. */
+static CacheEntry *
+find_nearest_in_cell (const char *cell_key,
+                      gdouble     latitude,
+                      gdouble     longitude,
+                      guint       radius,
+                      gint64      now,
+                      CacheEntry *nearest,
+                      gdouble    *nearest_distance)
+{
+	GPtrArray *cell;
+	guint i;
+
+	cell = g_hash_table_lookup (cache_cells, cell_key);
+	if (cell == NULL)
+		return nearest;
+
+	for (i = 0; i < cell->len; i++) {
+		CacheEntry *entry = g_ptr_array_index (cell, i);
+		gdouble distance;
+
+		if (entry->expires <= now)
+			continue;
+
+		distance = get_distance (latitude, longitude,
+		                         entry->latitude, entry->longitude);
+
+		if (distance <= radius && distance < *nearest_distance) {
+			nearest = entry;
+			*nearest_distance = distance;
+		}
+	}
+
+	return nearest;
+}
+
+/*
+ * _geocode_reverse_cache_get_cell:
+ * @latitude: latitude of a location, in degrees
+ * @longitude: longitude of a location, in degrees
+ * @size: height of the cells, in metres; must be positive
+ * @row: (out): return location for the row of the cell
+ * @column: (out): return location for the column of the cell
+ *
+ * Gets the cell the location is in, in the grid of roughly square cells of
+ * the given size which the cache files its entries in.
+ */
+void
+_geocode_reverse_cache_get_cell (gdouble  latitude,
+                                 gdouble  longitude,
+                                 gdouble  size,
+                                 gint64  *row,
+                                 gint64  *column)
+{
+	gdouble cell_height;
+
+	g_return_if_fail (size > 0);
+
+	cell_height = size / METRES_PER_DEGREE;
+	*row = floor (latitude / cell_height);
+	*column = floor (longitude / get_cell_width (*row, cell_height));
+}
+
+/*
+ * _geocode_reverse_cache_lookup:
+ * @scope: identifies the server and language of the results
+ * @latitude: latitude of the location to resolve, in degrees
+ * @longitude: longitude of the location to resolve, in degrees
+ * @radius: maximum distance to a cached location, in metres; must be
+ *    non-zero
+ * @places: (out) (transfer full) (element-type GeocodePlace): return location
+ *    for copies of the cached places
+ *
+ * Looks for the places cached for the location nearest to the given one,
+ * within @radius, and if found, marks them as most recently used and returns
+ * a deep copy of them.
+ *
+ * Returns: %TRUE on a cache hit, %FALSE otherwise
+ */
+gboolean
+_geocode_reverse_cache_lookup (const char  *scope,
+                               gdouble      latitude,
+                               gdouble      longitude,
+                               guint        radius,
+                               GList      **places)
+{
+	CacheEntry *nearest = NULL;
+	gdouble nearest_distance = G_MAXDOUBLE;
+	gdouble cell_height, span;
+	gint64 now, row, first_row, last_row;
+
+	g_return_val_if_fail (scope != NULL, FALSE);
+	g_return_val_if_fail (radius > 0, FALSE);
+	g_return_val_if_fail (places != NULL, FALSE);
+
+	cell_height = radius / METRES_PER_DEGREE;
+	first_row = floor ((latitude - cell_height) / cell_height);
+	last_row = floor ((latitude + cell_height) / cell_height);
+
+	/* The span in longitude of the circle, at the most poleward latitude
+	 * it covers. */
+	span = get_cell_width (fabs (latitude) / cell_height + 1, cell_height);
+
+	now = g_get_monotonic_time ();
+
+	g_mutex_lock (&cache_lock);
+
+	for (row = first_row; row <= last_row && cache_cells != NULL; row++) {
+		gdouble cell_width = get_cell_width (row, cell_height);
+		gint64 column, first_column, last_column;
+
+		first_column = floor ((longitude - span) / cell_width);
+		last_column = floor ((longitude + span) / cell_width);
+
+		for (column = first_column; column <= last_column; column++) {
+			g_autofree char *cell_key = NULL;
+
+			cell_key = get_cell_key (scope, radius, row, column);
+			nearest = find_nearest_in_cell (cell_key,
+			                                latitude, longitude,
+			                                radius, now,
+			                                nearest, &nearest_distance);
+		}
+	}
+
+	if (nearest != NULL) {
+		g_queue_unlink (&lru_queue, &nearest->link);
+		g_queue_push_head_link (&lru_queue, &nearest->link);
+		*places = places_list_dup (nearest->places);
+		cache_hits++;
+	} else {
+		cache_misses++;
+	}
+
+	g_mutex_unlock (&cache_lock);
+
+	return nearest != NULL;
+}
+
+/*
+ * _geocode_reverse_cache_insert:
+ * @scope: identifies the server and language of the results
+ * @latitude: latitude of the resolved location, in degrees
+ * @longitude: longitude of the resolved location, in degrees
+ * @radius: radius of the lookups to return the entry for, in metres; must be
+ *    non-zero
+ * @ttl: number of seconds for which to keep the entry; must be non-zero
+ * @places: (transfer none) (element-type GeocodePlace): places to cache
+ *
+ * Caches a copy of @places as the result of resolving the given location, to
+ * be returned by lookups for locations within @radius of it.
+ */
+void
+_geocode_reverse_cache_insert (const char *scope,
+                               gdouble     latitude,
+                               gdouble     longitude,
+                               guint       radius,
+                               guint       ttl,
+                               GList      *places)
+{
+	CacheEntry *entry;
+	GPtrArray *cell;
+	gint64 row, column;
+
+	g_return_if_fail (scope != NULL);
+	g_return_if_fail (radius > 0);
+	g_return_if_fail (ttl > 0);
+
+	_geocode_reverse_cache_get_cell (latitude, longitude, radius, &row, &column);
+
+	entry = g_slice_new0 (CacheEntry);
+	entry->cell = get_cell_key (scope, radius, row, column);
+	entry->latitude = latitude;
+	entry->longitude = longitude;
+	entry->places = places_list_dup (places);
+	entry->expires = g_get_monotonic_time () + (gint64) ttl * G_USEC_PER_SEC;
+	entry->link.data = entry;
+
+	g_mutex_lock (&cache_lock);
+
+	if (cache_cells == NULL)
+		cache_cells = g_hash_table_new_full (g_str_hash, g_str_equal,
+		                                     g_free,
+		                                     (GDestroyNotify) g_ptr_array_unref);
+
+	cell = g_hash_table_lookup (cache_cells, entry->cell);
+	if (cell == NULL) {
+		cell = g_ptr_array_new ();
+		g_hash_table_insert (cache_cells, g_strdup (entry->cell), cell);
+	}
+
+	g_ptr_array_add (cell, entry);
+	g_queue_push_head_link (&lru_queue, &entry->link);
+
+	evict_to_capacity (GEOCODE_REVERSE_CACHE_CAPACITY);
+
+	g_mutex_unlock (&cache_lock);
+}
+
+/*
+ * _geocode_reverse_cache_clear:
+ *
+ * Removes all entries from the reverse geocoding cache, and resets its
+ * statistics.
+ */
+void
+_geocode_reverse_cache_clear (void)
+{
+	g_mutex_lock (&cache_lock);
+	evict_to_capacity (0);
+	cache_hits = 0;
+	cache_misses = 0;
+	g_mutex_unlock (&cache_lock);
+}
+
+/*
+ * _geocode_reverse_cache_get_stats:
+ * @hits: (out) (optional): return location for the number of cache hits
+ * @misses: (out) (optional): return location for the number of cache misses
+ * @n_entries: (out) (optional): return location for the number of entries
+ *
+ * Gets statistics about the reverse geocoding cache.
+ */
+void
+_geocode_reverse_cache_get_stats (guint *hits,
+                                  guint *misses,
+                                  guint *n_entries)
+{
+	g_mutex_lock (&cache_lock);
+
+	if (hits != NULL)
+		*hits = cache_hits;
+	if (misses != NULL)
+		*misses = cache_misses;
+	if (n_entries != NULL)
+		*n_entries = lru_queue.length;
+
+	g_mutex_unlock (&cache_lock);
+}
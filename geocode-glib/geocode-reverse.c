@@ -45,10 +45,53 @@
 struct _GeocodeReversePrivate {
 	GeocodeLocation *location;
 	GeocodeBackend  *backend;
+	guint            timeout;
+};
+
+enum {
+	PROP_0,
+
+	PROP_TIMEOUT
 };
 
 G_DEFINE_TYPE (GeocodeReverse, geocode_reverse, G_TYPE_OBJECT)
 
+static void
+geocode_reverse_get_property (GObject    *object,
+                              guint       property_id,
+                              GValue     *value,
+                              GParamSpec *pspec)
+{
+	GeocodeReverse *reverse = GEOCODE_REVERSE (object);
+
+	switch (property_id) {
+	case PROP_TIMEOUT:
+		g_value_set_uint (value, geocode_reverse_get_timeout (reverse));
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+		break;
+	}
+}
+
+static void
+geocode_reverse_set_property (GObject      *object,
+                              guint         property_id,
+                              const GValue *value,
+                              GParamSpec   *pspec)
+{
+	GeocodeReverse *reverse = GEOCODE_REVERSE (object);
+
+	switch (property_id) {
+	case PROP_TIMEOUT:
+		geocode_reverse_set_timeout (reverse, g_value_get_uint (value));
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+		break;
+	}
+}
+
 static void
 geocode_reverse_finalize (GObject *gobject)
 {
@@ -64,13 +107,35 @@ static void
 geocode_reverse_class_init (GeocodeReverseClass *klass)
 {
 	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+	GParamSpec *pspec;
 
 	bindtextdomain (GETTEXT_PACKAGE, GEOCODE_LOCALEDIR);
 	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
 
 	gobject_class->finalize = geocode_reverse_finalize;
+	gobject_class->get_property = geocode_reverse_get_property;
+	gobject_class->set_property = geocode_reverse_set_property;
 
 	g_type_class_add_private (klass, sizeof (GeocodeReversePrivate));
+
+	/**
+	 * GeocodeReverse:timeout:
+	 *
+	 * The time a query may take, in milliseconds, after which it fails
+	 * with a %G_IO_ERROR_TIMED_OUT error. If set to 0, queries are not
+	 * given a deadline.
+	 *
+	 * Since: 3.27.1
+	 */
+	pspec = g_param_spec_uint ("timeout",
+	                           "Timeout",
+	                           "Deadline for queries in milliseconds, or 0",
+	                           0,
+	                           G_MAXUINT,
+	                           0,
+	                           G_PARAM_READWRITE |
+	                           G_PARAM_STATIC_STRINGS);
+	g_object_class_install_property (gobject_class, PROP_TIMEOUT, pspec);
 }
 
 static void
@@ -128,22 +193,36 @@ free_value (GValue *value)
 	g_free (value);
 }
 
-static GHashTable *
-_geocode_location_to_params (GeocodeLocation *location)
+/*
+ * _geocode_coordinates_to_params:
+ * @latitude: latitude of the location to resolve, in degrees
+ * @longitude: longitude of the location to resolve, in degrees
+ *
+ * Returns: (transfer full) (element-type utf8 GValue): the parameters of a
+ *    reverse geocoding query for the location
+ */
+GHashTable *
+_geocode_coordinates_to_params (gdouble latitude,
+                                gdouble longitude)
 {
 	GHashTable *ht;
 
 	/* Semantics from http://xmpp.org/extensions/xep-0080.html */
 	ht = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
 	                            (GDestroyNotify) free_value);
-	g_hash_table_insert (ht, (gpointer) "lat",
-	                     double_to_value (geocode_location_get_latitude (location)));
-	g_hash_table_insert (ht, (gpointer) "lon",
-	                     double_to_value (geocode_location_get_longitude (location)));
+	g_hash_table_insert (ht, (gpointer) "lat", double_to_value (latitude));
+	g_hash_table_insert (ht, (gpointer) "lon", double_to_value (longitude));
 
 	return ht;
 }
 
+static GHashTable *
+_geocode_location_to_params (GeocodeLocation *location)
+{
+	return _geocode_coordinates_to_params (geocode_location_get_latitude (location),
+	                                       geocode_location_get_longitude (location));
+}
+
 static void
 places_list_free (GList *places)
 {
@@ -155,16 +234,20 @@ backend_reverse_resolve_ready (GeocodeBackend *backend,
                                GAsyncResult   *res,
                                GTask          *task)
 {
+	GeocodeDeadline *deadline = g_task_get_task_data (task);
 	GList *places = NULL;  /* (element-type GeocodePlace) */
 	GError *error = NULL;
 
 	/* Extract the first result from the list and return that. */
 	places = geocode_backend_reverse_resolve_finish (backend, res, &error);
-	if (places != NULL)
+	if (places != NULL) {
 		g_task_return_pointer (task, g_object_ref (places->data),
 		                       g_object_unref);
-	else
+	} else {
+		if (deadline != NULL)
+			_geocode_deadline_check_error (deadline, &error);
 		g_task_return_error (task, error);
+	}
 	g_object_unref (task);
 	g_clear_pointer (&places, places_list_free);
 }
@@ -181,7 +264,9 @@ backend_reverse_resolve_ready (GeocodeBackend *backend,
  * thing synchronously.
  *
  * When the operation is finished, @callback will be called. You can then call
- * geocode_reverse_resolve_finish() to get the result of the operation.
+ * geocode_reverse_resolve_finish() to get the result of the operation. If the
+ * timeout set with geocode_reverse_set_timeout() expires first, the query is
+ * cancelled and fails with a %G_IO_ERROR_TIMED_OUT error.
  **/
 void
 geocode_reverse_resolve_async (GeocodeReverse     *object,
@@ -201,6 +286,17 @@ geocode_reverse_resolve_async (GeocodeReverse     *object,
 	params = _geocode_location_to_params (object->priv->location);
 
 	task = g_task_new (object, cancellable, callback, user_data);
+
+	if (object->priv->timeout > 0) {
+		GeocodeDeadline *deadline;
+
+		deadline = _geocode_deadline_new (object->priv->timeout,
+		                                  cancellable);
+		g_task_set_task_data (task, deadline,
+		                      (GDestroyNotify) _geocode_deadline_free);
+		cancellable = _geocode_deadline_get_cancellable (deadline);
+	}
+
 	geocode_backend_reverse_resolve_async (object->priv->backend,
 	                                       params,
 	                                       cancellable,
@@ -244,7 +340,8 @@ geocode_reverse_resolve_finish (GeocodeReverse *object,
  *
  * If no result could be found, a %GEOCODE_ERROR_NOT_SUPPORTED error will be
  * returned. This typically happens if the coordinates to geocode are in the
- * middle of the ocean.
+ * middle of the ocean. If the timeout set with geocode_reverse_set_timeout()
+ * expires first, a %G_IO_ERROR_TIMED_OUT error is returned.
  *
  * Returns: (transfer full): A #GeocodePlace instance, or %NULL in case of
  * errors. Free the returned instance with #g_object_unref() when done.
@@ -256,6 +353,9 @@ geocode_reverse_resolve (GeocodeReverse *object,
 	GList *places = NULL;  /* (element-type GeocodePlace) */
 	GeocodePlace *place = NULL;
 	g_autoptr (GHashTable) params = NULL;
+	GeocodeDeadline *deadline = NULL;
+	GCancellable *cancellable = NULL;
+	GError *local_error = NULL;
 
 	g_return_val_if_fail (GEOCODE_IS_REVERSE (object), NULL);
 	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
@@ -264,10 +364,23 @@ geocode_reverse_resolve (GeocodeReverse *object,
 	g_assert (object->priv->backend != NULL);
 
 	params = _geocode_location_to_params (object->priv->location);
+
+	if (object->priv->timeout > 0) {
+		deadline = _geocode_deadline_new (object->priv->timeout, NULL);
+		cancellable = _geocode_deadline_get_cancellable (deadline);
+	}
+
 	places = geocode_backend_reverse_resolve (object->priv->backend,
 	                                          params,
-	                                          NULL,
-	                                          error);
+	                                          cancellable,
+	                                          &local_error);
+
+	if (deadline != NULL) {
+		_geocode_deadline_check_error (deadline, &local_error);
+		_geocode_deadline_free (deadline);
+	}
+	if (local_error != NULL)
+		g_propagate_error (error, local_error);
 
 	if (places != NULL)
 		place = g_object_ref (places->data);
@@ -297,3 +410,49 @@ geocode_reverse_set_backend (GeocodeReverse *object,
 
 	g_set_object (&object->priv->backend, backend);
 }
+
+/**
+ * geocode_reverse_set_timeout:
+ * @object: a #GeocodeReverse representing a query
+ * @timeout: the deadline for queries in milliseconds, or 0 for none
+ *
+ * Sets the #GeocodeReverse:timeout property that bounds how long
+ * geocode_reverse_resolve() and geocode_reverse_resolve_async() may take.
+ * Once @timeout expires, the query is cancelled and fails with a
+ * %G_IO_ERROR_TIMED_OUT error.
+ *
+ * By default, queries are not given a deadline.
+ *
+ * Since: 3.27.1
+ */
+void
+geocode_reverse_set_timeout (GeocodeReverse *object,
+                             guint           timeout)
+{
+	g_return_if_fail (GEOCODE_IS_REVERSE (object));
+
+	if (object->priv->timeout == timeout)
+		return;
+
+	object->priv->timeout = timeout;
+	g_object_notify (G_OBJECT (object), "timeout");
+}
+
+/**
+ * geocode_reverse_get_timeout:
+ * @object: a #GeocodeReverse representing a query
+ *
+ * Gets the #GeocodeReverse:timeout property that bounds how long queries
+ * may take.
+ *
+ * Returns: the deadline for queries in milliseconds, or 0 for none
+ *
+ * Since: 3.27.1
+ */
+guint
+geocode_reverse_get_timeout (GeocodeReverse *object)
+{
+	g_return_val_if_fail (GEOCODE_IS_REVERSE (object), 0);
+
+	return object->priv->timeout;
+}
@@ -71,6 +71,10 @@ GeocodeReverse *geocode_reverse_new_for_location (GeocodeLocation *location);
 void geocode_reverse_set_backend (GeocodeReverse *object,
                                   GeocodeBackend *backend);
 
+void geocode_reverse_set_timeout (GeocodeReverse *object,
+                                  guint           timeout);
+guint geocode_reverse_get_timeout (GeocodeReverse *object);
+
 void geocode_reverse_resolve_async (GeocodeReverse      *object,
 				    GCancellable        *cancellable,
 				    GAsyncReadyCallback  callback,
@@ -0,0 +1,272 @@
+/*
+ * Copyright 2026 The geocode-glib authors
+ *
+ * The geocode-glib library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The geocode-glib library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301  USA.
+ */
+
+/*
+ * Compares the disk footprint and hit latency of the on-disk cache with each
+ * codec, against the one-file-per-query storage of raw JSON responses which
+ * the cache used to use. A hit is timed up to having the list of places, so
+ * includes parsing the JSON for the old storage, and deserializing (and
+ * decompressing) the places for the store.
+ *
+ * Run with `meson test --benchmark`, or directly; the number of entries can
+ * be given as an argument.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <geocode-glib/geocode-glib.h>
+#include <geocode-glib/geocode-glib-private.h>
+
+#define DEFAULT_N_ENTRIES 2000
+
+static const char *response_files[] = {
+	"search.json",
+	"search_lat_long.json",
+	"nominatim-rio.json",
+	"nominatim-area.json",
+	"nominatim-place_rank.json",
+	"nominatim-data-type-change.json",
+};
+
+typedef struct {
+	char *json;
+	GBytes *places;
+} Response;
+
+static guint64
+get_disk_usage (const char *path)
+{
+	GStatBuf st;
+
+	if (g_stat (path, &st) < 0)
+		return 0;
+
+#ifdef G_OS_UNIX
+	return (guint64) st.st_blocks * 512;
+#else
+	return st.st_size;
+#endif
+}
+
+static guint64
+get_directory_disk_usage (const char *path)
+{
+	GDir *dir;
+	const char *name;
+	guint64 usage = 0;
+
+	dir = g_dir_open (path, 0, NULL);
+	g_assert_nonnull (dir);
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		g_autofree char *child = g_build_filename (path, name, NULL);
+		usage += get_disk_usage (child);
+	}
+
+	g_dir_close (dir);
+
+	return usage;
+}
+
+static void
+remove_directory (const char *path)
+{
+	GDir *dir;
+	const char *name;
+
+	dir = g_dir_open (path, 0, NULL);
+	g_assert_nonnull (dir);
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		g_autofree char *child = g_build_filename (path, name, NULL);
+		g_unlink (child);
+	}
+
+	g_dir_close (dir);
+	g_rmdir (path);
+}
+
+static char *
+get_key (guint i)
+{
+	return g_strdup_printf ("https://nominatim.gnome.org/search?format=jsonv2&q=place-%u", i);
+}
+
+static void
+report (const char *name,
+        guint       n_entries,
+        guint64     disk_usage,
+        gint64      hit_time)
+{
+	g_print ("%-20s %10.1f KiB %10.1f µs/hit\n", name,
+	         disk_usage / 1024.0,
+	         (gdouble) hit_time / n_entries);
+}
+
+/* The storage used before the single-file store: one file per query, named
+ * after the hash of its key, holding the raw JSON response. */
+static void
+benchmark_files (Response *responses,
+                 guint     n_responses,
+                 guint     n_entries)
+{
+	g_autofree char *dir = NULL;
+	gint64 start, hit_time;
+	guint i;
+	GError *error = NULL;
+
+	dir = g_dir_make_tmp ("geocode-glib-benchmark-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	for (i = 0; i < n_entries; i++) {
+		g_autofree char *key = get_key (i);
+		g_autofree char *filename = g_compute_checksum_for_string (G_CHECKSUM_SHA256, key, -1);
+		g_autofree char *path = g_build_filename (dir, filename, NULL);
+
+		g_file_set_contents (path, responses[i % n_responses].json, -1, &error);
+		g_assert_no_error (error);
+	}
+
+	start = g_get_monotonic_time ();
+
+	for (i = 0; i < n_entries; i++) {
+		g_autofree char *key = get_key (i);
+		g_autofree char *filename = g_compute_checksum_for_string (G_CHECKSUM_SHA256, key, -1);
+		g_autofree char *path = g_build_filename (dir, filename, NULL);
+		g_autofree char *contents = NULL;
+		GList *places;
+
+		g_file_get_contents (path, &contents, NULL, &error);
+		g_assert_no_error (error);
+
+		places = _geocode_parse_search_json (contents, &error);
+		g_assert_no_error (error);
+		g_list_free_full (places, g_object_unref);
+	}
+
+	hit_time = g_get_monotonic_time () - start;
+
+	report ("files (JSON)", n_entries, get_directory_disk_usage (dir), hit_time);
+	remove_directory (dir);
+}
+
+static void
+benchmark_store (const char        *name,
+                 GeocodeCacheCodec  codec,
+                 Response          *responses,
+                 guint              n_responses,
+                 guint              n_entries)
+{
+	g_autofree char *dir = NULL;
+	GeocodeCacheStore *store;
+	gint64 start, hit_time;
+	guint i;
+	GError *error = NULL;
+
+	if (!_geocode_cache_store_codec_is_supported (codec)) {
+		g_print ("%-20s not supported by this build\n", name);
+		return;
+	}
+
+	dir = g_dir_make_tmp ("geocode-glib-benchmark-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	store = _geocode_cache_store_open (dir, &error);
+	g_assert_no_error (error);
+	_geocode_cache_store_set_codec (store, codec);
+
+	for (i = 0; i < n_entries; i++) {
+		g_autofree char *key = get_key (i);
+
+		_geocode_cache_store_insert (store, key,
+		                             responses[i % n_responses].places,
+		                             0, &error);
+		g_assert_no_error (error);
+	}
+
+	_geocode_cache_store_sync (store, &error);
+	g_assert_no_error (error);
+
+	start = g_get_monotonic_time ();
+
+	for (i = 0; i < n_entries; i++) {
+		g_autofree char *key = get_key (i);
+		g_autoptr (GBytes) value = NULL;
+		GList *places = NULL;
+
+		g_assert_true (_geocode_cache_store_lookup (store, key, &value));
+		g_assert_true (_geocode_place_list_deserialize (value, &places));
+		g_list_free_full (places, g_object_unref);
+	}
+
+	hit_time = g_get_monotonic_time () - start;
+
+	_geocode_cache_store_free (store);
+
+	report (name, n_entries, get_directory_disk_usage (dir), hit_time);
+	remove_directory (dir);
+}
+
+int
+main (int argc, char **argv)
+{
+	Response responses[G_N_ELEMENTS (response_files)];
+	guint n_entries = DEFAULT_N_ENTRIES;
+	guint i;
+
+	g_test_init (&argc, &argv, NULL);
+
+	if (argc > 1)
+		n_entries = MAX (atoi (argv[1]), 1);
+
+	for (i = 0; i < G_N_ELEMENTS (response_files); i++) {
+		g_autofree char *path = NULL;
+		GList *places;
+		GError *error = NULL;
+
+		path = g_test_build_filename (G_TEST_DIST, response_files[i], NULL);
+		g_file_get_contents (path, &responses[i].json, NULL, &error);
+		g_assert_no_error (error);
+
+		places = _geocode_parse_search_json (responses[i].json, &error);
+		g_assert_no_error (error);
+		responses[i].places = _geocode_place_list_serialize (places);
+		g_list_free_full (places, g_object_unref);
+	}
+
+	g_print ("%u entries\n", n_entries);
+
+	benchmark_files (responses, G_N_ELEMENTS (responses), n_entries);
+	benchmark_store ("store", GEOCODE_CACHE_CODEC_NONE,
+	                 responses, G_N_ELEMENTS (responses), n_entries);
+	benchmark_store ("store (zlib)", GEOCODE_CACHE_CODEC_ZLIB,
+	                 responses, G_N_ELEMENTS (responses), n_entries);
+	benchmark_store ("store (lz4)", GEOCODE_CACHE_CODEC_LZ4,
+	                 responses, G_N_ELEMENTS (responses), n_entries);
+
+	for (i = 0; i < G_N_ELEMENTS (responses); i++) {
+		g_free (responses[i].json);
+		g_bytes_unref (responses[i].places);
+	}
+
+	return 0;
+}
@@ -0,0 +1,365 @@
+/*
+ * Copyright 2026 The geocode-glib authors
+ *
+ * The geocode-glib library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The geocode-glib library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301  USA.
+ */
+
+/*
+ * Compares the time taken, and the number of allocations made, to decode each
+ * result of the Nominatim responses in the test data, by the single-pass
+ * decoder and by the JsonParser, JsonReader and GHashTable of attributes which
+ * were used before. The time taken to parse whole responses into places is
+ * also given.
+ *
+ * Allocations are only counted with the GNU C library, whose allocator can be
+ * wrapped.
+ *
+ * Run with `meson test --benchmark`, or directly; the number of rounds can be
+ * given as an argument.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <json-glib/json-glib.h>
+#include <geocode-glib/geocode-glib.h>
+#include <geocode-glib/geocode-glib-private.h>
+
+#define DEFAULT_N_ROUNDS 2000
+
+static const char *response_files[] = {
+	"search.json",
+	"search_lat_long.json",
+	"nominatim-rio.json",
+	"nominatim-area.json",
+	"nominatim-place_rank.json",
+	"nominatim-data-type-change.json",
+	"rev.json",
+};
+
+#ifdef __GLIBC__
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n_members, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void __libc_free (void *ptr);
+
+static guint64 n_allocations = 0;
+
+void *
+malloc (size_t size)
+{
+	n_allocations++;
+	return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n_members,
+        size_t size)
+{
+	n_allocations++;
+	return __libc_calloc (n_members, size);
+}
+
+void *
+realloc (void   *ptr,
+         size_t  size)
+{
+	n_allocations++;
+	return __libc_realloc (ptr, size);
+}
+
+void
+free (void *ptr)
+{
+	__libc_free (ptr);
+}
+
+#define HAVE_ALLOCATION_COUNT 1
+#endif
+
+static guint64
+get_n_allocations (void)
+{
+#ifdef HAVE_ALLOCATION_COUNT
+	return n_allocations;
+#else
+	return 0;
+#endif
+}
+
+/* The attributes of a result as they used to be read, into a hash table. */
+static void
+read_attributes (JsonReader *reader,
+                 GHashTable *ht)
+{
+	char **members;
+	guint i;
+	gboolean is_address;
+	const char *house_number = NULL;
+
+	is_address = (g_strcmp0 (json_reader_get_member_name (reader), "address") == 0);
+
+	members = json_reader_list_members (reader);
+	if (members == NULL) {
+		json_reader_end_member (reader);
+		return;
+	}
+
+	for (i = 0; members[i] != NULL; i++) {
+		char *value = NULL;
+
+		json_reader_read_member (reader, members[i]);
+
+		if (json_reader_is_value (reader)) {
+			JsonNode *node = json_reader_get_value (reader);
+			if (json_node_get_value_type (node) == G_TYPE_STRING) {
+				value = g_strdup (json_node_get_string (node));
+				if (value && *value == '\0')
+					g_clear_pointer (&value, g_free);
+			} else if (json_node_get_value_type (node) == G_TYPE_INT64) {
+				gint64 int_value = json_node_get_int (node);
+				value = g_strdup_printf ("%"G_GINT64_FORMAT, int_value);
+			}
+		}
+
+		if (value != NULL) {
+			g_hash_table_insert (ht, g_strdup (members[i]), value);
+
+			if (i == 0 && is_address) {
+				if (g_strcmp0 (members[i], "house_number") != 0)
+					g_hash_table_insert (ht, g_strdup ("name"), g_strdup (value));
+				else
+					house_number = value;
+			} else if (house_number != NULL && g_strcmp0 (members[i], "road") == 0) {
+				g_hash_table_insert (ht, g_strdup ("name"),
+				                     g_strdup_printf ("%s %s", house_number, value));
+			}
+		} else if (g_strcmp0 (members[i], "boundingbox") == 0) {
+			const char *names[] = {
+				"boundingbox-bottom", "boundingbox-top",
+				"boundingbox-left", "boundingbox-right",
+			};
+			guint j;
+
+			for (j = 0; j < G_N_ELEMENTS (names); j++) {
+				json_reader_read_element (reader, j);
+				if (json_reader_get_string_value (reader) != NULL)
+					g_hash_table_insert (ht, g_strdup (names[j]),
+					                     g_strdup (json_reader_get_string_value (reader)));
+				json_reader_end_element (reader);
+			}
+		}
+		json_reader_end_member (reader);
+	}
+
+	g_strfreev (members);
+
+	if (json_reader_read_member (reader, "address"))
+		read_attributes (reader, ht);
+	json_reader_end_member (reader);
+}
+
+/* Splits the test responses into their results. */
+static GPtrArray *
+load_results (void)
+{
+	GPtrArray *results;
+	guint i;
+
+	results = g_ptr_array_new_with_free_func (g_free);
+
+	for (i = 0; i < G_N_ELEMENTS (response_files); i++) {
+		g_autofree char *path = NULL;
+		g_autoptr (JsonParser) parser = NULL;
+		JsonNode *root;
+		GError *error = NULL;
+
+		path = g_test_build_filename (G_TEST_DIST, response_files[i], NULL);
+		parser = json_parser_new ();
+		json_parser_load_from_file (parser, path, &error);
+		g_assert_no_error (error);
+
+		root = json_parser_get_root (parser);
+
+		if (JSON_NODE_HOLDS_ARRAY (root)) {
+			JsonArray *array = json_node_get_array (root);
+			guint j;
+
+			for (j = 0; j < json_array_get_length (array); j++)
+				g_ptr_array_add (results,
+				                 json_to_string (json_array_get_element (array, j), FALSE));
+		} else {
+			g_ptr_array_add (results, json_to_string (root, FALSE));
+		}
+	}
+
+	return results;
+}
+
+static void
+report (const char *name,
+        guint       n_results,
+        guint64     n_allocations,
+        gint64      time)
+{
+	g_print ("%-20s %10.1f allocations/result %10.1f ns/result\n", name,
+	         (gdouble) n_allocations / n_results,
+	         time * 1000.0 / n_results);
+}
+
+static void
+benchmark_json_reader (GPtrArray *results,
+                       guint      n_rounds)
+{
+	JsonParser *parser;
+	guint64 allocations;
+	gint64 start, time;
+	guint i, j;
+
+	parser = json_parser_new ();
+
+	allocations = get_n_allocations ();
+	start = g_get_monotonic_time ();
+
+	for (i = 0; i < n_rounds; i++) {
+		for (j = 0; j < results->len; j++) {
+			const char *json = g_ptr_array_index (results, j);
+			JsonReader *reader;
+			GHashTable *ht;
+			GError *error = NULL;
+
+			json_parser_load_from_data (parser, json, -1, &error);
+			g_assert_no_error (error);
+
+			reader = json_reader_new (json_parser_get_root (parser));
+			ht = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+			read_attributes (reader, ht);
+
+			g_hash_table_unref (ht);
+			g_object_unref (reader);
+		}
+	}
+
+	time = g_get_monotonic_time () - start;
+	allocations = get_n_allocations () - allocations;
+
+	g_object_unref (parser);
+
+	report ("JsonReader", n_rounds * results->len, allocations, time);
+}
+
+static void
+benchmark_decoder (GPtrArray *results,
+                   guint      n_rounds)
+{
+	GeocodeNominatimResult *result;
+	guint64 allocations;
+	gint64 start, time;
+	guint i, j;
+
+	result = _geocode_nominatim_result_new ();
+
+	allocations = get_n_allocations ();
+	start = g_get_monotonic_time ();
+
+	for (i = 0; i < n_rounds; i++) {
+		for (j = 0; j < results->len; j++) {
+			const char *json = g_ptr_array_index (results, j);
+			GError *error = NULL;
+
+			_geocode_nominatim_result_decode (result, json, strlen (json), &error);
+			g_assert_no_error (error);
+		}
+	}
+
+	time = g_get_monotonic_time () - start;
+	allocations = get_n_allocations () - allocations;
+
+	_geocode_nominatim_result_free (result);
+
+	report ("decoder", n_rounds * results->len, allocations, time);
+}
+
+/* Parses whole search responses into places, as done for each response. */
+static void
+benchmark_search (guint n_rounds)
+{
+	/* All but rev.json, the last, are search responses. */
+	char *responses[G_N_ELEMENTS (response_files) - 1];
+	guint64 allocations;
+	gint64 start, time;
+	guint i, j, n_results = 0;
+
+	for (i = 0; i < G_N_ELEMENTS (responses); i++) {
+		g_autofree char *path = NULL;
+		GError *error = NULL;
+
+		path = g_test_build_filename (G_TEST_DIST, response_files[i], NULL);
+		g_file_get_contents (path, &responses[i], NULL, &error);
+		g_assert_no_error (error);
+	}
+
+	allocations = get_n_allocations ();
+	start = g_get_monotonic_time ();
+
+	for (i = 0; i < n_rounds; i++) {
+		for (j = 0; j < G_N_ELEMENTS (responses); j++) {
+			GList *places;
+			GError *error = NULL;
+
+			places = _geocode_parse_search_json (responses[j], &error);
+			g_assert_no_error (error);
+			n_results += g_list_length (places);
+			g_list_free_full (places, g_object_unref);
+		}
+	}
+
+	time = g_get_monotonic_time () - start;
+	allocations = get_n_allocations () - allocations;
+
+	report ("search (places)", n_results, allocations, time);
+
+	for (i = 0; i < G_N_ELEMENTS (responses); i++)
+		g_free (responses[i]);
+}
+
+int
+main (int argc, char **argv)
+{
+	GPtrArray *results;
+	guint n_rounds = DEFAULT_N_ROUNDS;
+
+	g_test_init (&argc, &argv, NULL);
+
+	if (argc > 1)
+		n_rounds = MAX (atoi (argv[1]), 1);
+
+	results = load_results ();
+
+	g_print ("%u results, %u rounds\n", results->len, n_rounds);
+#ifndef HAVE_ALLOCATION_COUNT
+	g_print ("Allocations are not counted by this build\n");
+#endif
+
+	benchmark_json_reader (results, n_rounds);
+	benchmark_decoder (results, n_rounds);
+	benchmark_search (n_rounds);
+
+	g_ptr_array_unref (results);
+
+	return 0;
+}
@@ -0,0 +1,325 @@
+/*
+ * Copyright 2026 The geocode-glib authors
+ *
+ * The geocode-glib library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The geocode-glib library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301  USA.
+ */
+
+/*
+ * Compares the time taken to give the places resulting from a search names
+ * which tell them apart, by the GeocodeDisambiguator and by the GNode tree
+ * which was used before, for responses of increasing numbers of synthetic
+ * results. The names and order of the places are checked to be the same.
+ *
+ * Run with `meson test --benchmark`, or directly; the number of rounds can be
+ * given as an argument.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <geocode-glib/geocode-glib.h>
+#include <geocode-glib/geocode-glib-private.h>
+
+#define DEFAULT_N_ROUNDS 200
+#define N_LEVELS 8
+
+static const guint response_sizes[] = { 10, 50, 200, 1000 };
+
+typedef struct {
+	char *name;
+	char *values[N_LEVELS];
+} Result;
+
+/* The places as they used to be grouped, into a tree. */
+static void
+insert_place_into_tree (GNode         *place_tree,
+                        GeocodePlace  *place,
+                        char         **values)
+{
+	GNode *start = place_tree;
+	guint i;
+
+	for (i = 0; i < N_LEVELS; i++) {
+		GNode *child = NULL;
+
+		if (!values[i]) {
+			child = g_node_insert_data (start, -1, NULL);
+		} else {
+			child = g_node_first_child (start);
+			while (child &&
+			       child->data &&
+			       g_ascii_strcasecmp (child->data, values[i]) != 0) {
+				child = g_node_next_sibling (child);
+			}
+			if (!child)
+				child = g_node_insert_data (start, -1, g_strdup (values[i]));
+		}
+		start = child;
+	}
+
+	g_node_insert_data (start, -1, place);
+}
+
+static void
+make_place_list_from_tree (GNode  *node,
+                           char  **s_array,
+                           GList **place_list,
+                           int     i)
+{
+	GNode *child;
+
+	if (node == NULL)
+		return;
+
+	if (G_NODE_IS_LEAF (node)) {
+		GPtrArray *rev_s_array;
+		GeocodePlace *place;
+		char *name;
+		int counter = 0;
+
+		rev_s_array = g_ptr_array_new ();
+
+		place = (GeocodePlace *) node->data;
+		name = (char *) geocode_place_get_name (place);
+
+		g_ptr_array_add (rev_s_array, (gpointer) name);
+		for (counter = 1; counter <= i; counter++)
+			g_ptr_array_add (rev_s_array, s_array[i - counter]);
+		g_ptr_array_add (rev_s_array, NULL);
+		name = g_strjoinv (", ", (char **) rev_s_array->pdata);
+		g_ptr_array_unref (rev_s_array);
+
+		geocode_place_set_name (place, name);
+		geocode_location_set_description (geocode_place_get_location (place), name);
+		g_free (name);
+
+		*place_list = g_list_prepend (*place_list, place);
+	} else {
+		GNode *prev, *next;
+
+		prev = g_node_prev_sibling (node);
+		next = g_node_next_sibling (node);
+
+		if (node->data && ((prev && prev->data) || (next && next->data))) {
+			s_array[i] = node->data;
+			i++;
+		}
+	}
+
+	for (child = node->children; child != NULL; child = child->next)
+		make_place_list_from_tree (child, s_array, place_list, i);
+}
+
+static gboolean
+node_free_func (GNode    *node,
+                gpointer  user_data)
+{
+	if (G_NODE_IS_LEAF (node) == FALSE)
+		g_free (node->data);
+
+	return FALSE;
+}
+
+static GList *
+disambiguate_with_tree (GeocodePlace **places,
+                        Result        *results,
+                        guint          n_results)
+{
+	GNode *place_tree;
+	GList *list = NULL;
+	char *s_array[N_LEVELS];
+	guint i;
+
+	place_tree = g_node_new (NULL);
+
+	for (i = 0; i < n_results; i++)
+		insert_place_into_tree (place_tree, places[i], results[i].values);
+
+	make_place_list_from_tree (place_tree, s_array, &list, 0);
+
+	g_node_traverse (place_tree, G_IN_ORDER, G_TRAVERSE_ALL, -1,
+	                 node_free_func, NULL);
+	g_node_destroy (place_tree);
+
+	return g_list_reverse (list);
+}
+
+static GList *
+disambiguate_with_disambiguator (GeocodePlace **places,
+                                 Result        *results,
+                                 guint          n_results)
+{
+	GeocodeDisambiguator *disambiguator;
+	GList *list;
+	guint i;
+
+	disambiguator = _geocode_disambiguator_new (N_LEVELS);
+
+	for (i = 0; i < n_results; i++)
+		_geocode_disambiguator_add (disambiguator, places[i],
+		                            (const char **) results[i].values);
+
+	list = _geocode_disambiguator_finish (disambiguator);
+	_geocode_disambiguator_free (disambiguator);
+
+	return list;
+}
+
+/* Makes results which share parts of their addresses, as those of a search
+ * for a common name would, with some parts missing and some differing only
+ * in case. */
+static Result *
+make_results (guint n_results)
+{
+	Result *results;
+	GRand *rand;
+	guint i, j;
+
+	results = g_new0 (Result, n_results);
+	rand = g_rand_new_with_seed (n_results);
+
+	for (i = 0; i < n_results; i++) {
+		guint value = 0;
+
+		results[i].name = g_strdup ("Springfield");
+
+		for (j = 0; j < N_LEVELS; j++) {
+			/* Fewer of the larger parts of addresses differ. */
+			value = value * 16 + g_rand_int_range (rand, 0, 2 + j * 2);
+
+			if (g_rand_int_range (rand, 0, 6) == 0)
+				continue;
+
+			results[i].values[j] = g_strdup_printf ("%s %u",
+			                                        g_rand_boolean (rand) ? "Part" : "PART",
+			                                        value);
+		}
+	}
+
+	g_rand_free (rand);
+
+	return results;
+}
+
+static void
+free_results (Result *results,
+              guint   n_results)
+{
+	guint i, j;
+
+	for (i = 0; i < n_results; i++) {
+		g_free (results[i].name);
+		for (j = 0; j < N_LEVELS; j++)
+			g_free (results[i].values[j]);
+	}
+
+	g_free (results);
+}
+
+static GeocodePlace **
+make_places (Result *results,
+             guint   n_results)
+{
+	GeocodePlace **places;
+	guint i;
+
+	places = g_new (GeocodePlace *, n_results);
+
+	for (i = 0; i < n_results; i++) {
+		g_autoptr (GeocodeLocation) loc = NULL;
+
+		loc = geocode_location_new (0, 0, GEOCODE_LOCATION_ACCURACY_UNKNOWN);
+		places[i] = geocode_place_new_with_location (results[i].name,
+		                                             GEOCODE_PLACE_TYPE_TOWN,
+		                                             loc);
+	}
+
+	return places;
+}
+
+static void
+check_same (GList *tree_list,
+            GList *list)
+{
+	g_assert_cmpuint (g_list_length (tree_list), ==, g_list_length (list));
+
+	for (; list != NULL; tree_list = tree_list->next, list = list->next)
+		g_assert_cmpstr (geocode_place_get_name (tree_list->data), ==,
+		                 geocode_place_get_name (list->data));
+}
+
+static void
+benchmark (guint n_results,
+           guint n_rounds)
+{
+	Result *results;
+	gint64 tree_time = 0, time = 0;
+	guint i;
+
+	results = make_results (n_results);
+
+	for (i = 0; i < n_rounds; i++) {
+		GeocodePlace **tree_places, **places;
+		GList *tree_list, *list;
+		gint64 start;
+
+		tree_places = make_places (results, n_results);
+		places = make_places (results, n_results);
+
+		start = g_get_monotonic_time ();
+		tree_list = disambiguate_with_tree (tree_places, results, n_results);
+		tree_time += g_get_monotonic_time () - start;
+
+		start = g_get_monotonic_time ();
+		list = disambiguate_with_disambiguator (places, results, n_results);
+		time += g_get_monotonic_time () - start;
+
+		if (i == 0)
+			check_same (tree_list, list);
+
+		g_list_free_full (tree_list, g_object_unref);
+		g_list_free_full (list, g_object_unref);
+		g_free (tree_places);
+		g_free (places);
+	}
+
+	free_results (results, n_results);
+
+	g_print ("%5u results/response %10.1f ns/result (tree) %10.1f ns/result (disambiguator)\n",
+	         n_results,
+	         tree_time * 1000.0 / (n_rounds * n_results),
+	         time * 1000.0 / (n_rounds * n_results));
+}
+
+int
+main (int argc, char **argv)
+{
+	guint n_rounds = DEFAULT_N_ROUNDS;
+	guint i;
+
+	g_test_init (&argc, &argv, NULL);
+
+	if (argc > 1)
+		n_rounds = MAX (atoi (argv[1]), 1);
+
+	g_print ("%u rounds\n", n_rounds);
+
+	for (i = 0; i < G_N_ELEMENTS (response_sizes); i++)
+		benchmark (response_sizes[i], n_rounds);
+
+	return 0;
+}
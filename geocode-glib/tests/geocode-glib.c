@@ -28,8 +28,12 @@
 #include <locale.h>
 #include <glib/gi18n.h>
 #include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <gio/gio.h>
+#include <libsoup/soup.h>
 #include <geocode-glib/geocode-glib.h>
 #include <geocode-glib/geocode-glib-private.h>
 #include <geocode-glib/tests/geocode-nominatim-test.h>
@@ -521,6 +525,190 @@ test_search (void)
 	g_list_free_full (results, (GDestroyNotify) g_object_unref);
 }
 
+static void
+test_prepared_search (void)
+{
+	g_autoptr (GeocodeNominatim) backend = NULL;
+	g_autoptr (GeocodePreparedSearch) search = NULL;
+	g_autoptr (GHashTable) expected = NULL;
+	g_autoptr (GHashTable) params = NULL;
+	g_autofree char *response = NULL;
+	GError *error = NULL;
+	GList *results;
+
+	set_up_cache ();
+	backend = geocode_nominatim_test_new ();
+	response = load_json ("search.json");
+
+	/* The query parameters the mock server expects to receive, with the
+	 * defaults of a forward search. */
+	expected = g_hash_table_new (g_str_hash, g_str_equal);
+	add_attr_string (expected, "q", "paris");
+	add_attr_string (expected, "limit", "10");
+	add_attr_string (expected, "bounded", "0");
+	geocode_nominatim_test_expect_query (GEOCODE_NOMINATIM_TEST (backend),
+	                                     expected, response);
+
+	search = geocode_nominatim_prepare_search (backend, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (search);
+
+	g_assert_cmpint (geocode_prepared_search_get_priority (search), ==, G_PRIORITY_DEFAULT);
+	geocode_prepared_search_set_priority (search, G_PRIORITY_HIGH);
+	g_assert_cmpint (geocode_prepared_search_get_priority (search), ==, G_PRIORITY_HIGH);
+
+	results = geocode_nominatim_search_prepared (backend, search, "paris", NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (g_list_length (results), ==, 10);
+	g_list_free_full (results, g_object_unref);
+
+	/* The fixed parameters are passed on. */
+	g_clear_pointer (&search, geocode_prepared_search_unref);
+	g_clear_pointer (&expected, g_hash_table_unref);
+
+	expected = g_hash_table_new (g_str_hash, g_str_equal);
+	add_attr_string (expected, "q", "rue de la paix");
+	add_attr_string (expected, "limit", "3");
+	add_attr_string (expected, "bounded", "1");
+	add_attr_string (expected, "viewbox", "2.2,48.9,2.5,48.8");
+	geocode_nominatim_test_expect_query (GEOCODE_NOMINATIM_TEST (backend),
+	                                     expected, response);
+
+	params = g_hash_table_new (g_str_hash, g_str_equal);
+	add_attr_string (params, "limit", "3");
+	add_attr_string (params, "bounded", "1");
+	add_attr_string (params, "viewbox", "2.2,48.9,2.5,48.8");
+
+	search = geocode_nominatim_prepare_search (backend, params, &error);
+	g_assert_no_error (error);
+
+	results = geocode_nominatim_search_prepared (backend, search, "rue de la paix", NULL, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (results);
+	g_list_free_full (results, g_object_unref);
+
+	/* The search terms are required. */
+	results = geocode_nominatim_search_prepared (backend, search, "", NULL, &error);
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_INVALID_ARGUMENTS);
+	g_assert_null (results);
+	g_clear_error (&error);
+
+	/* Invalid and unsupported parameters are rejected. */
+	g_clear_pointer (&search, geocode_prepared_search_unref);
+
+	add_attr_string (params, "limit", "0");
+	search = geocode_nominatim_prepare_search (backend, params, &error);
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_INVALID_ARGUMENTS);
+	g_assert_null (search);
+	g_clear_error (&error);
+
+	add_attr_string (params, "limit", "3");
+	add_attr_string (params, "viewbox", "2.2,48.9,2.5");
+	search = geocode_nominatim_prepare_search (backend, params, &error);
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_INVALID_ARGUMENTS);
+	g_assert_null (search);
+	g_clear_error (&error);
+
+	g_hash_table_remove (params, "viewbox");
+	add_attr_string (params, "q", "paris");
+	search = geocode_nominatim_prepare_search (backend, params, &error);
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_INVALID_ARGUMENTS);
+	g_assert_null (search);
+	g_clear_error (&error);
+}
+
+static void
+got_batch_results_cb (GObject      *source_object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+	GeocodeBatchResults **results = user_data;
+	GError *error = NULL;
+
+	*results = geocode_backend_forward_search_batch_finish (GEOCODE_BACKEND (source_object),
+	                                                        result, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (*results);
+}
+
+static GHashTable *
+create_batch_params (const char *key,
+                     const char *value)
+{
+	GHashTable *params;
+
+	params = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                g_free, (GDestroyNotify) free_attr);
+	add_attr (params, key, value);
+
+	return params;
+}
+
+static void
+test_forward_search_batch (void)
+{
+	g_autoptr (GeocodeNominatim) backend = NULL;
+	g_autoptr (GeocodeBatchResults) results = NULL;
+	g_autoptr (GHashTable) expected = NULL;
+	g_autoptr (GPtrArray) params = NULL;
+	g_autofree char *response = NULL;
+	GList *places, *other_places;
+	GError *error = NULL;
+
+	set_up_cache ();
+	backend = geocode_nominatim_test_new ();
+	response = load_json ("search.json");
+
+	/* The query parameters the mock server expects to receive. */
+	expected = g_hash_table_new (g_str_hash, g_str_equal);
+	add_attr_string (expected, "q", "paris");
+	add_attr_string (expected, "limit", "10");
+	add_attr_string (expected, "bounded", "0");
+	geocode_nominatim_test_expect_query (GEOCODE_NOMINATIM_TEST (backend),
+	                                     expected, response);
+
+	params = g_ptr_array_new_with_free_func ((GDestroyNotify) g_hash_table_unref);
+	g_ptr_array_add (params, create_batch_params ("location", "paris"));
+	g_ptr_array_add (params, create_batch_params ("location", "nowhere"));
+	g_ptr_array_add (params, create_batch_params ("uri", "http://example.com/"));
+	g_ptr_array_add (params, create_batch_params ("location", "paris"));
+
+	geocode_backend_forward_search_batch_async (GEOCODE_BACKEND (backend),
+	                                            params, NULL,
+	                                            got_batch_results_cb, &results);
+
+	while (results == NULL)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_assert_cmpuint (geocode_batch_results_get_n_items (results), ==, 4);
+
+	/* Each item has its own results, even those which were searched for
+	 * once. */
+	places = geocode_batch_results_get_places (results, 0, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (g_list_length (places), ==, 10);
+
+	other_places = geocode_batch_results_get_places (results, 3, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (g_list_length (other_places), ==, 10);
+	g_assert_true (places->data != other_places->data);
+	g_assert_true (geocode_place_equal (places->data, other_places->data));
+
+	g_list_free_full (places, g_object_unref);
+	g_list_free_full (other_places, g_object_unref);
+
+	/* Failures are reported for the items which failed. */
+	places = geocode_batch_results_get_places (results, 1, &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+	g_assert_null (places);
+	g_clear_error (&error);
+
+	places = geocode_batch_results_get_places (results, 2, &error);
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_INVALID_ARGUMENTS);
+	g_assert_null (places);
+	g_clear_error (&error);
+}
+
 static void
 test_search_lat_long (void)
 {
@@ -876,6 +1064,1782 @@ test_search_json (void)
 	g_free (contents);
 }
 
+static void
+collect_search_result (GeocodePlace *place,
+                       gpointer      user_data)
+{
+	GPtrArray *places = user_data;
+
+	g_ptr_array_add (places, place);
+}
+
+static void
+test_search_parser (void)
+{
+	GError *error = NULL;
+	GList *expected, *list, *l, *m;
+	GeocodeSearchParser *parser;
+	GPtrArray *collected;
+	char *contents;
+	gsize length, offset, chunk_sizes[] = { 1, 7, 64, 4096 };
+	guint i;
+	g_autofree gchar *filename = NULL;
+
+	filename = g_test_build_filename (G_TEST_DIST, "nominatim-rio.json",
+	                                  NULL);
+	g_assert_true (g_file_get_contents (filename, &contents, &length, &error));
+	g_assert_no_error (error);
+
+	expected = _geocode_parse_search_json (contents, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (g_list_length (expected), ==, 10);
+
+	/* However the response is split up, the results are the same. */
+	for (i = 0; i < G_N_ELEMENTS (chunk_sizes); i++) {
+		parser = _geocode_search_parser_new ();
+
+		for (offset = 0; offset < length; offset += chunk_sizes[i]) {
+			g_assert_true (_geocode_search_parser_feed (parser,
+			                                            contents + offset,
+			                                            MIN (chunk_sizes[i], length - offset),
+			                                            &error));
+			g_assert_no_error (error);
+		}
+
+		list = _geocode_search_parser_finish (parser, &error);
+		g_assert_no_error (error);
+		_geocode_search_parser_free (parser);
+
+		g_assert_cmpint (g_list_length (list), ==, g_list_length (expected));
+		for (l = list, m = expected; l != NULL; l = l->next, m = m->next)
+			g_assert_cmpstr (geocode_place_get_name (l->data), ==,
+			                 geocode_place_get_name (m->data));
+
+		g_list_free_full (list, g_object_unref);
+	}
+
+	/* Results are parsed before the response is complete. */
+	parser = _geocode_search_parser_new ();
+	g_assert_true (_geocode_search_parser_feed (parser, contents, length / 2, &error));
+	g_assert_no_error (error);
+	g_assert_cmpuint (_geocode_search_parser_get_n_results (parser), >, 0);
+	g_assert_cmpuint (_geocode_search_parser_get_n_results (parser), <, 10);
+
+	/* A truncated response fails, and the results so far are freed. */
+	list = _geocode_search_parser_finish (parser, &error);
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE);
+	g_assert_null (list);
+	g_clear_error (&error);
+	_geocode_search_parser_free (parser);
+
+	/* Results are handed over as they are parsed, and named at the end. */
+	parser = _geocode_search_parser_new ();
+	collected = g_ptr_array_new ();
+	_geocode_search_parser_set_result_func (parser, collect_search_result,
+	                                        collected);
+
+	g_assert_true (_geocode_search_parser_feed (parser, contents, length / 2, &error));
+	g_assert_no_error (error);
+	g_assert_cmpuint (collected->len, >, 0);
+	g_assert_cmpuint (collected->len, ==,
+	                  _geocode_search_parser_get_n_results (parser));
+
+	g_assert_true (_geocode_search_parser_feed (parser, contents + length / 2,
+	                                            length - length / 2, &error));
+	g_assert_no_error (error);
+	g_assert_cmpuint (collected->len, ==, 10);
+
+	list = _geocode_search_parser_finish (parser, &error);
+	g_assert_no_error (error);
+	_geocode_search_parser_free (parser);
+
+	for (i = 0; i < collected->len; i++)
+		g_assert_nonnull (g_list_find (list, g_ptr_array_index (collected, i)));
+	for (l = list, m = expected; l != NULL; l = l->next, m = m->next)
+		g_assert_cmpstr (geocode_place_get_name (l->data), ==,
+		                 geocode_place_get_name (m->data));
+
+	g_ptr_array_unref (collected);
+	g_list_free_full (list, g_object_unref);
+
+	g_list_free_full (expected, g_object_unref);
+	g_free (contents);
+
+	list = _geocode_parse_search_json (" [ ] ", &error);
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_NO_MATCHES);
+	g_assert_null (list);
+	g_clear_error (&error);
+
+	list = _geocode_parse_search_json ("{ \"error\": \"Bad request\" }", &error);
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE);
+	g_assert_null (list);
+	g_clear_error (&error);
+
+	/* Other responses are buffered whole, however they are split up. */
+	contents = g_strdup ("{ \"error\": \"Bad request\" }");
+	length = strlen (contents);
+	parser = _geocode_search_parser_new ();
+
+	for (offset = 0; offset < length; offset += 3) {
+		g_assert_true (_geocode_search_parser_feed (parser,
+		                                            contents + offset,
+		                                            MIN (3, length - offset),
+		                                            &error));
+		g_assert_no_error (error);
+	}
+
+	list = _geocode_search_parser_finish (parser, &error);
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE);
+	g_assert_null (list);
+	g_clear_error (&error);
+	_geocode_search_parser_free (parser);
+	g_free (contents);
+
+	list = _geocode_parse_search_json ("[ { \"display_name\": \"a]\\\"}\" } ] x", &error);
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE);
+	g_assert_null (list);
+	g_clear_error (&error);
+}
+
+static gboolean
+decode_result (GeocodeNominatimResult  *result,
+               const char              *json,
+               GError                 **error)
+{
+	return _geocode_nominatim_result_decode (result, json, strlen (json), error);
+}
+
+static void
+test_result_decoder (void)
+{
+	GeocodeNominatimResult *result;
+	GError *error = NULL;
+	g_autofree char *street_name = NULL;
+
+	result = _geocode_nominatim_result_new ();
+
+	/* Escapes are decoded, unknown members skipped, and integers kept. */
+	g_assert_true (decode_result (result,
+	                              "{ \"display_name\": \"Caf\\u00e9 \\\"Le \\ud83c\\udf7a\\\"\", "
+	                              "\"extratags\": { \"a\": [ 1, { \"b\": null } ] }, "
+	                              "\"osm_id\": 42, \"importance\": 0.5, \"name\": \"\", "
+	                              "\"boundingbox\": [ \"-1.5\", 2, -3e1, \"4\" ] }",
+	                              &error));
+	g_assert_no_error (error);
+	g_assert_cmpstr (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_DISPLAY_NAME),
+	                 ==, "Café \"Le \xf0\x9f\x8d\xba\"");
+	g_assert_cmpstr (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_OSM_ID), ==, "42");
+	g_assert_null (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_NAME));
+	g_assert_cmpstr (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_BOTTOM), ==, "-1.5");
+	g_assert_cmpstr (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_TOP), ==, "2");
+	g_assert_cmpstr (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_LEFT), ==, "-3e1");
+	g_assert_cmpstr (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_BOUNDING_BOX_RIGHT), ==, "4");
+	g_assert_false (_geocode_nominatim_result_has_error (result));
+
+	/* The address overrides the result, whatever the order, and a house
+	 * number and road give the name. Decoding again resets the result. */
+	g_assert_true (decode_result (result,
+	                              "{ \"address\": { \"house_number\": \"10\", \"road\": \"High Street\", "
+	                              "\"city\": \"Guildford\" }, \"city\": \"London\", \"country\": \"UK\" }",
+	                              &error));
+	g_assert_no_error (error);
+	street_name = _geocode_object_is_number_after_street () ?
+	              g_strdup ("High Street 10") : g_strdup ("10 High Street");
+	g_assert_cmpstr (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_NAME), ==, street_name);
+	g_assert_cmpstr (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_CITY), ==, "Guildford");
+	g_assert_cmpstr (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_COUNTRY), ==, "UK");
+	g_assert_null (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_DISPLAY_NAME));
+	g_assert_null (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_OSM_ID));
+
+	/* Otherwise the first member of the address is the name. */
+	g_assert_true (decode_result (result,
+	                              "{ \"address\": { \"pub\": \"The Astolat\", \"road\": \"Old Palace Road\" } }",
+	                              &error));
+	g_assert_no_error (error);
+	g_assert_cmpstr (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_NAME), ==, "The Astolat");
+
+	g_assert_true (decode_result (result, "{ \"error\": \"Unable to geocode\" }", &error));
+	g_assert_no_error (error);
+	g_assert_true (_geocode_nominatim_result_has_error (result));
+	g_assert_cmpstr (_geocode_nominatim_result_get (result, GEOCODE_NOMINATIM_FIELD_ERROR), ==, "Unable to geocode");
+
+	/* Invalid results. */
+	g_assert_false (decode_result (result, "[ ]", &error));
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE);
+	g_clear_error (&error);
+
+	g_assert_false (decode_result (result, "{ \"name\": \"a\" } x", &error));
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE);
+	g_clear_error (&error);
+
+	g_assert_false (decode_result (result, "{ \"name\": \"\\ud83c\" }", &error));
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE);
+	g_clear_error (&error);
+
+	g_assert_false (decode_result (result, "{ \"name\": \"a\", }", &error));
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_PARSE);
+	g_clear_error (&error);
+
+	_geocode_nominatim_result_free (result);
+}
+
+static void
+test_place_type (void)
+{
+	GeocodeNominatimResult *result;
+	guint i;
+	struct {
+		const char *category;
+		const char *type;
+		const char *place_rank;
+		GeocodePlaceType place_type;
+	} tests[] = {
+		{ "place", "house", NULL, GEOCODE_PLACE_TYPE_BUILDING },
+		{ "place", "building", NULL, GEOCODE_PLACE_TYPE_BUILDING },
+		{ "place", "residential", NULL, GEOCODE_PLACE_TYPE_BUILDING },
+		{ "place", "plaza", NULL, GEOCODE_PLACE_TYPE_BUILDING },
+		{ "place", "office", NULL, GEOCODE_PLACE_TYPE_BUILDING },
+		{ "place", "estate", NULL, GEOCODE_PLACE_TYPE_ESTATE },
+		{ "place", "town", NULL, GEOCODE_PLACE_TYPE_TOWN },
+		{ "place", "city", NULL, GEOCODE_PLACE_TYPE_TOWN },
+		{ "place", "hamlet", NULL, GEOCODE_PLACE_TYPE_TOWN },
+		{ "place", "isolated_dwelling", NULL, GEOCODE_PLACE_TYPE_TOWN },
+		{ "place", "village", NULL, GEOCODE_PLACE_TYPE_TOWN },
+		{ "place", "suburb", NULL, GEOCODE_PLACE_TYPE_SUBURB },
+		{ "place", "neighbourhood", NULL, GEOCODE_PLACE_TYPE_SUBURB },
+		{ "place", "state", NULL, GEOCODE_PLACE_TYPE_STATE },
+		{ "place", "region", NULL, GEOCODE_PLACE_TYPE_STATE },
+		{ "place", "farm", NULL, GEOCODE_PLACE_TYPE_LAND_FEATURE },
+		{ "place", "forest", NULL, GEOCODE_PLACE_TYPE_LAND_FEATURE },
+		{ "place", "valey", NULL, GEOCODE_PLACE_TYPE_LAND_FEATURE },
+		{ "place", "park", NULL, GEOCODE_PLACE_TYPE_LAND_FEATURE },
+		{ "place", "hill", NULL, GEOCODE_PLACE_TYPE_LAND_FEATURE },
+		{ "place", "island", NULL, GEOCODE_PLACE_TYPE_ISLAND },
+		{ "place", "islet", NULL, GEOCODE_PLACE_TYPE_ISLAND },
+		{ "place", "country", NULL, GEOCODE_PLACE_TYPE_COUNTRY },
+		{ "place", "continent", NULL, GEOCODE_PLACE_TYPE_CONTINENT },
+		{ "place", "lake", NULL, GEOCODE_PLACE_TYPE_DRAINAGE },
+		{ "place", "bay", NULL, GEOCODE_PLACE_TYPE_DRAINAGE },
+		{ "place", "river", NULL, GEOCODE_PLACE_TYPE_DRAINAGE },
+		{ "place", "sea", NULL, GEOCODE_PLACE_TYPE_SEA },
+		{ "place", "ocean", NULL, GEOCODE_PLACE_TYPE_OCEAN },
+		{ "highway", "motorway", NULL, GEOCODE_PLACE_TYPE_MOTORWAY },
+		{ "highway", "bus_stop", NULL, GEOCODE_PLACE_TYPE_BUS_STOP },
+		{ "railway", "station", NULL, GEOCODE_PLACE_TYPE_RAILWAY_STATION },
+		{ "railway", "halt", NULL, GEOCODE_PLACE_TYPE_RAILWAY_STATION },
+		{ "railway", "tram_stop", NULL, GEOCODE_PLACE_TYPE_LIGHT_RAIL_STATION },
+		{ "amenity", "school", NULL, GEOCODE_PLACE_TYPE_SCHOOL },
+		{ "amenity", "place_of_worship", NULL, GEOCODE_PLACE_TYPE_PLACE_OF_WORSHIP },
+		{ "amenity", "restaurant", NULL, GEOCODE_PLACE_TYPE_RESTAURANT },
+		{ "amenity", "bar", NULL, GEOCODE_PLACE_TYPE_BAR },
+		{ "amenity", "pub", NULL, GEOCODE_PLACE_TYPE_BAR },
+		{ "aeroway", "aerodrome", NULL, GEOCODE_PLACE_TYPE_AIRPORT },
+		{ "highway", "residential", NULL, GEOCODE_PLACE_TYPE_STREET },
+		{ "highway", NULL, NULL, GEOCODE_PLACE_TYPE_STREET },
+		{ "waterway", "canal", NULL, GEOCODE_PLACE_TYPE_DRAINAGE },
+		{ "boundary", "administrative", "28", GEOCODE_PLACE_TYPE_BUILDING },
+		{ "boundary", "administrative", "16", GEOCODE_PLACE_TYPE_TOWN },
+		{ "boundary", "administrative", "12", GEOCODE_PLACE_TYPE_COUNTY },
+		{ "boundary", "administrative", "10", GEOCODE_PLACE_TYPE_STATE },
+		{ "boundary", "administrative", "8", GEOCODE_PLACE_TYPE_STATE },
+		{ "boundary", "administrative", "4", GEOCODE_PLACE_TYPE_COUNTRY },
+		{ "boundary", "administrative", "1", GEOCODE_PLACE_TYPE_UNKNOWN },
+		{ "boundary", "administrative", NULL, GEOCODE_PLACE_TYPE_UNKNOWN },
+		{ "boundary", "postal_code", "4", GEOCODE_PLACE_TYPE_UNKNOWN },
+		{ "place", "locality", NULL, GEOCODE_PLACE_TYPE_UNKNOWN },
+		{ "railway", "rail", NULL, GEOCODE_PLACE_TYPE_UNKNOWN },
+		{ "shop", "bakery", NULL, GEOCODE_PLACE_TYPE_UNKNOWN },
+		{ NULL, "city", NULL, GEOCODE_PLACE_TYPE_UNKNOWN },
+	};
+
+	result = _geocode_nominatim_result_new ();
+
+	for (i = 0; i < G_N_ELEMENTS (tests); i++) {
+		g_autoptr (GString) json = g_string_new ("{ \"osm_id\": 1");
+		GError *error = NULL;
+
+		if (tests[i].category != NULL)
+			g_string_append_printf (json, ", \"category\": \"%s\"", tests[i].category);
+		if (tests[i].type != NULL)
+			g_string_append_printf (json, ", \"type\": \"%s\"", tests[i].type);
+		if (tests[i].place_rank != NULL)
+			g_string_append_printf (json, ", \"place_rank\": %s", tests[i].place_rank);
+		g_string_append (json, " }");
+
+		g_assert_true (_geocode_nominatim_result_decode (result, json->str, json->len, &error));
+		g_assert_no_error (error);
+		g_assert_cmpint (_geocode_nominatim_result_get_place_type (result), ==, tests[i].place_type);
+	}
+
+	_geocode_nominatim_result_free (result);
+}
+
+static void
+test_result_members (void)
+{
+	GeocodeNominatimResult *result;
+	GError *error = NULL;
+	const char *json;
+	guint i;
+
+	/* Every member which is kept is found. */
+	json = "{ \"name\": \"0\", \"display_name\": \"1\", \"lat\": \"2\", \"lon\": \"3\", "
+	       "\"boundingbox\": [ \"4\", \"5\", \"6\", \"7\" ], \"category\": \"8\", "
+	       "\"type\": \"9\", \"place_rank\": 10, \"osm_id\": 11, \"osm_type\": \"12\", "
+	       "\"address\": { \"house_number\": \"13\", \"road\": \"14\", \"suburb\": \"15\", "
+	       "\"village\": \"16\", \"city\": \"17\", \"county\": \"18\", "
+	       "\"state_district\": \"19\", \"state\": \"20\", \"postcode\": \"21\", "
+	       "\"country\": \"22\", \"country_code\": \"23\", \"continent\": \"24\" }, "
+	       "\"error\": \"25\" }";
+
+	result = _geocode_nominatim_result_new ();
+	g_assert_true (_geocode_nominatim_result_decode (result, json, strlen (json), &error));
+	g_assert_no_error (error);
+	g_assert_true (_geocode_nominatim_result_has_error (result));
+
+	/* The name is overridden by the house number and road. */
+	for (i = GEOCODE_NOMINATIM_FIELD_NAME + 1; i < GEOCODE_NOMINATIM_N_FIELDS; i++) {
+		g_autofree char *expected = g_strdup_printf ("%u", i);
+
+		g_assert_cmpstr (_geocode_nominatim_result_get (result, i), ==, expected);
+	}
+
+	_geocode_nominatim_result_free (result);
+}
+
+static void
+test_place_fields (void)
+{
+	GList *list;
+	GeocodePlace *place;
+	GeocodeLocation *loc;
+	GeocodeBoundingBox *bbox;
+	GError *error = NULL;
+	g_autofree char *street_address = NULL;
+
+	/* Every field of the place is set from the result. */
+	list = _geocode_parse_search_json ("[ { \"osm_type\": \"way\", \"osm_id\": 1234, "
+	                                   "\"lat\": \"51.5\", \"lon\": \"-0.5\", "
+	                                   "\"boundingbox\": [ \"51.4\", \"51.6\", \"-0.6\", \"-0.4\" ], "
+	                                   "\"category\": \"amenity\", \"type\": \"pub\", "
+	                                   "\"display_name\": \"The Astolat, Guildford\", "
+	                                   "\"address\": { \"pub\": \"The Astolat\", \"house_number\": \"7\", "
+	                                   "\"road\": \"Old Palace Road\", \"suburb\": \"Guildford Park\", "
+	                                   "\"village\": \"Onslow\", \"city\": \"Guildford\", "
+	                                   "\"county\": \"Surrey\", \"state_district\": \"South East\", "
+	                                   "\"state\": \"England\", \"postcode\": \"GU2 7NU\", "
+	                                   "\"country\": \"United Kingdom\", \"country_code\": \"gb\", "
+	                                   "\"continent\": \"Europe\" } } ]", &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (g_list_length (list), ==, 1);
+
+	place = list->data;
+	street_address = _geocode_object_is_number_after_street () ?
+	                 g_strdup ("Old Palace Road 7") : g_strdup ("7 Old Palace Road");
+
+	g_assert_cmpstr (geocode_place_get_name (place), ==, "The Astolat");
+	g_assert_cmpint (geocode_place_get_place_type (place), ==, GEOCODE_PLACE_TYPE_BAR);
+	g_assert_cmpint (geocode_place_get_osm_type (place), ==, GEOCODE_PLACE_OSM_TYPE_WAY);
+	g_assert_cmpstr (geocode_place_get_osm_id (place), ==, "1234");
+	g_assert_cmpstr (geocode_place_get_street_address (place), ==, street_address);
+	g_assert_cmpstr (geocode_place_get_street (place), ==, "Old Palace Road");
+	g_assert_cmpstr (geocode_place_get_building (place), ==, "7");
+	g_assert_cmpstr (geocode_place_get_area (place), ==, "Guildford Park");
+	g_assert_cmpstr (geocode_place_get_town (place), ==, "Guildford");
+	g_assert_cmpstr (geocode_place_get_county (place), ==, "Surrey");
+	g_assert_cmpstr (geocode_place_get_administrative_area (place), ==, "South East");
+	g_assert_cmpstr (geocode_place_get_state (place), ==, "England");
+	g_assert_cmpstr (geocode_place_get_postal_code (place), ==, "GU2 7NU");
+	g_assert_cmpstr (geocode_place_get_country (place), ==, "United Kingdom");
+	g_assert_cmpstr (geocode_place_get_country_code (place), ==, "gb");
+	g_assert_cmpstr (geocode_place_get_continent (place), ==, "Europe");
+
+	loc = geocode_place_get_location (place);
+	g_assert_nonnull (loc);
+	g_assert_cmpfloat (geocode_location_get_latitude (loc), ==, 51.5);
+	g_assert_cmpfloat (geocode_location_get_longitude (loc), ==, -0.5);
+	g_assert_cmpfloat (geocode_location_get_accuracy (loc), ==, GEOCODE_LOCATION_ACCURACY_UNKNOWN);
+	g_assert_cmpstr (geocode_location_get_description (loc), ==, "The Astolat");
+	g_assert_cmpuint (geocode_location_get_timestamp (loc), >, 0);
+
+	bbox = geocode_place_get_bounding_box (place);
+	g_assert_nonnull (bbox);
+	g_assert_cmpfloat (geocode_bounding_box_get_bottom (bbox), ==, 51.4);
+	g_assert_cmpfloat (geocode_bounding_box_get_top (bbox), ==, 51.6);
+	g_assert_cmpfloat (geocode_bounding_box_get_left (bbox), ==, -0.6);
+	g_assert_cmpfloat (geocode_bounding_box_get_right (bbox), ==, -0.4);
+
+	g_list_free_full (list, g_object_unref);
+}
+
+static void
+test_disambiguation (void)
+{
+	/* The name, then the country, state, county, state district,
+	 * postcode, city, suburb and village of each place. */
+	const char *places[][9] = {
+		{ "Guildford", "United Kingdom", "England", "Surrey", NULL, NULL, "Guildford", NULL, NULL },
+		{ "Guildford Park", "united kingdom", "England", "Surrey", NULL, NULL, "Guildford", "Guildford Park", NULL },
+		{ "Guildford", "Australia", "Western Australia", NULL, NULL, NULL, "Perth", "Guildford", NULL },
+		{ "Guildford", "United Kingdom", "England", "Surrey", NULL, NULL, "guildford", "Onslow", NULL },
+		{ "Nowhere", NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+		{ "Guildford", "Canada", "Nova Scotia", NULL, NULL, NULL, NULL, NULL, NULL },
+		{ NULL, "Australia", "New South Wales", NULL, NULL, NULL, NULL, NULL, NULL },
+	};
+	/* The places are grouped by country, ignoring case. A place with a
+	 * value is grouped with the first place before it which lacks one,
+	 * so the suburbs of the places in Guildford, and the country of the
+	 * place in Canada, are not given. */
+	const struct {
+		guint place;
+		const char *name;
+	} expected[] = {
+		{ 0, "Guildford, United Kingdom" },
+		{ 1, "Guildford Park, United Kingdom" },
+		{ 3, "Guildford, United Kingdom" },
+		{ 2, "Guildford, Western Australia, Australia" },
+		{ 6, "" },
+		{ 4, "Nowhere" },
+		{ 5, "Guildford" },
+	};
+	GeocodePlace *added[G_N_ELEMENTS (places)];
+	GeocodeDisambiguator *disambiguator;
+	GList *list, *l;
+	guint i;
+
+	disambiguator = _geocode_disambiguator_new (G_N_ELEMENTS (places[0]) - 1);
+
+	for (i = 0; i < G_N_ELEMENTS (places); i++) {
+		g_autoptr (GeocodeLocation) loc = NULL;
+
+		loc = geocode_location_new (i, i, GEOCODE_LOCATION_ACCURACY_UNKNOWN);
+		added[i] = geocode_place_new_with_location (places[i][0],
+		                                            GEOCODE_PLACE_TYPE_TOWN,
+		                                            loc);
+		_geocode_disambiguator_add (disambiguator, added[i], places[i] + 1);
+	}
+
+	g_assert_cmpuint (_geocode_disambiguator_get_n_places (disambiguator), ==, G_N_ELEMENTS (places));
+
+	list = _geocode_disambiguator_finish (disambiguator);
+	_geocode_disambiguator_free (disambiguator);
+
+	g_assert_cmpint (g_list_length (list), ==, G_N_ELEMENTS (expected));
+
+	for (l = list, i = 0; l != NULL; l = l->next, i++) {
+		GeocodePlace *place = l->data;
+
+		g_assert_true (place == added[expected[i].place]);
+		g_assert_cmpstr (geocode_place_get_name (place), ==, expected[i].name);
+		g_assert_cmpstr (geocode_location_get_description (geocode_place_get_location (place)), ==,
+		                 expected[i].name);
+	}
+
+	g_list_free_full (list, g_object_unref);
+}
+
+static void
+test_connection_pool (void)
+{
+	g_autoptr (GeocodeNominatim) backend = NULL;
+	guint max_connections, max_connections_per_host, idle_timeout;
+
+	backend = geocode_nominatim_new ("http://example.invalid",
+	                                 "maintainer@invalid");
+
+	g_object_get (backend,
+	              "max-connections", &max_connections,
+	              "max-connections-per-host", &max_connections_per_host,
+	              "idle-timeout", &idle_timeout,
+	              NULL);
+	g_assert_cmpuint (max_connections, ==, 10);
+	g_assert_cmpuint (max_connections_per_host, ==, 2);
+	g_assert_cmpuint (idle_timeout, ==, 60);
+
+	g_object_set (backend,
+	              "max-connections", 32,
+	              "max-connections-per-host", 8,
+	              "idle-timeout", 5,
+	              NULL);
+	g_object_get (backend,
+	              "max-connections", &max_connections,
+	              "max-connections-per-host", &max_connections_per_host,
+	              "idle-timeout", &idle_timeout,
+	              NULL);
+	g_assert_cmpuint (max_connections, ==, 32);
+	g_assert_cmpuint (max_connections_per_host, ==, 8);
+	g_assert_cmpuint (idle_timeout, ==, 5);
+}
+
+/* Holds each request until respond_to_request() is called for it. */
+static void
+pause_request_cb (SoupServer        *server,
+                  SoupMessage       *message,
+                  const char        *path,
+                  GHashTable        *query,
+                  SoupClientContext *client,
+                  gpointer           user_data)
+{
+	GPtrArray *messages = user_data;
+
+	soup_server_pause_message (server, message);
+	g_ptr_array_add (messages, g_object_ref (message));
+}
+
+static void
+respond_to_request (SoupServer  *server,
+                    SoupMessage *message)
+{
+	soup_message_set_status (message, SOUP_STATUS_OK);
+	soup_message_set_response (message, "application/json",
+	                           SOUP_MEMORY_STATIC, "[]", 2);
+	soup_server_unpause_message (server, message);
+}
+
+typedef struct {
+	gboolean done;
+	char *contents;
+	GError *error;
+} QueryResult;
+
+static void
+got_query_cb (GObject      *source_object,
+              GAsyncResult *result,
+              gpointer      user_data)
+{
+	GeocodeNominatim *backend = GEOCODE_NOMINATIM (source_object);
+	QueryResult *query_result = user_data;
+
+	query_result->contents = GEOCODE_NOMINATIM_GET_CLASS (backend)->query_finish (backend,
+	                                                                              result,
+	                                                                              &query_result->error);
+	query_result->done = TRUE;
+}
+
+static void
+query_result_clear (QueryResult *query_result)
+{
+	g_clear_pointer (&query_result->contents, g_free);
+	g_clear_error (&query_result->error);
+	query_result->done = FALSE;
+}
+
+static void
+test_query_coalescing (void)
+{
+	SoupServer *server;
+	g_autoptr (GPtrArray) messages = NULL;
+	g_autoptr (GeocodeNominatim) backend = NULL;
+	g_autoptr (GCancellable) cancellable = NULL;
+	g_autoptr (GCancellable) other_cancellable = NULL;
+	g_autofree char *base_url = NULL;
+	g_autofree char *uri = NULL;
+	g_autofree char *other_uri = NULL;
+	GeocodeNominatimClass *klass;
+	QueryResult a = { 0, }, b = { 0, }, c = { 0, };
+	GError *error = NULL;
+	GSList *uris;
+
+	messages = g_ptr_array_new_with_free_func (g_object_unref);
+
+	server = soup_server_new (NULL, NULL);
+	soup_server_add_handler (server, NULL, pause_request_cb, messages, NULL);
+	soup_server_listen_local (server, 0, 0, &error);
+	g_assert_no_error (error);
+
+	/* Without the trailing slash. */
+	uris = soup_server_get_uris (server);
+	base_url = soup_uri_to_string (uris->data, FALSE);
+	base_url[strlen (base_url) - 1] = '\0';
+	g_slist_free_full (uris, (GDestroyNotify) soup_uri_free);
+
+	uri = g_strconcat (base_url, "/search?q=paris", NULL);
+	other_uri = g_strconcat (base_url, "/search?q=london", NULL);
+
+	/* With a single connection, a request holds it until it is answered
+	 * or cancelled. */
+	backend = geocode_nominatim_new (base_url, "maintainer@invalid");
+	g_object_set (backend, "max-connections-per-host", 1, NULL);
+	klass = GEOCODE_NOMINATIM_GET_CLASS (backend);
+
+	/* Identical queries in flight share a request, and both get its
+	 * response. */
+	klass->query_async (backend, uri, NULL, got_query_cb, &a);
+	klass->query_async (backend, uri, NULL, got_query_cb, &b);
+
+	while (messages->len < 1)
+		g_main_context_iteration (NULL, TRUE);
+
+	respond_to_request (server, g_ptr_array_index (messages, 0));
+
+	while (!a.done || !b.done)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_assert_no_error (a.error);
+	g_assert_cmpstr (a.contents, ==, "[]");
+	g_assert_no_error (b.error);
+	g_assert_cmpstr (b.contents, ==, "[]");
+	g_assert_cmpuint (messages->len, ==, 1);
+
+	query_result_clear (&a);
+	query_result_clear (&b);
+
+	/* Cancelling one of them only fails that one. */
+	cancellable = g_cancellable_new ();
+
+	klass->query_async (backend, uri, cancellable, got_query_cb, &a);
+	klass->query_async (backend, uri, NULL, got_query_cb, &b);
+
+	while (messages->len < 2)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_cancellable_cancel (cancellable);
+
+	while (!a.done)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_assert_error (a.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+	g_assert_null (a.contents);
+	g_assert_false (b.done);
+
+	respond_to_request (server, g_ptr_array_index (messages, 1));
+
+	while (!b.done)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_assert_no_error (b.error);
+	g_assert_cmpstr (b.contents, ==, "[]");
+	g_assert_cmpuint (messages->len, ==, 2);
+
+	query_result_clear (&a);
+	query_result_clear (&b);
+	g_clear_object (&cancellable);
+
+	/* Cancelling all of them cancels the request, which releases the
+	 * connection for another query. */
+	cancellable = g_cancellable_new ();
+	other_cancellable = g_cancellable_new ();
+
+	klass->query_async (backend, uri, cancellable, got_query_cb, &a);
+	klass->query_async (backend, uri, other_cancellable, got_query_cb, &b);
+
+	while (messages->len < 3)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_cancellable_cancel (cancellable);
+	g_cancellable_cancel (other_cancellable);
+
+	while (!a.done || !b.done)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_assert_error (a.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+	g_assert_error (b.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+
+	klass->query_async (backend, other_uri, NULL, got_query_cb, &c);
+
+	while (messages->len < 4)
+		g_main_context_iteration (NULL, TRUE);
+
+	respond_to_request (server, g_ptr_array_index (messages, 3));
+
+	while (!c.done)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_assert_no_error (c.error);
+	g_assert_cmpstr (c.contents, ==, "[]");
+
+	query_result_clear (&a);
+	query_result_clear (&b);
+	query_result_clear (&c);
+
+	soup_server_disconnect (server);
+	g_object_unref (server);
+}
+
+static void
+test_language (void)
+{
+	g_autoptr (GeocodeNominatim) backend = NULL;
+	g_autofree char *old_locale = NULL;
+	char *lang, *language;
+
+	old_locale = g_strdup (setlocale (LC_MESSAGES, NULL));
+
+	/* The language follows the locale, as it changes. */
+	setlocale (LC_MESSAGES, "C");
+	lang = _geocode_object_get_lang ();
+	g_assert_cmpstr (lang, ==, "C");
+	g_free (lang);
+
+	if (setlocale (LC_MESSAGES, "en_GB.UTF-8") != NULL) {
+		lang = _geocode_object_get_lang ();
+		g_assert_cmpstr (lang, ==, "en-GB");
+		g_free (lang);
+
+		lang = _geocode_object_get_lang ();
+		g_assert_cmpstr (lang, ==, "en-GB");
+		g_free (lang);
+	}
+
+	setlocale (LC_MESSAGES, "C");
+	lang = _geocode_object_get_lang ();
+	g_assert_cmpstr (lang, ==, "C");
+	g_free (lang);
+
+	setlocale (LC_MESSAGES, old_locale);
+
+	/* The locale's language is used unless it is overridden. */
+	backend = geocode_nominatim_new ("http://example.invalid",
+	                                 "maintainer@invalid");
+
+	g_object_get (backend, "language", &language, NULL);
+	g_assert_null (language);
+
+	g_object_set (backend, "language", "de-AT", NULL);
+	g_object_get (backend, "language", &language, NULL);
+	g_assert_cmpstr (language, ==, "de-AT");
+	g_free (language);
+
+	g_object_set (backend, "language", NULL, NULL);
+	g_object_get (backend, "language", &language, NULL);
+	g_assert_null (language);
+}
+
+/* Replay a log of queries as they would be issued by different clients, and
+ * check that semantically identical ones share a cache key. */
+static void
+test_cache_key (void)
+{
+	g_autoptr (GHashTable) raw_keys = NULL, canonical_keys = NULL;
+	guint raw_hits = 0, canonical_hits = 0;
+	guint i;
+	const char *query_log[] = {
+		"http://example.invalid/search?q=paris&format=jsonv2&email=a%40example.invalid&limit=10",
+		"http://example.invalid/search?limit=10&q=paris&format=jsonv2&email=b%40example.invalid",
+		"http://example.invalid/search?format=jsonv2&q=%20Paris%20&limit=10",
+		"http://example.invalid/search?format=jsonv2&q=PARIS&limit=10",
+		"http://example.invalid/search?format=jsonv2&q=paris&limit=1",
+		"http://example.invalid/search?format=jsonv2&q=old%20%20palace%20road&limit=10",
+		"http://example.invalid/search?q=Old+Palace+Road&format=jsonv2&limit=10",
+		"http://example.invalid/reverse?lat=1&lon=2&format=json&accept-language=en-GB",
+		"http://example.invalid/reverse?format=json&accept-language=en-gb&lon=2&lat=1",
+	};
+
+	raw_keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	canonical_keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	for (i = 0; i < G_N_ELEMENTS (query_log); i++) {
+		SoupURI *uri;
+		char *raw_key, *canonical_key;
+
+		uri = soup_uri_new (query_log[i]);
+		g_assert_nonnull (uri);
+
+		raw_key = soup_uri_to_string (uri, FALSE);
+		canonical_key = _geocode_glib_cache_key_for_uri (uri);
+		soup_uri_free (uri);
+
+		g_test_message ("%s -> %s", query_log[i], canonical_key);
+
+		if (!g_hash_table_add (raw_keys, raw_key))
+			raw_hits++;
+		if (!g_hash_table_add (canonical_keys, canonical_key))
+			canonical_hits++;
+	}
+
+	g_test_message ("Replayed %u queries: %u hits with raw keys, %u hits with canonical keys",
+	                (guint) G_N_ELEMENTS (query_log), raw_hits, canonical_hits);
+
+	g_assert_cmpuint (raw_hits, ==, 0);
+	g_assert_cmpuint (canonical_hits, ==, 5);
+	g_assert_cmpuint (g_hash_table_size (canonical_keys), ==, 4);
+
+	/* A key split around its search terms gives the keys for other ones,
+	 * including when parameters sort after `q`. */
+	for (i = 0; i < 2; i++) {
+		SoupURI *uri;
+		g_autofree char *prefix = NULL, *suffix = NULL;
+		g_autofree char *key = NULL, *text = NULL, *split_key = NULL;
+
+		uri = soup_uri_new (i == 0 ?
+		                    "http://example.invalid/search?format=jsonv2&q=&limit=10" :
+		                    "http://example.invalid/search?format=jsonv2&q=&viewbox=1,2,3,4");
+		prefix = _geocode_glib_cache_key_split_for_uri (uri, &suffix);
+		soup_uri_set_query_from_fields (uri, "format", "jsonv2",
+		                                "q", " Old  Palace Road&Co ",
+		                                (i == 0) ? "limit" : "viewbox",
+		                                (i == 0) ? "10" : "1,2,3,4",
+		                                NULL);
+		key = _geocode_glib_cache_key_for_uri (uri);
+		soup_uri_free (uri);
+
+		text = _geocode_glib_cache_key_encode_free_text (" Old  Palace Road&Co ");
+		split_key = g_strconcat (prefix, text, suffix, NULL);
+		g_assert_cmpstr (split_key, ==, key);
+	}
+}
+
+static void
+test_memory_cache (void)
+{
+	g_autoptr (GHashTable) params = NULL;
+	g_autoptr (GeocodeNominatim) backend = NULL;
+	g_autoptr (GeocodeNominatim) offline_backend = NULL;
+	g_autoptr (GeocodeForward) forward = NULL;
+	g_autofree gchar *expected_response = NULL;
+	GList *first, *second, *third, *l, *m;
+	GError *error = NULL;
+	guint hits, misses;
+
+	set_up_cache ();
+	_geocode_memory_cache_clear ();
+
+	params = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, NULL);
+	add_attr_string (params, "q", "paris");
+	add_attr_string (params, "limit", "10");
+	add_attr_string (params, "bounded", "0");
+
+	expected_response = load_json ("search.json");
+
+	backend = geocode_nominatim_test_new ();
+	g_object_set (backend, "memory-cache-enabled", TRUE, NULL);
+	geocode_nominatim_test_expect_query (GEOCODE_NOMINATIM_TEST (backend),
+	                                     params, expected_response);
+
+	forward = geocode_forward_new_for_string ("paris");
+	geocode_forward_set_backend (forward, GEOCODE_BACKEND (backend));
+
+	first = geocode_forward_search (forward, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (g_list_length (first), ==, 10);
+
+	/* A backend with no canned responses can only answer from the
+	 * in-memory cache. */
+	offline_backend = geocode_nominatim_test_new ();
+	g_object_set (offline_backend, "memory-cache-enabled", TRUE, NULL);
+	geocode_forward_set_backend (forward, GEOCODE_BACKEND (offline_backend));
+
+	second = geocode_forward_search (forward, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (g_list_length (second), ==, g_list_length (first));
+
+	for (l = first, m = second; l != NULL; l = l->next, m = m->next) {
+		g_assert_true (l->data != m->data);
+		g_assert_true (geocode_place_equal (l->data, m->data));
+	}
+
+	/* Modifying a result must not modify the cached copy. */
+	geocode_place_set_name (second->data, "Not Paris");
+
+	third = geocode_forward_search (forward, &error);
+	g_assert_no_error (error);
+	g_assert_true (geocode_place_equal (first->data, third->data));
+
+	_geocode_memory_cache_get_stats (&hits, &misses, NULL);
+	g_assert_cmpuint (hits, ==, 2);
+	g_assert_cmpuint (misses, ==, 1);
+
+	/* Shrinking the cache to nothing evicts everything. */
+	geocode_nominatim_set_memory_cache_size (0);
+	g_assert_null (geocode_forward_search (forward, &error));
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+	g_clear_error (&error);
+
+	geocode_nominatim_set_memory_cache_size (GEOCODE_MEMORY_CACHE_DEFAULT_CAPACITY);
+
+	/* Results go stale in memory after the cache TTL, like on disk. */
+	g_object_set (backend, "cache-enabled", FALSE, "cache-ttl", 1, NULL);
+	g_object_set (offline_backend, "cache-enabled", FALSE, NULL);
+
+	geocode_forward_set_backend (forward, GEOCODE_BACKEND (backend));
+	g_list_free_full (third, g_object_unref);
+	third = geocode_forward_search (forward, &error);
+	g_assert_no_error (error);
+
+	geocode_forward_set_backend (forward, GEOCODE_BACKEND (offline_backend));
+	g_usleep (1100 * G_TIME_SPAN_MILLISECOND);
+	g_assert_null (geocode_forward_search (forward, &error));
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+	g_clear_error (&error);
+
+	g_list_free_full (first, g_object_unref);
+	g_list_free_full (second, g_object_unref);
+	g_list_free_full (third, g_object_unref);
+}
+
+static void
+test_negative_cache (void)
+{
+	g_autoptr (GHashTable) params = NULL;
+	g_autoptr (GeocodeNominatim) backend = NULL;
+	g_autoptr (GeocodeNominatim) offline_backend = NULL;
+	g_autoptr (GeocodeForward) forward = NULL;
+	GError *error = NULL;
+
+	set_up_cache ();
+	_geocode_memory_cache_clear ();
+
+	params = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, NULL);
+	add_attr_string (params, "q", "xyzzy");
+	add_attr_string (params, "limit", "10");
+	add_attr_string (params, "bounded", "0");
+
+	backend = geocode_nominatim_test_new ();
+	g_object_set (backend, "memory-cache-enabled", TRUE, NULL);
+	geocode_nominatim_test_expect_query (GEOCODE_NOMINATIM_TEST (backend),
+	                                     params, "[]");
+
+	offline_backend = geocode_nominatim_test_new ();
+	g_object_set (offline_backend, "memory-cache-enabled", TRUE, NULL);
+
+	forward = geocode_forward_new_for_string ("xyzzy");
+
+	/* Without a negative cache, the lack of results is not remembered. */
+	g_object_set (backend, "negative-cache-ttl", 0, NULL);
+	geocode_forward_set_backend (forward, GEOCODE_BACKEND (backend));
+	g_assert_null (geocode_forward_search (forward, &error));
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_NO_MATCHES);
+	g_clear_error (&error);
+
+	geocode_forward_set_backend (forward, GEOCODE_BACKEND (offline_backend));
+	g_assert_null (geocode_forward_search (forward, &error));
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+	g_clear_error (&error);
+
+	/* With it, the same error is returned without querying again. */
+	g_object_set (backend, "negative-cache-ttl", 60, NULL);
+	geocode_forward_set_backend (forward, GEOCODE_BACKEND (backend));
+	g_assert_null (geocode_forward_search (forward, &error));
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_NO_MATCHES);
+	g_clear_error (&error);
+
+	geocode_forward_set_backend (forward, GEOCODE_BACKEND (offline_backend));
+	g_assert_null (geocode_forward_search (forward, &error));
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_NO_MATCHES);
+	g_clear_error (&error);
+
+	_geocode_memory_cache_clear ();
+}
+
+static void
+test_reverse_cache (void)
+{
+	g_autoptr (GHashTable) params = NULL;
+	g_autoptr (GeocodeNominatim) backend = NULL;
+	g_autoptr (GeocodeNominatim) offline_backend = NULL;
+	g_autoptr (GeocodeLocation) loc = NULL;
+	g_autoptr (GeocodeLocation) near_loc = NULL;
+	g_autoptr (GeocodeLocation) far_loc = NULL;
+	g_autoptr (GeocodeReverse) reverse = NULL;
+	g_autoptr (GeocodePlace) first = NULL;
+	g_autoptr (GeocodePlace) second = NULL;
+	g_autofree gchar *expected_response = NULL;
+	char lat[G_ASCII_DTOSTR_BUF_SIZE];
+	char lon[G_ASCII_DTOSTR_BUF_SIZE];
+	GError *error = NULL;
+	guint hits, misses;
+
+	set_up_cache ();
+	_geocode_reverse_cache_clear ();
+
+	loc = geocode_location_new (51.2370361, -0.5894834, GEOCODE_LOCATION_ACCURACY_UNKNOWN);
+	/* About 8 m and 110 m away. */
+	near_loc = geocode_location_new (51.2371, -0.5895, GEOCODE_LOCATION_ACCURACY_UNKNOWN);
+	far_loc = geocode_location_new (51.238, -0.5895, GEOCODE_LOCATION_ACCURACY_UNKNOWN);
+
+	params = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, NULL);
+	add_attr_string (params, "lat",
+	                 g_ascii_dtostr (lat, sizeof (lat),
+	                                 geocode_location_get_latitude (loc)));
+	add_attr_string (params, "lon",
+	                 g_ascii_dtostr (lon, sizeof (lon),
+	                                 geocode_location_get_longitude (loc)));
+
+	expected_response = load_json ("rev.json");
+
+	backend = geocode_nominatim_test_new ();
+	g_object_set (backend, "reverse-cache-radius", 25, NULL);
+	geocode_nominatim_test_expect_query (GEOCODE_NOMINATIM_TEST (backend),
+	                                     params, expected_response);
+
+	reverse = geocode_reverse_new_for_location (loc);
+	geocode_reverse_set_backend (reverse, GEOCODE_BACKEND (backend));
+	first = geocode_reverse_resolve (reverse, &error);
+	g_assert_no_error (error);
+	g_clear_object (&reverse);
+
+	/* A backend with no canned responses can only answer nearby locations
+	 * from the reverse cache. */
+	offline_backend = geocode_nominatim_test_new ();
+	g_object_set (offline_backend, "reverse-cache-radius", 25, NULL);
+
+	reverse = geocode_reverse_new_for_location (near_loc);
+	geocode_reverse_set_backend (reverse, GEOCODE_BACKEND (offline_backend));
+	second = geocode_reverse_resolve (reverse, &error);
+	g_assert_no_error (error);
+	g_assert_true (geocode_place_equal (first, second));
+	g_clear_object (&reverse);
+
+	reverse = geocode_reverse_new_for_location (far_loc);
+	geocode_reverse_set_backend (reverse, GEOCODE_BACKEND (offline_backend));
+	g_assert_null (geocode_reverse_resolve (reverse, &error));
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+	g_clear_error (&error);
+	g_clear_object (&reverse);
+
+	/* Results are only reused by backends with the same radius. */
+	g_object_set (offline_backend, "reverse-cache-radius", 50, NULL);
+	reverse = geocode_reverse_new_for_location (near_loc);
+	geocode_reverse_set_backend (reverse, GEOCODE_BACKEND (offline_backend));
+	g_assert_null (geocode_reverse_resolve (reverse, &error));
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+	g_clear_error (&error);
+
+	_geocode_reverse_cache_get_stats (&hits, &misses, NULL);
+	g_assert_cmpuint (hits, ==, 1);
+	g_assert_cmpuint (misses, ==, 3);
+
+	_geocode_reverse_cache_clear ();
+}
+
+static void
+test_stale_while_revalidate (void)
+{
+	g_autoptr (GHashTable) params = NULL;
+	g_autoptr (GeocodeNominatim) backend = NULL;
+	g_autoptr (GeocodeNominatim) offline_backend = NULL;
+	g_autoptr (GeocodeForward) forward = NULL;
+	g_autofree gchar *expected_response = NULL;
+	GList *places;
+	GError *error = NULL;
+
+	set_up_cache ();
+
+	params = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, NULL);
+	add_attr_string (params, "q", "stale");
+	add_attr_string (params, "limit", "10");
+	add_attr_string (params, "bounded", "0");
+
+	expected_response = load_json ("search.json");
+
+	backend = geocode_nominatim_test_new ();
+	g_object_set (backend,
+	              "cache-enabled", TRUE,
+	              "cache-ttl", 1,
+	              "stale-while-revalidate", 60,
+	              NULL);
+	geocode_nominatim_test_expect_query (GEOCODE_NOMINATIM_TEST (backend),
+	                                     params, expected_response);
+
+	offline_backend = geocode_nominatim_test_new ();
+	g_object_set (offline_backend, "cache-enabled", TRUE, NULL);
+
+	forward = geocode_forward_new_for_string ("stale");
+	geocode_forward_set_backend (forward, GEOCODE_BACKEND (backend));
+
+	places = geocode_forward_search (forward, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (g_list_length (places), ==, 10);
+	g_list_free_full (places, g_object_unref);
+
+	/* Wait for the results to go stale. */
+	g_usleep (1100 * G_TIME_SPAN_MILLISECOND);
+
+	/* Stale results are not returned by backends which would not refresh
+	 * them. */
+	geocode_forward_set_backend (forward, GEOCODE_BACKEND (offline_backend));
+	g_assert_null (geocode_forward_search (forward, &error));
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+	g_clear_error (&error);
+
+	/* Otherwise they are returned straight away, and refreshed in the
+	 * background. */
+	g_object_set (backend, "cache-ttl", 3600, NULL);
+	geocode_forward_set_backend (forward, GEOCODE_BACKEND (backend));
+
+	places = geocode_forward_search (forward, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (g_list_length (places), ==, 10);
+	g_list_free_full (places, g_object_unref);
+
+	while (g_main_context_iteration (NULL, FALSE));
+
+	geocode_forward_set_backend (forward, GEOCODE_BACKEND (offline_backend));
+	places = geocode_forward_search (forward, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (g_list_length (places), ==, 10);
+	g_list_free_full (places, g_object_unref);
+}
+
+typedef struct {
+	GString *sent;
+	char name;
+} ScheduledRequestData;
+
+static void
+record_request (gpointer user_data)
+{
+	ScheduledRequestData *data = user_data;
+
+	g_string_append_c (data->sent, data->name);
+}
+
+static void
+test_request_scheduler (void)
+{
+	GeocodeRequestScheduler *scheduler;
+	GeocodeScheduledRequest *request, *request_b, *request_c;
+	g_autoptr (GString) sent = NULL;
+	ScheduledRequestData a, b, c, d, e, f;
+	gdouble rate;
+	guint burst;
+	gint64 start;
+	GError *error = NULL;
+
+	scheduler = _geocode_request_scheduler_new ();
+	sent = g_string_new (NULL);
+	a = (ScheduledRequestData) { sent, 'a' };
+	b = (ScheduledRequestData) { sent, 'b' };
+	c = (ScheduledRequestData) { sent, 'c' };
+	d = (ScheduledRequestData) { sent, 'd' };
+	e = (ScheduledRequestData) { sent, 'e' };
+	f = (ScheduledRequestData) { sent, 'f' };
+
+	/* Without a rate limit, everything may be sent straight away. */
+	_geocode_request_scheduler_get_rate (scheduler, &rate, &burst);
+	g_assert_cmpfloat (rate, ==, 0.0);
+	g_assert_cmpuint (burst, ==, 1);
+
+	g_assert_true (_geocode_request_scheduler_submit (scheduler, G_PRIORITY_DEFAULT,
+	                                                  record_request, &a,
+	                                                  &request, &error));
+	g_assert_no_error (error);
+	g_assert_null (request);
+
+	/* Up to a burst may be sent straight away with a limit... */
+	_geocode_request_scheduler_set_rate (scheduler, 10.0, 2);
+	_geocode_request_scheduler_set_max_queued (scheduler, 3);
+
+	g_assert_true (_geocode_request_scheduler_submit (scheduler, G_PRIORITY_DEFAULT,
+	                                                  record_request, &a,
+	                                                  &request, &error));
+	g_assert_null (request);
+	g_assert_true (_geocode_request_scheduler_submit (scheduler, G_PRIORITY_DEFAULT,
+	                                                  record_request, &a,
+	                                                  &request, &error));
+	g_assert_null (request);
+
+	/* ...then requests are queued, by priority... */
+	g_assert_true (_geocode_request_scheduler_submit (scheduler, G_PRIORITY_LOW,
+	                                                  record_request, &b,
+	                                                  &request_b, &error));
+	g_assert_nonnull (request_b);
+	g_assert_true (_geocode_request_scheduler_submit (scheduler, G_PRIORITY_DEFAULT,
+	                                                  record_request, &c,
+	                                                  &request_c, &error));
+	g_assert_nonnull (request_c);
+	g_assert_true (_geocode_request_scheduler_submit (scheduler, G_PRIORITY_DEFAULT,
+	                                                  record_request, &d,
+	                                                  &request, &error));
+	g_assert_nonnull (request);
+	g_assert_no_error (error);
+
+	/* ...until the queue is full. */
+	g_assert_false (_geocode_request_scheduler_submit (scheduler, G_PRIORITY_DEFAULT,
+	                                                   record_request, &e,
+	                                                   &request, &error));
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_BUSY);
+	g_clear_error (&error);
+
+	/* Cancelled requests are withdrawn, making room for others. */
+	g_assert_true (_geocode_request_scheduler_cancel (scheduler, request));
+	g_assert_true (_geocode_request_scheduler_submit (scheduler, G_PRIORITY_HIGH,
+	                                                  record_request, &f,
+	                                                  &request, &error));
+	g_assert_no_error (error);
+	g_assert_nonnull (request);
+
+	/* Queued requests can be moved up the queue, but not down it; they
+	 * keep their place among requests of the same priority. */
+	_geocode_request_scheduler_raise_priority (scheduler, request_b, G_PRIORITY_HIGH);
+	_geocode_request_scheduler_raise_priority (scheduler, request_c, G_PRIORITY_LOW);
+
+	/* Queued requests are sent in order, at the limited rate. */
+	start = g_get_monotonic_time ();
+
+	while (sent->len < 3)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_assert_cmpstr (sent->str, ==, "bfc");
+	g_assert_cmpint (g_get_monotonic_time () - start, >=, 250 * G_TIME_SPAN_MILLISECOND);
+
+	_geocode_request_scheduler_free (scheduler);
+}
+
+static void
+test_retry_after (void)
+{
+	/* Sun, 06 Nov 1994 08:49:37 GMT */
+	const gint64 now = 784111777;
+	g_autoptr (GeocodeNominatim) backend = NULL;
+	guint delay, max_attempts, n_failed_attempts, n_retries;
+
+	g_assert_true (_geocode_glib_parse_retry_after ("120", now, &delay));
+	g_assert_cmpuint (delay, ==, 120);
+	g_assert_true (_geocode_glib_parse_retry_after (" 0 ", now, &delay));
+	g_assert_cmpuint (delay, ==, 0);
+	g_assert_true (_geocode_glib_parse_retry_after ("99999999999", now, &delay));
+	g_assert_cmpuint (delay, ==, G_MAXUINT);
+
+	g_assert_true (_geocode_glib_parse_retry_after ("Sun, 06 Nov 1994 08:50:07 GMT", now, &delay));
+	g_assert_cmpuint (delay, ==, 30);
+	g_assert_true (_geocode_glib_parse_retry_after ("Sun, 06 Nov 1994 08:00:00 GMT", now, &delay));
+	g_assert_cmpuint (delay, ==, 0);
+
+	g_assert_false (_geocode_glib_parse_retry_after ("", now, &delay));
+	g_assert_false (_geocode_glib_parse_retry_after ("12 seconds", now, &delay));
+	g_assert_false (_geocode_glib_parse_retry_after ("soon", now, &delay));
+
+	/* Failed requests are retried by default. */
+	backend = geocode_nominatim_new ("http://example.com", "me@example.com");
+	g_object_get (backend, "max-query-attempts", &max_attempts, NULL);
+	g_assert_cmpuint (max_attempts, >, 1);
+
+	geocode_nominatim_get_retry_stats (backend, &n_failed_attempts, &n_retries);
+	g_assert_cmpuint (n_failed_attempts, ==, 0);
+	g_assert_cmpuint (n_retries, ==, 0);
+}
+
+static void
+test_endpoint_pool (void)
+{
+	const char *base_urls[] = {
+		"https://a.example.com", "https://b.example.com", "https://c.example.com", NULL
+	};
+	GeocodeEndpointPool *pool;
+	gboolean seen[3] = { FALSE, };
+	gboolean available;
+	gdouble latency, error_rate;
+	guint endpoint, i;
+
+	pool = _geocode_endpoint_pool_new (base_urls);
+	g_assert_cmpuint (_geocode_endpoint_pool_get_n_endpoints (pool), ==, 3);
+	g_assert_cmpstr (_geocode_endpoint_pool_get_base_url (pool, 1), ==, "https://b.example.com");
+
+	/* Concurrent requests are spread over the endpoints. */
+	for (i = 0; i < 3; i++)
+		seen[_geocode_endpoint_pool_choose (pool, -1)] = TRUE;
+	g_assert_true (seen[0] && seen[1] && seen[2]);
+
+	_geocode_endpoint_pool_report (pool, 0, GEOCODE_ENDPOINT_SUCCESS, 100 * G_TIME_SPAN_MILLISECOND);
+	_geocode_endpoint_pool_report (pool, 1, GEOCODE_ENDPOINT_SUCCESS, 10 * G_TIME_SPAN_MILLISECOND);
+	_geocode_endpoint_pool_report (pool, 2, GEOCODE_ENDPOINT_SUCCESS, 50 * G_TIME_SPAN_MILLISECOND);
+
+	/* Then they go to the fastest one. */
+	endpoint = _geocode_endpoint_pool_choose (pool, -1);
+	g_assert_cmpuint (endpoint, ==, 1);
+	_geocode_endpoint_pool_report (pool, endpoint, GEOCODE_ENDPOINT_CANCELLED, 0);
+
+	_geocode_endpoint_pool_get_stats (pool, 1, &latency, &error_rate, &available);
+	g_assert_cmpfloat (latency, ==, 10 * G_TIME_SPAN_MILLISECOND);
+	g_assert_cmpfloat (error_rate, ==, 0.0);
+	g_assert_true (available);
+
+	/* Unless it keeps failing, which trips its circuit breaker. */
+	for (i = 0; i < 10 && available; i++) {
+		endpoint = _geocode_endpoint_pool_choose (pool, -1);
+		g_assert_cmpuint (endpoint, ==, 1);
+		_geocode_endpoint_pool_report (pool, endpoint, GEOCODE_ENDPOINT_FAILURE, 0);
+		_geocode_endpoint_pool_get_stats (pool, 1, NULL, &error_rate, &available);
+	}
+
+	g_assert_false (available);
+	g_assert_cmpfloat (error_rate, >=, 0.5);
+
+	endpoint = _geocode_endpoint_pool_choose (pool, -1);
+	g_assert_cmpuint (endpoint, ==, 2);
+	_geocode_endpoint_pool_report (pool, endpoint, GEOCODE_ENDPOINT_CANCELLED, 0);
+
+	/* Retries avoid the endpoint which failed; hedges need another
+	 * available endpoint. */
+	endpoint = _geocode_endpoint_pool_choose (pool, 2);
+	g_assert_cmpuint (endpoint, ==, 0);
+	_geocode_endpoint_pool_report (pool, endpoint, GEOCODE_ENDPOINT_CANCELLED, 0);
+
+	g_assert_true (_geocode_endpoint_pool_choose_alternative (pool, 2, &endpoint));
+	g_assert_cmpuint (endpoint, ==, 0);
+	_geocode_endpoint_pool_report (pool, endpoint, GEOCODE_ENDPOINT_CANCELLED, 0);
+
+	/* The hedge delay is the 95th percentile of recent latencies, once
+	 * there are enough of them. */
+	g_assert_cmpint (_geocode_endpoint_pool_get_hedge_delay (pool, 2), ==, G_TIME_SPAN_SECOND);
+
+	for (i = 1; i <= 20; i++) {
+		endpoint = _geocode_endpoint_pool_choose (pool, 0);
+		g_assert_cmpuint (endpoint, ==, 2);
+		_geocode_endpoint_pool_report (pool, endpoint, GEOCODE_ENDPOINT_SUCCESS,
+		                               i * 10 * G_TIME_SPAN_MILLISECOND);
+	}
+
+	g_assert_cmpint (_geocode_endpoint_pool_get_hedge_delay (pool, 2), ==, 190 * G_TIME_SPAN_MILLISECOND);
+
+	/* With every endpoint unavailable, one is still chosen. */
+	for (i = 0; i < 20; i++) {
+		endpoint = _geocode_endpoint_pool_choose (pool, -1);
+		_geocode_endpoint_pool_report (pool, endpoint, GEOCODE_ENDPOINT_FAILURE, 0);
+	}
+
+	for (i = 0; i < 3; i++) {
+		_geocode_endpoint_pool_get_stats (pool, i, NULL, NULL, &available);
+		g_assert_false (available);
+	}
+
+	endpoint = _geocode_endpoint_pool_choose (pool, -1);
+	g_assert_cmpuint (endpoint, <, 3);
+	_geocode_endpoint_pool_report (pool, endpoint, GEOCODE_ENDPOINT_CANCELLED, 0);
+
+	_geocode_endpoint_pool_free (pool);
+}
+
+static void
+test_deadline (void)
+{
+	GeocodeDeadline *deadline;
+	GCancellable *cancellable, *parent;
+	GeocodeForward *forward;
+	GeocodeLocation *loc;
+	GeocodeReverse *reverse;
+	GError *error = NULL;
+	guint timeout;
+	gint64 end_time;
+
+	/* Expiring cancels the operation, which then fails with a timeout. */
+	deadline = _geocode_deadline_new (50, NULL);
+	cancellable = _geocode_deadline_get_cancellable (deadline);
+
+	end_time = g_get_monotonic_time () + 10 * G_USEC_PER_SEC;
+	while (!g_cancellable_is_cancelled (cancellable) &&
+	       g_get_monotonic_time () < end_time)
+		g_usleep (10 * 1000);
+	g_assert_true (g_cancellable_is_cancelled (cancellable));
+
+	g_assert_true (g_cancellable_set_error_if_cancelled (cancellable, &error));
+	_geocode_deadline_check_error (deadline, &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT);
+	g_clear_error (&error);
+	_geocode_deadline_free (deadline);
+
+	/* Cancelling the caller's cancellable cancels the operation too, which
+	 * then fails as cancelled. */
+	parent = g_cancellable_new ();
+	deadline = _geocode_deadline_new (60 * 1000, parent);
+	cancellable = _geocode_deadline_get_cancellable (deadline);
+	g_assert_false (g_cancellable_is_cancelled (cancellable));
+
+	g_cancellable_cancel (parent);
+	g_assert_true (g_cancellable_is_cancelled (cancellable));
+
+	g_assert_true (g_cancellable_set_error_if_cancelled (cancellable, &error));
+	_geocode_deadline_check_error (deadline, &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+	g_clear_error (&error);
+	_geocode_deadline_free (deadline);
+	g_object_unref (parent);
+
+	/* Other errors are left alone. */
+	deadline = _geocode_deadline_new (60 * 1000, NULL);
+	g_set_error_literal (&error, GEOCODE_ERROR, GEOCODE_ERROR_NO_MATCHES, "No matches");
+	_geocode_deadline_check_error (deadline, &error);
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_NO_MATCHES);
+	g_clear_error (&error);
+	_geocode_deadline_free (deadline);
+
+	/* Queries have no deadline by default. */
+	forward = geocode_forward_new_for_string ("Paris");
+	g_assert_cmpuint (geocode_forward_get_timeout (forward), ==, 0);
+	geocode_forward_set_timeout (forward, 2500);
+	g_object_get (forward, "timeout", &timeout, NULL);
+	g_assert_cmpuint (timeout, ==, 2500);
+	g_object_unref (forward);
+
+	loc = geocode_location_new (48.8566, 2.3522, GEOCODE_LOCATION_ACCURACY_UNKNOWN);
+	reverse = geocode_reverse_new_for_location (loc);
+	g_assert_cmpuint (geocode_reverse_get_timeout (reverse), ==, 0);
+	geocode_reverse_set_timeout (reverse, 500);
+	g_object_get (reverse, "timeout", &timeout, NULL);
+	g_assert_cmpuint (timeout, ==, 500);
+	g_object_unref (reverse);
+	g_object_unref (loc);
+}
+
+static void
+test_place_serialization (void)
+{
+	g_autofree char *contents = NULL;
+	g_autoptr (GBytes) bytes = NULL;
+	g_autoptr (GBytes) empty = NULL;
+	g_autoptr (GBytes) old_version = NULL;
+	GList *places, *copies = NULL, *l, *m;
+	char *data;
+	gsize len;
+	GError *error = NULL;
+
+	contents = load_json ("search.json");
+	places = _geocode_parse_search_json (contents, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (places);
+
+	bytes = _geocode_place_list_serialize (places);
+	g_assert_true (_geocode_place_list_deserialize (bytes, &copies));
+	g_assert_cmpuint (g_list_length (copies), ==, g_list_length (places));
+
+	for (l = places, m = copies; l != NULL; l = l->next, m = m->next) {
+		g_assert_true (geocode_place_equal (l->data, m->data));
+		g_assert_cmpstr (geocode_place_get_osm_id (l->data), ==,
+		                 geocode_place_get_osm_id (m->data));
+		g_assert_cmpint (geocode_place_get_osm_type (l->data), ==,
+		                 geocode_place_get_osm_type (m->data));
+	}
+
+	g_list_free_full (copies, g_object_unref);
+
+	/* Entries from other versions and corrupt entries are rejected. */
+	data = g_memdup (g_bytes_get_data (bytes, &len), len);
+	data[0]++;
+	old_version = g_bytes_new_take (data, len);
+	g_assert_false (_geocode_place_list_deserialize (old_version, &copies));
+
+	empty = g_bytes_new (NULL, 0);
+	g_assert_false (_geocode_place_list_deserialize (empty, &copies));
+
+	g_list_free_full (places, g_object_unref);
+}
+
+static void
+remove_directory (const char *path)
+{
+	GDir *dir;
+	const char *name;
+
+	dir = g_dir_open (path, 0, NULL);
+	g_assert_nonnull (dir);
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		g_autofree char *child = g_build_filename (path, name, NULL);
+		g_assert_cmpint (g_unlink (child), ==, 0);
+	}
+
+	g_dir_close (dir);
+	g_assert_cmpint (g_rmdir (path), ==, 0);
+}
+
+/* Stores strings, for readability; the store itself is not limited to them. */
+static gboolean
+store_insert (GeocodeCacheStore  *store,
+              const char         *key,
+              const char         *value,
+              guint64             expires,
+              GError            **error)
+{
+	g_autoptr (GBytes) bytes = g_bytes_new (value, strlen (value));
+
+	return _geocode_cache_store_insert (store, key, bytes, expires, error);
+}
+
+static gboolean
+store_lookup (GeocodeCacheStore  *store,
+              const char         *key,
+              char              **value)
+{
+	g_autoptr (GBytes) bytes = NULL;
+	gsize len;
+	const char *data;
+
+	if (!_geocode_cache_store_lookup (store, key, &bytes))
+		return FALSE;
+
+	data = g_bytes_get_data (bytes, &len);
+	*value = g_strndup (data, len);
+
+	return TRUE;
+}
+
+static void
+test_cache_store (void)
+{
+	g_autofree char *dir = NULL;
+	g_autofree char *data_path = NULL;
+	GeocodeCacheStore *store;
+	GError *error = NULL;
+	guint n_entries, i;
+	guint64 data_size, live_bytes, new_size;
+	char *contents;
+	FILE *f;
+
+	dir = g_dir_make_tmp ("geocode-glib-test-store-XXXXXX", &error);
+	g_assert_no_error (error);
+	data_path = g_build_filename (dir, "cache.data", NULL);
+
+	store = _geocode_cache_store_open (dir, &error);
+	g_assert_no_error (error);
+
+	g_assert_false (store_lookup (store, "missing", &contents));
+
+	/* Enough entries to force the index to grow a few times. */
+	for (i = 0; i < 5000; i++) {
+		g_autofree char *key = g_strdup_printf ("key-%u", i);
+		g_autofree char *value = g_strdup_printf ("value-%u", i);
+
+		g_assert_true (store_insert (store, key, value, 0, &error));
+		g_assert_no_error (error);
+	}
+
+	g_assert_true (store_insert (store, "key-7", "replaced", 0, &error));
+	g_assert_no_error (error);
+	g_assert_true (_geocode_cache_store_sync (store, &error));
+	g_assert_no_error (error);
+
+	_geocode_cache_store_get_stats (store, &n_entries, NULL, NULL);
+	g_assert_cmpuint (n_entries, ==, 5000);
+
+	g_assert_true (store_lookup (store, "key-4999", &contents));
+	g_assert_cmpstr (contents, ==, "value-4999");
+	g_free (contents);
+
+	/* Entries persist across reopening the store. */
+	_geocode_cache_store_free (store);
+	store = _geocode_cache_store_open (dir, &error);
+	g_assert_no_error (error);
+
+	for (i = 0; i < 5000; i++) {
+		g_autofree char *key = g_strdup_printf ("key-%u", i);
+		g_autofree char *value = g_strdup_printf ("value-%u", i);
+
+		g_assert_true (store_lookup (store, key, &contents));
+		g_assert_cmpstr (contents, ==, (i == 7) ? "replaced" : value);
+		g_free (contents);
+	}
+
+	/* A torn append is dropped when the store is reopened. */
+	_geocode_cache_store_get_stats (store, NULL, &data_size, NULL);
+	_geocode_cache_store_free (store);
+
+	f = fopen (data_path, "ab");
+	g_assert_nonnull (f);
+	fputs ("GCRC half a record", f);
+	fclose (f);
+
+	store = _geocode_cache_store_open (dir, &error);
+	g_assert_no_error (error);
+
+	_geocode_cache_store_get_stats (store, &n_entries, &new_size, NULL);
+	g_assert_cmpuint (n_entries, ==, 5000);
+	g_assert_cmpuint (new_size, ==, data_size);
+
+	g_assert_true (store_insert (store, "after-crash", "ok", 0, &error));
+	g_assert_no_error (error);
+	g_assert_true (store_lookup (store, "after-crash", &contents));
+	g_assert_cmpstr (contents, ==, "ok");
+	g_free (contents);
+
+	/* Replacing every entry leaves half the data file as garbage, which
+	 * compaction removes. */
+	for (i = 0; i < 5000; i++) {
+		g_autofree char *key = g_strdup_printf ("key-%u", i);
+		g_autofree char *value = g_strdup_printf ("VALUE-%u", i);
+
+		g_assert_true (store_insert (store, key, value, 0, &error));
+		g_assert_no_error (error);
+	}
+
+	_geocode_cache_store_get_stats (store, NULL, &data_size, &live_bytes);
+	g_assert_cmpuint (live_bytes, <, data_size);
+
+	g_assert_true (_geocode_cache_store_compact (store, &error));
+	g_assert_no_error (error);
+
+	_geocode_cache_store_get_stats (store, &n_entries, &new_size, &live_bytes);
+	g_assert_cmpuint (n_entries, ==, 5001);
+	g_assert_cmpuint (new_size, <, data_size);
+	g_assert_cmpuint (live_bytes, <, new_size);
+
+	for (i = 0; i < 5000; i++) {
+		g_autofree char *key = g_strdup_printf ("key-%u", i);
+		g_autofree char *value = g_strdup_printf ("VALUE-%u", i);
+
+		g_assert_true (store_lookup (store, key, &contents));
+		g_assert_cmpstr (contents, ==, value);
+		g_free (contents);
+	}
+
+	_geocode_cache_store_free (store);
+	remove_directory (dir);
+}
+
+static void
+test_cache_store_eviction (void)
+{
+	g_autofree char *dir = NULL;
+	GeocodeCacheStore *store;
+	GError *error = NULL;
+	guint n_entries, n_found, i;
+	guint64 now, data_size, live_bytes, trimmed_size;
+	char *contents;
+
+	dir = g_dir_make_tmp ("geocode-glib-test-store-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	store = _geocode_cache_store_open (dir, &error);
+	g_assert_no_error (error);
+
+	/* Expired entries are never returned. */
+	now = g_get_real_time () / G_USEC_PER_SEC;
+
+	g_assert_true (store_insert (store, "expired", "old", now - 1, &error));
+	g_assert_no_error (error);
+	g_assert_true (store_insert (store, "fresh", "new", now + 3600, &error));
+	g_assert_no_error (error);
+
+	g_assert_false (store_lookup (store, "expired", &contents));
+	g_assert_true (store_lookup (store, "fresh", &contents));
+	g_assert_cmpstr (contents, ==, "new");
+	g_free (contents);
+
+	for (i = 0; i < 3000; i++) {
+		g_autofree char *key = g_strdup_printf ("key-%u", i);
+		g_autofree char *value = g_strdup_printf ("value-%u", i);
+
+		g_assert_true (store_insert (store, key, value, 0, &error));
+		g_assert_no_error (error);
+	}
+
+	/* Incremental eviction brings the store within its limits. */
+	_geocode_cache_store_set_limits (store, G_MAXUINT64, 1000);
+	g_assert_true (_geocode_cache_store_is_over_limits (store));
+
+	while (_geocode_cache_store_evict (store, 64));
+
+	g_assert_false (_geocode_cache_store_is_over_limits (store));
+	_geocode_cache_store_get_stats (store, &n_entries, &data_size, &live_bytes);
+	g_assert_cmpuint (n_entries, <=, 1000);
+	g_assert_cmpuint (n_entries, >, 0);
+
+	/* Every entry left in the index can still be found after the others
+	 * were removed from around it. */
+	n_found = store_lookup (store, "fresh", &contents) ? 1 : 0;
+	if (n_found > 0)
+		g_free (contents);
+	g_assert_false (store_lookup (store, "expired", &contents));
+
+	for (i = 0; i < 3000; i++) {
+		g_autofree char *key = g_strdup_printf ("key-%u", i);
+		g_autofree char *value = g_strdup_printf ("value-%u", i);
+
+		if (store_lookup (store, key, &contents)) {
+			g_assert_cmpstr (contents, ==, value);
+			g_free (contents);
+			n_found++;
+		}
+	}
+
+	g_assert_cmpuint (n_found, ==, n_entries);
+
+	/* A synchronous trim enforces a size limit and releases the space. */
+	_geocode_cache_store_set_limits (store, 4096, G_MAXUINT);
+	g_assert_true (_geocode_cache_store_trim (store, &error));
+	g_assert_no_error (error);
+
+	_geocode_cache_store_get_stats (store, &n_entries, &trimmed_size, &live_bytes);
+	g_assert_cmpuint (n_entries, >, 0);
+	g_assert_cmpuint (live_bytes, <=, 4096);
+	g_assert_cmpuint (trimmed_size, <, data_size);
+
+	_geocode_cache_store_free (store);
+	remove_directory (dir);
+}
+
+static void
+test_cache_store_compression (void)
+{
+	g_autofree char *dir = NULL;
+	g_autoptr (GString) value = NULL;
+	GeocodeCacheStore *store;
+	GError *error = NULL;
+	guint64 live_bytes, plain_bytes;
+	char *contents;
+	guint i;
+	const GeocodeCacheCodec codecs[] = {
+		GEOCODE_CACHE_CODEC_ZLIB,
+		GEOCODE_CACHE_CODEC_LZ4,
+	};
+
+	dir = g_dir_make_tmp ("geocode-glib-test-store-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	store = _geocode_cache_store_open (dir, &error);
+	g_assert_no_error (error);
+
+	value = g_string_new (NULL);
+	for (i = 0; i < 100; i++)
+		g_string_append_printf (value, "{\"place_id\":\"%u\",\"type\":\"city\"},", i);
+
+	g_assert_true (store_insert (store, "plain", value->str, 0, &error));
+	g_assert_no_error (error);
+	_geocode_cache_store_get_stats (store, NULL, NULL, &plain_bytes);
+
+	for (i = 0; i < G_N_ELEMENTS (codecs); i++) {
+		g_autofree char *key = g_strdup_printf ("codec-%u", codecs[i]);
+		guint64 previous_bytes;
+
+		if (!_geocode_cache_store_codec_is_supported (codecs[i]))
+			continue;
+
+		_geocode_cache_store_set_codec (store, codecs[i]);
+		_geocode_cache_store_get_stats (store, NULL, NULL, &previous_bytes);
+
+		g_assert_true (store_insert (store, key, value->str, 0, &error));
+		g_assert_no_error (error);
+
+		_geocode_cache_store_get_stats (store, NULL, NULL, &live_bytes);
+		g_assert_cmpuint (live_bytes - previous_bytes, <, plain_bytes / 2);
+
+		g_assert_true (store_lookup (store, key, &contents));
+		g_assert_cmpstr (contents, ==, value->str);
+		g_free (contents);
+
+		/* Values too small to gain anything are stored as they are. */
+		g_assert_true (store_insert (store, "small", "tiny", 0, &error));
+		g_assert_no_error (error);
+		g_assert_true (store_lookup (store, "small", &contents));
+		g_assert_cmpstr (contents, ==, "tiny");
+		g_free (contents);
+	}
+
+	/* Entries written with any codec can be read after reopening, whatever
+	 * the current codec is. */
+	_geocode_cache_store_free (store);
+	store = _geocode_cache_store_open (dir, &error);
+	g_assert_no_error (error);
+
+	g_assert_true (store_lookup (store, "plain", &contents));
+	g_assert_cmpstr (contents, ==, value->str);
+	g_free (contents);
+
+	for (i = 0; i < G_N_ELEMENTS (codecs); i++) {
+		g_autofree char *key = g_strdup_printf ("codec-%u", codecs[i]);
+
+		if (!_geocode_cache_store_codec_is_supported (codecs[i]))
+			continue;
+
+		g_assert_true (store_lookup (store, key, &contents));
+		g_assert_cmpstr (contents, ==, value->str);
+		g_free (contents);
+	}
+
+	_geocode_cache_store_free (store);
+	remove_directory (dir);
+}
+
 static GeocodeLocation *
 new_loc (void)
 {
@@ -921,6 +2885,12 @@ int main (int argc, char **argv)
 	if (command_line_params == NULL) {
 		g_test_add_func ("/geocode/resolve_json", test_resolve_json);
 		g_test_add_func ("/geocode/search_json", test_search_json);
+		g_test_add_func ("/geocode/search_parser", test_search_parser);
+		g_test_add_func ("/geocode/result_decoder", test_result_decoder);
+		g_test_add_func ("/geocode/place_type", test_place_type);
+		g_test_add_func ("/geocode/result_members", test_result_members);
+		g_test_add_func ("/geocode/place_fields", test_place_fields);
+		g_test_add_func ("/geocode/disambiguation", test_disambiguation);
 		g_test_add_func ("/geocode/reverse", test_rev);
 		g_test_add_func ("/geocode/reverse_fail", test_rev_fail);
 		g_test_add_func ("/geocode/pub", test_pub);
@@ -928,10 +2898,28 @@ int main (int argc, char **argv)
 		g_test_add_func ("/geocode/locale_name", test_locale_name);
 		g_test_add_func ("/geocode/locale_format", test_locale_format);
 		g_test_add_func ("/geocode/search", test_search);
+		g_test_add_func ("/geocode/prepared_search", test_prepared_search);
+		g_test_add_func ("/geocode/forward_search_batch", test_forward_search_batch);
 		g_test_add_func ("/geocode/search_lat_long", test_search_lat_long);
 		g_test_add_func ("/geocode/distance", test_distance);
 		g_test_add_func ("/geocode/zero_distance", test_zero_distance);
 		g_test_add_func ("/geocode/osm_type", test_osm_type);
+		g_test_add_func ("/geocode/connection_pool", test_connection_pool);
+		g_test_add_func ("/geocode/query_coalescing", test_query_coalescing);
+		g_test_add_func ("/geocode/language", test_language);
+		g_test_add_func ("/geocode/cache_key", test_cache_key);
+		g_test_add_func ("/geocode/memory_cache", test_memory_cache);
+		g_test_add_func ("/geocode/negative_cache", test_negative_cache);
+		g_test_add_func ("/geocode/reverse_cache", test_reverse_cache);
+		g_test_add_func ("/geocode/stale_while_revalidate", test_stale_while_revalidate);
+		g_test_add_func ("/geocode/request_scheduler", test_request_scheduler);
+		g_test_add_func ("/geocode/retry_after", test_retry_after);
+		g_test_add_func ("/geocode/endpoint_pool", test_endpoint_pool);
+		g_test_add_func ("/geocode/deadline", test_deadline);
+		g_test_add_func ("/geocode/place_serialization", test_place_serialization);
+		g_test_add_func ("/geocode/cache_store", test_cache_store);
+		g_test_add_func ("/geocode/cache_store_eviction", test_cache_store_eviction);
+		g_test_add_func ("/geocode/cache_store_compression", test_cache_store_compression);
 		return g_test_run ();
 	}
 
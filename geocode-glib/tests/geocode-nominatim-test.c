@@ -216,9 +216,14 @@ geocode_nominatim_test_new (void)
 	 * will pollute it. */
 	g_assert (g_str_has_prefix (g_get_user_cache_dir (), g_get_tmp_dir ()));
 
+	/* The result caches are shared by the whole process, so disable them
+	 * by default: otherwise results would leak between test cases which
+	 * expect different responses for the same query. */
 	return GEOCODE_NOMINATIM (g_object_new (GEOCODE_TYPE_NOMINATIM_TEST,
 	                                        "base-url", "http://example.invalid",
 	                                        "maintainer-email-address", "maintainer@invalid",
+	                                        "memory-cache-enabled", FALSE,
+	                                        "cache-enabled", FALSE,
 	                                        NULL));
 }
 
@@ -560,6 +560,99 @@ test_reverse_error (void)
 	g_assert_cmpuint (query_log->len, ==, 1);
 }
 
+static void
+got_batch_results_cb (GObject      *source_object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+	GeocodeBatchResults **results = user_data;
+	g_autoptr (GError) error = NULL;
+
+	*results = geocode_backend_reverse_resolve_batch_finish (GEOCODE_BACKEND (source_object),
+	                                                         result, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (*results);
+}
+
+/* Test that a batch of reverse queries resolves each cell of the points once,
+ * and gives its results to all the points in it. */
+static void
+test_reverse_batch (void)
+{
+	g_autoptr (GeocodeMockBackend) backend = NULL;
+	g_autoptr (GHashTable) params = NULL;
+	g_autoptr (GeocodeBatchResults) results = NULL;
+	g_autoptr (PlaceList) expected_results = NULL;
+	g_autoptr (PlaceList) other_expected_results = NULL;
+	g_autoptr (GeocodeLocation) location = NULL;
+	g_autoptr (GError) error = NULL;
+	GPtrArray *query_log;  /* (element-type GeocodeMockBackendQuery) */
+	const gdouble coordinates[] = {
+		52.2127749, 0.0806149693681216,
+		52.2128, 0.0806,  /* in the same cell as the first */
+		51.5074, -0.1278,
+		52.2127, 0.0807,  /* back in the cell of the first */
+		91.0, 0.0,  /* invalid */
+	};
+	guint i;
+
+	backend = geocode_mock_backend_new ();
+
+	/* Build the set of results the mock backend should return, for the
+	 * first point in each cell. */
+	location = geocode_location_new (52.2127749, 0.0806149693681216, 10.0);
+	expected_results = g_list_prepend (NULL,
+	                                   geocode_place_new_with_location ("British Antarctic Survey",
+	                                                                    GEOCODE_PLACE_TYPE_BUILDING,
+	                                                                    location));
+	params = build_double_params ("lat", 52.2127749,
+	                              "lon", 0.0806149693681216,
+	                              NULL);
+	geocode_mock_backend_add_reverse_result (backend, params,
+	                                         expected_results, NULL);
+	g_clear_pointer (&params, g_hash_table_unref);
+	g_clear_object (&location);
+
+	location = geocode_location_new (51.5074, -0.1278, 10.0);
+	other_expected_results = g_list_prepend (NULL,
+	                                         geocode_place_new_with_location ("Charing Cross",
+	                                                                          GEOCODE_PLACE_TYPE_STREET,
+	                                                                          location));
+	params = build_double_params ("lat", 51.5074,
+	                              "lon", -0.1278,
+	                              NULL);
+	geocode_mock_backend_add_reverse_result (backend, params,
+	                                         other_expected_results, NULL);
+
+	/* Resolve the points. */
+	geocode_backend_reverse_resolve_batch_async (GEOCODE_BACKEND (backend),
+	                                             coordinates,
+	                                             G_N_ELEMENTS (coordinates) / 2,
+	                                             GEOCODE_LOCATION_ACCURACY_STREET,
+	                                             NULL, got_batch_results_cb,
+	                                             &results);
+
+	while (results == NULL)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_assert_cmpuint (geocode_batch_results_get_n_items (results), ==, 5);
+
+	for (i = 0; i < 4; i++) {
+		g_autoptr (PlaceList) places = NULL;
+
+		places = geocode_batch_results_get_places (results, i, &error);
+		g_assert_no_error (error);
+		assert_place_list_equal (places,
+		                         (i == 2) ? other_expected_results : expected_results);
+	}
+
+	g_assert_null (geocode_batch_results_get_places (results, 4, &error));
+	g_assert_error (error, GEOCODE_ERROR, GEOCODE_ERROR_INVALID_ARGUMENTS);
+
+	query_log = geocode_mock_backend_get_query_log (backend);
+	g_assert_cmpuint (query_log->len, ==, 2);
+}
+
 /* Test that the query log and clear functionality on the backend works. */
 static void
 test_clear (void)
@@ -647,6 +740,7 @@ main (int argc, char **argv)
 	g_test_add_func ("/mock-backend/reverse-no-results",
 	                 test_reverse_no_results);
 	g_test_add_func ("/mock-backend/reverse-error", test_reverse_error);
+	g_test_add_func ("/mock-backend/reverse-batch", test_reverse_batch);
 
 	g_test_add_func ("/mock-backend/clear", test_clear);
 